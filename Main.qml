@@ -7,6 +7,16 @@ import PanoramaPlayer
 PanoramaView {
     id: panoramaView
     debugOpenGL: appDebugOpenGL
+    zeroCopy: appZeroCopy
+    rhiRenderer: appRhiRenderer
+    captureRate: appCaptureRate
+    captureWidth: appCaptureWidth
+    gpuBudget: appGpuBudget
+    gpuStats: appGpuStats
+    coverage: appCoverage.width > 0 ? appCoverage : panoramaPlayer.coverage
+    projection: appProjection !== PanoramaView.ProjectionAuto ? appProjection : panoramaPlayer.projection
+    cubemapPadding: panoramaPlayer.cubemapPadding
+    stereoMode: appStereoMode !== PanoramaView.StereoAuto ? appStereoMode : panoramaPlayer.stereoMode
 
     readonly property string runIdleCommand: "backlight"
     
@@ -60,6 +70,8 @@ PanoramaView {
         //source: appSourceUrl.toString() ? appSourceUrl : allVideoFiles("/srv/http/player")[0]
         source: configReceiver.videoSource
         audioOutput: AudioOutput { }
+        loopCache: appLoopCache
+        loopCacheDir: appLoopCacheDir
         videoOutput: panoramaView
         /*onMetaDataChanged: {
             var list = metaData.keys()
@@ -84,9 +96,8 @@ PanoramaView {
         }
     }
 
-    onPitchAngleChanged: {
-        console.log(pitchIdleAngle)
-        if (pitchAngle < pitchIdleAngle && !panoramaPlayer.isPlaying() &&
+    onPitchDegreeChanged: {
+        if (pitchDegree < pitchIdleAngle && !panoramaPlayer.isPlaying() &&
                 panoramaPlayer.mediaState !== PanoramaPlayer.MediaUnknown) {
             idleTimer.stop()
             systemProcess.startCommand(runIdleCommand + " 1")
@@ -97,7 +108,7 @@ PanoramaView {
     Timer {
         id: idleTimer
         interval: configReceiver.screenSaver * 60000
-        running: !pitchAngle || pitchAngle >= pitchIdleAngle
+        running: !pitchDegree || pitchDegree >= pitchIdleAngle
         onTriggered: {
             panoramaPlayer.stop()
             systemProcess.startCommand(runIdleCommand + " 0")
@@ -112,10 +123,13 @@ PanoramaView {
         enableCompass: configReceiver.enableCompass
         adjustAngle: configReceiver.adjustAngle
         smoothingFactor: configReceiver.smoothingFactor
+        maxPrediction: appPrediction
+        maxPredictionAngle: appPredictionAngle
+        filter: appSensorFilter
+        displayLatency: panoramaView.photonLatency
         //Component.onCompleted: print(allPortNames())
     }
-    pitchAngle: serialSensor.pitchAngle
-    yawAngle: serialSensor.yawAngle
+    orientation: serialSensor.orientation
 
     ConfigReceiver {
         id: configReceiver
@@ -135,6 +149,7 @@ PanoramaView {
     stereoShift: configReceiver.stereoShift
     fovAngle: configReceiver.fovAngle
     readonly property int pitchIdleAngle: configReceiver.pitchIdleAngle
+    readonly property int pitchDegree: serialSensor.pitchDegree // notified by the degree only
     readonly property int rotateImage: rotateDisplay < 0 ? 270 : 90 * rotateDisplay
 
     Image {
@@ -0,0 +1,36 @@
+import QtQuick
+import PanoramaPlayer
+
+// An extra output of the frames decoded for Main.qml, see the --spectator option.
+// The frameSource, monoDisplay and sensorPort are the initial properties set by main.cpp.
+PanoramaView {
+    id: spectatorView
+    property string sensorPort // of a second headset, else empty
+    debugOpenGL: frameSource.debugOpenGL
+    coverage: frameSource.coverage
+    projection: frameSource.projection
+    cubemapPadding: frameSource.cubemapPadding
+    stereoMode: frameSource.stereoMode
+    stereoShift: frameSource.stereoShift
+    rotateDisplay: monoDisplay ? 0 : frameSource.rotateDisplay
+    fovAngle: frameSource.fovAngle
+
+    // A second headset by its own sensor, else follows the headset of the main output
+    SerialSensor {
+        id: headsetSensor
+        active: spectatorView.sensorPort !== ""
+        portName: spectatorView.sensorPort
+        maxPrediction: appPrediction
+        maxPredictionAngle: appPredictionAngle
+        filter: appSensorFilter
+        displayLatency: spectatorView.photonLatency
+    }
+    orientation: sensorPort ? headsetSensor.orientation : frameSource.orientation
+
+    Text {
+        anchors.centerIn: parent
+        color: "white"
+        text: spectatorView.errorText || headsetSensor.errorText
+        visible: text
+    }
+}
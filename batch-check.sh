@@ -0,0 +1,33 @@
+#!/bin/sh
+
+# The faster than real time check of panoramabatch, run by ctest: a generated 360 clip is
+# rendered to the raw frames on the default platform, EGL surfaceless without an X display
+# (e.g. Mesa llvmpipe on a CI runner). Fails if frames are missing or it took longer than
+# the clip plays.
+#
+#     batch-check.sh build/panoramabatch [seconds]
+
+BATCH=${1:?usage: $0 <panoramabatch> [seconds]}
+DURATION=${2:-10}
+WIDTH=640
+HEIGHT=360
+RATE=30
+
+DIR=$(mktemp -d) || exit 1
+trap 'rm -rf "$DIR"' EXIT
+
+ffmpeg -v error -f lavfi -i "testsrc2=size=3840x1920:rate=$RATE" -t "$DURATION" \
+    -pix_fmt yuv420p -c:v libx264 -preset ultrafast "$DIR/clip360.mp4" || exit 1
+
+START=$(date +%s%N)
+BYTES=$("$BATCH" --projection 360 -s ${WIDTH}x${HEIGHT} "$DIR/clip360.mp4" - | wc -c)
+ELAPSED=$(( ($(date +%s%N) - START) / 1000000 ))
+FRAMES=$(( BYTES / (WIDTH * HEIGHT * 4) ))
+
+echo "panoramabatch: $FRAMES frames of $DURATION s rendered in $ELAPSED ms"
+if [ "$FRAMES" -lt $(( DURATION * RATE - 1 )) ]; then
+    echo "Frames missing, $(( DURATION * RATE )) expected" && exit 1
+fi
+if [ "$ELAPSED" -ge $(( DURATION * 1000 )) ]; then
+    echo "Slower than real time" && exit 1
+fi
@@ -34,4 +34,6 @@ export QT_QPA_EGLFS_FORCEVSYNC=0
 #export QT_FFMPEG_HW_ALLOW_PROFILE_MISMATCH=1
 
 export LD_LIBRARY_PATH=/usr/local/Qt6.8.3/lib
+# The head tracker keeps the sensor initialized across the player restarts
+pgrep -x panoramatracker >/dev/null || /home/user/repos/PanoramaPlayer/build/panoramatracker -p ttyAMA0 >/dev/null 2>&1 &
 /home/user/repos/PanoramaPlayer/build/panoramaplay -d >&2 DEBUG.txt
@@ -18,7 +18,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-uniform sampler2D plane0;
+uniform $PLANE0_SAMPLER plane0; // samplerExternalOES for the imported OES frames
 uniform sampler2D plane1;
 uniform sampler2D plane2;
 uniform sampler2D plane3;
@@ -28,8 +28,15 @@ const int Format_YUVp = 2;
 const int Format_YVUp = 3;
 const int Format_YUVsp = 4;
 const int Format_Y = 5;
+const int Format_YUVi = 6; // packed 4:4:4, plane0.rgb = yuv
+const int Format_YUYV = 7; // packed 4:2:2, two pixels per plane0 texel Y0 U Y1 V
 const int planeFormat = $PLANE_FORMAT;
 
+// 16 bit samples uploaded as little-endian byte pairs when the normalized
+// 16 bit textures are not available; the 10 bit samples need a rescale
+const bool planeSplit16 = $PLANE_SPLIT16;
+const float sampleScale = $SAMPLE_SCALE;
+
 const bool colorRangeSmall = $COLOR_RANGE_SMALL;
 
 const int CS_BT601 = 1;
@@ -44,7 +51,7 @@ const int CT_STD_B67 = 3;
 const int colorTransfer = $COLOR_TRANSFER;
 uniform float masteringWhite;
 
-smooth in vec2 vtexcoord;
+smooth in highp vec2 vtexcoord; // the packed formats need the exact pixel column
 
 layout(location = 0) out vec4 fcolor;
 
@@ -60,6 +67,16 @@ vec3 rgb_to_linear(vec3 rgb)
     return vec3(to_linear(rgb.r), to_linear(rgb.g), to_linear(rgb.b));
 }
 
+highp float plane_r(highp vec4 t)
+{
+    return planeSplit16 ? (t.g * 65280.0 + t.r * 255.0) / 65535.0 : t.r;
+}
+
+highp vec2 plane_rg(highp vec4 t)
+{
+    return planeSplit16 ? (t.ga * 65280.0 + t.rb * 255.0) / 65535.0 : t.rg;
+}
+
 void main(void)
 {
     vec3 yuv = vec3(1.0, 0.0, 0.0);
@@ -67,23 +84,31 @@ void main(void)
     if (planeFormat == Format_RGB) {
         rgb = texture(plane0, vtexcoord).rgb;
     } else if (planeFormat == Format_Y) {
-        rgb = texture(plane0, vtexcoord).rrr;
+        rgb = vec3(plane_r(texture(plane0, vtexcoord)));
     } else {
-        if (planeFormat == Format_YUVp) {
+        if (planeFormat == Format_YUVi) {
+            yuv = texture(plane0, vtexcoord).rgb;
+        } else if (planeFormat == Format_YUYV) {
+            // The plane0 is half width and nearest filtered, select the luma by the pixel column
+            vec4 t = texture(plane0, vtexcoord);
+            highp float x = floor(vtexcoord.x * float(textureSize(plane0, 0).x) * 2.0);
+            yuv = vec3(mod(x, 2.0) < 1.0 ? t.r : t.b, t.g, t.a);
+        } else if (planeFormat == Format_YUVp) {
             yuv = vec3(
-                    texture(plane0, vtexcoord).r,
-                    texture(plane1, vtexcoord).r,
-                    texture(plane2, vtexcoord).r);
+                    plane_r(texture(plane0, vtexcoord)),
+                    plane_r(texture(plane1, vtexcoord)),
+                    plane_r(texture(plane2, vtexcoord)));
         } else if (planeFormat == Format_YVUp) {
             yuv = vec3(
-                    texture(plane0, vtexcoord).r,
-                    texture(plane2, vtexcoord).r,
-                    texture(plane1, vtexcoord).r);
+                    plane_r(texture(plane0, vtexcoord)),
+                    plane_r(texture(plane2, vtexcoord)),
+                    plane_r(texture(plane1, vtexcoord)));
         } else if (planeFormat == Format_YUVsp) {
             yuv = vec3(
-                    texture(plane0, vtexcoord).r,
-                    texture(plane1, vtexcoord).rg);
+                    plane_r(texture(plane0, vtexcoord)),
+                    plane_rg(texture(plane1, vtexcoord)));
         }
+        yuv *= sampleScale;
         mat4 m;
         // The following matrices are the same as used by Qt,
         // see qtmultimedia/src/multimedia/video/qvideotexturehelper.cpp
@@ -1,5 +1,6 @@
 uniform sampler2D view_tex;
 uniform int rotate_dir;
+uniform vec2 view_rect; // the eye half of the view texture: left, width
 
 smooth in vec2 vtexcoord;
 layout(location = 0) out vec4 fcolor;
@@ -26,6 +27,7 @@ float to_nonlinear(float x)
 void main(void)
 {
     vec2 coord = rotate_dir != 0 ? to_rotate(vtexcoord) : vtexcoord;
+    coord.x = view_rect.x + coord.x * view_rect.y;
     vec3 rgb = texture2D(view_tex, coord).rgb;
     fcolor = vec4(vec3(to_nonlinear(rgb.r), to_nonlinear(rgb.g), to_nonlinear(rgb.b)), 1.0);
 }
@@ -0,0 +1,21 @@
+uniform sampler2D atlas_tex;
+
+smooth in vec2 vtexcoord;
+
+layout(location = 0) out vec4 fcolor;
+
+float to_linear(float x)
+{
+    return (x <= 0.04045 ? (x / 12.92) : pow((x + 0.055) / 1.055, 2.4));
+}
+
+void main(void)
+{
+    // The atlas is premultiplied sRGB, the view texture is linear, see display.frag
+    vec4 color = texture(atlas_tex, vtexcoord);
+    if (color.a > 0.0) {
+        vec3 rgb = color.rgb / color.a;
+        color.rgb = vec3(to_linear(rgb.r), to_linear(rgb.g), to_linear(rgb.b)) * color.a;
+    }
+    fcolor = color;
+}
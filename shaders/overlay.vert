@@ -0,0 +1,28 @@
+uniform mat4 projection;
+uniform mat4 orientation;
+uniform vec2 eye_xoffs; // the eye position in view space per eye, in meters
+uniform int eye_count; // 1 for the mono display
+
+// Per overlay, advanced once per eye pair by the attribute divisor
+layout(location = 0) in vec3 center;
+layout(location = 1) in vec3 right;
+layout(location = 2) in vec3 up;
+layout(location = 3) in vec4 rect;
+
+smooth out vec2 vtexcoord;
+
+void main(void)
+{
+    // The quad as a triangle strip without vertex buffer
+    vec2 corner = vec2(float(gl_VertexID & 1), float(gl_VertexID >> 1)) * 2.0 - 1.0;
+    vtexcoord = rect.xy + vec2(corner.x + 1.0, 1.0 - corner.y) * 0.5 * rect.zw;
+    vec4 world = vec4(center + right * corner.x + up * corner.y, 1.0);
+
+    // The overlays are nearer than the sphere, so they shift by the eye position,
+    // the depth is replaced by the eye x to clip the eye within its half as view.vert
+    int eye = eye_count == 2 ? gl_InstanceID & 1 : 0;
+    vec4 view = orientation * world;
+    view.x -= eye_xoffs[eye];
+    vec4 pos = projection * view;
+    gl_Position = vec4(pos.x * 0.5 + (float(eye) - 0.5) * pos.w, pos.y, pos.x, pos.w);
+}
@@ -0,0 +1,23 @@
+#version 440
+
+// The QRhi variant of shaders/color.vert: the full frame quad as a triangle strip
+// without the vertex buffer, see RhiVideoRenderer.cpp
+
+layout(std140, binding = 0) uniform buf {
+    mat4 clip_corr; // the row 0 of the render target is at the top, see RhiVideoRenderer::offscreenCorrMatrix()
+    int plane_format;
+    int color_space;
+    int color_transfer;
+    int color_range_small;
+    float sample_scale;
+    float mastering_white;
+};
+
+layout(location = 0) out vec2 vtexcoord;
+
+void main(void)
+{
+    vec2 pos = vec2(float((gl_VertexIndex & 1) * 2 - 1), float((gl_VertexIndex & 2) - 1));
+    vtexcoord = vec2(pos.x + 1.0, 1.0 - pos.y) * 0.5;
+    gl_Position = clip_corr * vec4(pos, 0.0, 1.0);
+}
@@ -0,0 +1,38 @@
+#version 440
+
+// The QRhi variant of shaders/display.frag
+
+layout(std140, binding = 0) uniform buf {
+    mat4 clip_corr;
+    vec2 view_rect; // the eye half of the view texture: left, width
+    int rotate_dir;
+};
+
+layout(binding = 1) uniform sampler2D view_tex;
+
+layout(location = 0) in vec2 vtexcoord;
+
+layout(location = 0) out vec4 fcolor;
+
+vec2 to_rotate(vec2 uv)
+{
+    float cos_factor = rotate_dir > 0 ? 1.0 : -1.0;
+    mat2 rotation = mat2(vec2(0.0, -cos_factor),
+                         vec2(cos_factor, 0.0));
+    return (uv - 0.5) * rotation + 0.5;
+}
+
+float to_nonlinear(float x)
+{
+    const float c0 = 0.416666666667;
+    return (x <= 0.0031308 ? (x * 12.92) : (1.055 * pow(x, c0) - 0.055));
+}
+
+void main(void)
+{
+    vec2 coord = rotate_dir != 0 ? to_rotate(vtexcoord) : vtexcoord;
+    coord.x = view_rect.x + coord.x * view_rect.y;
+    // The row 0 of the view texture is its top, see RhiVideoRenderer::offscreenCorrMatrix()
+    vec3 rgb = texture(view_tex, vec2(coord.x, 1.0 - coord.y)).rgb;
+    fcolor = vec4(vec3(to_nonlinear(rgb.r), to_nonlinear(rgb.g), to_nonlinear(rgb.b)), 1.0);
+}
@@ -0,0 +1,18 @@
+#version 440
+
+// The QRhi variant of shaders/display.vert: the eye viewport quad as a triangle strip
+
+layout(std140, binding = 0) uniform buf {
+    mat4 clip_corr;
+    vec2 view_rect;
+    int rotate_dir;
+};
+
+layout(location = 0) out vec2 vtexcoord;
+
+void main(void)
+{
+    vec2 pos = vec2(float((gl_VertexIndex & 1) * 2 - 1), float((gl_VertexIndex & 2) - 1));
+    vtexcoord = (pos + 1.0) * 0.5; // bottom-up as the OpenGL texture coordinates
+    gl_Position = clip_corr * vec4(pos, 0.0, 1.0);
+}
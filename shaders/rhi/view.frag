@@ -0,0 +1,70 @@
+#version 440
+
+// The QRhi variant of shaders/view.frag without the frame slabs and the detail tiles
+
+layout(std140, binding = 0) uniform buf {
+    mat4 clip_corr;
+    mat4 projection;
+    mat4 orientation;
+    vec4 eye_rect[2]; // the frame part per eye: left, top, width, height
+    vec4 view_range; // the frame coverage of the full sphere: left, top, width, height
+    vec2 view_xoffs; // per eye
+    vec2 cube_pad; // the face padding within its cell
+    int frame_projection; // 0 equirectangular, 1 EAC of the YouTube 3x2 layout
+};
+
+layout(binding = 1) uniform sampler2D frame_tex;
+
+const float pi = 3.14159265358979323846;
+
+layout(location = 0) in vec3 vdirection;
+layout(location = 1) flat in int veye;
+
+layout(location = 0) out vec4 fcolor;
+
+// The direction v is right, down, forward handed as the cubemaps of ffmpeg v360
+vec2 cubemap_coord(vec3 v)
+{
+    vec3 a = abs(v);
+    vec2 uv;
+    float cell;
+    if (a.x >= a.y && a.x >= a.z) {
+        if (v.x > 0.0) { uv = vec2(-v.z, v.y) / a.x; cell = 2.0; } // right
+        else           { uv = vec2( v.z, v.y) / a.x; cell = 0.0; } // left
+    } else if (a.y >= a.z) {
+        if (v.y < 0.0) { uv = vec2(v.x,  v.z) / a.y; cell = 5.0; } // up
+        else           { uv = vec2(v.x, -v.z) / a.y; cell = 3.0; } // down
+    } else {
+        if (v.z > 0.0) { uv = vec2( v.x, v.y) / a.z; cell = 1.0; } // front
+        else           { uv = vec2(-v.x, v.y) / a.z; cell = 4.0; } // back
+    }
+    if (cell == 3.0 || cell == 5.0) uv = vec2(uv.y, -uv.x);
+    else if (cell == 4.0) uv = vec2(-uv.y, uv.x);
+    uv = clamp(atan(uv) * (2.0 / pi) + 0.5, 0.0, 1.0); // equi-angular
+    uv = cube_pad + uv * (1.0 - 2.0 * cube_pad);
+    return vec2((mod(cell, 3.0) + uv.x) / 3.0, (floor(cell / 3.0) + uv.y) / 2.0);
+}
+
+void main(void)
+{
+    vec3 dir = normalize(vdirection);
+    float xoffs = veye == 0 ? view_xoffs.x : view_xoffs.y;
+    vec2 tc;
+    if (frame_projection == 1) {
+        float a = xoffs * pi * 2.0;
+        vec2 xz = mat2(cos(a), sin(a), -sin(a), cos(a)) * dir.xz; // the yaw shift of a mono frame
+        tc = cubemap_coord(vec3(xz.x, -dir.y, -xz.y));
+    } else {
+        float tx = xoffs + atan(dir.x, -dir.z) / (pi * 2.0f) + 0.5;
+        float ty = asin(clamp(-dir.y, -1.0, 1.0)) / pi + 0.5;
+
+        // Map the sphere into the frame coverage, the rest is black
+        tc = vec2(fract(tx - view_range.x), ty - view_range.y) / view_range.zw;
+        if (tc.x > 1.0 || tc.y < 0.0 || tc.y > 1.0) {
+            fcolor = vec4(0.0, 0.0, 0.0, 1.0);
+            return;
+        }
+    }
+    tc = eye_rect[veye].xy + tc * eye_rect[veye].zw;
+    fcolor = vec4(texture(frame_tex, tc).rgb, 1.0);
+}
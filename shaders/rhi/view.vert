@@ -0,0 +1,30 @@
+#version 440
+
+// The QRhi variant of shaders/view.vert for the full sphere cube
+
+layout(std140, binding = 0) uniform buf {
+    mat4 clip_corr;
+    mat4 projection;
+    mat4 orientation;
+    vec4 eye_rect[2];
+    vec4 view_range;
+    vec2 view_xoffs;
+    vec2 cube_pad;
+    int frame_projection;
+};
+
+layout(location = 0) in vec4 position;
+
+layout(location = 0) out vec3 vdirection;
+layout(location = 1) flat out int veye;
+
+void main(void)
+{
+    vdirection = (position * orientation).xyz;
+    vec4 pos = projection * position;
+
+    // Both eyes by one instanced draw into the halves of the view texture, the depth
+    // is replaced by the eye x to clip the eye within its half as shaders/view.vert
+    veye = gl_InstanceIndex;
+    gl_Position = clip_corr * vec4(pos.x * 0.5 + (float(veye) - 0.5) * pos.w, pos.y, pos.x, pos.w);
+}
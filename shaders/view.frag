@@ -1,16 +1,101 @@
 uniform sampler2D frame_tex;
-uniform float view_xoffs;
+uniform highp sampler2DArray frame_slabs;
+uniform vec2 view_xoffs; // per eye
+uniform vec4 eye_rect[2]; // the frame part per eye: left, top, width, height
+uniform vec4 view_range; // the frame coverage of the full sphere: left, top, width, height
+uniform float lod_bias; // of the frame mipmaps at the reduced view resolution
 const float pi = 3.14159265358979323846;
 
+// The equirectangular frame or the equi-angular cubemap (EAC) of the YouTube 3x2 layout:
+// left, front, right faces on top, down, back, up faces below rotated by 270, 90, 270 degree
+const int frameProjection = $FRAME_PROJECTION;
+uniform vec2 cube_pad; // the face padding within its cell
+
+// The frame exceeding GL_MAX_TEXTURE_SIZE is a grid of slabs in the layers of frame_slabs,
+// each layer has an overlapping border around the slab interior
+const bool frameSlabs = $FRAME_SLABS;
+uniform vec2 slab_grid;   // columns, rows
+uniform vec4 slab_map;    // interior offset and scale within the layer
+uniform vec2 slab_extent; // the frame part of the grid
+
+// The detail of a still image is a level of its tile pyramid partially resident in tile_atlas,
+// the tile_table texel per tile holds the atlas slot (column, row) and alpha if resident
+const bool tileDetail = $TILE_DETAIL;
+uniform sampler2D tile_table;
+uniform sampler2D tile_atlas;
+uniform vec4 tile_level; // level width, height, tile interior and tile size in pixels
+uniform vec2 tile_slots; // atlas columns, rows
+
 smooth in vec2 vtexcoord;
 smooth in vec3 vdirection;
+flat in int veye;
 
 layout(location = 0) out vec4 fcolor;
 
+vec3 frame_color(highp vec2 tc)
+{
+    if (!frameSlabs)
+        return texture(frame_tex, tc, lod_bias).rgb;
+    highp vec2 g = vec2(fract(tc.x), clamp(tc.y, 0.0, 1.0)) * slab_extent * slab_grid;
+    highp vec2 cell = min(floor(g), slab_grid - 1.0);
+    highp vec2 uv = slab_map.xy + (g - cell) * slab_map.zw;
+    return texture(frame_slabs, vec3(uv, cell.y * slab_grid.x + cell.x)).rgb;
+}
+
+vec3 detail_color(highp vec2 tc)
+{
+    highp vec2 p = vec2(fract(tc.x), clamp(tc.y, 0.0, 1.0)) * tile_level.xy;
+    ivec2 tile = min(ivec2(p / tile_level.z), textureSize(tile_table, 0) - 1);
+    vec4 entry = texelFetch(tile_table, tile, 0);
+    if (entry.a < 0.5)
+        return frame_color(tc); // not streamed yet
+    highp vec2 local = (p - vec2(tile) * tile_level.z + 1.0) / tile_level.w; // skip the border
+    return texture(tile_atlas, (floor(entry.rg * 255.0 + 0.5) + local) / tile_slots).rgb;
+}
+
+// The direction v is right, down, forward handed as the cubemaps of ffmpeg v360
+highp vec2 cubemap_coord(vec3 v)
+{
+    vec3 a = abs(v);
+    highp vec2 uv;
+    float cell;
+    if (a.x >= a.y && a.x >= a.z) {
+        if (v.x > 0.0) { uv = vec2(-v.z, v.y) / a.x; cell = 2.0; } // right
+        else           { uv = vec2( v.z, v.y) / a.x; cell = 0.0; } // left
+    } else if (a.y >= a.z) {
+        if (v.y < 0.0) { uv = vec2(v.x,  v.z) / a.y; cell = 5.0; } // up
+        else           { uv = vec2(v.x, -v.z) / a.y; cell = 3.0; } // down
+    } else {
+        if (v.z > 0.0) { uv = vec2( v.x, v.y) / a.z; cell = 1.0; } // front
+        else           { uv = vec2(-v.x, v.y) / a.z; cell = 4.0; } // back
+    }
+    if (cell == 3.0 || cell == 5.0) uv = vec2(uv.y, -uv.x);
+    else if (cell == 4.0) uv = vec2(-uv.y, uv.x);
+    uv = clamp(atan(uv) * (2.0 / pi) + 0.5, 0.0, 1.0); // equi-angular
+    uv = cube_pad + uv * (1.0 - 2.0 * cube_pad);
+    return vec2((mod(cell, 3.0) + uv.x) / 3.0, (floor(cell / 3.0) + uv.y) / 2.0);
+}
+
 void main(void)
 {
     vec3 dir = normalize(vdirection);
-    float tx = view_xoffs + atan(dir.x, -dir.z) / (pi * 2.0f) + 0.5;
-    float ty = asin(clamp(-dir.y, -1.0, 1.0)) / pi + 0.5;
-    fcolor = vec4(texture2D(frame_tex, vec2(tx, ty)).rgb, 1.0);
+    float xoffs = veye == 0 ? view_xoffs.x : view_xoffs.y;
+    highp vec2 tc;
+    if (frameProjection == 1) {
+        float a = xoffs * pi * 2.0;
+        vec2 xz = mat2(cos(a), sin(a), -sin(a), cos(a)) * dir.xz; // the yaw shift of a mono frame
+        tc = cubemap_coord(vec3(xz.x, -dir.y, -xz.y));
+    } else {
+        float tx = xoffs + atan(dir.x, -dir.z) / (pi * 2.0f) + 0.5;
+        float ty = asin(clamp(-dir.y, -1.0, 1.0)) / pi + 0.5;
+
+        // Map the sphere into the frame coverage, the rest is black
+        tc = vec2(fract(tx - view_range.x), ty - view_range.y) / view_range.zw;
+        if (tc.x > 1.0 || tc.y < 0.0 || tc.y > 1.0) {
+            fcolor = vec4(0.0, 0.0, 0.0, 1.0);
+            return;
+        }
+    }
+    tc = eye_rect[veye].xy + tc * eye_rect[veye].zw;
+    fcolor = vec4(tileDetail ? detail_color(tc) : frame_color(tc), 1.0);
 }
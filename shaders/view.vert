@@ -1,15 +1,30 @@
 uniform mat4 projection;
 uniform mat4 orientation;
 
+// The partial sphere mesh is in world space, the full sphere cube is in view space
+const bool viewMesh = $VIEW_MESH;
+
 layout(location = 0) in vec4 position;
 layout(location = 1) in vec2 texcoord;
 
 smooth out vec2 vtexcoord;
 smooth out vec3 vdirection;
+flat out int veye;
 
 void main(void)
 {
     vtexcoord = texcoord;
-    vdirection = (position * orientation).xyz;
-    gl_Position = projection * position;
+    vec4 pos;
+    if (viewMesh) {
+        vdirection = position.xyz;
+        pos = projection * (orientation * position);
+    } else {
+        vdirection = (position * orientation).xyz;
+        pos = projection * position;
+    }
+
+    // Both eyes are drawn by one instanced draw into the halves of the view texture,
+    // the depth is replaced by the eye x to clip the eye within its half
+    veye = gl_InstanceID;
+    gl_Position = vec4(pos.x * 0.5 + (float(veye) - 0.5) * pos.w, pos.y, pos.x, pos.w);
 }
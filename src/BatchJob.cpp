@@ -0,0 +1,213 @@
+#include "BatchJob.h"
+#include "VideoRenderer.h"
+
+#include <QVideoFrameInput>
+#include <QMediaFormat>
+#include <QFileInfo>
+#include <QUrl>
+#include <QtDebug>
+
+#include <cstdio>
+
+//#define TRACE_BATCHJOB
+#ifdef  TRACE_BATCHJOB
+#include <QTime>
+#include <QThread>
+#define TRACE()      qDebug() << QTime::currentTime().toString("hh:mm:ss.zzz") << QThread::currentThreadId() << Q_FUNC_INFO;
+#define TRACE_ARG(x) qDebug() << QTime::currentTime().toString("hh:mm:ss.zzz") << QThread::currentThreadId() << Q_FUNC_INFO << x;
+#else
+#define TRACE()
+#define TRACE_ARG(x)
+#endif
+
+BatchJob::BatchJob(QObject *parent)
+    : QObject(parent)
+    , m_duration(0)
+    , m_imageTime(0)
+    , m_inputEnded(false)
+    , m_finishing(false)
+    , m_frames(0)
+    , m_lastTime(0)
+{
+}
+
+bool BatchJob::open(const QString &source, const QString &output, const QSize &size, bool debugOpenGL)
+{
+    TRACE_ARG(source << output << size);
+    m_size = size;
+    if (!m_reader.open(source)) {
+        m_errorText = m_reader.errorText();
+        return false;
+    }
+    if (!m_renderer.init(size, debugOpenGL)) {
+        m_errorText = m_renderer.errorText();
+        return false;
+    }
+    const QString suffix = QFileInfo(output).suffix().toLower();
+    if (output == "-") {
+        if (!m_rawFile.open(stdout, QIODevice::WriteOnly)) {
+            m_errorText = QStringLiteral("Can't write to stdout");
+            return false;
+        }
+    } else if (suffix == "rgba" || suffix == "raw") {
+        m_rawFile.setFileName(output);
+        if (!m_rawFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            m_errorText = QStringLiteral("Can't write %1: %2").arg(output, m_rawFile.errorString());
+            return false;
+        }
+    } else if (!openRecorder(output)) {
+        return false;
+    }
+    return true;
+}
+
+bool BatchJob::openRecorder(const QString &output)
+{
+    const QString suffix = QFileInfo(output).suffix().toLower();
+    QMediaFormat format;
+    if (suffix == "mp4" || suffix == "m4v") format.setFileFormat(QMediaFormat::MPEG4);
+    else if (suffix == "mkv") format.setFileFormat(QMediaFormat::Matroska);
+    else if (suffix == "mov") format.setFileFormat(QMediaFormat::QuickTime);
+    else if (suffix == "webm") format.setFileFormat(QMediaFormat::WebM);
+    else {
+        m_errorText = QStringLiteral("Unknown output format: %1").arg(output);
+        return false;
+    }
+    format.setVideoCodec(suffix == "webm" ? QMediaFormat::VideoCodec::VP9 : QMediaFormat::VideoCodec::H264);
+    if (!format.isSupported(QMediaFormat::Encode)) {
+        m_errorText = QStringLiteral("Can't encode %1 by the multimedia backend").arg(format.fileFormatName(format.fileFormat()));
+        return false;
+    }
+
+    QVideoFrameFormat frameFormat(m_size, QVideoFrameFormat::Format_RGBX8888);
+    frameFormat.setStreamFrameRate(m_reader.frameRate());
+    m_frameInput.reset(new QVideoFrameInput(frameFormat));
+    connect(m_frameInput.data(), &QVideoFrameInput::readyToSendVideoFrame, this, &BatchJob::process);
+    m_session.setVideoFrameInput(m_frameInput.data());
+    m_session.setRecorder(&m_recorder);
+    m_recorder.setMediaFormat(format);
+    m_recorder.setQuality(QMediaRecorder::VeryHighQuality);
+    m_recorder.setVideoResolution(m_size);
+    m_recorder.setVideoFrameRate(m_reader.frameRate());
+    m_recorder.setOutputLocation(QUrl::fromLocalFile(QFileInfo(output).absoluteFilePath()));
+    connect(&m_recorder, &QMediaRecorder::errorOccurred, this, [this](QMediaRecorder::Error, const QString &text) {
+        finish(text);
+    });
+    connect(&m_recorder, &QMediaRecorder::recorderStateChanged, this, &BatchJob::onRecorderStateChanged);
+    return true;
+}
+
+void BatchJob::setSourceLayout(int stereoMode, const QRectF &coverage, int projection, int padding)
+{
+    m_renderer.setSourceLayout(stereoMode, coverage, projection, padding);
+}
+
+void BatchJob::setCameraPath(const CameraPath &path)
+{
+    m_path = path;
+}
+
+void BatchJob::setDuration(qint64 ms)
+{
+    m_duration = qMax(qint64(0), ms);
+}
+
+void BatchJob::start()
+{
+    TRACE();
+    m_timer.start();
+    m_reader.start();
+    if (m_frameInput) m_recorder.record(); // the frames are taken once it's ready
+    else QMetaObject::invokeMethod(this, &BatchJob::process, Qt::QueuedConnection);
+}
+
+void BatchJob::process()
+{
+    if (m_finishing) return;
+    for (int steps = 0; ; steps++) {
+        if (!m_image.isNull() && !writeImage()) return;
+
+        // Keep framesInFlight views rendering while the oldest one is read back
+        if (!m_inputEnded && !m_renderer.isFull()) {
+            const QVideoFrame frame = m_reader.takeFrame();
+            const qint64 time = frame.startTime() >= 0 ? frame.startTime() / 1000
+                                                       : qint64(m_frames + m_renderer.pending()) * 1000 / m_reader.frameRate();
+            if (!frame.isValid() || (m_duration > 0 && time >= m_duration)) {
+                m_inputEnded = true;
+                m_reader.stop();
+                if (!m_reader.errorText().isEmpty()) {
+                    finish(m_reader.errorText());
+                    return;
+                }
+            } else if (!VideoRenderer::isFrameSuppored(frame) || !m_renderer.render(frame, time, m_path.poseAt(time))) {
+                finish(m_renderer.errorText().isEmpty() ? QStringLiteral("Can't render the frame at %1 ms").arg(time)
+                                                        : m_renderer.errorText());
+                return;
+            }
+            continue;
+        }
+        if (!m_renderer.pending()) {
+            finish();
+            return;
+        }
+        m_image = m_renderer.takeImage(&m_imageTime);
+        if (m_image.isNull()) {
+            finish(m_renderer.errorText());
+            return;
+        }
+
+        // Let the encoder and the errors in now and then
+        if (steps >= BatchRenderer::framesInFlight * 4) {
+            QMetaObject::invokeMethod(this, &BatchJob::process, Qt::QueuedConnection);
+            return;
+        }
+    }
+}
+
+bool BatchJob::writeImage()
+{
+    if (m_frameInput) {
+        QVideoFrame frame(m_image);
+        frame.setStartTime(m_imageTime * 1000);
+        frame.setEndTime(qint64((m_imageTime + 1000.0 / m_reader.frameRate()) * 1000));
+        if (!m_frameInput->sendVideoFrame(frame)) return false;
+    } else if (m_rawFile.write(reinterpret_cast<const char *>(m_image.constBits()), m_image.sizeInBytes()) != m_image.sizeInBytes()) {
+        finish(QStringLiteral("Can't write the output: %1").arg(m_rawFile.errorString()));
+        return false;
+    }
+    m_image = QImage();
+    m_lastTime = m_imageTime;
+    m_frames++;
+    return true;
+}
+
+void BatchJob::finish(const QString &errorText)
+{
+    if (m_finishing) return;
+    TRACE_ARG(errorText);
+    m_finishing = true;
+    m_errorText = errorText;
+    m_reader.stop();
+    if (errorText.isEmpty()) {
+        const qreal seconds = m_timer.elapsed() / 1000.0;
+        const qreal clip = (m_lastTime + 1000.0 / m_reader.frameRate()) / 1000.0;
+        qInfo().noquote() << QStringLiteral("Rendered %1 frames of %2x%3 in %4 s, %5 fps, %6x real time on %7")
+                             .arg(m_frames).arg(m_size.width()).arg(m_size.height()).arg(seconds, 0, 'f', 2)
+                             .arg(m_frames / qMax(seconds, 0.001), 0, 'f', 1).arg(clip / qMax(seconds, 0.001), 0, 'f', 2)
+                             .arg(m_renderer.glRenderer());
+    }
+    if (m_frameInput && m_recorder.recorderState() != QMediaRecorder::StoppedState) {
+        m_recorder.stop(); // finished once the file is written
+        return;
+    }
+    m_rawFile.close();
+    emit finished(m_errorText.isEmpty());
+}
+
+void BatchJob::onRecorderStateChanged(QMediaRecorder::RecorderState state)
+{
+    TRACE_ARG(state);
+    if (state != QMediaRecorder::StoppedState) return;
+    if (!m_finishing) finish(QStringLiteral("The recording stopped unexpectedly")); // emits
+    else emit finished(m_errorText.isEmpty());
+}
@@ -0,0 +1,69 @@
+#ifndef BATCHJOB_H
+#define BATCHJOB_H
+
+#include <QObject>
+#include <QFile>
+#include <QImage>
+#include <QElapsedTimer>
+#include <QMediaCaptureSession>
+#include <QMediaRecorder>
+#include <QScopedPointer>
+
+#include "CameraPath.h"
+#include "FrameReader.h"
+#include "BatchRenderer.h"
+
+class QVideoFrameInput;
+
+/*
+ * The panoramabatch run: the frames of FrameReader rendered by BatchRenderer through the
+ * camera path, then written as raw RGBX8888 frames to a file or stdout, or encoded by
+ * QMediaRecorder from the frame input. The decoding, the rendering with its readbacks and
+ * the encoding overlap, the slowest one sets the pace.
+ */
+class BatchJob : public QObject
+{
+    Q_OBJECT
+public:
+    explicit BatchJob(QObject *parent = nullptr);
+
+    // The output is raw if "-" (stdout) or of the .rgba, .raw suffix, else encoded by its suffix
+    bool open(const QString &source, const QString &output, const QSize &size, bool debugOpenGL = false);
+    QString errorText() const { return m_errorText; }
+    FrameReader *reader() { return &m_reader; } // for the source properties
+    void setSourceLayout(int stereoMode, const QRectF &coverage, int projection, int padding);
+    void setCameraPath(const CameraPath &path);
+    void setDuration(qint64 ms); // of the output from the clip begin, 0 is all
+
+    void start();
+
+signals:
+    void finished(bool ok);
+
+private:
+    bool openRecorder(const QString &output);
+    void process(); // as far as the output takes the frames
+    bool writeImage(); // false if the encoder is full, retried by readyToSendVideoFrame
+    void finish(const QString &errorText = QString());
+    void onRecorderStateChanged(QMediaRecorder::RecorderState state);
+
+    FrameReader m_reader;
+    BatchRenderer m_renderer;
+    CameraPath m_path;
+    QSize m_size;
+    qint64 m_duration;
+    QFile m_rawFile; // if raw
+    QMediaCaptureSession m_session; // if encoded
+    QMediaRecorder m_recorder;
+    QScopedPointer<QVideoFrameInput> m_frameInput;
+    QImage m_image; // rendered, to write
+    qint64 m_imageTime;
+    bool m_inputEnded;
+    bool m_finishing;
+    int m_frames; // written
+    qint64 m_lastTime; // of the last written frame in ms
+    QElapsedTimer m_timer;
+    QString m_errorText;
+};
+
+#endif // BATCHJOB_H
@@ -0,0 +1,177 @@
+#include "BatchRenderer.h"
+#include "VideoRenderer.h"
+#include "RenderProfile.h"
+
+#include <QOpenGLContext>
+#include <QOffscreenSurface>
+#include <QSurfaceFormat>
+#include <QtDebug>
+
+#include <cstring>
+
+//#define TRACE_BATCHRENDERER
+#ifdef  TRACE_BATCHRENDERER
+#include <QTime>
+#include <QThread>
+#define TRACE()      qDebug() << QTime::currentTime().toString("hh:mm:ss.zzz") << QThread::currentThreadId() << Q_FUNC_INFO;
+#define TRACE_ARG(x) qDebug() << QTime::currentTime().toString("hh:mm:ss.zzz") << QThread::currentThreadId() << Q_FUNC_INFO << x;
+#else
+#define TRACE()
+#define TRACE_ARG(x)
+#endif
+
+BatchRenderer::BatchRenderer(QObject *parent)
+    : QObject(parent)
+    , m_fbo(0)
+    , m_tex(0)
+    , m_first(0)
+    , m_pending(0)
+{
+}
+
+BatchRenderer::~BatchRenderer()
+{
+    TRACE();
+    if (!m_context || !m_context->makeCurrent(m_surface.data())) return;
+    m_renderer.reset(); // in its context
+    for (auto &readback : m_readbacks) {
+        if (readback.fence) glDeleteSync(readback.fence);
+        if (readback.pbo) glDeleteBuffers(1, &readback.pbo);
+    }
+    if (m_fbo) glDeleteFramebuffers(1, &m_fbo);
+    if (m_tex) glDeleteTextures(1, &m_tex);
+    m_context->doneCurrent();
+}
+
+bool BatchRenderer::init(const QSize &size, bool debugOpenGL)
+{
+    TRACE_ARG(size << debugOpenGL);
+    m_size = size;
+    m_surface.reset(new QOffscreenSurface);
+    m_surface->setFormat(QSurfaceFormat::defaultFormat());
+    m_surface->create();
+    m_context.reset(new QOpenGLContext);
+    m_context->setFormat(QSurfaceFormat::defaultFormat());
+    if (!m_surface->isValid() || !m_context->create() || !m_context->makeCurrent(m_surface.data())) {
+        m_errorText = QStringLiteral("Can't create offscreen OpenGL context");
+        return false;
+    }
+    initializeOpenGLFunctions();
+
+    // The target of the display pass, no default framebuffer on a surfaceless context
+    glGenTextures(1, &m_tex);
+    glBindTexture(GL_TEXTURE_2D, m_tex);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, size.width(), size.height(), 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glGenFramebuffers(1, &m_fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_tex, 0);
+    bool complete = (glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    const int bytes = size.width() * size.height() * 4;
+    for (auto &readback : m_readbacks) {
+        glGenBuffers(1, &readback.pbo);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.pbo);
+        glBufferData(GL_PIXEL_PACK_BUFFER, bytes, nullptr, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    GLenum glErr = glGetError();
+    if (glErr != GL_NO_ERROR || !complete) {
+        qCritical() << Q_FUNC_INFO << "OpenGL Error" << glErr << "Line" << __LINE__;
+        m_errorText = QStringLiteral("Can't create the %1x%2 output framebuffer").arg(size.width()).arg(size.height());
+        return false;
+    }
+
+    m_renderer.reset(new VideoRenderer(nullptr, debugOpenGL));
+    connect(m_renderer.data(), &VideoRenderer::errorOccurred, this, [this](const QString &text) {
+        qCritical().noquote() << text;
+        m_errorText = text;
+    });
+    bool found = false;
+    const auto profile = RenderProfile::load(m_renderer->glRenderer(), &found);
+    if (found) qInfo().noquote() << "Render profile of" << m_renderer->glRenderer() << "-" << profile.toString();
+    m_renderer->setRenderProfile(profile);
+    m_renderer->setZeroCopy(false);
+    m_renderer->setMonoDisplay(true);
+    m_renderer->setViewportSize(size);
+    m_renderer->setTargetFramebuffer(m_fbo);
+    return true;
+}
+
+QString BatchRenderer::glRenderer() const
+{
+    return m_renderer ? m_renderer->glRenderer() : QString();
+}
+
+void BatchRenderer::setSourceLayout(int stereoMode, const QRectF &coverage, int projection, int padding)
+{
+    if (!m_renderer) return;
+    m_renderer->setStereoMode(stereoMode);
+    m_renderer->setCoverage(coverage);
+    m_renderer->setFrameProjection(projection, padding);
+}
+
+bool BatchRenderer::render(const QVideoFrame &frame, qint64 time, const CameraPath::Pose &pose)
+{
+    TRACE_ARG(time << pose.yaw << pose.pitch << pose.fov);
+    if (!m_renderer || isFull() || !m_context->makeCurrent(m_surface.data())) return false;
+    m_renderer->setOrientation(QQuaternion::fromEulerAngles(pose.pitch, pose.yaw, 0.0f));
+    m_renderer->setProjection(pose.fov);
+    m_renderer->setVideoFrame(frame);
+    m_renderer->render();
+
+    // Read back into the next pixel buffer, taken by takeImage() once fenced
+
+    Readback &readback = m_readbacks[(m_first + m_pending) % framesInFlight];
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, m_fbo);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.pbo);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, m_size.width(), m_size.height(), GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    readback.time = time;
+    glFlush(); // start the work now, the readback is waited for frames later
+    GLenum glErr = glGetError();
+    if (glErr != GL_NO_ERROR) {
+        qCritical() << Q_FUNC_INFO << "OpenGL Error" << glErr << "Line" << __LINE__;
+        return false;
+    }
+    m_pending++;
+    return true;
+}
+
+QImage BatchRenderer::takeImage(qint64 *time)
+{
+    if (!m_pending || !m_context->makeCurrent(m_surface.data())) return QImage();
+    Readback &readback = m_readbacks[m_first];
+    m_first = (m_first + 1) % framesInFlight;
+    m_pending--;
+    if (time) *time = readback.time;
+
+    const GLenum status = glClientWaitSync(readback.fence, GL_SYNC_FLUSH_COMMANDS_BIT, GLuint64(fenceTimeout) * 1000000);
+    glDeleteSync(readback.fence);
+    readback.fence = nullptr;
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+        m_errorText = QStringLiteral("The view readback timed out");
+        return QImage();
+    }
+    const int stride = m_size.width() * 4;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.pbo);
+    auto pixels = static_cast<const uchar *>(glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, stride * m_size.height(), GL_MAP_READ_BIT));
+    QImage image;
+    if (pixels) {
+        // The rows are bottom-up in OpenGL
+        image = QImage(m_size, QImage::Format_RGBX8888);
+        for (int row = 0; row < m_size.height(); row++)
+            memcpy(image.scanLine(row), pixels + (m_size.height() - 1 - row) * stride, stride);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    } else {
+        qCritical() << Q_FUNC_INFO << "Can't map pixel buffer" << readback.pbo;
+        m_errorText = QStringLiteral("Can't read back the view");
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    return image;
+}
@@ -0,0 +1,63 @@
+#ifndef BATCHRENDERER_H
+#define BATCHRENDERER_H
+
+#include <QObject>
+#include <QOpenGLExtraFunctions>
+#include <QScopedPointer>
+#include <QVideoFrame>
+#include <QImage>
+#include <QRectF>
+
+#include "CameraPath.h"
+
+class QOpenGLContext;
+class QOffscreenSurface;
+class VideoRenderer;
+
+/*
+ * The flat views of the batch tool: VideoRenderer on an offscreen context, the left eye
+ * through the camera pose into a framebuffer of the output size, read back by the pixel
+ * buffers asynchronously. Up to framesInFlight frames are rendered before the oldest one
+ * is taken, so the GPU (or the llvmpipe threads) works while the CPU reads the frames.
+ */
+class BatchRenderer : public QObject, protected QOpenGLExtraFunctions
+{
+    Q_OBJECT
+public:
+    static constexpr int const framesInFlight = 3;
+    static constexpr int const fenceTimeout = 5000; // ms of a readback, then it fails
+
+    explicit BatchRenderer(QObject *parent = nullptr);
+    ~BatchRenderer() override;
+
+    bool init(const QSize &size, bool debugOpenGL = false); // false with errorText() if failed
+    QString errorText() const { return m_errorText; }
+    QString glRenderer() const;
+
+    // As the metadata of the source, PanoramaView::StereoMode, PanoramaView::Projection
+    void setSourceLayout(int stereoMode, const QRectF &coverage, int projection, int padding);
+
+    bool isFull() const { return m_pending == framesInFlight; }
+    int pending() const { return m_pending; }
+    bool render(const QVideoFrame &frame, qint64 time, const CameraPath::Pose &pose); // if not full
+    QImage takeImage(qint64 *time); // the oldest rendered view, RGBX8888 top-down, null if failed
+
+private:
+    struct Readback {
+        GLuint pbo = 0;
+        GLsync fence = nullptr;
+        qint64 time = 0;
+    };
+
+    QScopedPointer<QOffscreenSurface> m_surface;
+    QScopedPointer<QOpenGLContext> m_context;
+    QScopedPointer<VideoRenderer> m_renderer;
+    QString m_errorText;
+    QSize m_size;
+    GLuint m_fbo, m_tex;
+    Readback m_readbacks[framesInFlight];
+    int m_first; // the oldest of the pending readbacks
+    int m_pending;
+};
+
+#endif // BATCHRENDERER_H
@@ -0,0 +1,73 @@
+#include "CameraPath.h"
+#include "Lerp.h"
+
+#include <QFile>
+#include <QTextStream>
+#include <QRegularExpression>
+
+#include <algorithm>
+
+CameraPath::CameraPath()
+{
+}
+
+//static
+CameraPath CameraPath::load(const QString &fileName, QString *errorText)
+{
+    CameraPath path;
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        if (errorText) *errorText = QStringLiteral("Can't open %1: %2").arg(fileName, file.errorString());
+        return path;
+    }
+    QTextStream stream(&file);
+    static const QRegularExpression space(QStringLiteral("\\s+"));
+    qreal fov = defaultFov;
+    for (int lineNo = 1; !stream.atEnd(); lineNo++) {
+        QString line = stream.readLine();
+        int comment = line.indexOf('#');
+        if (comment >= 0) line.truncate(comment);
+        const auto fields = line.split(space, Qt::SkipEmptyParts);
+        if (fields.isEmpty()) continue;
+
+        bool ok = (fields.size() == 3 || fields.size() == 4);
+        qreal values[4] = { 0.0, 0.0, 0.0, fov };
+        for (int i = 0; ok && i < fields.size(); i++)
+            values[i] = fields.at(i).toDouble(&ok);
+        if (!ok || values[0] < 0.0 || values[3] < 5.0 || values[3] > 115.0) {
+            if (errorText) *errorText = QStringLiteral("%1:%2: bad camera key").arg(fileName).arg(lineNo);
+            return CameraPath();
+        }
+        Key key;
+        key.time = qRound64(values[0] * 1000.0);
+        key.pose.yaw = values[1];
+        key.pose.pitch = qBound(-90.0, values[2], 90.0);
+        key.pose.fov = fov = values[3];
+        path.m_keys.append(key);
+    }
+    std::stable_sort(path.m_keys.begin(), path.m_keys.end(),
+                     [](const Key &a, const Key &b) { return a.time < b.time; });
+    if (path.m_keys.isEmpty() && errorText)
+        *errorText = QStringLiteral("%1: no camera keys").arg(fileName);
+    return path;
+}
+
+CameraPath::Pose CameraPath::poseAt(qint64 time) const
+{
+    if (m_keys.isEmpty()) return Pose();
+    if (time <= m_keys.first().time) return m_keys.first().pose;
+    if (time >= m_keys.last().time) return m_keys.last().pose;
+
+    auto next = std::upper_bound(m_keys.cbegin(), m_keys.cend(), time,
+                                 [](qint64 t, const Key &key) { return t < key.time; });
+    const Key &b = *next;
+    const Key &a = *(next - 1);
+    qreal t = qreal(time - a.time) / qMax(qint64(1), b.time - a.time);
+    t = t * t * (3.0 - 2.0 * t); // smoothstep
+
+    Pose pose;
+    pose.yaw = lerpAngle(a.pose.yaw, b.pose.yaw, t);
+    pose.pitch = lerp(a.pose.pitch, b.pose.pitch, t);
+    pose.fov = lerp(a.pose.fov, b.pose.fov, t);
+    return pose;
+}
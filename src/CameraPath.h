@@ -0,0 +1,44 @@
+#ifndef CAMERAPATH_H
+#define CAMERAPATH_H
+
+#include <QString>
+#include <QVector>
+
+/*
+ * The keyframed camera of the batch renderer, read from a text file of the lines
+ *
+ *     <time> <yaw> <pitch> [<fov>]
+ *
+ * with the time in seconds and the angles in degree as the view orientation, the FOV is kept
+ * from the previous key if omitted. The '#' starts a comment. Between the keys the camera
+ * eases in and out, the yaw by the shorter arc; before the first and after the last key
+ * it stays still.
+ */
+class CameraPath
+{
+public:
+    static constexpr int const defaultFov = 90;
+
+    struct Pose {
+        qreal yaw = 0.0;
+        qreal pitch = 0.0;
+        qreal fov = defaultFov;
+    };
+
+    CameraPath(); // a still camera at the default pose
+
+    static CameraPath load(const QString &fileName, QString *errorText);
+
+    bool isEmpty() const { return m_keys.isEmpty(); }
+    int keyCount() const { return m_keys.size(); }
+    Pose poseAt(qint64 time) const; // in ms
+
+private:
+    struct Key {
+        qint64 time; // ms
+        Pose pose;
+    };
+    QVector<Key> m_keys; // by time
+};
+
+#endif // CAMERAPATH_H
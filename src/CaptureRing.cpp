@@ -0,0 +1,152 @@
+#include "CaptureRing.h"
+
+#include <QtDebug>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <new>
+
+//#define TRACE_CAPTURERING
+#ifdef  TRACE_CAPTURERING
+#include <QTime>
+#include <QThread>
+#define TRACE()      qDebug() << QTime::currentTime().toString("hh:mm:ss.zzz") << QThread::currentThreadId() << Q_FUNC_INFO;
+#define TRACE_ARG(x) qDebug() << QTime::currentTime().toString("hh:mm:ss.zzz") << QThread::currentThreadId() << Q_FUNC_INFO << x;
+#else
+#define TRACE()
+#define TRACE_ARG(x)
+#endif
+
+CaptureRing::CaptureRing()
+    : m_header(nullptr)
+    , m_size(0)
+    , m_serial(0)
+{
+}
+
+CaptureRing::~CaptureRing()
+{
+    close();
+}
+
+bool CaptureRing::open(int maxWidth, int maxHeight)
+{
+    TRACE_ARG(maxWidth << maxHeight);
+    close();
+    if (maxWidth <= 0 || maxHeight <= 0)
+        return false;
+
+    const size_t slotOffset = (sizeof(CaptureRingHeader) + 63) & ~size_t(63);
+    const size_t slotStride = (sizeof(CaptureSlotHeader) + size_t(maxWidth) * maxHeight * 4 + 63) & ~size_t(63);
+    const size_t size = slotOffset + slotStride * slotCount;
+
+    // A stale object of a crashed player is replaced, the readers reopen by the magic
+    shm_unlink(captureRingName);
+    int fd = shm_open(captureRingName, O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0) {
+        qWarning() << Q_FUNC_INFO << "Can't create shared memory" << captureRingName << strerror(errno);
+        return false;
+    }
+    if (ftruncate(fd, off_t(size)) != 0) {
+        qWarning() << Q_FUNC_INFO << "Can't resize shared memory" << captureRingName << strerror(errno);
+        ::close(fd);
+        shm_unlink(captureRingName);
+        return false;
+    }
+    void *data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        qWarning() << Q_FUNC_INFO << "Can't map shared memory" << captureRingName << strerror(errno);
+        shm_unlink(captureRingName);
+        return false;
+    }
+
+    // The new object is zero filled, the atomics are constructed in place
+    auto header = new (data) CaptureRingHeader;
+    header->slotCount = slotCount;
+    header->slotOffset = uint32_t(slotOffset);
+    header->slotStride = uint32_t(slotStride);
+    header->maxWidth = uint32_t(maxWidth);
+    header->maxHeight = uint32_t(maxHeight);
+    header->latest.store(0, std::memory_order_relaxed);
+    header->readerTime.store(0, std::memory_order_relaxed);
+    for (int i = 0; i < slotCount; i++) {
+        auto slot = new (static_cast<char *>(data) + slotOffset + slotStride * i) CaptureSlotHeader;
+        slot->sequence.store(0, std::memory_order_relaxed);
+    }
+    header->version = captureRingVersion;
+    std::atomic_thread_fence(std::memory_order_release);
+    header->magic = captureRingMagic;
+
+    m_header = header;
+    m_size = size;
+    m_serial = 0;
+    TRACE_ARG("Created" << captureRingName << size << "bytes");
+    return true;
+}
+
+void CaptureRing::close()
+{
+    if (!m_header) return;
+    TRACE();
+    munmap(m_header, m_size);
+    shm_unlink(captureRingName);
+    m_header = nullptr;
+    m_size = 0;
+}
+
+int CaptureRing::maxWidth() const
+{
+    return m_header ? int(m_header->maxWidth) : 0;
+}
+
+int CaptureRing::maxHeight() const
+{
+    return m_header ? int(m_header->maxHeight) : 0;
+}
+
+int64_t CaptureRing::monotonicTime()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return int64_t(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+}
+
+bool CaptureRing::hasReaders() const
+{
+    if (!m_header) return false;
+    const int64_t time = m_header->readerTime.load(std::memory_order_relaxed);
+    return (time > 0 && monotonicTime() - time < readerTimeout);
+}
+
+void CaptureRing::publish(const uint8_t *pixels, int width, int height, int64_t timestamp)
+{
+    if (!m_header || width > int(m_header->maxWidth) || height > int(m_header->maxHeight))
+        return;
+    const uint64_t serial = ++m_serial;
+    auto base = reinterpret_cast<char *>(m_header) + m_header->slotOffset +
+            size_t(m_header->slotStride) * (serial % slotCount);
+    auto slot = reinterpret_cast<CaptureSlotHeader *>(base);
+    auto dst = reinterpret_cast<uint8_t *>(base + sizeof(CaptureSlotHeader));
+    TRACE_ARG(serial << width << height);
+
+    // Seqlock: odd while written, the readers drop the copies made meanwhile
+    const uint64_t sequence = slot->sequence.load(std::memory_order_relaxed);
+    slot->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot->serial = serial;
+    slot->timestamp = timestamp;
+    slot->width = uint32_t(width);
+    slot->height = uint32_t(height);
+    slot->stride = uint32_t(width) * 4;
+    const size_t rowBytes = size_t(width) * 4;
+    for (int y = 0; y < height; y++)
+        memcpy(dst + rowBytes * y, pixels + rowBytes * (height - 1 - y), rowBytes);
+    slot->sequence.store(sequence + 2, std::memory_order_release);
+    m_header->latest.store(serial, std::memory_order_release);
+}
@@ -0,0 +1,79 @@
+#ifndef CAPTURERING_H
+#define CAPTURERING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * The POSIX shared memory ring of the captured headset views for the other local processes,
+ * e.g. the web UI or a recorder. The layout below is the interface, a reader maps the whole
+ * object of captureRingName read-write and polls header.latest:
+ *
+ *   1. store the CLOCK_MONOTONIC time in ms into header.readerTime at least once a second,
+ *      the player captures nothing while no reader has done so for readerTimeout
+ *   2. the slot of the frame serial is (serial % slotCount) at slotOffset + index * slotStride
+ *   3. read slot.sequence, skip the slot if it is odd (being written), copy the header and the
+ *      pixels, then read slot.sequence again and drop the copy if it has changed (seqlock)
+ *
+ * The pixels are sRGB encoded RGBA8 rows top-down as shown on the headset, the left eye on
+ * the left half unless mono.
+ */
+
+static constexpr const char *captureRingName = "/panoramaplay-view";
+static constexpr uint32_t captureRingMagic = 0x52435650; // "PVCR"
+static constexpr uint32_t captureRingVersion = 1;
+
+struct CaptureRingHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slotCount;
+    uint32_t slotOffset; // of the first slot from the header in bytes
+    uint32_t slotStride; // in bytes, CaptureSlotHeader included
+    uint32_t maxWidth, maxHeight; // of the frames in pixels
+    uint32_t reserved;
+    std::atomic<uint64_t> latest; // serial of the last published frame, 0 if none
+    std::atomic<int64_t> readerTime; // CLOCK_MONOTONIC ms of the last reader poll, by the readers
+};
+
+struct CaptureSlotHeader
+{
+    std::atomic<uint64_t> sequence; // odd while the slot is written
+    uint64_t serial;
+    int64_t timestamp; // CLOCK_MONOTONIC ms of the rendering
+    uint32_t width, height;
+    uint32_t stride; // of the rows in bytes
+    uint32_t reserved;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "The ring is shared by processes, the atomics must be lock-free");
+
+class CaptureRing
+{
+public:
+    static constexpr int const slotCount = 3;
+    static constexpr int const readerTimeout = 2000; // ms
+
+    CaptureRing();
+    ~CaptureRing();
+
+    bool open(int maxWidth, int maxHeight); // creates the shared memory object of captureRingName
+    void close();
+    bool isOpen() const { return m_header != nullptr; }
+    int maxWidth() const;
+    int maxHeight() const;
+
+    bool hasReaders() const; // any reader polled within readerTimeout
+    static int64_t monotonicTime(); // in ms as the readers store
+
+    // The bottom-up rows of glReadPixels are stored flipped
+    void publish(const uint8_t *pixels, int width, int height, int64_t timestamp);
+
+private:
+    CaptureRingHeader *m_header;
+    size_t m_size;
+    uint64_t m_serial;
+};
+
+#endif // CAPTURERING_H
@@ -0,0 +1,8 @@
+// Compiled with -mavx2 -mfma, called only if the CPU supports them, see ColorConverter.cpp
+#include "ColorConvertKernel.h"
+
+void colorConvertRowAvx2(const ColorMatrix &matrix, const float *y, const float *u, const float *v,
+                         int count, uint32_t *dst)
+{
+    colorKernel<SimdAvx2>(matrix, y, u, v, count, dst);
+}
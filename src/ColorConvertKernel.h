@@ -0,0 +1,54 @@
+#ifndef COLORCONVERTKERNEL_H
+#define COLORCONVERTKERNEL_H
+
+#include "Simd.h"
+
+/*
+ * The row kernel of ColorConverter, kept free of Qt since the AVX2 variant is compiled
+ * with its own target flags in ColorConvertAvx2.cpp and selected at runtime.
+ */
+
+// The YUV to RGB matrix of shaders/color.frag: Y, U, V factors and the offset per R, G, B
+struct ColorMatrix
+{
+    float rgb[3][4];
+};
+
+#if defined(PANORAMA_SIMD_AVX2)
+void colorConvertRowAvx2(const ColorMatrix &matrix, const float *y, const float *u, const float *v,
+                         int count, uint32_t *dst);
+#endif
+
+namespace {
+
+// The normalized Y, U, V samples to the RGB32 pixels, V::N pixels at once
+template <class V>
+void colorKernel(const ColorMatrix &m, const float *y, const float *u, const float *v, int count, uint32_t *dst)
+{
+    typedef typename V::F F;
+    F k[3][4];
+    for (int c = 0; c < 3; c++) {
+        for (int i = 0; i < 4; i++)
+            k[c][i] = V::set1(m.rgb[c][i] * 255.0f);
+    }
+    const F zero = V::set1(0.0f), full = V::set1(255.0f);
+
+    int i = 0;
+    for (; i + V::N <= count; i += V::N) {
+        const F cy = V::load(y + i), cu = V::load(u + i), cv = V::load(v + i);
+        F rgb[3];
+        for (int c = 0; c < 3; c++) {
+            const F value = V::fmadd(cy, k[c][0], V::fmadd(cu, k[c][1], V::fmadd(cv, k[c][2], k[c][3])));
+            rgb[c] = V::max(zero, V::min(value, full));
+        }
+        V::storeRgb32(dst + i, rgb[0], rgb[1], rgb[2]);
+    }
+    if constexpr (V::N > 1) {
+        if (i < count)
+            colorKernel<SimdScalar>(m, y + i, u + i, v + i, count - i, dst + i);
+    }
+}
+
+} // namespace
+
+#endif // COLORCONVERTKERNEL_H
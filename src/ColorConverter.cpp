@@ -0,0 +1,472 @@
+#include "ColorConverter.h"
+#include "ColorConvertKernel.h"
+#include "ParallelStrips.h"
+#include "VideoFrameExt.h"
+#include "VideoRenderer.h"
+
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QSurfaceFormat>
+#include <QScopedPointer>
+#include <QThreadPool>
+#include <QVarLengthArray>
+#include <QElapsedTimer>
+#include <QRandomGenerator>
+#include <QtDebug>
+
+#include <cmath>
+#include <iterator>
+
+//#define TRACE_COLORCONVERTER
+#ifdef  TRACE_COLORCONVERTER
+#include <QTime>
+#include <QThread>
+#define TRACE()      qDebug() << QTime::currentTime().toString("hh:mm:ss.zzz") << QThread::currentThreadId() << Q_FUNC_INFO;
+#define TRACE_ARG(x) qDebug() << QTime::currentTime().toString("hh:mm:ss.zzz") << QThread::currentThreadId() << Q_FUNC_INFO << x;
+#else
+#define TRACE()
+#define TRACE_ARG(x)
+#endif
+
+static constexpr int const stripRows = 16;
+static constexpr int const tolerance = 2; // of the 8 bit channels against the reference
+
+typedef void (*ColorConvertRowFunc)(const ColorMatrix &, const float *, const float *, const float *, int, uint32_t *);
+
+template <class V>
+static void colorConvertRowWith(const ColorMatrix &matrix, const float *y, const float *u, const float *v,
+                                int count, uint32_t *dst)
+{
+    colorKernel<V>(matrix, y, u, v, count, dst);
+}
+
+#if defined(SIMD_HAVE_NEON)
+typedef SimdNeon SimdBase;
+#elif defined(SIMD_HAVE_SSE2)
+typedef SimdSse2 SimdBase;
+#else
+typedef SimdScalar SimdBase;
+#endif
+
+static ColorConvertRowFunc selectColorConvertRow(const char **name)
+{
+#if defined(PANORAMA_SIMD_AVX2)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        *name = "AVX2";
+        return &colorConvertRowAvx2;
+    }
+#endif
+    *name = SimdBase::name();
+    return &colorConvertRowWith<SimdBase>;
+}
+
+static const char *colorConvertName = nullptr;
+static const ColorConvertRowFunc colorConvertRow = selectColorConvertRow(&colorConvertName);
+
+// The matrices of shaders/color.frag, the same as used by Qt,
+// see qtmultimedia/src/multimedia/video/qvideotexturehelper.cpp
+static const ColorMatrix &colorMatrix(int space, bool full)
+{
+    static const ColorMatrix adobeRgb = {{
+        { 1.0f,     0.0f,       1.402f,    -0.701f },
+        { 1.0f,    -0.344f,    -0.714f,     0.529f },
+        { 1.0f,     1.772f,     0.0f,      -0.886f } }};
+    static const ColorMatrix bt709Small = {{
+        { 1.1644f,  0.0f,       1.7927f,   -0.9729f },
+        { 1.1644f, -0.2132f,   -0.5329f,    0.3015f },
+        { 1.1644f,  2.1124f,    0.0f,      -1.1334f } }};
+    static const ColorMatrix bt709Full = {{
+        { 1.0f,     0.0f,       1.5748f,   -0.790488f },
+        { 1.0f,    -0.187324f, -0.468124f,  0.329010f },
+        { 1.0f,     1.8556f,    0.0f,      -0.931439f } }};
+    static const ColorMatrix bt2020Small = {{
+        { 1.1644f,  0.0f,       1.6787f,   -0.9157f },
+        { 1.1644f, -0.1874f,   -0.6504f,    0.3475f },
+        { 1.1644f,  2.1418f,    0.0f,      -1.1483f } }};
+    static const ColorMatrix bt2020Full = {{
+        { 1.0f,     0.0f,       1.4746f,   -0.7402f },
+        { 1.0f,    -0.1646f,   -0.5714f,    0.3694f },
+        { 1.0f,     1.8814f,    0.0f,      -0.9445f } }};
+    static const ColorMatrix bt601Small = {{
+        { 1.164f,   0.0f,       1.596f,    -0.8708f },
+        { 1.164f,  -0.392f,    -0.813f,     0.5296f },
+        { 1.164f,   2.017f,     0.0f,      -1.081f } }};
+    static const ColorMatrix bt601Full = {{
+        { 1.0f,     0.0f,       1.772f,    -0.886f },
+        { 1.0f,    -0.1646f,   -0.57135f,   0.36795f },
+        { 1.0f,     1.42f,      0.0f,      -0.71f } }};
+    switch (space) {
+    case VideoFrameExt::ColorSpaceAdobeRgb: return adobeRgb;
+    case VideoFrameExt::ColorSpaceBT709:    return full ? bt709Full : bt709Small;
+    case VideoFrameExt::ColorSpaceBT2020:   return full ? bt2020Full : bt2020Small;
+    default:                                return full ? bt601Full : bt601Small;
+    }
+}
+
+namespace {
+struct PlaneLayout
+{
+    int planeFormat; // see shaders/color.frag
+    int planes[3];   // of Y, U, V
+    bool interleaved; // the U, V pairs in planes[1]
+    bool sample16;
+    bool chromaRows; // vertically subsampled
+};
+}
+
+static bool planeLayout(QVideoFrameFormat::PixelFormat format, PlaneLayout &layout)
+{
+    switch (format) {
+    case QVideoFrameFormat::Format_YUV420P:   layout = { 2, { 0, 1, 2 }, false, false, true };  break;
+    case QVideoFrameFormat::Format_YUV422P:   layout = { 2, { 0, 1, 2 }, false, false, false }; break;
+    case QVideoFrameFormat::Format_YV12:      layout = { 3, { 0, 2, 1 }, false, false, true };  break;
+    case QVideoFrameFormat::Format_NV12:      layout = { 4, { 0, 1, 1 }, true,  false, true };  break;
+    case QVideoFrameFormat::Format_YUV420P10: layout = { 2, { 0, 1, 2 }, false, true,  true };  break;
+    case QVideoFrameFormat::Format_P010:
+    case QVideoFrameFormat::Format_P016:      layout = { 4, { 0, 1, 1 }, true,  true,  true };  break;
+    default:
+        return false;
+    }
+    return true;
+}
+
+static void loadSamples(const uchar *line, bool sample16, int step, int count, float scale, float *dst)
+{
+    if (sample16) {
+        const auto samples = reinterpret_cast<const quint16 *>(line);
+        for (int i = 0; i < count; i++)
+            dst[i] = samples[i * step] * scale;
+    } else {
+        for (int i = 0; i < count; i++)
+            dst[i] = line[i * step] * scale;
+    }
+}
+
+static void loadChroma(const QVideoFrame &frame, const PlaneLayout &layout, int row, int count, float scale,
+                       float *u, float *v)
+{
+    const uchar *line = frame.bits(layout.planes[1]) + row * frame.bytesPerLine(layout.planes[1]);
+    if (layout.interleaved) {
+        loadSamples(line, layout.sample16, 2, count, scale, u);
+        loadSamples(line + (layout.sample16 ? 2 : 1), layout.sample16, 2, count, scale, v);
+    } else {
+        loadSamples(line, layout.sample16, 1, count, scale, u);
+        line = frame.bits(layout.planes[2]) + row * frame.bytesPerLine(layout.planes[2]);
+        loadSamples(line, layout.sample16, 1, count, scale, v);
+    }
+}
+
+// The half width chroma at the luma pixel centers as the linear filtering of its texture
+static void upsampleChroma(const float *chroma, int count, int width, float *dst)
+{
+    for (int k = 0; k < count; k++) {
+        const float prev = chroma[qMax(k - 1, 0)], curr = chroma[k], next = chroma[qMin(k + 1, count - 1)];
+        dst[2 * k] = 0.25f * prev + 0.75f * curr;
+        if (2 * k + 1 < width) dst[2 * k + 1] = 0.75f * curr + 0.25f * next;
+    }
+    for (int x = 2 * count; x < width; x++)
+        dst[x] = chroma[count - 1];
+}
+
+static float toLinear(float x)
+{
+    return x <= 0.04045f ? x * (1.0f / 12.92f) : std::pow((x + 0.055f) * (1.0f / 1.055f), 2.4f);
+}
+
+static float toNonlinear(float x)
+{
+    return x <= 0.0031308f ? x * 12.92f : 1.055f * std::pow(x, 1.0f / 2.4f) - 0.055f;
+}
+
+static quint32 toChannel(float x)
+{
+    return x > 0.0f ? quint32(qMin(x, 1.0f) * 255.0f + 0.5f) : 0; // NaN to black as well
+}
+
+//static
+bool ColorConverter::isSupported(QVideoFrameFormat::PixelFormat format)
+{
+    PlaneLayout layout;
+    return planeLayout(format, layout);
+}
+
+//static
+void ColorConverter::referenceColor(const VideoFrameExt &ext, const float yuv[3], float rgb[3])
+{
+    const ColorMatrix &m = colorMatrix(ext.colorSpace(), ext.isColorFull());
+    for (int c = 0; c < 3; c++)
+        rgb[c] = m.rgb[c][0] * yuv[0] + m.rgb[c][1] * yuv[1] + m.rgb[c][2] * yuv[2] + m.rgb[c][3];
+
+    const int transfer = ext.colorTransfer();
+    if (transfer != VideoFrameExt::ColorTransferST2084 && transfer != VideoFrameExt::ColorTransferSTD_B67) {
+        for (int c = 0; c < 3; c++)
+            rgb[c] = toLinear(rgb[c]);
+        return;
+    }
+    // 1. scale, literally as the shader
+    const float maxLum = 1.0f;
+    float scale = 1.0f;
+    const float y = (yuv[0] - 16.0f / 256.0f) * 256.0f / 219.0f;
+    float p = y / ext.colorWhite();
+    const float ks = 1.5f * maxLum - 0.5f;
+    if (p > ks) {
+        const float t = (p - ks) / (1.0f - ks);
+        const float t2 = t * t;
+        const float t3 = t * t2;
+        p = (2.0f * t3 - 3.0f * t2 + 1.0f) * ks + (t3 - 2.0f * t2 + t) * (1.0f - ks) + (-2.0f * t3 + 3.0f * t2) * maxLum;
+        scale = p * ext.colorWhite() / y;
+    }
+    for (int c = 0; c < 3; c++)
+        rgb[c] *= scale;
+    // 2. tonemap
+    if (transfer == VideoFrameExt::ColorTransferST2084) {
+        const float c1 = 107.0f / 128.0f, c2 = 2413.0f / 128.0f, c3 = 2392.0f / 128.0f;
+        for (int c = 0; c < 3; c++) {
+            const float e = std::pow(rgb[c], 32.0f / 2523.0f);
+            rgb[c] = std::pow(qMax(e - c1, 0.0f) / (c2 - c3 * e), 8192.0f / 1305.0f) * 10000.0f / 100.0f;
+        }
+    } else {
+        const float a = 0.17883277f, b = 0.28466892f, c = 0.55991073f;
+        for (int i = 0; i < 3; i++)
+            rgb[i] = rgb[i] < 0.5f ? rgb[i] * rgb[i] / 3.0f : (std::exp((rgb[i] - c) / a) + b) / 12.0f;
+        const float lum = rgb[0] * 0.2627f + rgb[1] * 0.6780f + rgb[2] * 0.0593f;
+        const float gamma = std::pow(lum, 0.2f);
+        for (int i = 0; i < 3; i++)
+            rgb[i] *= gamma;
+    }
+    // 3. convert rec2020 to sRGB
+    const float r = rgb[0], g = rgb[1], b = rgb[2];
+    rgb[0] =  1.6605f * r - 0.5876f * g - 0.0728f * b;
+    rgb[1] = -0.1246f * r + 1.1329f * g - 0.0083f * b;
+    rgb[2] = -0.0182f * r - 0.1006f * g + 1.1187f * b;
+}
+
+//static
+quint32 ColorConverter::referencePixel(const VideoFrameExt &ext, const float yuv[3])
+{
+    float rgb[3];
+    referenceColor(ext, yuv, rgb);
+    return 0xff000000 | toChannel(toNonlinear(rgb[0])) << 16 | toChannel(toNonlinear(rgb[1])) << 8 |
+            toChannel(toNonlinear(rgb[2]));
+}
+
+//static
+QString ColorConverter::instructionSet()
+{
+    return QString::fromLatin1(colorConvertName);
+}
+
+//static
+bool ColorConverter::convert(const QVideoFrame &frame, QImage &image, QThreadPool *pool)
+{
+    TRACE_ARG(frame);
+    PlaneLayout layout;
+    if (!planeLayout(frame.pixelFormat(), layout) || !frame.isMapped() ||
+            frame.planeCount() < (layout.interleaved ? 2 : 3))
+        return false;
+    const int width = frame.width(), height = frame.height();
+    if (width < 2 || height < 2)
+        return false;
+    if (image.size() != frame.size() || image.format() != QImage::Format_RGB32 || !image.isDetached())
+        image = QImage(frame.size(), QImage::Format_RGB32);
+    if (image.isNull())
+        return false;
+
+    const VideoFrameExt ext(layout.planeFormat, frame.surfaceFormat());
+    const ColorMatrix &matrix = colorMatrix(ext.colorSpace(), ext.isColorFull());
+    // The SDR transfer is linearized by the color pass and encoded back by the display pass
+    const bool sdr = (ext.colorTransfer() == VideoFrameExt::ColorTransferNOOP);
+    const float scale = ext.sampleScale() / (layout.sample16 ? 65535.0f : 255.0f);
+    const int chromaWidth = width / 2;
+    const int chromaHeight = layout.chromaRows ? height / 2 : height;
+    uchar *bits = image.bits();
+    const qsizetype bytesPerLine = image.bytesPerLine();
+
+    parallelStrips(pool, (height + stripRows - 1) / stripRows, [&](int strip) {
+        QVarLengthArray<float, 4096> y(width), u(width), v(width);
+        QVarLengthArray<float, 2048> u0(chromaWidth), v0(chromaWidth), u1(chromaWidth), v1(chromaWidth);
+        const int bottom = qMin((strip + 1) * stripRows, height);
+        for (int row = strip * stripRows; row < bottom; row++) {
+            loadSamples(frame.bits(layout.planes[0]) + row * frame.bytesPerLine(layout.planes[0]),
+                        layout.sample16, 1, width, scale, y.data());
+
+            // The chroma rows around the luma pixel center
+            int row0 = row;
+            float weight = 0.0f;
+            if (layout.chromaRows) {
+                const float center = row * 0.5f - 0.25f;
+                row0 = int(std::floor(center));
+                weight = center - row0;
+            }
+            loadChroma(frame, layout, qBound(0, row0, chromaHeight - 1), chromaWidth, scale, u0.data(), v0.data());
+            if (weight > 0.0f) {
+                loadChroma(frame, layout, qBound(0, row0 + 1, chromaHeight - 1), chromaWidth, scale, u1.data(), v1.data());
+                for (int i = 0; i < chromaWidth; i++) {
+                    u0[i] += (u1[i] - u0[i]) * weight;
+                    v0[i] += (v1[i] - v0[i]) * weight;
+                }
+            }
+            upsampleChroma(u0.constData(), chromaWidth, width, u.data());
+            upsampleChroma(v0.constData(), chromaWidth, width, v.data());
+
+            auto dst = reinterpret_cast<uint32_t *>(bits + row * bytesPerLine);
+            if (sdr) {
+                colorConvertRow(matrix, y.constData(), u.constData(), v.constData(), width, dst);
+            } else {
+                for (int x = 0; x < width; x++) {
+                    const float yuv[3] = { y[x], u[x], v[x] };
+                    dst[x] = referencePixel(ext, yuv);
+                }
+            }
+        }
+    });
+    return true;
+}
+
+namespace {
+struct BenchmarkCase
+{
+    QVideoFrameFormat::PixelFormat format;
+    QVideoFrameFormat::ColorSpace space;
+    QVideoFrameFormat::ColorRange range;
+    QVideoFrameFormat::ColorTransfer transfer;
+};
+
+enum ChromaPattern { // of the benchmark frames
+    ChromaConstant, // the given U, V
+    ChromaGradient, // U ramps left to right, V top to bottom over the full range
+    ChromaChecker, // the given U, V and their opposites per chroma sample, the edges of the upsampling
+    ChromaRandom,
+    ChromaPatterns
+};
+}
+
+// The frame of random luma and the chroma pattern, the 10 bit samples in place of the format
+static QVideoFrame benchmarkFrame(const BenchmarkCase &test, const QSize &size, int pattern, int u, int v)
+{
+    QVideoFrameFormat format(size, test.format);
+    format.setColorSpace(test.space);
+    format.setColorRange(test.range);
+    format.setColorTransfer(test.transfer);
+    format.setMaxLuminance(1000.0f);
+    QVideoFrame frame(format);
+    if (!frame.map(QVideoFrame::WriteOnly)) return QVideoFrame();
+    PlaneLayout layout;
+    planeLayout(test.format, layout);
+    const int bits = (test.format == QVideoFrameFormat::Format_YUV420P10 ||
+                      test.format == QVideoFrameFormat::Format_P010) ? 10 : layout.sample16 ? 16 : 8;
+    const int shift = (test.format == QVideoFrameFormat::Format_P010) ? 6 : 0;
+    const int maxValue = (1 << bits) - 1;
+    auto random = QRandomGenerator::global();
+    for (int plane = 0; plane < frame.planeCount(); plane++) {
+        const int rows = (plane && layout.chromaRows) ? size.height() / 2 : size.height();
+        const int samples = (plane ? size.width() / 2 : size.width()) * (plane && layout.interleaved ? 2 : 1);
+        const int chromaWidth = size.width() / 2;
+        for (int row = 0; row < rows; row++) {
+            uchar *line = frame.bits(plane) + row * frame.bytesPerLine(plane);
+            for (int i = 0; i < samples; i++) {
+                const bool isU = plane == layout.planes[1] && (!layout.interleaved || !(i & 1));
+                const int k = layout.interleaved ? i / 2 : i; // of the chroma sample in the row
+                int value = isU ? u : v;
+                if (!plane) {
+                    value = int(random->bounded(maxValue + 1));
+                } else if (pattern == ChromaGradient) {
+                    value = isU ? k * maxValue / qMax(chromaWidth - 1, 1) : row * maxValue / qMax(rows - 1, 1);
+                } else if (pattern == ChromaChecker) {
+                    if ((k + row) & 1) value = maxValue - value;
+                } else if (pattern == ChromaRandom) {
+                    value = int(random->bounded(maxValue + 1));
+                }
+                value <<= shift;
+                if (layout.sample16) reinterpret_cast<quint16 *>(line)[i] = quint16(value);
+                else line[i] = uchar(value);
+            }
+        }
+    }
+    frame.unmap();
+    return frame;
+}
+
+//static
+int ColorConverter::benchmark()
+{
+    static const BenchmarkCase cases[] = {
+        { QVideoFrameFormat::Format_YUV420P,   QVideoFrameFormat::ColorSpace_BT709,  QVideoFrameFormat::ColorRange_Video, QVideoFrameFormat::ColorTransfer_BT709 },
+        { QVideoFrameFormat::Format_YV12,      QVideoFrameFormat::ColorSpace_BT601,  QVideoFrameFormat::ColorRange_Full,  QVideoFrameFormat::ColorTransfer_BT709 },
+        { QVideoFrameFormat::Format_NV12,      QVideoFrameFormat::ColorSpace_BT709,  QVideoFrameFormat::ColorRange_Full,  QVideoFrameFormat::ColorTransfer_BT709 },
+        { QVideoFrameFormat::Format_YUV422P,   QVideoFrameFormat::ColorSpace_BT601,  QVideoFrameFormat::ColorRange_Video, QVideoFrameFormat::ColorTransfer_BT709 },
+        { QVideoFrameFormat::Format_YUV420P10, QVideoFrameFormat::ColorSpace_BT2020, QVideoFrameFormat::ColorRange_Video, QVideoFrameFormat::ColorTransfer_BT709 },
+        { QVideoFrameFormat::Format_P010,      QVideoFrameFormat::ColorSpace_BT2020, QVideoFrameFormat::ColorRange_Video, QVideoFrameFormat::ColorTransfer_ST2084 },
+        { QVideoFrameFormat::Format_YUV420P10, QVideoFrameFormat::ColorSpace_BT2020, QVideoFrameFormat::ColorRange_Video, QVideoFrameFormat::ColorTransfer_STD_B67 }
+    };
+    const QSize accuracySize(256, 64), speedSize(3840, 1920);
+    QThreadPool pool;
+    QImage image;
+    int failed = 0;
+    qInfo().noquote() << "Color conversion:" << instructionSet() << pool.maxThreadCount() << "threads";
+
+    // The accuracy is of the pixels read back from the color pass of VideoRenderer
+    QOffscreenSurface surface;
+    surface.setFormat(QSurfaceFormat::defaultFormat());
+    surface.create();
+    QOpenGLContext context;
+    context.setFormat(QSurfaceFormat::defaultFormat());
+    QScopedPointer<VideoRenderer> renderer; // released before the context
+    if (surface.isValid() && context.create() && context.makeCurrent(&surface)) {
+        renderer.reset(new VideoRenderer(nullptr));
+        renderer->setZeroCopy(false);
+    } else qWarning() << Q_FUNC_INFO << "Can't create OpenGL context, the accuracy is not checked";
+
+    for (const auto &test : cases) {
+        PlaneLayout layout;
+        planeLayout(test.format, layout);
+        int maxError = 0;
+        for (int pass = 0; renderer && pass < 2 * ChromaPatterns; pass++) {
+            const int range = layout.sample16 && test.format != QVideoFrameFormat::Format_P016 ? 1024 : 256;
+            const int u = QRandomGenerator::global()->bounded(range), v = QRandomGenerator::global()->bounded(range);
+            QVideoFrame frame = benchmarkFrame(test, accuracySize, pass % ChromaPatterns, u, v);
+            renderer->setVideoFrame(frame); // unmapped, the renderer maps it
+            renderer->render();
+            const QImage expect = renderer->readFrame();
+            if (expect.size() != accuracySize || !frame.map(QVideoFrame::ReadOnly) || !convert(frame, image, &pool)) {
+                qCritical() << Q_FUNC_INFO << "Can't convert" << test.format;
+                return int(std::size(cases));
+            }
+            for (int row = 0; row < accuracySize.height(); row++) {
+                const auto colors = reinterpret_cast<const QRgba64 *>(expect.constScanLine(row));
+                const auto pixels = reinterpret_cast<const quint32 *>(image.constScanLine(row));
+                for (int x = 0; x < accuracySize.width(); x++) {
+                    // Encoded to sRGB as the display pass does
+                    const quint32 pixel = toChannel(toNonlinear(colors[x].red() / 65535.0f)) << 16 |
+                            toChannel(toNonlinear(colors[x].green() / 65535.0f)) << 8 |
+                            toChannel(toNonlinear(colors[x].blue() / 65535.0f));
+                    for (int c = 0; c < 24; c += 8)
+                        maxError = qMax(maxError, qAbs(int((pixel >> c) & 0xff) - int((pixels[x] >> c) & 0xff)));
+                }
+            }
+            frame.unmap();
+        }
+
+        QVideoFrame frame = benchmarkFrame(test, speedSize, ChromaConstant, 128, 128);
+        frame.map(QVideoFrame::ReadOnly);
+        QElapsedTimer timer;
+        timer.start();
+        int runs = 0;
+        do {
+            convert(frame, image, &pool);
+            runs++;
+        } while (timer.elapsed() < 1000);
+        const qreal mpix = qreal(runs) * speedSize.width() * speedSize.height() / timer.nsecsElapsed() * 1000.0;
+        frame.unmap();
+
+        const bool ok = (maxError <= tolerance);
+        if (!ok) failed++;
+        qInfo().noquote() << QString("%1 %2 %3 %4: %5 MPix/s, max error %6 %7")
+                             .arg(QVideoFrameFormat::pixelFormatToString(test.format), -18)
+                             .arg(int(test.space)).arg(int(test.range)).arg(int(test.transfer))
+                             .arg(mpix, 0, 'f', 1).arg(renderer ? QString::number(maxError) : QStringLiteral("n/a"))
+                             .arg(ok ? "ok" : "FAILED");
+    }
+    return failed;
+}
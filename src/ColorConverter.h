@@ -0,0 +1,40 @@
+#ifndef COLORCONVERTER_H
+#define COLORCONVERTER_H
+
+#include <QVideoFrame>
+#include <QVideoFrameFormat>
+#include <QImage>
+#include <QString>
+
+class QThreadPool;
+class VideoFrameExt;
+
+/*
+ * The CPU conversion of the planar YUV frames (YUV420P, YV12, NV12, YUV422P and their
+ * 10 bit kinds) as the color pass of VideoRenderer: the matrices and transfer functions
+ * of shaders/color.frag followed by the sRGB encoding of shaders/display.frag. The SDR
+ * rows go through the SIMD kernel of ColorConvertKernel.h, the HDR ones (PQ, HLG) through
+ * the scalar reference, both in strips of rows on all pool threads.
+ */
+class ColorConverter
+{
+public:
+    static bool isSupported(QVideoFrameFormat::PixelFormat format);
+
+    // The frame mapped for reading to the RGB32 image, reallocated if the size doesn't match
+    static bool convert(const QVideoFrame &frame, QImage &image, QThreadPool *pool);
+
+    // The linear RGB of shaders/color.frag for the YUV samples normalized with the sample scale,
+    // transcribed as the scalar path of the HDR rows
+    static void referenceColor(const VideoFrameExt &ext, const float yuv[3], float rgb[3]);
+    static quint32 referencePixel(const VideoFrameExt &ext, const float yuv[3]); // sRGB encoded RGB32
+
+    static QString instructionSet(); // of the row kernel running on this CPU
+
+    // Prints the throughput in MPix/s and the max deviation per format from the color pass of
+    // VideoRenderer read back from an offscreen context, over the frames of constant, gradient,
+    // checkered and random chroma, returns the count of the formats beyond the tolerance
+    static int benchmark();
+};
+
+#endif // COLORCONVERTER_H
@@ -1,5 +1,5 @@
 #include "ConfigReceiver.h"
-#include "PanoramaView.h" // just for defaultStereoShift and FovAngle
+#include "PanoramaOutput.h" // just for defaultStereoShift and FovAngle
 
 #include <QTimer>
 #include <QUdpSocket>
@@ -34,8 +34,8 @@ ConfigReceiver::ConfigReceiver(QObject *parent)
     , m_enableCompass(false)
     , m_screenSaver(defaultScreenSaver)
     , m_adjustAngle(0)
-    , m_fovAngle(PanoramaView::FovDef)
-    , m_stereoShift(PanoramaView::defaultStereoShift)
+    , m_fovAngle(PanoramaOutput::FovDef)
+    , m_stereoShift(PanoramaOutput::defaultStereoShift)
     , m_udpPort(defaultUdpPort)
     , m_udpSocket(nullptr)
     , m_fileWatcher(new QFileSystemWatcher(this))
@@ -50,11 +50,11 @@ ConfigReceiver::~ConfigReceiver()
     if (m_adjustAngle != 0)
         settings.setValue("AdjustAngle", m_adjustAngle);
 
-    if (m_fovAngle != PanoramaView::FovDef)
+    if (m_fovAngle != PanoramaOutput::FovDef)
         settings.setValue("FovAngle", m_fovAngle);
 
     qreal value = roundTo2(m_stereoShift);
-    if (value != PanoramaView::defaultStereoShift)
+    if (value != PanoramaOutput::defaultStereoShift)
         settings.setValue("StereoShift", value);
 }
 
@@ -420,13 +420,13 @@ void ConfigReceiver::onActiveTimer()
         m_adjustAngle = angle;
         emit adjustAngleChanged();
     }
-    num = settings.value("FovAngle", PanoramaView::FovDef).toInt();
-    angle = qBound(int(PanoramaView::FovMin), num, int(PanoramaView::FovMax));
+    num = settings.value("FovAngle", PanoramaOutput::FovDef).toInt();
+    angle = qBound(int(PanoramaOutput::FovMin), num, int(PanoramaOutput::FovMax));
     if (angle != m_fovAngle) {
         m_fovAngle = angle;
         emit fovAngleChanged();
     }
-    qreal val = settings.value("StereoShift", PanoramaView::defaultStereoShift).toDouble();
+    qreal val = settings.value("StereoShift", PanoramaOutput::defaultStereoShift).toDouble();
     qreal shift = roundTo2(qBound(0.0, val, 1.0));
     if (shift != m_stereoShift) {
         m_stereoShift = shift;
@@ -459,13 +459,13 @@ void ConfigReceiver::onUdpReadyRead()
                 reset_req = true;
                 emit adjustAngleChanged();
             }
-            if (m_fovAngle != PanoramaView::FovDef) {
-                m_fovAngle = PanoramaView::FovDef;
+            if (m_fovAngle != PanoramaOutput::FovDef) {
+                m_fovAngle = PanoramaOutput::FovDef;
                 reset_req = true;
                 emit fovAngleChanged();
             }
-            if (!qFuzzyCompare(m_stereoShift, PanoramaView::defaultStereoShift)) {
-                m_stereoShift = PanoramaView::defaultStereoShift;
+            if (!qFuzzyCompare(m_stereoShift, PanoramaOutput::defaultStereoShift)) {
+                m_stereoShift = PanoramaOutput::defaultStereoShift;
                 reset_req = true;
                 emit stereoShiftChanged();
             }
@@ -480,12 +480,12 @@ void ConfigReceiver::onUdpReadyRead()
                 emit adjustAngleChanged();
             }
         } else if (token == "zoom_plus") {
-            if (m_fovAngle > PanoramaView::FovMin) {
+            if (m_fovAngle > PanoramaOutput::FovMin) {
                 m_fovAngle -= 5;
                 emit fovAngleChanged();
             }
         } else if (token == "zoom_minus") {
-            if (m_fovAngle < PanoramaView::FovMax) {
+            if (m_fovAngle < PanoramaOutput::FovMax) {
                 m_fovAngle += 5;
                 emit fovAngleChanged();
             }
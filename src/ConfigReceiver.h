@@ -2,7 +2,7 @@
 #define CONFIGRECEIVER_H
 
 #include <QObject>
-#include <QQmlComponent>
+#include <QtQmlIntegration/qqmlintegration.h> // QML_ELEMENT without linking Qt Qml
 #include <qtmetamacros.h>
 
 class QUdpSocket;
@@ -0,0 +1,152 @@
+#include "Etc2Encoder.h"
+
+#include <climits>
+
+// The ETC1 modifier tables, the pixel index (msb, lsb) 0..3 is +a, +b, -a, -b
+static const int modifierTables[8][2] = {
+    { 2, 8 }, { 5, 17 }, { 9, 29 }, { 13, 42 }, { 18, 60 }, { 24, 80 }, { 33, 106 }, { 47, 183 }
+};
+
+static inline int clamp255(int value)
+{
+    return value < 0 ? 0 : value > 255 ? 255 : value;
+}
+
+static inline int modifier(int table, int index)
+{
+    const int value = modifierTables[table][index & 1];
+    return (index & 2) ? -value : value;
+}
+
+struct SubBlock {
+    int pixels[8][3]; // RGB
+    int positions[8]; // the pixel bit, x * 4 + y
+};
+
+// The best table and pixel indices of the sub-block around the base color, returns the error
+static int fitSubBlock(const SubBlock &sub, const int base[3], int *table, int indices[8])
+{
+    int bestError = INT_MAX;
+    for (int t = 0; t < 8; t++) {
+        int error = 0;
+        int picks[8];
+        for (int p = 0; p < 8 && error < bestError; p++) {
+            int pixelBest = INT_MAX;
+            for (int i = 0; i < 4; i++) {
+                const int mod = modifier(t, i);
+                int e = 0;
+                for (int c = 0; c < 3; c++) {
+                    const int d = clamp255(base[c] + mod) - sub.pixels[p][c];
+                    e += d * d;
+                }
+                if (e < pixelBest) {
+                    pixelBest = e;
+                    picks[p] = i;
+                }
+            }
+            error += pixelBest;
+        }
+        if (error < bestError) {
+            bestError = error;
+            *table = t;
+            for (int p = 0; p < 8; p++)
+                indices[p] = picks[p];
+        }
+    }
+    return bestError;
+}
+
+static void encodeBlock(const uint8_t *rgba, int bytesPerLine, uint8_t *dst)
+{
+    uint64_t bestBlock = 0;
+    int bestError = INT_MAX;
+    for (int flip = 0; flip < 2; flip++) {
+        // Two 2x4 sub-blocks side by side, or two 4x2 ones on top of each other if flipped
+        SubBlock subs[2];
+        int counts[2] = { 0, 0 };
+        int sums[2][3] = { { 0, 0, 0 }, { 0, 0, 0 } };
+        for (int y = 0; y < 4; y++) {
+            const uint8_t *row = rgba + y * bytesPerLine;
+            for (int x = 0; x < 4; x++) {
+                const int s = flip ? (y >= 2) : (x >= 2);
+                SubBlock &sub = subs[s];
+                const int n = counts[s]++;
+                for (int c = 0; c < 3; c++) {
+                    sub.pixels[n][c] = row[x * 4 + c];
+                    sums[s][c] += row[x * 4 + c];
+                }
+                sub.positions[n] = x * 4 + y;
+            }
+        }
+
+        // The differential mode if the 5 bit averages are close enough, else 4 bits each
+        int q5[2][3], q4[2][3];
+        bool differential = true;
+        for (int s = 0; s < 2; s++) {
+            for (int c = 0; c < 3; c++) {
+                q5[s][c] = (sums[s][c] * 31 + 8 * 255 / 2) / (8 * 255);
+                q4[s][c] = (sums[s][c] * 15 + 8 * 255 / 2) / (8 * 255);
+            }
+        }
+        for (int c = 0; c < 3; c++) {
+            const int d = q5[1][c] - q5[0][c];
+            if (d < -4 || d > 3) differential = false;
+        }
+        int bases[2][3];
+        for (int s = 0; s < 2; s++) {
+            for (int c = 0; c < 3; c++) {
+                bases[s][c] = differential ? (q5[s][c] << 3) | (q5[s][c] >> 2)
+                                           : (q4[s][c] << 4) | q4[s][c];
+            }
+        }
+
+        int tables[2], indices[2][8];
+        int error = fitSubBlock(subs[0], bases[0], &tables[0], indices[0]);
+        if (error >= bestError) continue;
+        error += fitSubBlock(subs[1], bases[1], &tables[1], indices[1]);
+        if (error >= bestError) continue;
+        bestError = error;
+
+        uint64_t block = 0;
+        if (differential) {
+            for (int c = 0; c < 3; c++) {
+                const int shift = 59 - c * 8;
+                block |= uint64_t(q5[0][c]) << shift;
+                block |= uint64_t((q5[1][c] - q5[0][c]) & 7) << (shift - 3);
+            }
+            block |= uint64_t(1) << 33;
+        } else {
+            for (int c = 0; c < 3; c++) {
+                const int shift = 60 - c * 8;
+                block |= uint64_t(q4[0][c]) << shift;
+                block |= uint64_t(q4[1][c]) << (shift - 4);
+            }
+        }
+        block |= uint64_t(tables[0]) << 37;
+        block |= uint64_t(tables[1]) << 34;
+        block |= uint64_t(flip) << 32;
+        for (int s = 0; s < 2; s++) {
+            for (int p = 0; p < 8; p++) {
+                const int bit = subs[s].positions[p];
+                block |= uint64_t(indices[s][p] >> 1) << (16 + bit);
+                block |= uint64_t(indices[s][p] & 1) << bit;
+            }
+        }
+        bestBlock = block;
+    }
+
+    // Big-endian as the format defines
+    for (int i = 0; i < 8; i++)
+        dst[i] = uint8_t(bestBlock >> (56 - i * 8));
+}
+
+void etc2EncodeImage(const uint8_t *rgba, int bytesPerLine, int width, int height, uint8_t *blocks)
+{
+    for (int y = 0; y + 4 <= height; y += 4) {
+        const uint8_t *row = rgba + y * bytesPerLine;
+        for (int x = 0; x + 4 <= width; x += 4) {
+            encodeBlock(row + x * 4, bytesPerLine, blocks);
+            blocks += etc2BlockBytes;
+        }
+    }
+}
@@ -0,0 +1,23 @@
+#ifndef ETC2ENCODER_H
+#define ETC2ENCODER_H
+
+#include <cstdint>
+
+/*
+ * The fast CPU encoder of the RGB8 ETC2 textures for LoopCache. The blocks use the ETC1
+ * individual and differential modes only, which are a valid subset of ETC2, with the base
+ * colors by the sub-block averages and the best modifier table per sub-block.
+ */
+
+static constexpr int const etc2BlockBytes = 8; // per 4x4 pixels
+
+// The bytes of a width x height texture, both multiples of 4
+inline int etc2ImageBytes(int width, int height)
+{
+    return (width / 4) * (height / 4) * etc2BlockBytes;
+}
+
+// Encode the RGBA8888 (or RGBX8888) image into the blocks in row-major order, alpha ignored
+void etc2EncodeImage(const uint8_t *rgba, int bytesPerLine, int width, int height, uint8_t *blocks);
+
+#endif // ETC2ENCODER_H
@@ -0,0 +1,292 @@
+#include "FrameReader.h"
+
+#include <QVideoFrameFormat>
+#include <QtDebug>
+
+#include <cstring>
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+#include <libavutil/pixdesc.h>
+#include <libswscale/swscale.h>
+}
+
+//#define TRACE_FRAMEREADER
+#ifdef  TRACE_FRAMEREADER
+#include <QTime>
+#define TRACE()      qDebug() << QTime::currentTime().toString("hh:mm:ss.zzz") << QThread::currentThreadId() << Q_FUNC_INFO;
+#define TRACE_ARG(x) qDebug() << QTime::currentTime().toString("hh:mm:ss.zzz") << QThread::currentThreadId() << Q_FUNC_INFO << x;
+#else
+#define TRACE()
+#define TRACE_ARG(x)
+#endif
+
+static QString avErrorText(int err)
+{
+    char buf[AV_ERROR_MAX_STRING_SIZE] = { 0 };
+    av_strerror(err, buf, sizeof(buf));
+    return QString::fromLocal8Bit(buf);
+}
+
+FrameReader::FrameReader(QObject *parent)
+    : QThread(parent)
+    , m_formatCtx(nullptr)
+    , m_codecCtx(nullptr)
+    , m_swsCtx(nullptr)
+    , m_stream(-1)
+    , m_frameRate(0.0)
+    , m_duration(0)
+    , m_startPts(AV_NOPTS_VALUE)
+    , m_finished(false)
+    , m_stopped(false)
+{
+}
+
+FrameReader::~FrameReader()
+{
+    stop();
+    wait();
+    close();
+}
+
+bool FrameReader::open(const QString &fileName)
+{
+    TRACE_ARG(fileName);
+    Q_ASSERT(!isRunning());
+    close();
+    int err = avformat_open_input(&m_formatCtx, fileName.toUtf8().constData(), nullptr, nullptr);
+    if (err >= 0) err = avformat_find_stream_info(m_formatCtx, nullptr);
+    const AVCodec *codec = nullptr;
+    if (err >= 0) err = m_stream = av_find_best_stream(m_formatCtx, AVMEDIA_TYPE_VIDEO, -1, -1, &codec, 0);
+    if (err < 0) {
+        m_errorText = QStringLiteral("Can't open video of %1: %2").arg(fileName, avErrorText(err));
+        close();
+        return false;
+    }
+    const AVStream *stream = m_formatCtx->streams[m_stream];
+    m_codecCtx = avcodec_alloc_context3(codec);
+    err = m_codecCtx ? avcodec_parameters_to_context(m_codecCtx, stream->codecpar) : AVERROR(ENOMEM);
+    if (err >= 0) {
+        // All cores by the frame and slice threads, the renderer takes the frames in order
+        m_codecCtx->thread_count = 0;
+        m_codecCtx->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+        err = avcodec_open2(m_codecCtx, codec, nullptr);
+    }
+    if (err < 0) {
+        m_errorText = QStringLiteral("Can't open %1 decoder: %2").arg(QString::fromLatin1(codec->name), avErrorText(err));
+        close();
+        return false;
+    }
+    m_frameRate = av_q2d(av_guess_frame_rate(m_formatCtx, const_cast<AVStream *>(stream), nullptr));
+    if (m_frameRate <= 0.0) m_frameRate = 30.0;
+    if (stream->duration != AV_NOPTS_VALUE)
+        m_duration = av_rescale_q(stream->duration, stream->time_base, AVRational{ 1, 1000 });
+    else if (m_formatCtx->duration != AV_NOPTS_VALUE)
+        m_duration = m_formatCtx->duration / (AV_TIME_BASE / 1000);
+    m_finished = m_stopped = false;
+    m_errorText.clear();
+    TRACE_ARG(codec->name << frameSize() << m_frameRate << m_duration);
+    return true;
+}
+
+void FrameReader::close()
+{
+    if (m_swsCtx) sws_freeContext(m_swsCtx);
+    m_swsCtx = nullptr;
+    if (m_codecCtx) avcodec_free_context(&m_codecCtx);
+    if (m_formatCtx) avformat_close_input(&m_formatCtx);
+    m_stream = -1;
+    m_startPts = AV_NOPTS_VALUE;
+}
+
+QString FrameReader::errorText() const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_errorText;
+}
+
+QSize FrameReader::frameSize() const
+{
+    return m_codecCtx ? QSize(m_codecCtx->width, m_codecCtx->height) : QSize();
+}
+
+qreal FrameReader::frameRate() const
+{
+    return m_frameRate;
+}
+
+qint64 FrameReader::duration() const
+{
+    return m_duration;
+}
+
+QVideoFrame FrameReader::takeFrame()
+{
+    QMutexLocker lock(&m_mutex);
+    while (m_queue.isEmpty() && !m_finished && !m_stopped)
+        m_queueChanged.wait(&m_mutex);
+    if (m_queue.isEmpty()) return QVideoFrame();
+    QVideoFrame frame = m_queue.dequeue();
+    m_queueChanged.wakeAll();
+    return frame;
+}
+
+void FrameReader::stop()
+{
+    QMutexLocker lock(&m_mutex);
+    m_stopped = true;
+    m_queue.clear();
+    m_queueChanged.wakeAll();
+}
+
+bool FrameReader::enqueue(const QVideoFrame &frame)
+{
+    QMutexLocker lock(&m_mutex);
+    while (m_queue.size() >= maxQueued && !m_stopped)
+        m_queueChanged.wait(&m_mutex);
+    if (m_stopped) return false;
+    m_queue.enqueue(frame);
+    m_queueChanged.wakeAll();
+    return true;
+}
+
+void FrameReader::setFinished(const QString &errorText)
+{
+    QMutexLocker lock(&m_mutex);
+    m_finished = true;
+    if (!errorText.isEmpty()) m_errorText = errorText;
+    m_queueChanged.wakeAll();
+}
+
+void FrameReader::run()
+{
+    TRACE();
+    if (!m_codecCtx) {
+        setFinished(QStringLiteral("No video to decode"));
+        return;
+    }
+    AVPacket *packet = av_packet_alloc();
+    AVFrame *avFrame = av_frame_alloc();
+    QString error;
+    bool endOfFile = false;
+    for (;;) {
+        int err = avcodec_receive_frame(m_codecCtx, avFrame);
+        if (err >= 0) {
+            const QVideoFrame frame = toVideoFrame(avFrame);
+            av_frame_unref(avFrame);
+            if (!frame.isValid()) {
+                error = QStringLiteral("Can't convert the decoded frame");
+                break;
+            }
+            if (!enqueue(frame)) break;
+            continue;
+        }
+        if (err == AVERROR_EOF) break;
+        if (err != AVERROR(EAGAIN)) {
+            error = QStringLiteral("Decoding failed: %1").arg(avErrorText(err));
+            break;
+        }
+
+        // The decoder takes more input
+
+        err = av_read_frame(m_formatCtx, packet);
+        if (err < 0) {
+            if (err != AVERROR_EOF) qWarning().noquote() << "Reading stopped:" << avErrorText(err);
+            if (endOfFile) break;
+            endOfFile = true;
+            avcodec_send_packet(m_codecCtx, nullptr); // drain
+            continue;
+        }
+        if (packet->stream_index == m_stream) {
+            err = avcodec_send_packet(m_codecCtx, packet);
+            if (err < 0 && err != AVERROR_INVALIDDATA)
+                qWarning().noquote() << "Packet dropped:" << avErrorText(err);
+        }
+        av_packet_unref(packet);
+    }
+    av_frame_free(&avFrame);
+    av_packet_free(&packet);
+    setFinished(error);
+    TRACE_ARG("Finished" << error);
+}
+
+QVideoFrame FrameReader::toVideoFrame(const AVFrame *src)
+{
+    // The planes of the formats taken as they are, the chroma height divisor per plane
+    QVideoFrameFormat::PixelFormat pixelFormat = QVideoFrameFormat::Format_Invalid;
+    int chromaShift = 1;
+    switch (src->format) {
+    case AV_PIX_FMT_YUV420P:
+    case AV_PIX_FMT_YUVJ420P:    pixelFormat = QVideoFrameFormat::Format_YUV420P; break;
+    case AV_PIX_FMT_YUV422P:
+    case AV_PIX_FMT_YUVJ422P:    pixelFormat = QVideoFrameFormat::Format_YUV422P; chromaShift = 0; break;
+    case AV_PIX_FMT_NV12:        pixelFormat = QVideoFrameFormat::Format_NV12; break;
+    case AV_PIX_FMT_YUV420P10LE: pixelFormat = QVideoFrameFormat::Format_YUV420P10; break;
+    case AV_PIX_FMT_P010LE:      pixelFormat = QVideoFrameFormat::Format_P010; break;
+    default: break;
+    }
+    const AVFrame *planes = src;
+    AVFrame *converted = nullptr;
+    if (pixelFormat == QVideoFrameFormat::Format_Invalid) {
+        m_swsCtx = sws_getCachedContext(m_swsCtx, src->width, src->height, AVPixelFormat(src->format),
+                                        src->width, src->height, AV_PIX_FMT_YUV420P, SWS_BILINEAR,
+                                        nullptr, nullptr, nullptr);
+        converted = av_frame_alloc();
+        converted->format = AV_PIX_FMT_YUV420P;
+        converted->width = src->width;
+        converted->height = src->height;
+        if (!m_swsCtx || av_frame_get_buffer(converted, 0) < 0) {
+            av_frame_free(&converted);
+            return QVideoFrame();
+        }
+        sws_scale(m_swsCtx, src->data, src->linesize, 0, src->height, converted->data, converted->linesize);
+        planes = converted;
+        pixelFormat = QVideoFrameFormat::Format_YUV420P;
+    }
+
+    QVideoFrameFormat format(QSize(src->width, src->height), pixelFormat);
+    switch (src->colorspace) {
+    case AVCOL_SPC_BT709:      format.setColorSpace(QVideoFrameFormat::ColorSpace_BT709); break;
+    case AVCOL_SPC_BT470BG:
+    case AVCOL_SPC_SMPTE170M:  format.setColorSpace(QVideoFrameFormat::ColorSpace_BT601); break;
+    case AVCOL_SPC_BT2020_NCL:
+    case AVCOL_SPC_BT2020_CL:  format.setColorSpace(QVideoFrameFormat::ColorSpace_BT2020); break;
+    default: break;
+    }
+    switch (src->color_trc) {
+    case AVCOL_TRC_BT709:        format.setColorTransfer(QVideoFrameFormat::ColorTransfer_BT709); break;
+    case AVCOL_TRC_SMPTE2084:    format.setColorTransfer(QVideoFrameFormat::ColorTransfer_ST2084); break;
+    case AVCOL_TRC_ARIB_STD_B67: format.setColorTransfer(QVideoFrameFormat::ColorTransfer_STD_B67); break;
+    default: break;
+    }
+    format.setColorRange(src->color_range == AVCOL_RANGE_JPEG || src->format == AV_PIX_FMT_YUVJ420P ||
+                         src->format == AV_PIX_FMT_YUVJ422P ? QVideoFrameFormat::ColorRange_Full
+                                                            : QVideoFrameFormat::ColorRange_Video);
+    format.setStreamFrameRate(m_frameRate);
+
+    QVideoFrame frame(format);
+    if (frame.map(QVideoFrame::WriteOnly)) {
+        for (int i = 0; i < frame.planeCount(); i++) {
+            const int rows = i ? (src->height + chromaShift) >> chromaShift : src->height;
+            const int bytes = qMin(frame.bytesPerLine(i), planes->linesize[i]);
+            for (int row = 0; row < rows; row++) {
+                memcpy(frame.bits(i) + row * frame.bytesPerLine(i),
+                       planes->data[i] + row * planes->linesize[i], bytes);
+            }
+        }
+        frame.unmap();
+    } else frame = QVideoFrame();
+    if (converted) av_frame_free(&converted);
+
+    // The times from the first frame, as the player position
+    const AVStream *stream = m_formatCtx->streams[m_stream];
+    const qint64 pts = src->best_effort_timestamp;
+    if (frame.isValid() && pts != AV_NOPTS_VALUE) {
+        if (m_startPts == AV_NOPTS_VALUE) m_startPts = pts;
+        const qint64 start = av_rescale_q(pts - m_startPts, stream->time_base, AVRational{ 1, 1000000 });
+        frame.setStartTime(start);
+        frame.setEndTime(start + qint64(1e6 / m_frameRate));
+    }
+    return frame;
+}
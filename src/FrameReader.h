@@ -0,0 +1,66 @@
+#ifndef FRAMEREADER_H
+#define FRAMEREADER_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QQueue>
+#include <QVideoFrame>
+#include <QString>
+#include <QSize>
+
+struct AVFormatContext;
+struct AVCodecContext;
+struct AVFrame;
+struct SwsContext;
+
+/*
+ * The video frames of a file decoded by FFmpeg on its own thread as fast as the decoder
+ * goes, for the batch renderer. QMediaPlayer paces the frames by the clock instead and
+ * drops the late ones. The decoded frames are copied into QVideoFrame of the formats
+ * VideoRenderer takes, the others are converted to YUV420P, a few are queued ahead.
+ */
+class FrameReader : public QThread
+{
+    Q_OBJECT
+public:
+    static constexpr int const maxQueued = 4; // the decoded frames ahead of the renderer
+
+    explicit FrameReader(QObject *parent = nullptr);
+    ~FrameReader() override;
+
+    bool open(const QString &fileName); // the best video stream, false with errorText() if failed
+    QString errorText() const;
+    QSize frameSize() const;
+    qreal frameRate() const; // per second, the nominal one
+    qint64 duration() const; // in ms, 0 if unknown
+
+    QVideoFrame takeFrame(); // blocks while decoding, the start time is from the clip begin, invalid at the end
+    void stop(); // and drop the queue
+
+protected:
+    void run() override;
+
+private:
+    void close();
+    QVideoFrame toVideoFrame(const AVFrame *frame);
+    bool enqueue(const QVideoFrame &frame); // blocks while the queue is full, false if stopped
+    void setFinished(const QString &errorText = QString());
+
+    AVFormatContext *m_formatCtx;
+    AVCodecContext *m_codecCtx;
+    SwsContext *m_swsCtx; // for the other pixel formats
+    int m_stream;
+    qreal m_frameRate;
+    qint64 m_duration;
+    qint64 m_startPts; // of the first frame, in the stream time base
+
+    mutable QMutex m_mutex;
+    QWaitCondition m_queueChanged;
+    QQueue<QVideoFrame> m_queue;
+    bool m_finished;
+    bool m_stopped;
+    QString m_errorText;
+};
+
+#endif // FRAMEREADER_H
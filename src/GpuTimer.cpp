@@ -0,0 +1,191 @@
+#include "GpuTimer.h"
+
+#include <QOpenGLContext>
+#include <QSurfaceFormat>
+#include <QtDebug>
+
+#include <cstring>
+#include <algorithm>
+
+#ifndef GL_TIME_ELAPSED
+#define GL_TIME_ELAPSED 0x88BF
+#endif
+#ifndef GL_GPU_DISJOINT_EXT
+#define GL_GPU_DISJOINT_EXT 0x8FBB
+#endif
+
+//#define TRACE_GPUTIMER
+#ifdef  TRACE_GPUTIMER
+#include <QTime>
+#include <QThread>
+#define TRACE()      qDebug() << QTime::currentTime().toString("hh:mm:ss.zzz") << QThread::currentThreadId() << Q_FUNC_INFO;
+#define TRACE_ARG(x) qDebug() << QTime::currentTime().toString("hh:mm:ss.zzz") << QThread::currentThreadId() << Q_FUNC_INFO << x;
+#else
+#define TRACE()
+#define TRACE_ARG(x)
+#endif
+
+GpuTimer::GpuTimer(int stages)
+    : m_stages(qBound(1, stages, int(maxStages)))
+    , m_valid(false)
+    , m_disjoint(false)
+    , m_frame(0)
+    , m_active(-1)
+    , m_results(0)
+    , m_sampled(0)
+{
+    memset(m_queries, 0, sizeof(m_queries));
+    memset(m_issued, 0, sizeof(m_issued));
+    memset(m_times, 0, sizeof(m_times));
+}
+
+GpuTimer::~GpuTimer()
+{
+    // The queries go with the scene graph context as the other GL objects
+}
+
+bool GpuTimer::init()
+{
+    const auto ctx = QOpenGLContext::currentContext();
+    if (!ctx) return false;
+    initializeOpenGLFunctions();
+    if (ctx->isOpenGLES()) {
+        m_valid = ctx->hasExtension("GL_EXT_disjoint_timer_query");
+        m_disjoint = m_valid;
+    } else {
+        m_valid = (ctx->format().version() >= qMakePair(3, 3) || ctx->hasExtension("GL_ARB_timer_query"));
+    }
+    TRACE_ARG("Valid" << m_valid << "disjoint" << m_disjoint);
+    if (!m_valid) return false;
+    for (int i = 0; i < frameLatency; i++)
+        for (int j = 0; j < m_stages; j++)
+            glGenQueries(maxSpans, m_queries[i][j]);
+    GLenum glErr = glGetError();
+    if (glErr != GL_NO_ERROR) {
+        qCritical() << Q_FUNC_INFO << "OpenGL Error" << glErr << "Line" << __LINE__;
+        m_valid = false;
+    }
+    return m_valid;
+}
+
+void GpuTimer::release()
+{
+    TRACE();
+    if (!m_valid) return;
+    end();
+    for (int i = 0; i < frameLatency; i++)
+        for (int j = 0; j < m_stages; j++)
+            glDeleteQueries(maxSpans, m_queries[i][j]);
+    memset(m_queries, 0, sizeof(m_queries));
+    memset(m_issued, 0, sizeof(m_issued));
+    m_valid = false;
+}
+
+bool GpuTimer::nextFrame()
+{
+    if (!m_valid) return false;
+    m_frame = (m_frame + 1) % frameLatency;
+
+    // The slot to reuse was issued frameLatency frames ago, its results are normally there,
+    // if not they are dropped instead of waiting
+    bool available = true;
+    for (int i = 0; i < m_stages && available; i++) {
+        // The spans end in order, the last one is enough
+        if (!m_issued[m_frame][i]) continue;
+        GLuint ready = 0;
+        glGetQueryObjectuiv(m_queries[m_frame][i][m_issued[m_frame][i] - 1], GL_QUERY_RESULT_AVAILABLE, &ready);
+        available = ready;
+    }
+    GLint disjoint = 0;
+    if (m_disjoint) glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+    bool any = false;
+    for (int i = 0; i < m_stages; i++) {
+        if (m_issued[m_frame][i]) any = true;
+    }
+    any = (any && available && !disjoint);
+    if (any) memset(m_times, 0, sizeof(m_times)); // the stages not run in this frame took no time
+    for (int i = 0; i < m_stages; i++) {
+        const int spans = m_issued[m_frame][i];
+        m_issued[m_frame][i] = 0;
+        for (int j = 0; any && j < spans; j++) {
+            GLuint time = 0; // ns, 32 bits are 4 seconds
+            glGetQueryObjectuiv(m_queries[m_frame][i][j], GL_QUERY_RESULT, &time);
+            m_times[i] += time;
+        }
+    }
+    if (any) {
+        m_results++;
+        if (!m_samples.isEmpty()) {
+            const int slot = m_sampled % statsFrames;
+            if (++m_sampled >= 2 * statsFrames) m_sampled -= statsFrames; // full, no overflow
+            for (int i = 0; i < m_stages; i++)
+                m_samples[i * statsFrames + slot] = m_times[i];
+            m_samples[m_stages * statsFrames + slot] = frameTime();
+        }
+    }
+    TRACE_ARG(m_frame << available << disjoint << frameTime());
+    return any;
+}
+
+void GpuTimer::begin(int stage)
+{
+    if (!m_valid || stage < 0 || stage >= m_stages || stage == m_active) return;
+    if (m_active >= 0) end();
+    if (m_issued[m_frame][stage] >= maxSpans) return;
+    glBeginQuery(GL_TIME_ELAPSED, m_queries[m_frame][stage][m_issued[m_frame][stage]]);
+    m_active = stage;
+}
+
+void GpuTimer::end()
+{
+    if (!m_valid || m_active < 0) return;
+    glEndQuery(GL_TIME_ELAPSED);
+    m_issued[m_frame][m_active]++;
+    m_active = -1;
+}
+
+qint64 GpuTimer::frameTime() const
+{
+    qint64 time = 0;
+    for (int i = 0; i < m_stages; i++)
+        time += m_times[i];
+    return time;
+}
+
+void GpuTimer::setStatistics(bool yes)
+{
+    if (yes == statistics()) return;
+    if (yes) m_samples.fill(0, (m_stages + 1) * statsFrames);
+    else m_samples.clear();
+    m_sampled = 0;
+}
+
+GpuTimer::Stats GpuTimer::stageStats(int stage) const
+{
+    if (m_samples.isEmpty() || stage < 0 || stage >= m_stages) return Stats();
+    return windowStats(m_samples.constData() + stage * statsFrames, qMin(m_sampled, int(statsFrames)));
+}
+
+GpuTimer::Stats GpuTimer::frameStats() const
+{
+    if (m_samples.isEmpty()) return Stats();
+    return windowStats(m_samples.constData() + m_stages * statsFrames, qMin(m_sampled, int(statsFrames)));
+}
+
+GpuTimer::Stats GpuTimer::windowStats(const qint64 *samples, int count)
+{
+    Stats stats;
+    if (count <= 0) return stats;
+    qint64 sorted[statsFrames];
+    std::copy(samples, samples + count, sorted);
+    const int rank = qMin(count - 1, (count * 99 + 99) / 100 - 1); // the nearest rank
+    std::nth_element(sorted, sorted + rank, sorted + count);
+    stats.p99 = sorted[rank];
+    stats.min = *std::min_element(samples, samples + count);
+    qint64 sum = 0;
+    for (int i = 0; i < count; i++)
+        sum += samples[i];
+    stats.avg = sum / count;
+    stats.frames = count;
+    return stats;
+}
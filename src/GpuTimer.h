@@ -0,0 +1,66 @@
+#ifndef GPUTIMER_H
+#define GPUTIMER_H
+
+#include <QOpenGLExtraFunctions>
+#include <QList>
+
+/*
+ * The GPU time of the render stages by the GL_TIME_ELAPSED queries, of OpenGL 3.3 or the
+ * GL_EXT_disjoint_timer_query of OpenGLES. The results are read a few frames later when
+ * available, so the timing never stalls the pipeline. A stage may run in a few spans per
+ * frame, their times add up. Used on the render thread only.
+ *
+ * The rolling statistics of the last statsFrames frames per stage are kept on request only.
+ */
+class GpuTimer : protected QOpenGLExtraFunctions
+{
+public:
+    static constexpr int const maxStages = 8;
+    static constexpr int const maxSpans = 4; // per stage and frame, the extra ones are not timed
+    static constexpr int const frameLatency = 4; // the frames of queries in flight
+    static constexpr int const statsFrames = 256; // the window of the rolling statistics
+
+    struct Stats { // in ns over the window
+        qint64 min = 0;
+        qint64 avg = 0;
+        qint64 p99 = 0;
+        int frames = 0; // in the window, 0 if none yet
+    };
+
+    explicit GpuTimer(int stages);
+    ~GpuTimer();
+
+    bool init(); // in the current context, false if the timer queries are not supported
+    void release(); // the queries, in the context of init()
+    bool isValid() const { return m_valid; }
+
+    bool nextFrame(); // collect the results of the oldest frame, call before the stages, true if any
+    void begin(int stage); // the stages don't nest
+    void end();
+
+    bool hasResults() const { return m_results > 0; } // of at least one frame
+    qint64 stageTime(int stage) const { return m_times[stage]; } // of the last finished frame in ns
+    qint64 frameTime() const; // of all stages in ns
+
+    void setStatistics(bool yes); // collect the rolling statistics, off by default
+    bool statistics() const { return !m_samples.isEmpty(); }
+    Stats stageStats(int stage) const; // of the last statsFrames frames with results
+    Stats frameStats() const; // of all stages summed per frame
+
+private:
+    static Stats windowStats(const qint64 *samples, int count);
+
+    int m_stages;
+    bool m_valid;
+    bool m_disjoint; // the GL_GPU_DISJOINT_EXT is to be checked
+    GLuint m_queries[frameLatency][maxStages][maxSpans];
+    int m_issued[frameLatency][maxStages]; // spans
+    int m_frame;
+    int m_active; // the stage of the running query or -1
+    qint64 m_results;
+    qint64 m_times[maxStages];
+    QList<qint64> m_samples; // statsFrames rings of the stages, then of the frame time
+    int m_sampled; // the frames in the rings
+};
+
+#endif // GPUTIMER_H
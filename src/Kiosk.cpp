@@ -0,0 +1,215 @@
+#include "Kiosk.h"
+#include "KioskWindow.h"
+#include "PanoramaOutput.h"
+#include "PanoramaPlayer.h"
+#include "SerialSensor.h"
+#include "ConfigReceiver.h"
+#include "SystemProcess.h"
+
+#include <QAudioOutput>
+#include <QStandardPaths>
+#include <QScreen>
+#include <QtDebug>
+
+//#define TRACE_KIOSK
+#ifdef  TRACE_KIOSK
+#include <QTime>
+#include <QThread>
+#define TRACE()      qDebug() << QTime::currentTime().toString("hh:mm:ss.zzz") << QThread::currentThreadId() << Q_FUNC_INFO;
+#define TRACE_ARG(x) qDebug() << QTime::currentTime().toString("hh:mm:ss.zzz") << QThread::currentThreadId() << Q_FUNC_INFO << x;
+#else
+#define TRACE()
+#define TRACE_ARG(x)
+#endif
+
+Kiosk::Kiosk(bool debugOpenGL, QObject *parent)
+    : QObject(parent)
+    , m_window(new KioskWindow(debugOpenGL))
+    , m_player(new PanoramaPlayer(this))
+    , m_audioOutput(new QAudioOutput(this))
+    , m_sensor(new SerialSensor(this))
+    , m_config(new ConfigReceiver(this))
+    , m_process(new SystemProcess(this))
+    , m_idleCommand(!QStandardPaths::findExecutable(QString::fromLatin1(idleCommand)).isEmpty())
+    , m_stereoMode(PanoramaOutput::StereoAuto)
+    , m_projection(PanoramaOutput::ProjectionAuto)
+{
+    TRACE();
+    if (!m_idleCommand)
+        qWarning().noquote() << "Can't find executable" << idleCommand << "in the system PATH";
+
+    // The same settings as Main.qml
+    m_config->setUdpPort(ConfigReceiver::defaultUdpPort);
+    m_config->setWatchForVideo(QStringLiteral("/srv/http/current_video.txt"));
+    m_config->setWatchForRotate(QStringLiteral("/srv/http/rotate.txt"));
+    m_config->setWatchForCompass(QStringLiteral("/srv/http/compass.txt"));
+    m_config->setWatchForSaver(QStringLiteral("/srv/http/screensaver.txt"));
+    m_config->setWatchForSmoothing(QStringLiteral("/srv/http/smoothing.txt"));
+    m_config->setWatchForPitchIdleAngle(QStringLiteral("/srv/http/pitch_idle_angle.txt"));
+    connect(m_config, &ConfigReceiver::videoSourceChanged, this, [this]() { m_player->setSource(QUrl(m_config->videoSource())); });
+    connect(m_config, &ConfigReceiver::rotateDisplayChanged, this, [this]() { m_window->setRotateDisplay(m_config->rotateDisplay()); });
+    connect(m_config, &ConfigReceiver::stereoShiftChanged, this, [this]() { m_window->setStereoShift(m_config->stereoShift()); });
+    connect(m_config, &ConfigReceiver::fovAngleChanged, this, [this]() { m_window->setFovAngle(m_config->fovAngle()); });
+    connect(m_config, &ConfigReceiver::enableCompassChanged, this, [this]() { m_sensor->setEnableCompass(m_config->enableCompass()); });
+    connect(m_config, &ConfigReceiver::adjustAngleChanged, this, [this]() { m_sensor->setAdjustAngle(m_config->adjustAngle()); });
+    connect(m_config, &ConfigReceiver::smoothingFactorChanged, this, [this]() { m_sensor->setSmoothingFactor(m_config->smoothingFactor()); });
+    connect(m_config, &ConfigReceiver::screenSaverChanged, this, &Kiosk::updateIdleTimer);
+    connect(m_config, &ConfigReceiver::pitchIdleAngleChanged, this, &Kiosk::updateIdleTimer);
+    connect(m_config, &ConfigReceiver::calibrateRequested, m_sensor, &SerialSensor::startCalibrate);
+
+    m_sensor->setPortName(QStringLiteral("ttyAMA0"));
+    connect(m_sensor, &SerialSensor::orientationChanged, this, [this]() { m_window->setOrientation(m_sensor->orientation()); });
+    connect(m_sensor, &SerialSensor::pitchDegreeChanged, this, &Kiosk::onPitchDegreeChanged);
+    connect(m_sensor, &SerialSensor::calibratingChanged, this, [this]() { m_window->setCalibrating(m_sensor->calibrating()); });
+    connect(m_window, &KioskWindow::photonLatencyChanged, m_sensor, &SerialSensor::setDisplayLatency);
+    connect(m_sensor, &SerialSensor::errorTextChanged, this, [this]() {
+        if (!m_sensor->errorText().isEmpty()) qCritical().noquote() << m_sensor->errorText();
+    });
+
+    m_player->setAudioOutput(m_audioOutput);
+    m_player->setVideoOutput(m_window);
+    connect(m_player, &PanoramaPlayer::mediaStateChanged, this, &Kiosk::onMediaStateChanged);
+    connect(m_player, &PanoramaPlayer::stereoModeChanged, this, &Kiosk::updateOutput);
+    connect(m_player, &PanoramaPlayer::coverageChanged, this, &Kiosk::updateOutput);
+    connect(m_player, &PanoramaPlayer::projectionChanged, this, &Kiosk::updateOutput);
+    connect(m_player, &PanoramaPlayer::errorTextChanged, this, [this]() {
+        if (!m_player->errorText().isEmpty()) qCritical().noquote() << m_player->errorText();
+    });
+    connect(m_window, &KioskWindow::errorOccurred, this, [](const QString &text) { qCritical().noquote() << text; });
+
+    m_idleTimer.setSingleShot(true);
+    connect(&m_idleTimer, &QTimer::timeout, this, &Kiosk::onIdleTimeout);
+
+    // The current values, then the changes by the signals above
+    m_window->setRotateDisplay(m_config->rotateDisplay());
+    m_window->setStereoShift(m_config->stereoShift());
+    m_window->setFovAngle(m_config->fovAngle());
+    m_sensor->setEnableCompass(m_config->enableCompass());
+    m_sensor->setAdjustAngle(m_config->adjustAngle());
+    m_sensor->setSmoothingFactor(m_config->smoothingFactor());
+    updateOutput();
+    m_config->setActive(true);
+    m_sensor->setActive(true);
+    if (!m_config->videoSource().isEmpty())
+        m_player->setSource(QUrl(m_config->videoSource()));
+    updateIdleTimer();
+}
+
+Kiosk::~Kiosk()
+{
+    TRACE();
+    m_player->setVideoOutput(nullptr);
+    delete m_window;
+}
+
+void Kiosk::setStereoMode(int mode)
+{
+    m_stereoMode = mode;
+    updateOutput();
+}
+
+void Kiosk::setCoverage(const QRectF &range)
+{
+    m_coverage = range;
+    updateOutput();
+}
+
+void Kiosk::setProjection(int type)
+{
+    m_projection = type;
+    updateOutput();
+}
+
+void Kiosk::setLoopCache(int megabytes, const QString &path)
+{
+    m_player->setLoopCacheDir(path);
+    m_player->setLoopCache(megabytes);
+}
+
+void Kiosk::setCapture(int rate, int width)
+{
+    m_window->setCapture(rate, width);
+}
+
+void Kiosk::setGpuBudget(int percent)
+{
+    m_window->setGpuBudget(percent);
+}
+
+void Kiosk::setGpuStats(bool yes)
+{
+    m_window->setGpuStats(yes);
+}
+
+void Kiosk::setPrediction(int ms, qreal degree)
+{
+    m_sensor->setMaxPrediction(ms);
+    m_sensor->setMaxPredictionAngle(degree);
+}
+
+void Kiosk::setSensorFilter(int type)
+{
+    m_sensor->setFilter(type);
+}
+
+void Kiosk::show(QScreen *screen, bool fullScreen)
+{
+    TRACE_ARG(screen << fullScreen);
+    if (screen) m_window->setScreen(screen);
+    m_window->setMinimumSize(QSize(640, 360));
+    if (fullScreen) {
+        m_window->setGeometry(m_window->screen()->geometry());
+        m_window->showFullScreen();
+    } else {
+        m_window->resize(QSize(1280, 720));
+        m_window->show();
+    }
+}
+
+void Kiosk::updateOutput()
+{
+    m_window->setStereoMode(m_stereoMode != PanoramaOutput::StereoAuto ? m_stereoMode : m_player->stereoMode());
+    m_window->setCoverage(m_coverage.width() > 0 ? m_coverage : m_player->coverage());
+    m_window->setProjection(m_projection != PanoramaOutput::ProjectionAuto ? m_projection : m_player->projection(),
+                            m_player->cubemapPadding());
+}
+
+void Kiosk::onMediaStateChanged()
+{
+    TRACE_ARG(m_player->mediaState());
+    if (m_player->mediaState() == PanoramaPlayer::MediaReady) {
+        m_idleTimer.stop();
+        m_player->play();
+    } else if (m_player->mediaState() == PanoramaPlayer::MediaUnknown) {
+        m_player->stop();
+    }
+}
+
+void Kiosk::onPitchDegreeChanged()
+{
+    const int pitch = m_sensor->pitchDegree();
+    if (pitch < m_config->pitchIdleAngle() && !m_player->isPlaying() &&
+            m_player->mediaState() != PanoramaPlayer::MediaUnknown) {
+        m_idleTimer.stop();
+        if (m_idleCommand) m_process->startCommand(QString::fromLatin1(idleCommand) + " 1");
+        m_player->play();
+    }
+    updateIdleTimer();
+}
+
+void Kiosk::onIdleTimeout()
+{
+    TRACE();
+    m_player->stop();
+    if (m_idleCommand) m_process->startCommand(QString::fromLatin1(idleCommand) + " 0");
+}
+
+void Kiosk::updateIdleTimer()
+{
+    // Runs while the headset is put down, looking at the floor, as the Timer of Main.qml
+    const int pitch = m_sensor->pitchDegree();
+    const bool idle = (!pitch || pitch >= m_config->pitchIdleAngle());
+    m_idleTimer.setInterval(m_config->screenSaver() * 60000);
+    if (!idle) m_idleTimer.stop();
+    else if (!m_idleTimer.isActive()) m_idleTimer.start();
+}
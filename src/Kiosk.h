@@ -0,0 +1,63 @@
+#ifndef KIOSK_H
+#define KIOSK_H
+
+#include <QObject>
+#include <QRectF>
+#include <QTimer>
+
+class QScreen;
+class QAudioOutput;
+class KioskWindow;
+class PanoramaPlayer;
+class SerialSensor;
+class ConfigReceiver;
+class SystemProcess;
+
+/*
+ * The panoramakiosk frontend: the objects and bindings of Main.qml wired in C++ around a
+ * KioskWindow, without the QML engine, Qt Quick and its controls. The errors go to the log.
+ */
+class Kiosk : public QObject
+{
+    Q_OBJECT
+public:
+    static constexpr const char *idleCommand = "backlight";
+
+    explicit Kiosk(bool debugOpenGL = false, QObject *parent = nullptr);
+    ~Kiosk() override;
+
+    // The options overriding the metadata of the source as the app* context properties
+    void setStereoMode(int mode); // PanoramaOutput::StereoAuto by the source
+    void setCoverage(const QRectF &range); // empty by the source
+    void setProjection(int type); // PanoramaOutput::ProjectionAuto by the source
+    void setLoopCache(int megabytes, const QString &path);
+    void setCapture(int rate, int width);
+    void setGpuBudget(int percent);
+    void setGpuStats(bool yes);
+    void setPrediction(int ms, qreal degree); // of the head pose, 0 ms is off
+    void setSensorFilter(int type); // SerialSensor::Filter
+
+    KioskWindow *window() const { return m_window; }
+    void show(QScreen *screen, bool fullScreen);
+
+private:
+    void updateOutput(); // the options or the player metadata
+    void onMediaStateChanged();
+    void onPitchDegreeChanged(); // the idle screen by the head pitch
+    void onIdleTimeout();
+    void updateIdleTimer();
+
+    KioskWindow *m_window;
+    PanoramaPlayer *m_player;
+    QAudioOutput *m_audioOutput;
+    SerialSensor *m_sensor;
+    ConfigReceiver *m_config;
+    SystemProcess *m_process;
+    QTimer m_idleTimer;
+    bool m_idleCommand; // found in the PATH
+    int m_stereoMode;
+    QRectF m_coverage;
+    int m_projection;
+};
+
+#endif // KIOSK_H
@@ -0,0 +1,257 @@
+#include "KioskWindow.h"
+#include "VideoRenderer.h"
+#include "RenderProfile.h"
+
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
+#include <QOpenGLPaintDevice>
+#include <QPainter>
+#include <QKeyEvent>
+#include <QMouseEvent>
+#include <QGuiApplication>
+#include <QScreen>
+#include <QtDebug>
+
+//#define TRACE_KIOSKWINDOW
+#ifdef  TRACE_KIOSKWINDOW
+#include <QTime>
+#include <QThread>
+#define TRACE()      qDebug() << QTime::currentTime().toString("hh:mm:ss.zzz") << QThread::currentThreadId() << Q_FUNC_INFO;
+#define TRACE_ARG(x) qDebug() << QTime::currentTime().toString("hh:mm:ss.zzz") << QThread::currentThreadId() << Q_FUNC_INFO << x;
+#else
+#define TRACE()
+#define TRACE_ARG(x)
+#endif
+
+KioskWindow::KioskWindow(bool debugOpenGL)
+    : QOpenGLWindow(QOpenGLWindow::NoPartialUpdate)
+    , m_debugOpenGL(debugOpenGL)
+    , m_etc2Frames(false)
+    , m_rotateDisplay(0)
+    , m_stereoShift(PanoramaOutput::defaultStereoShift)
+    , m_stereoMode(PanoramaOutput::StereoMono)
+    , m_fovAngle(PanoramaOutput::FovDef)
+    , m_coverage(PanoramaOutput::fullCoverage())
+    , m_projection(PanoramaOutput::ProjectionEquirect)
+    , m_cubemapPadding(0)
+    , m_captureRate(0)
+    , m_captureWidth(PanoramaOutput::defaultCaptureWidth)
+    , m_gpuBudget(0)
+    , m_gpuStats(false)
+    , m_calibrating(false)
+    , m_cacheFrame(-1)
+    , m_lensMask(QStringLiteral(":/PanoramaPlayer/icons/lens-mask.png"))
+    , m_turnAround(QStringLiteral(":/PanoramaPlayer/icons/turn-around.png"))
+{
+    TRACE();
+    connect(this, &QOpenGLWindow::frameSwapped, this, &KioskWindow::onFrameSwapped);
+}
+
+KioskWindow::~KioskWindow()
+{
+    TRACE();
+    // The renderer leaves its GL objects to the context as within the scene graph
+    makeCurrent();
+    m_renderer.reset();
+    doneCurrent();
+}
+
+void KioskWindow::setRotateDisplay(int direction)
+{
+    int dir = qBound(-1, direction, 1);
+    if (dir != m_rotateDisplay) {
+        m_rotateDisplay = dir;
+        update();
+    }
+}
+
+void KioskWindow::setStereoShift(qreal shift)
+{
+    qreal value = qBound(0.0, shift, 1.0);
+    if (value != m_stereoShift) {
+        m_stereoShift = value;
+        update();
+    }
+}
+
+void KioskWindow::setStereoMode(int mode)
+{
+    int stereo = qBound(int(PanoramaOutput::StereoMono), mode, int(PanoramaOutput::StereoSideBySide));
+    if (stereo != m_stereoMode) {
+        m_stereoMode = stereo;
+        update();
+    }
+}
+
+void KioskWindow::setFovAngle(int angle)
+{
+    int degree = angle < 1 ? int(PanoramaOutput::FovDef) : qBound(int(PanoramaOutput::FovMin), angle, int(PanoramaOutput::FovMax));
+    if (degree != m_fovAngle) {
+        m_fovAngle = degree;
+        update();
+    }
+}
+
+void KioskWindow::setCoverage(const QRectF &range)
+{
+    QRectF rect = range.isEmpty() ? PanoramaOutput::fullCoverage() : range;
+    if (rect != m_coverage) {
+        m_coverage = rect;
+        update();
+    }
+}
+
+void KioskWindow::setProjection(int type, int padding)
+{
+    int proj = qBound(int(PanoramaOutput::ProjectionEquirect), type, int(PanoramaOutput::ProjectionCubemap));
+    int pad = qMax(0, padding);
+    if (proj != m_projection || pad != m_cubemapPadding) {
+        m_projection = proj;
+        m_cubemapPadding = pad;
+        update();
+    }
+}
+
+void KioskWindow::setOrientation(const QQuaternion &rotation)
+{
+    if (rotation != m_orientation) {
+        m_orientation = rotation;
+        m_latency.changed();
+        update();
+    }
+}
+
+void KioskWindow::setCapture(int rate, int width)
+{
+    m_captureRate = qBound(0, rate, 60);
+    m_captureWidth = width > 0 ? qBound(64, width, 4096) : int(PanoramaOutput::defaultCaptureWidth);
+    update();
+}
+
+void KioskWindow::setGpuBudget(int percent)
+{
+    m_gpuBudget = qBound(0, percent, 100);
+    update();
+}
+
+void KioskWindow::setGpuStats(bool yes)
+{
+    m_gpuStats = yes;
+    update();
+}
+
+void KioskWindow::setCalibrating(bool yes)
+{
+    if (yes != m_calibrating) {
+        m_calibrating = yes;
+        update();
+    }
+}
+
+void KioskWindow::setVideoFrame(const QVideoFrame &frame)
+{
+    TRACE_ARG(frame);
+    if (VideoRenderer::isFrameSuppored(frame)) {
+        m_videoFrame = frame;
+        update();
+    }
+}
+
+void KioskWindow::setTilePyramid(const QSharedPointer<TilePyramid> &tiles)
+{
+    if (tiles != m_tilePyramid) {
+        m_tilePyramid = tiles;
+        update();
+    }
+}
+
+void KioskWindow::setCachedFrame(const QSharedPointer<LoopCache> &cache, int index)
+{
+    if (cache == m_loopCache && index == m_cacheFrame) return;
+    m_loopCache = cache;
+    m_cacheFrame = cache ? index : -1;
+    update();
+}
+
+bool KioskWindow::loopCacheSupported() const
+{
+    return m_etc2Frames;
+}
+
+void KioskWindow::initializeGL()
+{
+    TRACE();
+    m_renderer.reset(new VideoRenderer(this, m_debugOpenGL));
+    connect(m_renderer.data(), &VideoRenderer::errorOccurred, this, &KioskWindow::errorOccurred);
+    connect(m_renderer.data(), &VideoRenderer::gpuStatsUpdated, this, &KioskWindow::gpuStatsUpdated);
+    m_etc2Frames = m_renderer->hasEtc2();
+    bool found = false;
+    const auto profile = RenderProfile::load(m_renderer->glRenderer(), &found);
+    if (found) qInfo().noquote() << "Render profile of" << m_renderer->glRenderer() << "-" << profile.toString();
+    m_renderer->setRenderProfile(profile);
+    m_renderer->setZeroCopy(false);
+    if (screen()) m_latency.setRefreshRate(screen()->refreshRate());
+}
+
+void KioskWindow::paintGL()
+{
+    TRACE();
+    auto f = context()->functions();
+    f->glClearColor(0, 0, 0, 1);
+    f->glClear(GL_COLOR_BUFFER_BIT);
+    if (!m_renderer) return;
+
+    m_renderer->setRotateDisplay(m_rotateDisplay);
+    m_renderer->setStereoShift(m_stereoShift);
+    m_renderer->setStereoMode(m_stereoMode);
+    m_renderer->setProjection(m_fovAngle);
+    m_renderer->setCoverage(m_coverage);
+    m_renderer->setFrameProjection(m_projection, m_cubemapPadding);
+    m_renderer->setOrientation(m_orientation);
+    m_latency.synchronized();
+    m_renderer->setTilePyramid(m_tilePyramid);
+    m_renderer->setCapture(m_captureRate, m_captureWidth);
+    m_renderer->setGpuBudget(m_gpuBudget);
+    m_renderer->setGpuStats(m_gpuStats);
+    m_renderer->setCachedFrame(m_loopCache, m_cacheFrame);
+    if (m_videoFrame.isValid())
+        m_renderer->setVideoFrame(m_videoFrame);
+    m_renderer->render();
+    paintMask();
+}
+
+void KioskWindow::onFrameSwapped()
+{
+    if (m_latency.swapped()) emit photonLatencyChanged(m_latency.latency());
+}
+
+void KioskWindow::paintMask()
+{
+    // As the images of Main.qml, centered and turned with the display
+    const QImage &image = m_calibrating ? m_turnAround : m_lensMask;
+    if (image.isNull()) return;
+    QOpenGLPaintDevice device(size() * devicePixelRatio());
+    device.setDevicePixelRatio(devicePixelRatio());
+    QPainter painter(&device);
+    painter.setRenderHint(QPainter::SmoothPixmapTransform);
+    painter.translate(width() / 2.0, height() / 2.0);
+    painter.rotate(m_rotateDisplay < 0 ? 270 : 90 * m_rotateDisplay);
+    painter.drawImage(QPointF(-image.width() / 2.0, -image.height() / 2.0), image);
+}
+
+void KioskWindow::keyPressEvent(QKeyEvent *event)
+{
+    TRACE_ARG(event->key());
+    if (event->matches(QKeySequence::Cancel) || event->matches(QKeySequence::Quit)) {
+        QGuiApplication::quit();
+    } else if (event->key() == Qt::Key_F11) {
+        if (visibility() == QWindow::FullScreen) showNormal();
+        else showFullScreen();
+    } else QOpenGLWindow::keyPressEvent(event);
+}
+
+void KioskWindow::mouseReleaseEvent(QMouseEvent *event)
+{
+    if (event->button() == Qt::RightButton) QGuiApplication::quit();
+    else QOpenGLWindow::mouseReleaseEvent(event);
+}
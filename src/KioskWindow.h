@@ -0,0 +1,88 @@
+#ifndef KIOSKWINDOW_H
+#define KIOSKWINDOW_H
+
+#include <QOpenGLWindow>
+#include <QScopedPointer>
+#include <QVideoFrame>
+#include <QSharedPointer>
+#include <QRectF>
+#include <QImage>
+#include <QQuaternion>
+
+#include "PanoramaOutput.h"
+#include "GpuTimer.h"
+#include "PhotonLatency.h"
+
+class VideoRenderer;
+
+/*
+ * The output of panoramakiosk: VideoRenderer in a plain QOpenGLWindow with the lens mask on top,
+ * no Qt Quick scene graph. Everything runs on the GUI thread, the settings are passed to
+ * the renderer on paint as PanoramaView does while synchronizing.
+ */
+class KioskWindow : public QOpenGLWindow, public PanoramaOutput
+{
+    Q_OBJECT
+public:
+    explicit KioskWindow(bool debugOpenGL = false);
+    ~KioskWindow() override;
+
+    // As the PanoramaView properties
+    void setRotateDisplay(int direction); // -1/0/1
+    void setStereoShift(qreal shift); // 0.0..1.0
+    void setStereoMode(int mode); // PanoramaOutput::StereoMode
+    void setFovAngle(int angle); // in degree, 0 is the default
+    void setCoverage(const QRectF &range); // in degree, empty is the full sphere
+    void setProjection(int type, int padding); // PanoramaOutput::Projection and the cubemap padding
+    void setOrientation(const QQuaternion &rotation);
+    void setCapture(int rate, int width);
+    void setGpuBudget(int percent);
+    void setGpuStats(bool yes);
+    void setCalibrating(bool yes); // the turn-around sign instead of the lens mask
+
+    void setVideoFrame(const QVideoFrame &frame) override;
+    void setTilePyramid(const QSharedPointer<TilePyramid> &tiles) override;
+    void setCachedFrame(const QSharedPointer<LoopCache> &cache, int index) override;
+    bool loopCacheSupported() const override;
+    QRhi *sinkRhi() const override { return nullptr; } // the frames are always mapped
+
+signals:
+    void errorOccurred(const QString &text);
+    void gpuStatsUpdated(const QList<GpuTimer::Stats> &stats); // per VideoRenderer::GpuStage then the frame
+    void photonLatencyChanged(qreal ms); // from an orientation change to the screen
+
+protected:
+    void initializeGL() override;
+    void paintGL() override;
+    void keyPressEvent(QKeyEvent *event) override;
+    void mouseReleaseEvent(QMouseEvent *event) override;
+
+private:
+    void paintMask();
+    void onFrameSwapped();
+
+    QScopedPointer<VideoRenderer> m_renderer;
+    bool m_debugOpenGL;
+    bool m_etc2Frames; // by the renderer
+    int m_rotateDisplay;
+    qreal m_stereoShift;
+    int m_stereoMode;
+    int m_fovAngle;
+    QRectF m_coverage;
+    int m_projection;
+    int m_cubemapPadding;
+    QQuaternion m_orientation;
+    PhotonLatency m_latency;
+    int m_captureRate;
+    int m_captureWidth;
+    int m_gpuBudget;
+    bool m_gpuStats;
+    bool m_calibrating;
+    QVideoFrame m_videoFrame;
+    QSharedPointer<TilePyramid> m_tilePyramid;
+    QSharedPointer<LoopCache> m_loopCache;
+    int m_cacheFrame;
+    QImage m_lensMask, m_turnAround;
+};
+
+#endif // KIOSKWINDOW_H
@@ -0,0 +1,329 @@
+#include "LoopCache.h"
+#include "Etc2Encoder.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QCryptographicHash>
+#include <QImage>
+#include <QThread>
+#include <QMutexLocker>
+#include <QtDebug>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sys/mman.h>
+
+//#define TRACE_LOOPCACHE
+#ifdef  TRACE_LOOPCACHE
+#include <QTime>
+#define TRACE()      qDebug() << QTime::currentTime().toString("hh:mm:ss.zzz") << QThread::currentThreadId() << Q_FUNC_INFO;
+#define TRACE_ARG(x) qDebug() << QTime::currentTime().toString("hh:mm:ss.zzz") << QThread::currentThreadId() << Q_FUNC_INFO << x;
+#else
+#define TRACE()
+#define TRACE_ARG(x)
+#endif
+
+// The cache file: the header, the frame times, then the frames page aligned
+struct LoopCacheHeader
+{
+    char magic[8];
+    qint64 sourceSize;
+    qint64 sourceTime; // modification time in ms since epoch
+    qint32 width, height;
+    qint32 maxFrames;
+    qint32 frameCount; // of the complete pass, 0 until then
+};
+static const char loopCacheMagic[8] = { 'P', 'P', 'L', 'O', 'O', 'P', '0', '1' };
+static constexpr qint64 const dataAlign = 4096;
+
+static qint64 dataOffset(int maxFrames)
+{
+    const qint64 end = sizeof(LoopCacheHeader) + qint64(maxFrames) * sizeof(qint64);
+    return (end + dataAlign - 1) / dataAlign * dataAlign;
+}
+
+LoopCache::LoopCache(const QString &sourceFile, const QSize &videoSize, qint64 duration, qreal frameRate,
+                     qint64 budget, const QString &cacheDir)
+    : m_sourceFile(sourceFile)
+    , m_frameBytes(0)
+    , m_maxFrames(0)
+    , m_framesDone(0)
+    , m_pending(0)
+    , m_generation(0)
+    , m_failedPasses(0)
+    , m_passFinished(false)
+    , m_complete(false)
+    , m_failed(false)
+    , m_unplayable(0)
+    , m_file(nullptr)
+    , m_map(nullptr)
+{
+    TRACE_ARG(sourceFile << videoSize << duration << frameRate << budget << cacheDir);
+    if (videoSize.isEmpty() || duration <= 0 || frameRate <= 0.0 || budget <= 0)
+        return;
+
+    // The largest frame size of the video aspect fitting all frames with a margin into
+    // the budget, the multiples of 4 for the blocks
+    m_maxFrames = int(duration * frameRate * 1.05 / 1000.0) + 2;
+    const qint64 frameBudget = budget / m_maxFrames;
+    int width = videoSize.width() / 4 * 4;
+    for (;;) {
+        const int height = int(qint64(width) * videoSize.height() / videoSize.width()) / 4 * 4;
+        if (width < minWidth || height < 4) return;
+        if (etc2ImageBytes(width, height) <= frameBudget) {
+            m_frameSize = QSize(width, height);
+            break;
+        }
+        width = (width * 9 / 10) / 4 * 4;
+    }
+    m_frameBytes = etc2ImageBytes(m_frameSize.width(), m_frameSize.height());
+    m_frameTimes.reserve(m_maxFrames);
+    m_frameStates.reserve(m_maxFrames);
+
+    if (!cacheDir.isEmpty() && !openFile(cacheDir, m_maxFrames)) {
+        m_frameSize = QSize(); // invalid, the directory was requested
+        return;
+    }
+    if (!m_map) m_frames.resize(m_maxFrames);
+
+    // Leave a core to the decoder and the render thread, the encoding is the lowest priority
+    m_pool.setMaxThreadCount(qMax(1, QThread::idealThreadCount() - 1));
+    m_pool.setThreadPriority(QThread::LowPriority);
+    qInfo().noquote() << "Loop cache" << m_frameSize.width() << 'x' << m_frameSize.height()
+                      << "ETC2 of" << m_maxFrames << "frames at most," << (qint64(m_frameBytes) * m_maxFrames >> 20) << "MB"
+                      << (m_file ? "in " + m_file->fileName() : QStringLiteral("in RAM"))
+                      << (m_complete ? "(complete)" : "");
+}
+
+LoopCache::~LoopCache()
+{
+    TRACE();
+    m_pool.clear(); // the queued frames, just the ones being encoded are waited for
+    m_pool.waitForDone();
+    if (m_file) {
+        if (m_map) m_file->unmap(m_map);
+        delete m_file;
+    }
+}
+
+bool LoopCache::openFile(const QString &cacheDir, int maxFrames)
+{
+    const QFileInfo source(m_sourceFile);
+    if (!QDir().mkpath(cacheDir)) {
+        qWarning() << Q_FUNC_INFO << "Can't create" << cacheDir;
+        return false;
+    }
+    const QByteArray key = QCryptographicHash::hash(source.absoluteFilePath().toUtf8(), QCryptographicHash::Sha1).toHex().left(16);
+    m_file = new QFile(QDir(cacheDir).filePath(QStringLiteral("%1-%2x%3.etc2").arg(QString::fromLatin1(key))
+                                               .arg(m_frameSize.width()).arg(m_frameSize.height())));
+    const qint64 size = dataOffset(maxFrames) + qint64(m_frameBytes) * maxFrames;
+    if (!m_file->open(QIODevice::ReadWrite) || !m_file->resize(size)) {
+        qWarning() << Q_FUNC_INFO << m_file->fileName() << m_file->errorString();
+        return false;
+    }
+    m_map = m_file->map(0, size);
+    if (!m_map) {
+        qWarning() << Q_FUNC_INFO << "Can't map" << m_file->fileName() << m_file->errorString();
+        return false;
+    }
+
+    // The complete pass of the same source is reused, else recorded again
+    auto header = reinterpret_cast<LoopCacheHeader *>(m_map);
+    const qint64 sourceTime = source.lastModified().toMSecsSinceEpoch();
+    if (!memcmp(header->magic, loopCacheMagic, sizeof(loopCacheMagic)) && header->sourceSize == source.size() &&
+            header->sourceTime == sourceTime && header->maxFrames == maxFrames && header->frameCount > 0 &&
+            header->width == m_frameSize.width() && header->height == m_frameSize.height()) {
+        m_frameTimes.resize(header->frameCount);
+        memcpy(m_frameTimes.data(), m_map + sizeof(LoopCacheHeader), header->frameCount * sizeof(qint64));
+        m_passFinished = m_complete = true;
+        return true;
+    }
+    memcpy(header->magic, loopCacheMagic, sizeof(loopCacheMagic));
+    header->sourceSize = source.size();
+    header->sourceTime = sourceTime;
+    header->width = m_frameSize.width();
+    header->height = m_frameSize.height();
+    header->maxFrames = maxFrames;
+    header->frameCount = 0;
+    return true;
+}
+
+bool LoopCache::isValid() const
+{
+    return !m_frameSize.isEmpty();
+}
+
+bool LoopCache::isComplete() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_complete;
+}
+
+QSize LoopCache::frameSize() const
+{
+    return m_frameSize;
+}
+
+int LoopCache::frameCount() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_frameTimes.size();
+}
+
+bool LoopCache::addFrame(const QVideoFrame &frame)
+{
+    QMutexLocker locker(&m_mutex);
+    if (!isValid() || m_complete || m_failed || m_failedPasses >= maxFailedPasses) return false;
+    const qint64 time = frame.startTime() / 1000;
+    if (frame.startTime() < 0) return false;
+    int index;
+    if (!m_passFinished) {
+        if (m_frameTimes.isEmpty() && time > 100)
+            return false; // the pass starts with the clip begin
+        if (m_frameTimes.size() >= m_maxFrames) {
+            qWarning() << Q_FUNC_INFO << "The loop cache is full at" << time << "ms, retrying on the next pass";
+            m_failed = true;
+            return false;
+        }
+        index = m_frameTimes.size();
+        m_frameTimes.append(time);
+        m_frameStates.append(FrameMissing);
+    } else {
+        // A later pass, the frames skipped on the first one
+        index = frameAt(time);
+        if (qAbs(m_frameTimes.at(index) - time) > 1 || m_frameStates.at(index) != FrameMissing)
+            return false;
+    }
+    if (m_pending >= maxPending) {
+        TRACE_ARG("Skipped" << index << "for a later pass");
+        return false;
+    }
+    m_frameStates[index] = FrameEncoding;
+    m_pending++;
+    const int generation = m_generation;
+    m_pool.start([this, frame, index, generation]() { encodeFrame(frame, index, generation); });
+    return true;
+}
+
+void LoopCache::encodeFrame(const QVideoFrame &frame, int index, int generation)
+{
+    // The conversion and downscaling are on the pool thread too, the decoder continues,
+    // the blocks go to the slot at once under the mutex
+    QByteArray data;
+    QImage image = frame.toImage();
+    if (!image.isNull()) {
+        image = image.scaled(m_frameSize, Qt::IgnoreAspectRatio, Qt::SmoothTransformation)
+                .convertToFormat(QImage::Format_RGBX8888);
+        data = QByteArray(m_frameBytes, Qt::Uninitialized);
+        etc2EncodeImage(image.constBits(), image.bytesPerLine(), image.width(), image.height(),
+                        reinterpret_cast<uchar *>(data.data()));
+    }
+
+    QMutexLocker locker(&m_mutex);
+    if (generation != m_generation) return; // the pass was reset meanwhile
+    m_pending--;
+    if (data.isEmpty()) {
+        qWarning() << Q_FUNC_INFO << "Can't convert the frame at" << m_frameTimes.at(index) << "ms";
+        m_failed = true;
+        return;
+    }
+    if (m_map) memcpy(m_map + dataOffset(m_maxFrames) + qint64(index) * m_frameBytes, data.constData(), m_frameBytes);
+    else m_frames[index] = data;
+    m_frameStates[index] = FrameDone;
+    if (++m_framesDone == m_frameTimes.size() && m_passFinished) {
+        locker.unlock();
+        commit(generation);
+    }
+}
+
+void LoopCache::commit(int generation)
+{
+    QMutexLocker locker(&m_mutex);
+    if (generation != m_generation) return;
+    const QVector<qint64> frameTimes = m_frameTimes;
+    locker.unlock();
+    TRACE_ARG(frameTimes.size());
+
+    if (m_map) {
+        // The frames are on the disk before the header marks them complete, else a crash
+        // meanwhile would leave a complete cache of garbage to the next runs
+        auto header = reinterpret_cast<LoopCacheHeader *>(m_map);
+        const qint64 dataEnd = dataOffset(m_maxFrames) + qint64(frameTimes.size()) * m_frameBytes;
+        memcpy(m_map + sizeof(LoopCacheHeader), frameTimes.constData(), frameTimes.size() * sizeof(qint64));
+        if (msync(m_map, dataEnd, MS_SYNC) == 0) {
+            header->frameCount = frameTimes.size();
+            if (msync(m_map, sizeof(LoopCacheHeader), MS_SYNC) != 0)
+                qWarning() << Q_FUNC_INFO << "Can't sync the header of" << m_file->fileName() << strerror(errno);
+        } else qWarning() << Q_FUNC_INFO << "Can't sync" << m_file->fileName() << strerror(errno) << ", not reused";
+    }
+    locker.relock();
+    if (generation != m_generation) return;
+    m_complete = true;
+    TRACE_ARG("Complete" << frameTimes.size() << "frames");
+}
+
+void LoopCache::finishPass()
+{
+    QMutexLocker locker(&m_mutex);
+    TRACE_ARG(m_frameTimes.size() << m_framesDone << m_failed);
+    if (m_complete || (m_passFinished && !m_failed)) return;
+    if (m_failed || m_frameTimes.isEmpty()) {
+        if (m_failed && ++m_failedPasses == maxFailedPasses)
+            qWarning() << Q_FUNC_INFO << "The loop cache failed" << m_failedPasses << "passes, the clip plays from the decoder";
+        locker.unlock();
+        resetPass();
+        return;
+    }
+    m_passFinished = true;
+    if (m_framesDone == m_frameTimes.size()) {
+        const int generation = m_generation;
+        m_pool.start([this, generation]() { commit(generation); });
+    }
+}
+
+void LoopCache::resetPass()
+{
+    TRACE();
+    m_pool.clear(); // the queued frames, the ones being encoded are dropped by the generation
+    QMutexLocker locker(&m_mutex);
+    if (m_complete) return;
+    m_generation++;
+    m_frameTimes.clear();
+    m_frameStates.clear();
+    if (!m_map) m_frames.fill(QByteArray());
+    m_framesDone = 0;
+    m_pending = 0;
+    m_passFinished = false;
+    m_failed = false;
+}
+
+int LoopCache::frameAt(qint64 position) const
+{
+    const auto it = std::upper_bound(m_frameTimes.cbegin(), m_frameTimes.cend(), position);
+    return qMax(0, int(it - m_frameTimes.cbegin()) - 1);
+}
+
+const uchar *LoopCache::frameData(int index) const
+{
+    if (index < 0 || index >= m_frameTimes.size()) return nullptr;
+    if (m_map) return m_map + dataOffset(m_maxFrames) + qint64(index) * m_frameBytes;
+    return reinterpret_cast<const uchar *>(m_frames.at(index).constData());
+}
+
+int LoopCache::frameBytes() const
+{
+    return m_frameBytes;
+}
+
+void LoopCache::setUnplayable()
+{
+    TRACE();
+    m_unplayable.storeRelease(1);
+}
+
+bool LoopCache::isUnplayable() const
+{
+    return m_unplayable.loadAcquire();
+}
@@ -0,0 +1,85 @@
+#ifndef LOOPCACHE_H
+#define LOOPCACHE_H
+
+#include <QString>
+#include <QSize>
+#include <QVector>
+#include <QByteArray>
+#include <QVideoFrame>
+#include <QThreadPool>
+#include <QAtomicInt>
+#include <QMutex>
+
+class QFile;
+
+/*
+ * The ETC2 compressed frames of a looping clip, recorded on its first pass by the pool
+ * threads (downscaled to fit the memory budget) while the decoder plays as usual, then the
+ * later loops are played from the cache by the player position with the video track off.
+ * The frames are kept in RAM, or in a memory-mapped file of the cache directory which is
+ * reused by the next runs for the same source.
+ *
+ * The frames the pool can't keep up with are skipped and encoded on the later passes, the
+ * cache is complete with all frames of the first pass. The frames are written under the
+ * mutex by the pool threads while recording, and read by the render thread once complete.
+ */
+class LoopCache
+{
+public:
+    static constexpr int const minWidth = 1024; // else the budget is too small to be worth it
+    static constexpr int const maxPending = 8; // the frames being encoded, the next ones are skipped
+    static constexpr int const maxFailedPasses = 3; // then the clip plays from the decoder only
+
+    LoopCache(const QString &sourceFile, const QSize &videoSize, qint64 duration, qreal frameRate,
+              qint64 budget, const QString &cacheDir = QString());
+    ~LoopCache();
+
+    bool isValid() const; // the budget fits a frame size of at least minWidth
+    bool isComplete() const; // all frames of a pass are encoded
+    QSize frameSize() const; // of the compressed frames
+    int frameCount() const;
+
+    // Recording: the frames of the first pass in order, starting from the clip begin, then
+    // the skipped ones on the later passes, false if the frame isn't encoded
+    bool addFrame(const QVideoFrame &frame);
+    void finishPass(); // the clip has looped, complete once all its frames are encoded
+    void resetPass(); // without waiting, the frames being encoded are dropped
+
+    // Playback: the frame index at the position in ms, the data is valid while the cache lives
+    int frameAt(qint64 position) const;
+    const uchar *frameData(int index) const;
+    int frameBytes() const;
+    void setUnplayable(); // by the renderer, the player goes back to the decoded frames
+    bool isUnplayable() const;
+
+private:
+    enum FrameState : quint8 { FrameMissing, FrameEncoding, FrameDone };
+
+    bool openFile(const QString &cacheDir, int maxFrames);
+    void encodeFrame(const QVideoFrame &frame, int index, int generation); // on a pool thread
+    void commit(int generation); // on a pool thread, once all frames are encoded
+
+    QString m_sourceFile;
+    QSize m_frameSize;
+    int m_frameBytes;
+    int m_maxFrames;
+    QThreadPool m_pool;
+
+    mutable QMutex m_mutex;
+    QVector<qint64> m_frameTimes; // start time per frame in ms
+    QVector<quint8> m_frameStates; // FrameState per frame
+    int m_framesDone;
+    int m_pending;
+    int m_generation; // of the pass, the encoded frames of a reset one are dropped
+    int m_failedPasses;
+    bool m_passFinished;
+    bool m_complete;
+    bool m_failed;
+    QAtomicInt m_unplayable;
+
+    QVector<QByteArray> m_frames; // in RAM, or
+    QFile *m_file; // the mapped file with the frame times and data
+    uchar *m_map;
+};
+
+#endif // LOOPCACHE_H
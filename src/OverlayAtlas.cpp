@@ -0,0 +1,198 @@
+#include "OverlayAtlas.h"
+
+#include <QPainter>
+#include <QFontMetrics>
+#include <QQuaternion>
+#include <QVector3D>
+#include <QtDebug>
+
+#include <algorithm>
+
+//#define TRACE_OVERLAYATLAS
+#ifdef  TRACE_OVERLAYATLAS
+#include <QTime>
+#include <QThread>
+#define TRACE()      qDebug() << QTime::currentTime().toString("hh:mm:ss.zzz") << QThread::currentThreadId() << Q_FUNC_INFO;
+#define TRACE_ARG(x) qDebug() << QTime::currentTime().toString("hh:mm:ss.zzz") << QThread::currentThreadId() << Q_FUNC_INFO << x;
+#else
+#define TRACE()
+#define TRACE_ARG(x)
+#endif
+
+static constexpr int const textPixelSize = 48; // the glyph height in the atlas
+
+OverlayAtlas::OverlayAtlas()
+    : m_nextId(1)
+    , m_atlasSerial(0)
+{
+}
+
+int OverlayAtlas::addImage(const QImage &image, qreal yaw, qreal pitch, qreal distance, qreal width)
+{
+    TRACE_ARG(image.size() << yaw << pitch << distance << width);
+    if (image.isNull() || width <= 0.0) return -1;
+    QImage scaled = image;
+    const int maxSide = atlasSize / 2 - 2 * atlasBorder;
+    if (scaled.width() > maxSide || scaled.height() > maxSide)
+        scaled = scaled.scaled(maxSide, maxSide, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+
+    Overlay overlay;
+    overlay.image = scaled.convertToFormat(QImage::Format_RGBA8888_Premultiplied);
+    overlay.yaw = yaw;
+    overlay.pitch = pitch;
+    overlay.distance = distance;
+    overlay.halfWidth = width / 2.0;
+    overlay.halfHeight = overlay.halfWidth * scaled.height() / scaled.width();
+    return insert(overlay);
+}
+
+int OverlayAtlas::addText(const QString &text, qreal yaw, qreal pitch, qreal distance, qreal height, const QColor &color)
+{
+    TRACE_ARG(text << yaw << pitch << distance << height);
+    if (text.isEmpty() || height <= 0.0) return -1;
+    QFont font;
+    font.setPixelSize(textPixelSize);
+    const QFontMetrics metrics(font);
+    const QSize size(qMin(metrics.horizontalAdvance(text) + textPixelSize / 2, atlasSize - 2 * atlasBorder),
+                     metrics.height());
+
+    // A translucent plate behind the text keeps it readable over any video
+    QImage image(size, QImage::Format_RGBA8888_Premultiplied);
+    image.fill(QColor(0, 0, 0, 128));
+    QPainter painter(&image);
+    painter.setRenderHint(QPainter::TextAntialiasing);
+    painter.setFont(font);
+    painter.setPen(color);
+    painter.drawText(image.rect(), Qt::AlignCenter, text);
+    painter.end();
+
+    Overlay overlay;
+    overlay.image = image;
+    overlay.yaw = yaw;
+    overlay.pitch = pitch;
+    overlay.distance = distance;
+    overlay.halfHeight = height / 2.0;
+    overlay.halfWidth = overlay.halfHeight * size.width() / size.height();
+    return insert(overlay);
+}
+
+int OverlayAtlas::insert(const Overlay &overlay)
+{
+    const int id = m_nextId++;
+    m_overlays.insert(id, overlay);
+    if (!pack()) {
+        qWarning() << Q_FUNC_INFO << "The overlay atlas is full, the overlay" << overlay.image.size() << "is dropped";
+        m_overlays.remove(id);
+        pack();
+        return -1;
+    }
+    update();
+    return id;
+}
+
+bool OverlayAtlas::move(int id, qreal yaw, qreal pitch, qreal distance)
+{
+    TRACE_ARG(id << yaw << pitch << distance);
+    auto it = m_overlays.find(id);
+    if (it == m_overlays.end()) return false;
+    it->yaw = yaw;
+    it->pitch = pitch;
+    it->distance = distance;
+    update(); // the atlas stays
+    return true;
+}
+
+bool OverlayAtlas::remove(int id)
+{
+    TRACE_ARG(id);
+    if (!m_overlays.remove(id)) return false;
+    pack();
+    update();
+    return true;
+}
+
+void OverlayAtlas::clear()
+{
+    TRACE();
+    m_overlays.clear();
+    pack();
+    update();
+}
+
+bool OverlayAtlas::isEmpty() const
+{
+    return m_overlays.isEmpty();
+}
+
+OverlayAtlas::Batch OverlayAtlas::batch() const
+{
+    Batch batch;
+    batch.atlas = m_atlas;
+    batch.instances = m_instances;
+    batch.atlasSerial = m_atlasSerial;
+    return batch;
+}
+
+bool OverlayAtlas::pack()
+{
+    // The shelves of the overlays sorted by height, the tallest first
+    QVector<Overlay *> order;
+    for (auto &overlay : m_overlays)
+        order.append(&overlay);
+    std::stable_sort(order.begin(), order.end(), [](const Overlay *a, const Overlay *b) {
+        return a->image.height() > b->image.height();
+    });
+    int x = 0, y = 0, shelf = 0;
+    for (auto overlay : std::as_const(order)) {
+        const QSize size = overlay->image.size() + QSize(2 * atlasBorder, 2 * atlasBorder);
+        if (x + size.width() > atlasSize) {
+            x = 0;
+            y += shelf;
+            shelf = 0;
+        }
+        if (y + size.height() > atlasSize)
+            return false;
+        overlay->rect = QRect(QPoint(x + atlasBorder, y + atlasBorder), overlay->image.size());
+        x += size.width();
+        shelf = qMax(shelf, size.height());
+    }
+
+    m_atlas = QImage();
+    if (!m_overlays.isEmpty()) {
+        // The atlas height is of the used shelves only, the texture grows as needed
+        m_atlas = QImage(atlasSize, qMin(atlasSize, y + shelf), QImage::Format_RGBA8888_Premultiplied);
+        m_atlas.fill(Qt::transparent);
+        QPainter painter(&m_atlas);
+        painter.setCompositionMode(QPainter::CompositionMode_Source);
+        for (const auto &overlay : std::as_const(m_overlays))
+            painter.drawImage(overlay.rect.topLeft(), overlay.image);
+    }
+    m_atlasSerial++;
+    TRACE_ARG(m_overlays.size() << "overlays in" << m_atlas.size());
+    return true;
+}
+
+void OverlayAtlas::update()
+{
+    m_instances.clear();
+    m_instances.reserve(m_overlays.size());
+    for (const auto &overlay : std::as_const(m_overlays)) {
+        // The quad faces the viewer, by the same Euler angles as the view orientation
+        const QQuaternion rotation = QQuaternion::fromEulerAngles(overlay.pitch, overlay.yaw, 0.0);
+        const float distance = qBound(minDistance, float(overlay.distance), maxDistance);
+        const QVector3D center = rotation.rotatedVector(QVector3D(0.0f, 0.0f, -distance));
+        const QVector3D right = rotation.rotatedVector(QVector3D(overlay.halfWidth, 0.0f, 0.0f));
+        const QVector3D up = rotation.rotatedVector(QVector3D(0.0f, overlay.halfHeight, 0.0f));
+        Instance instance;
+        for (int i = 0; i < 3; i++) {
+            instance.center[i] = center[i];
+            instance.right[i] = right[i];
+            instance.up[i] = up[i];
+        }
+        instance.rect[0] = float(overlay.rect.x()) / m_atlas.width();
+        instance.rect[1] = float(overlay.rect.y()) / m_atlas.height();
+        instance.rect[2] = float(overlay.rect.width()) / m_atlas.width();
+        instance.rect[3] = float(overlay.rect.height()) / m_atlas.height();
+        m_instances.append(instance);
+    }
+}
@@ -0,0 +1,70 @@
+#ifndef OVERLAYATLAS_H
+#define OVERLAYATLAS_H
+
+#include <QImage>
+#include <QString>
+#include <QColor>
+#include <QRect>
+#include <QVector>
+#include <QMap>
+
+/*
+ * The world-anchored overlays (logos, captions, markers) of PanoramaView packed into one
+ * RGBA8 texture atlas, so VideoRenderer draws all of them in both eyes by one instanced
+ * draw. An overlay is a quad facing the viewer at the yaw, pitch angles of PanoramaView
+ * and a distance in meters, which gives the stereo disparity of the eyes.
+ *
+ * Owned by the GUI thread, the render thread gets the Batch copies while synchronizing.
+ */
+class OverlayAtlas
+{
+public:
+    static constexpr int const atlasSize = 2048; // in pixels
+    static constexpr int const atlasBorder = 1; // transparent pixels around each overlay
+    static constexpr float const minDistance = 1.5f; // in meters, beyond the near plane
+    static constexpr float const maxDistance = 90.0f; // within the far plane
+
+    struct Instance { // the per-instance vertex attributes
+        float center[3]; // in world space
+        float right[3];  // half the width
+        float up[3];     // half the height
+        float rect[4];   // in the atlas normalized: left, top, width, height
+    };
+
+    struct Batch {
+        QImage atlas; // premultiplied
+        QVector<Instance> instances;
+        qint64 atlasSerial = 0; // changed when the atlas image needs an upload
+    };
+
+    OverlayAtlas();
+
+    // The id of the overlay or -1 if it doesn't fit into the atlas
+    int addImage(const QImage &image, qreal yaw, qreal pitch, qreal distance, qreal width);
+    int addText(const QString &text, qreal yaw, qreal pitch, qreal distance, qreal height, const QColor &color);
+    bool move(int id, qreal yaw, qreal pitch, qreal distance);
+    bool remove(int id);
+    void clear();
+    bool isEmpty() const;
+
+    Batch batch() const;
+
+private:
+    struct Overlay {
+        QImage image;
+        QRect rect; // in the atlas
+        qreal yaw, pitch, distance;
+        float halfWidth, halfHeight; // in meters
+    };
+    int insert(const Overlay &overlay);
+    bool pack(); // rebuilds the atlas by the shelves, false if it overflows
+    void update(); // the instances by the overlays
+
+    QMap<int, Overlay> m_overlays; // by id, the draw order
+    int m_nextId;
+    QImage m_atlas;
+    qint64 m_atlasSerial;
+    QVector<Instance> m_instances;
+};
+
+#endif // OVERLAYATLAS_H
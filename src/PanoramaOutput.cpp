@@ -0,0 +1,84 @@
+#include "PanoramaOutput.h"
+
+//static
+int PanoramaOutput::parseStereoMode(const QString &text)
+{
+    const QString mode = text.trimmed().toLower();
+    if (mode.isEmpty() || mode == "auto") return StereoAuto;
+    if (mode == "mono") return StereoMono;
+    if (mode == "tb" || mode == "top-bottom") return StereoTopBottom;
+    if (mode == "sbs" || mode == "side-by-side" || mode == "left-right") return StereoSideBySide;
+    return StereoAuto - 1;
+}
+
+//static
+QRectF PanoramaOutput::parseCoverage(const QString &text)
+{
+    const QString mode = text.trimmed().toLower();
+    if (mode.isEmpty() || mode == "360" || mode == "equirect")
+        return fullCoverage();
+    if (mode == "180" || mode == "vr180")
+        return halfCoverage();
+    const auto list = mode.split(',');
+    if (list.size() != 4) return QRectF();
+    qreal val[4];
+    for (int i = 0; i < 4; i++) {
+        bool ok = false;
+        val[i] = list.at(i).toDouble(&ok);
+        if (!ok) return QRectF();
+    }
+    return QRectF(QPointF(qBound(-180.0, val[0], 180.0), qBound(-90.0, val[2], 90.0)),
+                  QPointF(qBound(-180.0, val[1], 180.0), qBound(-90.0, val[3], 90.0))).normalized();
+}
+
+//static
+bool PanoramaOutput::parseCapture(const QString &text, int *rate, int *width)
+{
+    const auto parts = text.trimmed().split(':');
+    bool rateOk = false, widthOk = true;
+    const int r = parts.at(0).toInt(&rateOk);
+    const int w = parts.size() > 1 ? parts.at(1).toInt(&widthOk) : *width;
+    if (!rateOk || !widthOk || parts.size() > 2 || r < 1 || r > 60 || w < 64 || w > 4096)
+        return false;
+    *rate = r;
+    *width = w;
+    return true;
+}
+
+//static
+bool PanoramaOutput::parseGpuBudget(const QString &text, int *percent)
+{
+    bool ok = false;
+    const int p = text.trimmed().toInt(&ok);
+    if (!ok || p < 10 || p > 100) return false;
+    *percent = p;
+    return true;
+}
+
+//static
+bool PanoramaOutput::parsePrediction(const QString &text, int *ms, qreal *angle)
+{
+    const auto parts = text.trimmed().split(':');
+    bool msOk = false, angleOk = true;
+    const int m = parts.at(0).toInt(&msOk);
+    const qreal a = parts.size() > 1 ? parts.at(1).toDouble(&angleOk) : *angle;
+    if (!msOk || !angleOk || parts.size() > 2 || m < 0 || m > 500 || a <= 0.0 || a > 90.0)
+        return false;
+    *ms = m;
+    *angle = a;
+    return true;
+}
+
+//static
+bool PanoramaOutput::parseLoopCache(const QString &text, int *megabytes, QString *dir)
+{
+    const QString value = text.trimmed();
+    const int colon = value.indexOf(':');
+    bool ok = false;
+    const int budget = value.left(colon).toInt(&ok);
+    const QString path = colon >= 0 ? value.mid(colon + 1) : *dir;
+    if (!ok || budget <= 0 || (colon >= 0 && path.isEmpty())) return false;
+    *megabytes = budget;
+    *dir = path;
+    return true;
+}
@@ -0,0 +1,63 @@
+#ifndef PANORAMAOUTPUT_H
+#define PANORAMAOUTPUT_H
+
+#include <QVideoFrame>
+#include <QSharedPointer>
+#include <QRectF>
+
+class QRhi;
+class TilePyramid;
+class LoopCache;
+
+/*
+ * The video output of PanoramaPlayer: the PanoramaView item of the QML frontend or the
+ * KioskWindow of the panoramakiosk frontend, both on top of VideoRenderer. The settings
+ * of the outputs are here for the code built without Qt Quick, PanoramaView mirrors the
+ * enums for QML.
+ */
+class PanoramaOutput
+{
+public:
+    static constexpr qreal const defaultStereoShift = 0.5;
+    static constexpr int const defaultCaptureWidth = 960;
+
+    enum FovAngle { // vertical FOV angle in degree
+        FovMin = 35,
+        FovDef = 95,
+        FovMax = 115
+    };
+
+    enum StereoMode { // of the frames, as SphericalMetadata::StereoMode
+        StereoAuto = -1, // for the options only
+        StereoMono,
+        StereoTopBottom,
+        StereoSideBySide
+    };
+    static int parseStereoMode(const QString &text); // "auto", "mono", "tb" or "sbs", -2 if bad
+
+    enum Projection { // of the frames
+        ProjectionAuto = -1, // for the options only
+        ProjectionEquirect,
+        ProjectionCubemap // equi-angular cubemap (EAC) in the 3x2 layout
+    };
+
+    static QRectF fullCoverage() { return QRectF(-180.0, -90.0, 360.0, 180.0); }
+    static QRectF halfCoverage() { return QRectF(-90.0, -90.0, 180.0, 180.0); } // VR180
+    static QRectF parseCoverage(const QString &text); // "360", "180" or "lonMin,lonMax,latMin,latMax"
+
+    // The option values of the frontends, false if bad, the parts omitted are left as they are
+    static bool parseCapture(const QString &text, int *rate, int *width); // "rate[:width]"
+    static bool parseGpuBudget(const QString &text, int *percent); // of the refresh interval, 10 to 100
+    static bool parsePrediction(const QString &text, int *ms, qreal *angle); // "ms[:degree]"
+    static bool parseLoopCache(const QString &text, int *megabytes, QString *dir); // "budget[:directory]"
+
+    virtual ~PanoramaOutput() = default;
+
+    virtual void setVideoFrame(const QVideoFrame &frame) = 0;
+    virtual void setTilePyramid(const QSharedPointer<TilePyramid> &tiles) = 0; // the detail of a still image
+    virtual void setCachedFrame(const QSharedPointer<LoopCache> &cache, int index) = 0; // instead of the video frames, null to reset
+    virtual bool loopCacheSupported() const = 0; // the compressed frames can be shown
+    virtual QRhi *sinkRhi() const = 0; // for the zero-copy video sink, null for the mapped frames
+};
+
+#endif // PANORAMAOUTPUT_H
@@ -1,8 +1,15 @@
 #include "PanoramaPlayer.h"
+#include "PanoramaOutput.h"
+#ifndef PANORAMA_NO_QUICK
 #include "PanoramaView.h"
+#endif
+#include "TilePyramid.h"
+#include "SphericalMetadata.h"
+#include "LoopCache.h"
 
 #include <QVideoSink>
 #include <QVideoFrame>
+#include <QMediaMetaData>
 #include <QTimer>
 #include <QDir>
 #include <QFileInfo>
@@ -25,6 +32,15 @@ PanoramaPlayer::PanoramaPlayer(QObject *parent)
     , m_videoSink(new QVideoSink(this))
     , m_statusTimer(nullptr)
     , m_mediaState(MediaUnknown)
+    , m_output(nullptr)
+    , m_stereoMode(PanoramaOutput::StereoMono)
+    , m_coverage(PanoramaOutput::fullCoverage())
+    , m_projection(PanoramaOutput::ProjectionEquirect)
+    , m_cubemapPadding(0)
+    , m_loopCacheBudget(0)
+    , m_loopCacheTried(false)
+    , m_lastFrameTime(-1)
+    , m_cacheTimer(nullptr)
 {
     TRACE();
     m_mediaPlayer->setLoops(QMediaPlayer::Infinite);
@@ -44,16 +60,97 @@ PanoramaPlayer::PanoramaPlayer(QObject *parent)
 
 QUrl PanoramaPlayer::source() const
 {
-    return m_mediaPlayer->source();
+    return m_stillImage ? QUrl::fromLocalFile(m_stillImage->imageFile()) : m_mediaPlayer->source();
 }
 
 void PanoramaPlayer::setSource(const QUrl &url)
 {
     TRACE_ARG(url);
     onMediaStatusChanged(QMediaPlayer::NoMedia);
+    resetLoopCache();
+    QString fileName = url.isLocalFile() ? url.toLocalFile() : (url.scheme().isEmpty() ? url.path() : QString());
+    if (!fileName.isEmpty() && TilePyramid::isImageFile(fileName)) {
+        setStillImage(fileName);
+        readSphericalMetadata(QUrl());
+        if (!m_mediaPlayer->source().isEmpty())
+             m_mediaPlayer->setSource(QUrl());
+        else emit sourceChanged();
+        return;
+    }
+    setStillImage(QString());
+    readSphericalMetadata(url);
     m_mediaPlayer->setSource(url);
 }
 
+void PanoramaPlayer::readSphericalMetadata(const QUrl &url)
+{
+    QString fileName = url.isLocalFile() ? url.toLocalFile() : (url.scheme().isEmpty() ? url.path() : QString());
+    int stereo = PanoramaOutput::StereoMono;
+    QRectF range = PanoramaOutput::fullCoverage();
+    int proj = PanoramaOutput::ProjectionEquirect, padding = 0;
+    if (!fileName.isEmpty()) {
+        const auto meta = SphericalMetadata::read(fileName);
+        if (meta.isSpherical()) {
+            stereo = meta.stereoMode();
+            if (!meta.coverage().isEmpty()) range = meta.coverage();
+            if (meta.projection() == SphericalMetadata::ProjectionCubemap && meta.cubemapLayout() == 0) {
+                proj = PanoramaOutput::ProjectionCubemap;
+                padding = meta.cubemapPadding();
+            }
+        }
+    }
+    TRACE_ARG(fileName << stereo << range << proj << padding);
+    if (proj != m_projection || padding != m_cubemapPadding) {
+        m_projection = proj;
+        m_cubemapPadding = padding;
+        emit projectionChanged();
+    }
+    if (stereo != m_stereoMode) {
+        m_stereoMode = stereo;
+        emit stereoModeChanged();
+    }
+    if (range != m_coverage) {
+        m_coverage = range;
+        emit coverageChanged();
+    }
+}
+
+void PanoramaPlayer::setStillImage(const QString &fileName)
+{
+    TRACE_ARG(fileName);
+    if (m_stillImage.isNull() && fileName.isEmpty()) return;
+    m_stillImage.reset();
+    m_stillFrame = QVideoFrame();
+    if (!fileName.isEmpty()) {
+        // The tile pyramid is built in background on the first use, then the base level
+        // is shown as a regular video frame and the detail is streamed by the renderer
+        auto still = QSharedPointer<TilePyramid>::create(fileName);
+        m_stillImage = still;
+        still->build(this, [this, still](const QString &error) {
+            if (still != m_stillImage) return; // replaced meanwhile
+            if (!error.isEmpty()) {
+                setErrorText(error);
+                return;
+            }
+            m_stillFrame = QVideoFrame(still->baseImage());
+            emit videoSizeChanged();
+            updateStillOutput();
+            onMediaStatusChanged(QMediaPlayer::LoadedMedia);
+        });
+    }
+    updateStillOutput();
+}
+
+void PanoramaPlayer::updateStillOutput()
+{
+    const auto output = videoOutputIface();
+    if (!output) return;
+    TRACE_ARG(m_stillFrame);
+    output->setTilePyramid(m_stillFrame.isValid() ? m_stillImage : QSharedPointer<TilePyramid>());
+    if (m_stillFrame.isValid())
+        output->setVideoFrame(m_stillFrame);
+}
+
 QAudioOutput *PanoramaPlayer::audioOutput() const
 {
     return m_mediaPlayer->audioOutput();
@@ -67,23 +164,47 @@ void PanoramaPlayer::setAudioOutput(QAudioOutput *item)
 
 QObject *PanoramaPlayer::videoOutput() const
 {
-    return m_viewItem.data();
+    return m_outputObject.data();
+}
+
+PanoramaOutput *PanoramaPlayer::videoOutputIface() const
+{
+    return m_outputObject.isNull() ? nullptr : m_output;
 }
 
 void PanoramaPlayer::setVideoOutput(QObject *item)
 {
     TRACE_ARG(item);
     if (item) {
-        if (item == m_viewItem.data()) return;
-        m_viewItem = qobject_cast<PanoramaView *>(item);
-        if (m_viewItem.isNull()) {
-            qWarning() << Q_FUNC_INFO << "Bad output, VideoItem expected";
+        if (item == m_outputObject.data()) return;
+        auto output = dynamic_cast<PanoramaOutput *>(item);
+        if (!output) {
+            qWarning() << Q_FUNC_INFO << "Bad output, PanoramaOutput expected";
             return;
         }
+        if (videoOutputIface()) {
+            m_outputObject->disconnect(this);
+            m_output->setTilePyramid(QSharedPointer<TilePyramid>());
+            resetLoopCache();
+        }
+        m_outputObject = item;
+        m_output = output;
+#ifndef PANORAMA_NO_QUICK
+        if (auto view = qobject_cast<PanoramaView *>(item)) {
+            connect(view, &PanoramaView::rhiChanged, this, &PanoramaPlayer::updateSinkRhi);
+            connect(view, &PanoramaView::zeroCopyChanged, this, &PanoramaPlayer::updateSinkRhi);
+        }
+#endif
     } else {
-        if (m_viewItem.isNull()) return;
-        m_viewItem.clear();
+        if (!videoOutputIface()) return;
+        resetLoopCache();
+        m_outputObject->disconnect(this);
+        m_output->setTilePyramid(QSharedPointer<TilePyramid>());
+        m_outputObject.clear();
+        m_output = nullptr;
     }
+    updateSinkRhi();
+    updateStillOutput();
     emit videoOutputChanged();
 }
 
@@ -112,7 +233,9 @@ void PanoramaPlayer::setMediaState()
 {
     TRACE();
     int prev_state = m_mediaState;
-    switch (m_mediaPlayer->mediaStatus()) {
+    if (!m_stillImage.isNull()) {
+        m_mediaState = m_stillFrame.isValid() ? MediaReady : MediaUnknown;
+    } else switch (m_mediaPlayer->mediaStatus()) {
     case QMediaPlayer::NoMedia:
     case QMediaPlayer::LoadingMedia:
     case QMediaPlayer::InvalidMedia:
@@ -154,12 +277,65 @@ void PanoramaPlayer::setErrorText(const QString &text)
 
 QSize PanoramaPlayer::videoSize() const
 {
+    if (!m_stillImage.isNull()) return m_stillImage->imageSize();
     return m_videoSink->videoSize();
 }
 
+int PanoramaPlayer::stereoMode() const
+{
+    return m_stereoMode;
+}
+
+QRectF PanoramaPlayer::coverage() const
+{
+    return m_coverage;
+}
+
+int PanoramaPlayer::projection() const
+{
+    return m_projection;
+}
+
+int PanoramaPlayer::cubemapPadding() const
+{
+    return m_cubemapPadding;
+}
+
+int PanoramaPlayer::loopCache() const
+{
+    return m_loopCacheBudget;
+}
+
+void PanoramaPlayer::setLoopCache(int megabytes)
+{
+    TRACE_ARG(megabytes);
+    int budget = qMax(0, megabytes);
+    if (budget != m_loopCacheBudget) {
+        m_loopCacheBudget = budget;
+        resetLoopCache();
+        emit loopCacheChanged();
+    }
+}
+
+QString PanoramaPlayer::loopCacheDir() const
+{
+    return m_loopCacheDir;
+}
+
+void PanoramaPlayer::setLoopCacheDir(const QString &path)
+{
+    TRACE_ARG(path);
+    if (path != m_loopCacheDir) {
+        m_loopCacheDir = path;
+        resetLoopCache();
+        emit loopCacheChanged();
+    }
+}
+
 void PanoramaPlayer::play()
 {
     TRACE();
+    if (!m_stillImage.isNull()) return; // nothing to play
 #if QT_VERSION >= QT_VERSION_CHECK(6, 5, 0)
     if (m_mediaPlayer->isPlaying()) return;
 #endif
@@ -206,7 +382,7 @@ QStringList PanoramaPlayer::allVideoFiles(const QString &path)
             return QStringList();
         }
         nameFilters.append(info.fileName());
-    } else nameFilters.append("*.mp4");
+    } else nameFilters << "*.mp4" << "*.jpg" << "*.jpeg" << "*.png" << "*.tif" << "*.tiff";
 
     QStringList files, list = dir.entryList(nameFilters, QDir::Files | QDir::Readable, QDir::Time);
     for (int i = 0; i < list.size(); i++) {
@@ -215,9 +391,96 @@ QStringList PanoramaPlayer::allVideoFiles(const QString &path)
     return files;
 }
 
+void PanoramaPlayer::updateSinkRhi()
+{
+    // With the QRhi the hardware decoder may deliver frames as native textures,
+    // without it the frames are always downloaded into the mappable memory
+    QRhi *rhi = videoOutputIface() ? m_output->sinkRhi() : nullptr;
+    TRACE_ARG(rhi);
+    if (rhi != m_videoSink->rhi())
+        m_videoSink->setRhi(rhi);
+}
+
 void PanoramaPlayer::onVideoFrameChanged(const QVideoFrame &frame)
 {
     TRACE_ARG(frame);
-    if (!m_viewItem.isNull())
-        m_viewItem->setVideoFrame(frame);
+    if (videoOutputIface() && m_stillImage.isNull()) {
+        m_output->setVideoFrame(frame);
+        if (m_loopCacheBudget > 0 && frame.isValid())
+            recordLoopFrame(frame);
+    }
+}
+
+void PanoramaPlayer::recordLoopFrame(const QVideoFrame &frame)
+{
+    if (!m_loopCache) {
+        if (m_loopCacheTried || !m_output->loopCacheSupported()) return;
+        m_loopCacheTried = true;
+        const QUrl url = m_mediaPlayer->source();
+        const qint64 duration = m_mediaPlayer->duration();
+        const qreal frameRate = m_mediaPlayer->metaData().value(QMediaMetaData::VideoFrameRate).toReal();
+        auto cache = QSharedPointer<LoopCache>::create(url.isLocalFile() ? url.toLocalFile() : url.toString(),
+                                                       frame.size(), duration, frameRate, qint64(m_loopCacheBudget) << 20,
+                                                       url.isLocalFile() ? m_loopCacheDir : QString());
+        if (!cache->isValid()) {
+            qWarning() << Q_FUNC_INFO << "No loop cache for" << frame.size() << duration << "ms at" << frameRate
+                       << "fps within" << m_loopCacheBudget << "MB";
+            return;
+        }
+        m_loopCache = cache;
+    }
+
+    // The first pass is recorded from the clip begin, the next loop plays from the cache
+    // once all its frames are encoded
+    const qint64 time = frame.startTime() / 1000;
+    if (time < m_lastFrameTime) m_loopCache->finishPass();
+    m_lastFrameTime = time;
+    if (m_loopCache->isComplete())
+        startCachePlayback();
+    else m_loopCache->addFrame(frame);
+}
+
+void PanoramaPlayer::startCachePlayback()
+{
+    if (m_cacheTimer && m_cacheTimer->isActive()) return;
+    TRACE();
+    qInfo().noquote() << "Playing" << m_mediaPlayer->source().toDisplayString() << "from the loop cache";
+
+    // The decoder is idle, the audio goes on and its position selects the frames
+    m_mediaPlayer->setActiveVideoTrack(-1);
+    if (!m_cacheTimer) {
+        m_cacheTimer = new QTimer(this);
+        m_cacheTimer->setTimerType(Qt::PreciseTimer);
+        m_cacheTimer->setInterval(5);
+        connect(m_cacheTimer, &QTimer::timeout, this, &PanoramaPlayer::updateCachedFrame);
+    }
+    m_cacheTimer->start();
+    updateCachedFrame();
+}
+
+void PanoramaPlayer::updateCachedFrame()
+{
+    if (!videoOutputIface() || !m_loopCache) return;
+    if (m_loopCache->isUnplayable()) {
+        // The renderer shows the decoded frames again, not retried for this source
+        qWarning() << Q_FUNC_INFO << "The loop cache can't be shown, playing" << m_mediaPlayer->source().toDisplayString() << "from the decoder";
+        resetLoopCache();
+        m_loopCacheTried = true;
+        return;
+    }
+    m_output->setCachedFrame(m_loopCache, m_loopCache->frameAt(m_mediaPlayer->position()));
+}
+
+void PanoramaPlayer::resetLoopCache()
+{
+    if (m_cacheTimer && m_cacheTimer->isActive()) {
+        TRACE();
+        m_cacheTimer->stop();
+        m_mediaPlayer->setActiveVideoTrack(0);
+    }
+    if (videoOutputIface())
+        m_output->setCachedFrame(QSharedPointer<LoopCache>(), -1);
+    m_loopCache.reset();
+    m_loopCacheTried = false;
+    m_lastFrameTime = -1;
 }
@@ -2,18 +2,22 @@
 #define PANORAMAPLAYER_H
 
 #include <QObject>
-#include <QQmlEngine>
+#include <QtQmlIntegration/qqmlintegration.h> // QML_ELEMENT without linking Qt Qml
 #include <QUrl>
 #include <QSize>
+#include <QRectF>
 #include <QMediaPlayer>
 //#include <QMediaMetaData>
 #include <QAudioOutput>
 #include <QPointer>
+#include <QSharedPointer>
+#include <QVideoFrame>
 
 class QTimer;
 class QVideoSink;
-class QVideoFrame;
-class PanoramaView;
+class PanoramaOutput;
+class TilePyramid;
+class LoopCache;
 
 class PanoramaPlayer : public QObject
 {
@@ -27,6 +31,12 @@ class PanoramaPlayer : public QObject
     Q_PROPERTY(QString         errorText READ errorText    NOTIFY errorTextChanged FINAL)
     //Q_PROPERTY(QMediaMetaData   metaData READ metaData     NOTIFY metaDataChanged FINAL)
     Q_PROPERTY(QSize           videoSize READ videoSize    NOTIFY videoSizeChanged FINAL)
+    Q_PROPERTY(int            stereoMode READ stereoMode   NOTIFY stereoModeChanged FINAL)
+    Q_PROPERTY(QRectF           coverage READ coverage     NOTIFY coverageChanged FINAL)
+    Q_PROPERTY(int            projection READ projection   NOTIFY projectionChanged FINAL)
+    Q_PROPERTY(int        cubemapPadding READ cubemapPadding NOTIFY projectionChanged FINAL)
+    Q_PROPERTY(int             loopCache READ loopCache    WRITE setLoopCache   NOTIFY loopCacheChanged FINAL)
+    Q_PROPERTY(QString      loopCacheDir READ loopCacheDir WRITE setLoopCacheDir NOTIFY loopCacheChanged FINAL)
 
 public:
     explicit PanoramaPlayer(QObject *parent = nullptr);
@@ -45,15 +55,25 @@ public:
     void setAudioOutput(QAudioOutput *item);
 
     QObject *videoOutput() const;
-    void setVideoOutput(QObject *item);
+    void setVideoOutput(QObject *item); // a PanoramaOutput
 
     int mediaState() const;
     QString errorText() const;
     //QMediaMetaData metaData() const;
     QSize videoSize() const;
+    int stereoMode() const; // PanoramaOutput::StereoMode by the spherical metadata of the source
+    QRectF coverage() const; // by the spherical metadata of the source, in degree
+    int projection() const; // PanoramaOutput::Projection by the spherical metadata of the source
+    int cubemapPadding() const;
+
+    int loopCache() const;
+    void setLoopCache(int megabytes); // the memory budget of the compressed frames of a loop, 0 is off
+
+    QString loopCacheDir() const;
+    void setLoopCacheDir(const QString &path); // the cache files instead of RAM, for the local sources
 
     Q_INVOKABLE bool isPlaying() const;
-    Q_INVOKABLE static QStringList allVideoFiles(const QString &path); // folder and optional fileMask
+    Q_INVOKABLE static QStringList allVideoFiles(const QString &path); // folder and optional fileMask, with still images
 
 public slots:
     void play();
@@ -68,19 +88,45 @@ signals:
     void errorTextChanged();
     //void metaDataChanged();
     void videoSizeChanged();
+    void stereoModeChanged();
+    void coverageChanged();
+    void projectionChanged();
+    void loopCacheChanged();
 
 private:
+    PanoramaOutput *videoOutputIface() const; // null if none or destroyed
     void setMediaState();
     void setErrorText(const QString &text);
     void onMediaStatusChanged(QMediaPlayer::MediaStatus status);
     void onVideoFrameChanged(const QVideoFrame &frame);
+    void updateSinkRhi();
+    void setStillImage(const QString &fileName);
+    void updateStillOutput();
+    void readSphericalMetadata(const QUrl &url);
+    void recordLoopFrame(const QVideoFrame &frame);
+    void startCachePlayback();
+    void updateCachedFrame();
+    void resetLoopCache();
 
     QMediaPlayer *m_mediaPlayer;
     QVideoSink *m_videoSink;
     QTimer *m_statusTimer;
     int m_mediaState;
     QString m_errorText;
-    QPointer<PanoramaView> m_viewItem;
+    QPointer<QObject> m_outputObject;
+    PanoramaOutput *m_output; // the interface of m_outputObject
+    QSharedPointer<TilePyramid> m_stillImage; // instead of the media player source
+    QVideoFrame m_stillFrame;
+    int m_stereoMode;
+    QRectF m_coverage;
+    int m_projection;
+    int m_cubemapPadding;
+    int m_loopCacheBudget; // in MB
+    QString m_loopCacheDir;
+    QSharedPointer<LoopCache> m_loopCache;
+    bool m_loopCacheTried; // for the current source
+    qint64 m_lastFrameTime; // in ms, to detect the loop
+    QTimer *m_cacheTimer; // while playing from the cache
 };
 
 #endif // PANORAMAPLAYER_H
@@ -1,9 +1,18 @@
 #include "PanoramaView.h"
 #include "VideoRenderer.h"
+#include "SoftwareRenderer.h"
+#include "RhiVideoRenderer.h"
+#include "TilePyramid.h"
+#include "SharedFrame.h"
+#include "LoopCache.h"
 
 #include <QQuickWindow>
+#include <QScreen>
 #include <QSGRendererInterface>
+#include <QSGSimpleTextureNode>
 #include <QRunnable>
+#include <QQmlFile>
+#include <QImage>
 #include <QtDebug>
 
 //#define TRACE_PANORAMAVIEW
@@ -26,12 +35,31 @@ static qreal roundTo2(qreal value)
 PanoramaView::PanoramaView(QQuickItem *parent)
     : QQuickItem(parent)
     , m_renderer(nullptr)
+    , m_softRenderer(nullptr)
+    , m_rhiRenderer(false)
+    , m_rhiMode(false)
     , m_debugOpenGL(false)
+    , m_zeroCopy(true)
+    , m_rhi(nullptr)
     , m_rotateDisplay(0)
     , m_stereoShift(defaultStereoShift)
-    , m_pitchAngle(0.0)
-    , m_yawAngle(0.0)
+    , m_stereoMode(StereoMono)
     , m_fovAngle(FovDef)
+    , m_coverage(fullCoverage())
+    , m_projection(ProjectionEquirect)
+    , m_cubemapPadding(0)
+    , m_monoDisplay(false)
+    , m_captureRate(0)
+    , m_captureWidth(defaultCaptureWidth)
+    , m_gpuBudget(0)
+    , m_renderScale(1.0)
+    , m_photonLatency(0.0)
+    , m_gpuStats(false)
+    , m_cacheFrame(-1)
+    , m_etc2Frames(false)
+    , m_profileFixed(false)
+    , m_frameTiming(false)
+    , m_overlaysDirty(false)
     , m_mousePress(false)
 {
     TRACE_ARG(parent);
@@ -40,6 +68,12 @@ PanoramaView::PanoramaView(QQuickItem *parent)
     connect(this, &QQuickItem::windowChanged, this, &PanoramaView::onWindowChanged);
 }
 
+PanoramaView::~PanoramaView()
+{
+    TRACE();
+    delete m_softRenderer;
+}
+
 bool PanoramaView::debugOpenGL() const
 {
     return m_debugOpenGL;
@@ -56,6 +90,35 @@ void PanoramaView::setDebugOpenGL(bool yes)
     }
 }
 
+bool PanoramaView::zeroCopy() const
+{
+    return m_zeroCopy;
+}
+
+void PanoramaView::setZeroCopy(bool yes)
+{
+    TRACE_ARG(yes);
+    if (yes != m_zeroCopy) {
+        m_zeroCopy = yes;
+        emit zeroCopyChanged();
+        updateWindow();
+    }
+}
+
+bool PanoramaView::rhiRenderer() const
+{
+    return m_rhiRenderer;
+}
+
+void PanoramaView::setRhiRenderer(bool yes)
+{
+    TRACE_ARG(yes);
+    if (yes != m_rhiRenderer) {
+        m_rhiRenderer = yes;
+        emit rhiRendererChanged();
+    }
+}
+
 int PanoramaView::rotateDisplay() const
 {
     return m_rotateDisplay;
@@ -68,7 +131,7 @@ void PanoramaView::setRotateDisplay(int direction)
     if (dir != m_rotateDisplay) {
         m_rotateDisplay = dir;
         emit rotateDisplayChanged();
-        if (window()) window()->update();
+        updateWindow();
     }
 }
 
@@ -84,40 +147,65 @@ void PanoramaView::setStereoShift(qreal stereo)
     if (shift != m_stereoShift) {
         m_stereoShift = shift;
         emit stereoShiftChanged();
-        if (window()) window()->update();
+        updateWindow();
+    }
+}
+
+int PanoramaView::stereoMode() const
+{
+    return m_stereoMode;
+}
+
+void PanoramaView::setStereoMode(int mode)
+{
+    TRACE_ARG(mode);
+    int stereo = qBound((int)StereoMono, mode, (int)StereoSideBySide);
+    if (stereo != m_stereoMode) {
+        m_stereoMode = stereo;
+        emit stereoModeChanged();
+        updateWindow();
+    }
+}
+
+QQuaternion PanoramaView::orientation() const
+{
+    return m_orientation;
+}
+
+void PanoramaView::setOrientation(const QQuaternion &rotation)
+{
+    TRACE_ARG(rotation);
+    const QQuaternion unit = rotation.normalized();
+    if (unit != m_orientation) {
+        m_orientation = unit;
+        m_latency.changed();
+        emit orientationChanged();
+        updateWindow();
     }
 }
 
 qreal PanoramaView::pitchAngle() const
 {
-    return m_pitchAngle;
+    return m_orientation.toEulerAngles().x();
 }
 
 void PanoramaView::setPitchAngle(qreal angle)
 {
     TRACE_ARG(angle);
-    qreal degree = roundTo2(qBound(-90.0, angle, 90.0));
-    if (degree != m_pitchAngle) {
-        m_pitchAngle = degree;
-        emit pitchAngleChanged();
-        if (window()) window()->update();
-    }
+    const QVector3D euler = m_orientation.toEulerAngles();
+    setOrientation(QQuaternion::fromEulerAngles(qBound(-90.0, angle, 90.0), euler.y(), euler.z()));
 }
 
 qreal PanoramaView::yawAngle() const
 {
-    return m_yawAngle;
+    return m_orientation.toEulerAngles().y();
 }
 
 void PanoramaView::setYawAngle(qreal angle)
 {
     TRACE_ARG(angle);
-    qreal degree = roundTo2(qBound(-180.0, angle, 180.0));
-    if (degree != m_yawAngle) {
-        m_yawAngle = degree;
-        emit yawAngleChanged();
-        if (window()) window()->update();
-    }
+    const QVector3D euler = m_orientation.toEulerAngles();
+    setOrientation(QQuaternion::fromEulerAngles(euler.x(), qBound(-180.0, angle, 180.0), euler.z()));
 }
 
 int PanoramaView::fovAngle() const
@@ -137,24 +225,188 @@ void PanoramaView::setFovAngle(int angle)
     if (degree != m_fovAngle) {
         m_fovAngle = degree;
         emit fovAngleChanged();
-        if (window()) window()->update();
+        updateWindow();
+    }
+}
+
+QRectF PanoramaView::coverage() const
+{
+    return m_coverage;
+}
+
+void PanoramaView::setCoverage(const QRectF &range)
+{
+    TRACE_ARG(range);
+    QRectF rect = range.isEmpty() ? fullCoverage() : range;
+    if (rect != m_coverage) {
+        m_coverage = rect;
+        emit coverageChanged();
+        updateWindow();
+    }
+}
+
+int PanoramaView::projection() const
+{
+    return m_projection;
+}
+
+void PanoramaView::setProjection(int type)
+{
+    TRACE_ARG(type);
+    int proj = qBound((int)ProjectionEquirect, type, (int)ProjectionCubemap);
+    if (proj != m_projection) {
+        m_projection = proj;
+        emit projectionChanged();
+        checkSoftwareProjection();
+        updateWindow();
+    }
+}
+
+int PanoramaView::cubemapPadding() const
+{
+    return m_cubemapPadding;
+}
+
+void PanoramaView::setCubemapPadding(int pixels)
+{
+    TRACE_ARG(pixels);
+    int pad = qMax(0, pixels);
+    if (pad != m_cubemapPadding) {
+        m_cubemapPadding = pad;
+        emit cubemapPaddingChanged();
+        updateWindow();
+    }
+}
+
+bool PanoramaView::monoDisplay() const
+{
+    return m_monoDisplay;
+}
+
+void PanoramaView::setMonoDisplay(bool yes)
+{
+    TRACE_ARG(yes);
+    if (yes != m_monoDisplay) {
+        m_monoDisplay = yes;
+        emit monoDisplayChanged();
+        updateWindow();
+    }
+}
+
+int PanoramaView::captureRate() const
+{
+    return m_captureRate;
+}
+
+void PanoramaView::setCaptureRate(int fps)
+{
+    TRACE_ARG(fps);
+    int rate = qBound(0, fps, 60);
+    if (rate != m_captureRate) {
+        m_captureRate = rate;
+        emit captureRateChanged();
+        updateWindow();
+    }
+}
+
+int PanoramaView::captureWidth() const
+{
+    return m_captureWidth;
+}
+
+void PanoramaView::setCaptureWidth(int pixels)
+{
+    TRACE_ARG(pixels);
+    int width = pixels > 0 ? qBound(64, pixels, 4096) : defaultCaptureWidth;
+    if (width != m_captureWidth) {
+        m_captureWidth = width;
+        emit captureWidthChanged();
+        updateWindow();
+    }
+}
+
+int PanoramaView::gpuBudget() const
+{
+    return m_gpuBudget;
+}
+
+void PanoramaView::setGpuBudget(int percent)
+{
+    TRACE_ARG(percent);
+    int budget = qBound(0, percent, 100);
+    if (budget != m_gpuBudget) {
+        m_gpuBudget = budget;
+        emit gpuBudgetChanged();
+        updateWindow();
+    }
+}
+
+qreal PanoramaView::renderScale() const
+{
+    return m_renderScale;
+}
+
+void PanoramaView::setRenderScale(qreal scale)
+{
+    if (!qFuzzyCompare(scale, m_renderScale)) {
+        m_renderScale = scale;
+        emit renderScaleChanged();
+    }
+}
+
+qreal PanoramaView::photonLatency() const
+{
+    return m_photonLatency;
+}
+
+void PanoramaView::setPhotonLatency(qreal ms)
+{
+    TRACE_ARG(ms);
+    if (ms != m_photonLatency) {
+        m_photonLatency = ms;
+        emit photonLatencyChanged();
+    }
+}
+
+bool PanoramaView::gpuStats() const
+{
+    return m_gpuStats;
+}
+
+void PanoramaView::setGpuStats(bool yes)
+{
+    TRACE_ARG(yes);
+    if (yes != m_gpuStats) {
+        m_gpuStats = yes;
+        emit gpuStatsChanged();
+        updateWindow();
+    }
+}
+
+PanoramaView *PanoramaView::frameSource() const
+{
+    return m_frameSource.data();
+}
+
+void PanoramaView::setFrameSource(PanoramaView *view)
+{
+    TRACE_ARG(view);
+    if (view == this) view = nullptr;
+    if (view != m_frameSource.data()) {
+        m_frameSource = view;
+        // The source publishes its converted frames from its next synchronization on
+        if (view && !view->m_frameShare)
+            view->m_frameShare.reset(new SharedFrame);
+        emit frameSourceChanged();
+        checkFrameSource();
+        updateWindow();
     }
 }
 
 void PanoramaView::setOrientation(qreal p, qreal y)
 {
     TRACE_ARG(p << y);
-    qreal pitch = roundTo2(qBound(-90.0, p, 90.0));
-    qreal yaw = roundTo2(qBound(-180.0, y, 180.0));
-    bool pitch_changed = (pitch != m_pitchAngle);
-    if (pitch_changed) m_pitchAngle = pitch;
-    bool yaw_changed = (yaw != m_yawAngle);
-    if (yaw_changed) m_yawAngle = yaw;
-    if (pitch_changed || yaw_changed) {
-        if (pitch_changed) emit pitchAngleChanged();
-        if (yaw_changed) emit yawAngleChanged();
-        if (window()) window()->update();
-    }
+    setOrientation(QQuaternion::fromEulerAngles(qBound(-90.0, p, 90.0), qBound(-180.0, y, 180.0), 0.0));
 }
 
 QString PanoramaView::graphicsApi() const
@@ -185,6 +437,16 @@ QString PanoramaView::errorText() const
     return m_errorText;
 }
 
+QRhi *PanoramaView::rhi() const
+{
+    return m_rhi;
+}
+
+QRhi *PanoramaView::sinkRhi() const
+{
+    return m_zeroCopy ? m_rhi : nullptr;
+}
+
 void PanoramaView::setErrorText(const QString &text)
 {
     TRACE_ARG(text);
@@ -194,6 +456,29 @@ void PanoramaView::setErrorText(const QString &text)
     }
 }
 
+bool PanoramaView::itemRendering() const
+{
+    return m_softRenderer || m_rhiMode;
+}
+
+void PanoramaView::updateWindow()
+{
+    if (itemRendering()) update(); // the item content, see updatePaintNode()
+    else if (window()) window()->update();
+}
+
+void PanoramaView::checkSoftwareProjection()
+{
+    if (m_softRenderer && m_projection != ProjectionEquirect)
+        setErrorText(QStringLiteral("The software renderer supports the equirectangular frames only"));
+}
+
+void PanoramaView::checkFrameSource()
+{
+    if (m_frameSource && itemRendering())
+        setErrorText(QStringLiteral("The frame source requires the OpenGL renderer"));
+}
+
 void PanoramaView::onWindowChanged(QQuickWindow *win)
 {
     if (!win) return;
@@ -201,14 +486,29 @@ void PanoramaView::onWindowChanged(QQuickWindow *win)
     QSGRendererInterface *rif = win->rendererInterface();
     if (!rif) return;
     const auto gapi = rif->graphicsApi();
-    if (gapi == QSGRendererInterface::OpenGL) {
+    if (win->screen()) m_latency.setRefreshRate(win->screen()->refreshRate());
+    connect(win, &QQuickWindow::frameSwapped,
+            this, &PanoramaView::onFrameSwapped, Qt::DirectConnection);
+    if (gapi == QSGRendererInterface::Vulkan || (gapi == QSGRendererInterface::OpenGL && m_rhiRenderer)) {
+        // The QRhi renderer as the render node of the item content
+        m_rhiMode = true;
+        setFlag(ItemHasContents);
+        win->setColor(Qt::black);
+    } else if (gapi == QSGRendererInterface::OpenGL) {
         connect(win, &QQuickWindow::beforeSynchronizing,
                 this, &PanoramaView::onBeforeSynchronizing, Qt::DirectConnection);
         connect(win, &QQuickWindow::sceneGraphInvalidated,
                 this, &PanoramaView::onSceneGraphInvalidated, Qt::DirectConnection);
+    } else if (gapi == QSGRendererInterface::Software) {
+        // No usable OpenGL, the frames are remapped on CPU into the item content
+        if (!m_softRenderer) m_softRenderer = new SoftwareRenderer;
+        setFlag(ItemHasContents);
+        win->setColor(Qt::black);
+        checkSoftwareProjection();
     } else {
-        setErrorText(QStringLiteral("Current graphics API: %1, but OpenGL is required!").arg(graphicsApiText(gapi)));
+        setErrorText(QStringLiteral("Current graphics API: %1, but OpenGL or Vulkan is required!").arg(graphicsApiText(gapi)));
     }
+    checkFrameSource();
     QString text = graphicsApiText(gapi);
     if (text != m_graphicsApi) {
         m_graphicsApi = text;
@@ -218,12 +518,122 @@ void PanoramaView::onWindowChanged(QQuickWindow *win)
 
 void PanoramaView::setVideoFrame(const QVideoFrame &frame)
 {
-    auto win = window();
-    if (!win) return;
+    if (!window()) return;
     TRACE_ARG(frame);
-    if (VideoRenderer::isFrameSuppored(frame)) {
+    if (m_softRenderer || VideoRenderer::isFrameSuppored(frame)) {
         m_videoFrame = frame;
-        win->update();
+        updateWindow();
+    }
+}
+
+void PanoramaView::setTilePyramid(const QSharedPointer<TilePyramid> &tiles)
+{
+    TRACE_ARG((tiles ? tiles->imageFile() : QString()));
+    if (tiles != m_tilePyramid) {
+        m_tilePyramid = tiles;
+        updateWindow();
+    }
+}
+
+int PanoramaView::addImageOverlay(const QUrl &source, qreal yaw, qreal pitch, qreal distance, qreal width)
+{
+    TRACE_ARG(source << yaw << pitch << distance << width);
+    const QString fileName = QQmlFile::urlToLocalFileOrQrc(source);
+    QImage image(fileName);
+    if (image.isNull()) {
+        qWarning() << Q_FUNC_INFO << "Can't load overlay image" << source;
+        return -1;
+    }
+    int id = m_overlayAtlas.addImage(image, yaw, pitch, distance, width);
+    if (id >= 0) {
+        m_overlaysDirty = true;
+        updateWindow();
+    }
+    return id;
+}
+
+int PanoramaView::addTextOverlay(const QString &text, qreal yaw, qreal pitch, qreal distance, qreal height,
+                                 const QColor &color)
+{
+    TRACE_ARG(text << yaw << pitch << distance << height);
+    int id = m_overlayAtlas.addText(text, yaw, pitch, distance, height, color);
+    if (id >= 0) {
+        m_overlaysDirty = true;
+        updateWindow();
+    }
+    return id;
+}
+
+bool PanoramaView::moveOverlay(int id, qreal yaw, qreal pitch, qreal distance)
+{
+    if (!m_overlayAtlas.move(id, yaw, pitch, distance))
+        return false;
+    m_overlaysDirty = true;
+    updateWindow();
+    return true;
+}
+
+bool PanoramaView::removeOverlay(int id)
+{
+    if (!m_overlayAtlas.remove(id))
+        return false;
+    m_overlaysDirty = true;
+    updateWindow();
+    return true;
+}
+
+void PanoramaView::clearOverlays()
+{
+    TRACE();
+    if (m_overlayAtlas.isEmpty()) return;
+    m_overlayAtlas.clear();
+    m_overlaysDirty = true;
+    updateWindow();
+}
+
+void PanoramaView::setCachedFrame(const QSharedPointer<LoopCache> &cache, int index)
+{
+    if (cache == m_loopCache && index == m_cacheFrame) return;
+    TRACE_ARG(index);
+    m_loopCache = cache;
+    m_cacheFrame = cache ? index : -1;
+    updateWindow();
+}
+
+bool PanoramaView::loopCacheSupported() const
+{
+    // The shared frames are converted by the color pass only
+    return m_etc2Frames && !itemRendering() && !m_frameShare;
+}
+
+void PanoramaView::setRenderProfile(const RenderProfile &profile)
+{
+    TRACE_ARG(profile.toString());
+    m_renderProfile = profile;
+    m_profileFixed = true;
+    updateWindow();
+}
+
+void PanoramaView::setFrameTiming(bool yes)
+{
+    TRACE_ARG(yes);
+    if (yes != m_frameTiming) {
+        m_frameTiming = yes;
+        updateWindow();
+    }
+}
+
+QString PanoramaView::glRenderer() const
+{
+    return m_glRenderer;
+}
+
+void PanoramaView::onFrameSwapped()
+{
+    // On the render thread, the GUI thread takes the latency as the sensor samples come
+    if (m_latency.swapped()) {
+        const qreal ms = m_latency.latency();
+        QMetaObject::invokeMethod(this, [this, ms]() { setPhotonLatency(ms); }, Qt::QueuedConnection);
     }
 }
 
@@ -232,23 +642,125 @@ void PanoramaView::onBeforeSynchronizing()
     auto win = window();
     if (!win) return;
     TRACE();
+    m_latency.synchronized();
     if (!m_renderer) {
         m_renderer = new VideoRenderer(win, m_debugOpenGL);
         connect(m_renderer, &VideoRenderer::errorOccurred,
                 this, &PanoramaView::setErrorText, Qt::QueuedConnection);
+        connect(m_renderer, &VideoRenderer::renderScaleChanged,
+                this, &PanoramaView::setRenderScale, Qt::QueuedConnection);
         win->setColor(Qt::black);
+        m_overlaysDirty = !m_overlayAtlas.isEmpty(); // the new renderer has none
+        connect(m_renderer, &VideoRenderer::frameTimed,
+                this, &PanoramaView::frameTimed, Qt::QueuedConnection);
+        connect(m_renderer, &VideoRenderer::gpuStatsUpdated,
+                this, &PanoramaView::gpuStatsUpdated, Qt::QueuedConnection);
+        m_etc2Frames = m_renderer->hasEtc2();
+
+        // The pipeline configuration tuned for this GPU if any
+        m_glRenderer = m_renderer->glRenderer();
+        if (!m_profileFixed) {
+            bool found = false;
+            m_renderProfile = RenderProfile::load(m_glRenderer, &found);
+            if (found) qInfo().noquote() << "Render profile of" << m_glRenderer << "-" << m_renderProfile.toString();
+        }
+    }
+    if (win->rhi() != m_rhi) {
+        m_rhi = win->rhi();
+        emit rhiChanged();
     }
+    m_renderer->setZeroCopy(m_zeroCopy);
     m_renderer->setRotateDisplay(m_rotateDisplay);
     m_renderer->setStereoShift(m_stereoShift);
+    m_renderer->setStereoMode(m_stereoMode);
     m_renderer->setProjection(m_fovAngle);
-    m_renderer->setOrientation(m_pitchAngle, m_yawAngle);
+    m_renderer->setCoverage(m_coverage);
+    m_renderer->setFrameProjection(m_projection, m_cubemapPadding);
+    m_renderer->setOrientation(m_orientation);
+    m_renderer->setTilePyramid(m_tilePyramid);
+    m_renderer->setMonoDisplay(m_monoDisplay);
+    m_renderer->setFrameShare(m_frameShare);
+    m_renderer->setFrameSource(m_frameSource ? m_frameSource->m_frameShare : QSharedPointer<SharedFrame>());
+    m_renderer->setCapture(m_captureRate, m_captureWidth);
+    m_renderer->setGpuBudget(m_gpuBudget);
+    m_renderer->setRenderProfile(m_renderProfile);
+    m_renderer->setFrameTiming(m_frameTiming);
+    m_renderer->setGpuStats(m_gpuStats);
+    m_renderer->setCachedFrame(m_loopCache, m_cacheFrame);
+    if (m_overlaysDirty) {
+        m_overlaysDirty = false;
+        m_renderer->setOverlays(m_overlayAtlas.batch());
+    }
     if (m_videoFrame.isValid())
         m_renderer->setVideoFrame(m_videoFrame);
 }
 
+QSGNode *PanoramaView::updateRhiNode(QSGNode *oldNode)
+{
+    TRACE();
+    auto node = static_cast<RhiVideoRenderer *>(oldNode);
+    if (!node) node = new RhiVideoRenderer(window());
+    const QString text = node->takeErrorText();
+    if (!text.isEmpty()) // on the render thread while the GUI thread is blocked
+        QMetaObject::invokeMethod(this, [this, text]() { setErrorText(text); }, Qt::QueuedConnection);
+    node->setDebug(m_debugOpenGL);
+    node->setRotateDisplay(m_rotateDisplay);
+    node->setStereoShift(m_stereoShift);
+    node->setStereoMode(m_stereoMode);
+    node->setProjection(m_fovAngle);
+    node->setCoverage(m_coverage);
+    node->setFrameProjection(m_projection, m_cubemapPadding);
+    node->setOrientation(m_orientation);
+    if (m_videoFrame.isValid())
+        node->setVideoFrame(m_videoFrame);
+    node->setRect(boundingRect());
+    node->markDirty(QSGNode::DirtyMaterial);
+    return node;
+}
+
+QSGNode *PanoramaView::updatePaintNode(QSGNode *oldNode, UpdatePaintNodeData *data)
+{
+    Q_UNUSED(data);
+    if (itemRendering()) m_latency.synchronized(); // else by onBeforeSynchronizing()
+    if (m_rhiMode && window())
+        return updateRhiNode(oldNode);
+    auto node = static_cast<QSGSimpleTextureNode *>(oldNode);
+    auto win = window();
+    if (!m_softRenderer || !win) {
+        delete node;
+        return nullptr;
+    }
+    TRACE();
+    m_softRenderer->setRotateDisplay(m_rotateDisplay);
+    m_softRenderer->setStereoShift(m_stereoShift);
+    m_softRenderer->setStereoMode(m_stereoMode);
+    m_softRenderer->setProjection(m_fovAngle);
+    m_softRenderer->setCoverage(m_coverage);
+    m_softRenderer->setOrientation(m_orientation);
+    if (m_videoFrame.isValid())
+        m_softRenderer->setVideoFrame(m_videoFrame);
+
+    const QImage image = m_softRenderer->render((size() * win->devicePixelRatio()).toSize());
+    if (image.isNull()) {
+        delete node;
+        return nullptr;
+    }
+    if (!node) {
+        node = new QSGSimpleTextureNode;
+        node->setOwnsTexture(true);
+    }
+    node->setTexture(win->createTextureFromImage(image));
+    node->setRect(boundingRect());
+    return node;
+}
+
 void PanoramaView::onSceneGraphInvalidated()
 {
     TRACE();
+    if (m_rhi) {
+        m_rhi = nullptr;
+        emit rhiChanged();
+    }
     if (!m_renderer) return;
     delete m_renderer;
     m_renderer = nullptr;
@@ -283,7 +795,7 @@ void PanoramaView::keyPressEvent(QKeyEvent *event)
     case Qt::Key_Right:
         if (m_stereoShift <= 0.9) {
             m_stereoShift += 0.1;
-            win->update();
+            updateWindow();
         }
         break;
     case Qt::Key_Minus:
@@ -291,14 +803,14 @@ void PanoramaView::keyPressEvent(QKeyEvent *event)
         if (m_stereoShift >= 0.1) {
             m_stereoShift -= 0.1;
             if (m_stereoShift < 0.1) m_stereoShift = 0.0;
-            win->update();
+            updateWindow();
         }
         break;
     case Qt::Key_Equal:
     case Qt::Key_Asterisk:
         if (!qFuzzyCompare(m_stereoShift, defaultStereoShift)) {
             m_stereoShift = defaultStereoShift;
-            win->update();
+            updateWindow();
         }
         break;
     case Qt::Key_Space:
@@ -324,7 +836,7 @@ void PanoramaView::keyPressEvent(QKeyEvent *event)
 void PanoramaView::mousePressEvent(QMouseEvent *event)
 {
     TRACE();
-    if (!m_renderer) return;
+    if (!m_renderer && !itemRendering()) return;
     m_mousePress = true;
     m_mousePos = event->position();
     m_mouseAngle.setX(0.0);
@@ -347,7 +859,7 @@ void PanoramaView::mouseMoveEvent(QMouseEvent *event)
 
 void PanoramaView::mouseReleaseEvent(QMouseEvent *event)
 {
-    if (!m_mousePress || !m_renderer) return;
+    if (!m_mousePress || (!m_renderer && !itemRendering())) return;
     TRACE();
     Q_UNUSED(event);
     m_mousePress = false;
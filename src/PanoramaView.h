@@ -5,44 +5,103 @@
 #include <QQmlEngine>
 #include <QQuickItem>
 #include <QVideoFrame>
+#include <QSharedPointer>
+#include <QPointer>
+#include <QRectF>
+#include <QColor>
+#include <QQuaternion>
+#include <QUrl>
+
+#include "OverlayAtlas.h"
+#include "RenderProfile.h"
+#include "GpuTimer.h"
+#include "PanoramaOutput.h"
+#include "PhotonLatency.h"
 
 class VideoRenderer;
+class SoftwareRenderer;
+class QRhi;
+class TilePyramid;
+class SharedFrame;
+class LoopCache;
 
-class PanoramaView : public QQuickItem
+class PanoramaView : public QQuickItem, public PanoramaOutput
 {
     Q_OBJECT
     Q_PROPERTY(bool    debugOpenGL READ debugOpenGL   WRITE setDebugOpenGL   NOTIFY debugOpenGLChanged FINAL)
+    Q_PROPERTY(bool       zeroCopy READ zeroCopy      WRITE setZeroCopy      NOTIFY zeroCopyChanged FINAL)
+    Q_PROPERTY(bool    rhiRenderer READ rhiRenderer   WRITE setRhiRenderer   NOTIFY rhiRendererChanged FINAL)
     Q_PROPERTY(int   rotateDisplay READ rotateDisplay WRITE setRotateDisplay NOTIFY rotateDisplayChanged FINAL)
     Q_PROPERTY(qreal   stereoShift READ stereoShift   WRITE setStereoShift   NOTIFY stereoShiftChanged FINAL)
-    Q_PROPERTY(qreal    pitchAngle READ pitchAngle    WRITE setPitchAngle    NOTIFY pitchAngleChanged FINAL)
-    Q_PROPERTY(qreal      yawAngle READ yawAngle      WRITE setYawAngle      NOTIFY yawAngleChanged FINAL)
+    Q_PROPERTY(int      stereoMode READ stereoMode    WRITE setStereoMode    NOTIFY stereoModeChanged FINAL)
+    Q_PROPERTY(QQuaternion orientation READ orientation WRITE setOrientation NOTIFY orientationChanged FINAL)
+    Q_PROPERTY(qreal    pitchAngle READ pitchAngle    WRITE setPitchAngle    NOTIFY orientationChanged FINAL)
+    Q_PROPERTY(qreal      yawAngle READ yawAngle      WRITE setYawAngle      NOTIFY orientationChanged FINAL)
     Q_PROPERTY(int        fovAngle READ fovAngle      WRITE setFovAngle      NOTIFY fovAngleChanged FINAL)
+    Q_PROPERTY(QRectF     coverage READ coverage      WRITE setCoverage      NOTIFY coverageChanged FINAL)
+    Q_PROPERTY(int      projection READ projection    WRITE setProjection    NOTIFY projectionChanged FINAL)
+    Q_PROPERTY(int  cubemapPadding READ cubemapPadding WRITE setCubemapPadding NOTIFY cubemapPaddingChanged FINAL)
+    Q_PROPERTY(bool    monoDisplay READ monoDisplay   WRITE setMonoDisplay   NOTIFY monoDisplayChanged FINAL)
+    Q_PROPERTY(PanoramaView *frameSource READ frameSource WRITE setFrameSource NOTIFY frameSourceChanged FINAL)
+    Q_PROPERTY(int     captureRate READ captureRate   WRITE setCaptureRate   NOTIFY captureRateChanged FINAL)
+    Q_PROPERTY(int    captureWidth READ captureWidth  WRITE setCaptureWidth  NOTIFY captureWidthChanged FINAL)
+    Q_PROPERTY(int       gpuBudget READ gpuBudget     WRITE setGpuBudget     NOTIFY gpuBudgetChanged FINAL)
+    Q_PROPERTY(qreal   renderScale READ renderScale   NOTIFY renderScaleChanged FINAL)
+    Q_PROPERTY(qreal photonLatency READ photonLatency NOTIFY photonLatencyChanged FINAL)
+    Q_PROPERTY(bool       gpuStats READ gpuStats      WRITE setGpuStats      NOTIFY gpuStatsChanged FINAL)
     Q_PROPERTY(QString graphicsApi READ graphicsApi   NOTIFY graphicsApiChanged FINAL)
     Q_PROPERTY(QString   errorText READ errorText     NOTIFY errorTextChanged FINAL)
     QML_ELEMENT
 
 public:
-    static constexpr qreal const defaultStereoShift = 0.5;
-
     explicit PanoramaView(QQuickItem *parent = nullptr);
+    ~PanoramaView() override;
 
-    enum FovAngle { // vertical FOV angle in degree
-        FovMin = 35,
-        FovDef = 95,
-        FovMax = 115
+    // The enums of PanoramaOutput for QML
+    enum FovAngle {
+        FovMin = PanoramaOutput::FovMin,
+        FovDef = PanoramaOutput::FovDef,
+        FovMax = PanoramaOutput::FovMax
     };
     Q_ENUM(FovAngle)
 
+    enum StereoMode {
+        StereoAuto = PanoramaOutput::StereoAuto,
+        StereoMono = PanoramaOutput::StereoMono,
+        StereoTopBottom = PanoramaOutput::StereoTopBottom,
+        StereoSideBySide = PanoramaOutput::StereoSideBySide
+    };
+    Q_ENUM(StereoMode)
+
+    enum Projection {
+        ProjectionAuto = PanoramaOutput::ProjectionAuto,
+        ProjectionEquirect = PanoramaOutput::ProjectionEquirect,
+        ProjectionCubemap = PanoramaOutput::ProjectionCubemap
+    };
+    Q_ENUM(Projection)
+
     bool debugOpenGL() const;
     void setDebugOpenGL(bool yes);
 
+    bool zeroCopy() const;
+    void setZeroCopy(bool yes);
+
+    bool rhiRenderer() const;
+    void setRhiRenderer(bool yes); // the QRhi renderer on OpenGL too, set before the window
+
     int rotateDisplay() const;
     void setRotateDisplay(int direction); // -1/0/1
 
     qreal stereoShift() const;
     void setStereoShift(qreal stereo); // 0.0..1.0
 
-    qreal pitchAngle() const;
+    int stereoMode() const;
+    void setStereoMode(int mode); // StereoMono..StereoSideBySide
+
+    QQuaternion orientation() const;
+    void setOrientation(const QQuaternion &rotation); // of the view as QQuaternion::fromEulerAngles()
+
+    qreal pitchAngle() const; // of the orientation
     void setPitchAngle(qreal angle); // -90.0..90.0
 
     qreal yawAngle() const;
@@ -51,23 +110,87 @@ public:
     int fovAngle() const;
     void setFovAngle(int angle); // FovMin..FovMax in degree, use 0 to reset to default
 
+    QRectF coverage() const;
+    void setCoverage(const QRectF &range); // longitude, latitude range of the equirectangular frames in degree
+
+    int projection() const;
+    void setProjection(int type); // ProjectionEquirect or ProjectionCubemap
+
+    int cubemapPadding() const;
+    void setCubemapPadding(int pixels); // around each face of the cubemap
+
+    bool monoDisplay() const;
+    void setMonoDisplay(bool yes); // the left eye on the whole view, for a flat spectator screen
+
+    PanoramaView *frameSource() const;
+    void setFrameSource(PanoramaView *view); // render the frames of the view in another window, decoded once
+
+    int captureRate() const;
+    void setCaptureRate(int fps); // of the view capture into the shared memory ring, 0 is off
+
+    int captureWidth() const;
+    void setCaptureWidth(int pixels); // of the captured views, downscaled
+
+    int gpuBudget() const;
+    void setGpuBudget(int percent); // of the refresh interval, the view resolution is scaled to fit, 0 is off
+
+    qreal renderScale() const; // of the view resolution by the GPU budget
+    qreal photonLatency() const; // ms from an orientation change to the screen, for the pose prediction
+
+    bool gpuStats() const;
+    void setGpuStats(bool yes); // log and emit gpuStatsUpdated() of the GPU time per render stage
+
     QString graphicsApi() const;
     QString errorText() const;
+    QRhi *rhi() const; // of the scene graph, for the zero-copy video sink
+
+    void setOrientation(qreal pitch, qreal yaw); // without roll
+    void setVideoFrame(const QVideoFrame &frame) override;
+    void setTilePyramid(const QSharedPointer<TilePyramid> &tiles) override;
+    void setCachedFrame(const QSharedPointer<LoopCache> &cache, int index) override;
+    bool loopCacheSupported() const override;
+    QRhi *sinkRhi() const override;
+    void setRenderProfile(const RenderProfile &profile); // instead of the saved one of the GPU
+    void setFrameTiming(bool yes); // emit frameTimed() per rendered frame
+    QString glRenderer() const; // of the renderer once started, else empty
 
-    void setOrientation(qreal pitch, qreal yaw);
-    void setVideoFrame(const QVideoFrame &frame);
+    // The world-anchored overlays drawn in both eyes by the OpenGL renderer, placed by the yaw,
+    // pitch angles as the view orientation and the distance in meters, the id or -1 if failed
+    Q_INVOKABLE int addImageOverlay(const QUrl &source, qreal yaw, qreal pitch, qreal distance, qreal width);
+    Q_INVOKABLE int addTextOverlay(const QString &text, qreal yaw, qreal pitch, qreal distance, qreal height,
+                                   const QColor &color = QColor(Qt::white));
+    Q_INVOKABLE bool moveOverlay(int id, qreal yaw, qreal pitch, qreal distance);
+    Q_INVOKABLE bool removeOverlay(int id);
+    Q_INVOKABLE void clearOverlays();
 
 signals:
     void debugOpenGLChanged();
+    void zeroCopyChanged();
+    void rhiRendererChanged();
     void rotateDisplayChanged();
     void stereoShiftChanged();
-    void pitchAngleChanged();
-    void yawAngleChanged();
+    void stereoModeChanged();
+    void orientationChanged();
     void fovAngleChanged();
+    void coverageChanged();
+    void projectionChanged();
+    void cubemapPaddingChanged();
+    void monoDisplayChanged();
+    void frameSourceChanged();
+    void captureRateChanged();
+    void captureWidthChanged();
+    void gpuBudgetChanged();
+    void renderScaleChanged();
+    void photonLatencyChanged();
+    void gpuStatsChanged();
     void graphicsApiChanged();
     void errorTextChanged();
+    void rhiChanged(); // emitted from the render thread
+    void frameTimed(qint64 cpuTime, qint64 gpuTime); // ns of the render thread and of the GPU if known else -1
+    void gpuStatsUpdated(const QList<GpuTimer::Stats> &stats); // per VideoRenderer::GpuStage then the frame
 
 protected:
+    QSGNode *updatePaintNode(QSGNode *oldNode, UpdatePaintNodeData *data) override;
     void releaseResources() override;
     void keyPressEvent(QKeyEvent *event) override;
     void mousePressEvent(QMouseEvent *event) override;
@@ -77,19 +200,55 @@ protected:
 
 private:
     void setErrorText(const QString &text);
+    void setRenderScale(qreal scale);
+    void setPhotonLatency(qreal ms);
+    void updateWindow();
+    bool itemRendering() const; // the content by updatePaintNode()
+    void checkSoftwareProjection();
+    void checkFrameSource();
+    QSGNode *updateRhiNode(QSGNode *oldNode);
     void onWindowChanged(QQuickWindow *window);
     void onBeforeSynchronizing();
+    void onFrameSwapped();
     void onSceneGraphInvalidated();
 
     VideoRenderer *m_renderer;
+    SoftwareRenderer *m_softRenderer; // instead of m_renderer on the software scene graph
+    bool m_rhiRenderer;
+    bool m_rhiMode; // the RhiVideoRenderer node instead of m_renderer
     bool m_debugOpenGL;
+    bool m_zeroCopy;
+    QRhi *m_rhi;
     int m_rotateDisplay;
     qreal m_stereoShift;
-    qreal m_pitchAngle;
-    qreal m_yawAngle;
+    int m_stereoMode;
+    QQuaternion m_orientation;
     int m_fovAngle;
+    QRectF m_coverage;
+    int m_projection;
+    int m_cubemapPadding;
+    bool m_monoDisplay;
+    QPointer<PanoramaView> m_frameSource;
+    QSharedPointer<SharedFrame> m_frameShare; // created for the views having this one as the source
+    int m_captureRate;
+    int m_captureWidth;
+    int m_gpuBudget;
+    qreal m_renderScale;
+    PhotonLatency m_latency; // measured by the render thread
+    qreal m_photonLatency;
+    bool m_gpuStats;
     QString m_graphicsApi;
     QVideoFrame m_videoFrame;
+    QSharedPointer<TilePyramid> m_tilePyramid;
+    QSharedPointer<LoopCache> m_loopCache;
+    int m_cacheFrame;
+    bool m_etc2Frames; // by the renderer
+    QString m_glRenderer;
+    RenderProfile m_renderProfile;
+    bool m_profileFixed; // by setRenderProfile()
+    bool m_frameTiming;
+    OverlayAtlas m_overlayAtlas;
+    bool m_overlaysDirty;
     QString m_errorText;
 
     bool m_mousePress;
@@ -0,0 +1,30 @@
+#ifndef PARALLELSTRIPS_H
+#define PARALLELSTRIPS_H
+
+#include <QThreadPool>
+#include <QSemaphore>
+#include <QAtomicInt>
+
+// Call func(strip) for the strips 0..count-1 on the pool threads and the calling one,
+// each takes the next strip until none is left, returns when all of them are done
+template <class Func>
+void parallelStrips(QThreadPool *pool, int count, const Func &func)
+{
+    QAtomicInt next(0);
+    auto work = [&next, count, &func]() {
+        for (int strip; (strip = next.fetchAndAddRelaxed(1)) < count; )
+            func(strip);
+    };
+    QSemaphore done;
+    const int helpers = qMax(0, qMin(pool->maxThreadCount(), count) - 1);
+    for (int i = 0; i < helpers; i++) {
+        pool->start([&work, &done]() {
+            work();
+            done.release();
+        });
+    }
+    work();
+    done.acquire(helpers);
+}
+
+#endif // PARALLELSTRIPS_H
@@ -0,0 +1,45 @@
+#include "PhotonLatency.h"
+
+#include <QtMath>
+
+PhotonLatency::PhotonLatency()
+    : m_changed(0)
+    , m_synced(0)
+    , m_scanout(1e9 / 120.0)
+    , m_average(0.0)
+    , m_reported(0.0)
+{
+    m_clock.start();
+}
+
+void PhotonLatency::setRefreshRate(qreal hz)
+{
+    if (hz > 0.0) m_scanout = 1e9 / hz / 2.0;
+}
+
+void PhotonLatency::changed()
+{
+    if (!m_changed) m_changed = qMax(qint64(1), m_clock.nsecsElapsed());
+}
+
+void PhotonLatency::synchronized()
+{
+    m_synced = m_changed;
+    m_changed = 0;
+}
+
+bool PhotonLatency::swapped()
+{
+    if (!m_synced) return false;
+    const qreal latency = qreal(m_clock.nsecsElapsed() - m_synced) + m_scanout;
+    m_synced = 0;
+    m_average = m_average > 0.0 ? m_average * 0.9 + latency * 0.1 : latency;
+    if (qAbs(m_average - m_reported) <= m_reported * reportRatio) return false;
+    m_reported = m_average;
+    return true;
+}
+
+qreal PhotonLatency::latency() const
+{
+    return m_reported / 1e6;
+}
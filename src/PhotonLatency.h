@@ -0,0 +1,35 @@
+#ifndef PHOTONLATENCY_H
+#define PHOTONLATENCY_H
+
+#include <QElapsedTimer>
+
+/*
+ * The time from an orientation change of the view to its frame on the screen: the wait for
+ * the next frame, the render and swap, then half a refresh interval of the scanout on average.
+ * The head pose predictor extrapolates over it. The change is marked by the GUI thread, the
+ * synchronization and swap by the render thread, not concurrently with the GUI thread for the
+ * first and alone for the second.
+ */
+class PhotonLatency
+{
+public:
+    static constexpr qreal const reportRatio = 0.05; // of the latency to report a new one
+
+    PhotonLatency();
+
+    void setRefreshRate(qreal hz); // of the screen
+    void changed(); // the orientation of the next frame
+    void synchronized(); // the frame takes the orientation
+    bool swapped(); // the frame goes to the screen, true if latency() is worth reporting
+    qreal latency() const; // in ms, 0 until measured
+
+private:
+    QElapsedTimer m_clock;
+    qint64 m_changed; // ns of m_clock, 0 if none since the last frame
+    qint64 m_synced;
+    qreal m_scanout; // ns
+    qreal m_average;
+    qreal m_reported;
+};
+
+#endif // PHOTONLATENCY_H
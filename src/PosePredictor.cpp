@@ -0,0 +1,124 @@
+#include "PosePredictor.h"
+#include "SensorTrace.h"
+
+#include <QVector>
+#include <QVector3D>
+#include <QtMath>
+#include <QtDebug>
+
+#include <algorithm>
+#include <iterator>
+
+// The angle between the forward (x) axes of the sensor rotations in degree, the roll aside
+static qreal viewError(const QQuaternion &a, const QQuaternion &b)
+{
+    const QVector3D forward(1.0f, 0.0f, 0.0f);
+    const float dot = QVector3D::dotProduct(a.rotatedVector(forward), b.rotatedVector(forward));
+    return qRadiansToDegrees(qAcos(qBound(-1.0, qreal(dot), 1.0)));
+}
+
+PosePredictor::PosePredictor()
+    : m_maxHorizon(defaultMaxHorizon)
+    , m_maxAngle(defaultMaxAngle)
+{
+}
+
+void PosePredictor::setMaxHorizon(int ms)
+{
+    m_maxHorizon = qBound(0, ms, 500);
+}
+
+void PosePredictor::setMaxAngle(qreal degree)
+{
+    m_maxAngle = qBound(0.0, degree, 90.0);
+}
+
+QQuaternion PosePredictor::predict(const QQuaternion &rotation, const float *rates, qint64 horizon) const
+{
+    horizon = qMin(horizon, qint64(m_maxHorizon) * 1000);
+    if (horizon <= 0 || !rates || m_maxAngle <= 0.0) return rotation;
+
+    // The body rates turn about the body axis, applied on the right
+    const QVector3D rate(rates[0], rates[1], rates[2]);
+    const float speed = rate.length();
+    if (speed <= 0.0f) return rotation;
+    const qreal angle = qMin(speed * horizon / 1e6, m_maxAngle);
+    return rotation * QQuaternion::fromAxisAndAngle(rate / speed, float(angle));
+}
+
+struct ErrorStats
+{
+    qreal mean = 0.0;
+    qreal p99 = 0.0;
+};
+
+static ErrorStats errorStats(QVector<qreal> &errors)
+{
+    ErrorStats stats;
+    if (errors.isEmpty()) return stats;
+    qreal sum = 0.0;
+    for (qreal error : errors) sum += error;
+    stats.mean = sum / errors.size();
+    const int rank = qMin(int(errors.size()) - 1, int((errors.size() * 99 + 99) / 100) - 1); // the nearest rank
+    std::nth_element(errors.begin(), errors.begin() + rank, errors.end());
+    stats.p99 = errors.at(rank);
+    return stats;
+}
+
+//static
+int PosePredictor::benchmark(const QString &traceFile, int maxHorizon, qreal maxAngle)
+{
+    SensorTrace trace;
+    if (!trace.load(traceFile)) return 1;
+    static const int latencies[] = { 10, 20, 30, 40, 50, 60, 80, 100 }; // ms
+    const int maxLag = 2 * latencies[std::size(latencies) - 1];
+    if (trace.duration() < maxLag * 2000) {
+        qCritical().noquote() << "The trace is too short:" << traceFile;
+        return 1;
+    }
+    const qint64 lastTime = trace.sample(trace.size() - 1).timestamp;
+    qInfo().noquote() << QString("Pose prediction of %1: %2 samples at %3 Hz, clamped to %4 ms and %5 degree")
+                         .arg(traceFile).arg(trace.size()).arg(trace.rate(), 0, 'f', 1).arg(maxHorizon).arg(maxAngle, 0, 'f', 1);
+
+    // The mean error of the late samples as shown without prediction, by the lag in ms
+    QVector<qreal> lagErrors(maxLag + 1);
+    QVector<qreal> errors;
+    errors.reserve(trace.size());
+    for (int lag = 0; lag <= maxLag; lag++) {
+        errors.clear();
+        int index = 0;
+        for (int i = 0; i < trace.size(); i++) {
+            const qint64 time = trace.sample(i).timestamp + lag * 1000;
+            if (time > lastTime) break;
+            errors.append(viewError(trace.rotation(i), trace.rotationAt(time, index)));
+        }
+        lagErrors[lag] = errorStats(errors).mean;
+    }
+
+    PosePredictor predictor;
+    predictor.setMaxHorizon(maxHorizon);
+    predictor.setMaxAngle(maxAngle);
+    qInfo().noquote() << "latency   without: mean    p99   predicted: mean    p99   latency saved";
+    for (int latency : latencies) {
+        QVector<qreal> late, predicted;
+        int index = 0;
+        for (int i = 0; i < trace.size(); i++) {
+            const qint64 time = trace.sample(i).timestamp + latency * 1000;
+            if (time > lastTime) break;
+            const QQuaternion truth = trace.rotationAt(time, index);
+            late.append(viewError(trace.rotation(i), truth));
+            predicted.append(viewError(predictor.predict(trace.rotation(i), trace.sample(i).gyro, latency * 1000), truth));
+        }
+        const ErrorStats lateStats = errorStats(late), predictedStats = errorStats(predicted);
+
+        // The lag of the same error without prediction, the latency minus it is saved
+        int lag = 0;
+        while (lag < maxLag && lagErrors.at(lag) < predictedStats.mean) lag++;
+        qInfo().noquote() << QString("%1 ms    %2 %3         %4 %5   %6 ms")
+                             .arg(latency, 3)
+                             .arg(lateStats.mean, 8, 'f', 3).arg(lateStats.p99, 6, 'f', 2)
+                             .arg(predictedStats.mean, 8, 'f', 3).arg(predictedStats.p99, 6, 'f', 2)
+                             .arg(latency - lag, 4);
+    }
+    return 0;
+}
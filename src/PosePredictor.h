@@ -0,0 +1,41 @@
+#ifndef POSEPREDICTOR_H
+#define POSEPREDICTOR_H
+
+#include <QString>
+#include <QQuaternion>
+
+/*
+ * The head pose at the photon time of the frame, extrapolated from the last sensor sample by
+ * its gyro rates: the angular velocity of the body axes held constant over the horizon turns
+ * the orientation about its own axis, exactly and without the gimbal lock of the Euler rates.
+ * The horizon and the extrapolated angle are clamped, a long horizon amplifies the gyro noise
+ * more than it saves.
+ */
+class PosePredictor
+{
+public:
+    static constexpr int const defaultMaxHorizon = 50; // ms
+    static constexpr qreal const defaultMaxAngle = 10.0; // degree
+
+    PosePredictor();
+
+    int maxHorizon() const { return m_maxHorizon; }
+    void setMaxHorizon(int ms); // 0 is off
+
+    qreal maxAngle() const { return m_maxAngle; }
+    void setMaxAngle(qreal degree); // of the turn from the sample
+
+    // The rotation of the body axes after the horizon in us, the rates are of the same x, y
+    // and z axes in degree/s
+    QQuaternion predict(const QQuaternion &rotation, const float *rates, qint64 horizon) const;
+
+    // Replays a trace of panoramatracker --record against its own later samples, the error of
+    // the prediction and the latency it saves by the latency to cover, 0 if done
+    static int benchmark(const QString &traceFile, int maxHorizon, qreal maxAngle);
+
+private:
+    int m_maxHorizon;
+    qreal m_maxAngle;
+};
+
+#endif // POSEPREDICTOR_H
@@ -0,0 +1,240 @@
+#include "PoseRing.h"
+
+#include <QtDebug>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <new>
+
+//#define TRACE_POSERING
+#ifdef  TRACE_POSERING
+#include <QTime>
+#include <QThread>
+#define TRACE()      qDebug() << QTime::currentTime().toString("hh:mm:ss.zzz") << QThread::currentThreadId() << Q_FUNC_INFO;
+#define TRACE_ARG(x) qDebug() << QTime::currentTime().toString("hh:mm:ss.zzz") << QThread::currentThreadId() << Q_FUNC_INFO << x;
+#else
+#define TRACE()
+#define TRACE_ARG(x)
+#endif
+
+static constexpr size_t poseSlotOffset = (sizeof(PoseRingHeader) + 63) & ~size_t(63);
+static constexpr size_t poseSlotStride = (sizeof(PoseSlot) + 63) & ~size_t(63); // a cache line each
+static constexpr size_t poseRingSize = poseSlotOffset + poseSlotStride * PoseRing::slotCount;
+
+PoseRing::PoseRing()
+    : m_header(nullptr)
+    , m_slots(nullptr)
+    , m_fd(-1)
+    , m_writer(false)
+    , m_serial(0)
+{
+}
+
+PoseRing::~PoseRing()
+{
+    close();
+}
+
+bool PoseRing::create()
+{
+    TRACE();
+    close();
+
+    // A stale object of a crashed daemon is replaced, the readers reopen by the name
+    shm_unlink(poseRingName);
+    int fd = shm_open(poseRingName, O_RDWR | O_CREAT | O_EXCL, 0666);
+    if (fd < 0) {
+        qWarning() << Q_FUNC_INFO << "Can't create shared memory" << poseRingName << strerror(errno);
+        return false;
+    }
+    fchmod(fd, 0666); // the readers request the calibration, whatever the umask
+    if (ftruncate(fd, off_t(poseRingSize)) != 0) {
+        qWarning() << Q_FUNC_INFO << "Can't resize shared memory" << poseRingName << strerror(errno);
+        ::close(fd);
+        shm_unlink(poseRingName);
+        return false;
+    }
+    void *data = mmap(nullptr, poseRingSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        qWarning() << Q_FUNC_INFO << "Can't map shared memory" << poseRingName << strerror(errno);
+        shm_unlink(poseRingName);
+        return false;
+    }
+
+    // The new object is zero filled, the atomics are constructed in place
+    auto header = new (data) PoseRingHeader;
+    header->slotCount = slotCount;
+    header->slotOffset = uint32_t(poseSlotOffset);
+    header->slotStride = uint32_t(poseSlotStride);
+    header->latest.store(0, std::memory_order_relaxed);
+    header->writerTime.store(monotonicTime(), std::memory_order_relaxed);
+    header->calibrateRequest.store(0, std::memory_order_relaxed);
+    header->compassRequest.store(-1, std::memory_order_relaxed);
+    for (int i = 0; i < slotCount; i++) {
+        auto slot = new (static_cast<char *>(data) + poseSlotOffset + poseSlotStride * i) PoseSlot;
+        slot->sequence.store(0, std::memory_order_relaxed);
+    }
+    header->version = poseRingVersion;
+    std::atomic_thread_fence(std::memory_order_release);
+    header->magic = poseRingMagic;
+
+    m_header = header;
+    m_slots = reinterpret_cast<PoseSlot *>(static_cast<char *>(data) + poseSlotOffset);
+    m_writer = true;
+    m_serial = 0;
+    TRACE_ARG("Created" << poseRingName << poseRingSize << "bytes");
+    return true;
+}
+
+bool PoseRing::attach()
+{
+    int fd = shm_open(poseRingName, O_RDWR, 0);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || size_t(st.st_size) < poseRingSize) {
+        ::close(fd); // not sized yet by the daemon
+        return false;
+    }
+    void *data = mmap(nullptr, poseRingSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+        qWarning() << Q_FUNC_INFO << "Can't map shared memory" << poseRingName << strerror(errno);
+        ::close(fd);
+        return false;
+    }
+    auto header = static_cast<PoseRingHeader *>(data);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const int64_t time = header->writerTime.load(std::memory_order_relaxed);
+    if (header->magic != poseRingMagic || header->version != poseRingVersion ||
+            header->slotCount != uint32_t(slotCount) || header->slotOffset != poseSlotOffset ||
+            header->slotStride != poseSlotStride || monotonicTime() - time >= writerTimeout * 1000) {
+        munmap(data, poseRingSize);
+        ::close(fd);
+        return false;
+    }
+
+    close();
+    m_header = header;
+    m_slots = reinterpret_cast<PoseSlot *>(static_cast<char *>(data) + poseSlotOffset);
+    m_fd = fd;
+    m_writer = false;
+    TRACE_ARG("Attached" << poseRingName << header->latest.load(std::memory_order_relaxed));
+    return true;
+}
+
+void PoseRing::close()
+{
+    if (!m_header) return;
+    TRACE_ARG(m_writer);
+    munmap(m_header, poseRingSize);
+    if (m_writer) shm_unlink(poseRingName);
+    if (m_fd >= 0) ::close(m_fd);
+    m_header = nullptr;
+    m_slots = nullptr;
+    m_fd = -1;
+    m_writer = false;
+}
+
+int64_t PoseRing::monotonicTime()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return int64_t(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+void PoseRing::publish(const Pose &pose)
+{
+    if (!m_header || !m_writer) return;
+    const uint64_t serial = ++m_serial;
+    auto slot = reinterpret_cast<PoseSlot *>(reinterpret_cast<char *>(m_slots) + poseSlotStride * (serial % slotCount));
+
+    // Seqlock: odd while written, the readers drop the copies made meanwhile
+    const uint64_t sequence = slot->sequence.load(std::memory_order_relaxed);
+    slot->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot->serial = serial;
+    slot->timestamp = pose.timestamp;
+    memcpy(slot->quat, pose.quat, sizeof(slot->quat));
+    memcpy(slot->rates, pose.rates, sizeof(slot->rates));
+    memcpy(slot->gravity, pose.gravity, sizeof(slot->gravity));
+    memcpy(slot->mag, pose.mag, sizeof(slot->mag));
+    slot->flags = pose.flags;
+    slot->sequence.store(sequence + 2, std::memory_order_release);
+    m_header->latest.store(serial, std::memory_order_release);
+    m_header->writerTime.store(monotonicTime(), std::memory_order_relaxed);
+}
+
+void PoseRing::heartbeat()
+{
+    if (m_header && m_writer)
+        m_header->writerTime.store(monotonicTime(), std::memory_order_relaxed);
+}
+
+uint32_t PoseRing::calibrateRequest() const
+{
+    return m_header ? m_header->calibrateRequest.load(std::memory_order_relaxed) : 0;
+}
+
+int PoseRing::takeCompassRequest()
+{
+    return m_header ? m_header->compassRequest.exchange(-1, std::memory_order_relaxed) : -1;
+}
+
+bool PoseRing::isLive() const
+{
+    if (!m_header) return false;
+    if (m_writer) return true;
+    const int64_t time = m_header->writerTime.load(std::memory_order_relaxed);
+    if (monotonicTime() - time >= writerTimeout * 1000) return false;
+    struct stat st;
+    return (fstat(m_fd, &st) == 0 && st.st_nlink > 0); // else unlinked, a new daemon is starting
+}
+
+uint64_t PoseRing::latest() const
+{
+    return m_header ? m_header->latest.load(std::memory_order_acquire) : 0;
+}
+
+bool PoseRing::read(Pose *pose) const
+{
+    if (!m_header) return false;
+    const uint64_t serial = m_header->latest.load(std::memory_order_acquire);
+    return serial && read(serial, pose);
+}
+
+bool PoseRing::read(uint64_t serial, Pose *pose) const
+{
+    if (!m_header || !serial) return false;
+    auto slot = reinterpret_cast<const PoseSlot *>(reinterpret_cast<const char *>(m_slots) + poseSlotStride * (serial % slotCount));
+    const uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+    if (sequence & 1) return false;
+    Pose copy;
+    copy.serial = slot->serial;
+    copy.timestamp = slot->timestamp;
+    memcpy(copy.quat, slot->quat, sizeof(copy.quat));
+    memcpy(copy.rates, slot->rates, sizeof(copy.rates));
+    memcpy(copy.gravity, slot->gravity, sizeof(copy.gravity));
+    memcpy(copy.mag, slot->mag, sizeof(copy.mag));
+    copy.flags = slot->flags;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot->sequence.load(std::memory_order_relaxed) != sequence || copy.serial != serial) return false;
+    *pose = copy;
+    return true;
+}
+
+void PoseRing::requestCalibrate()
+{
+    if (m_header && !m_writer)
+        m_header->calibrateRequest.fetch_add(1, std::memory_order_relaxed);
+}
+
+void PoseRing::requestCompass(bool yes)
+{
+    if (m_header && !m_writer)
+        m_header->compassRequest.store(yes ? 1 : 0, std::memory_order_relaxed);
+}
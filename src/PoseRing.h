@@ -0,0 +1,114 @@
+#ifndef POSERING_H
+#define POSERING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * The POSIX shared memory ring of the head orientation samples published by the tracker
+ * daemon (panoramatracker) which keeps the sensor port open, for the player and the other
+ * local processes. The layout below is the interface, a reader maps the whole object of
+ * poseRingName read-write and polls header.latest at any rate:
+ *
+ *   1. the object is live while header.writerTime, the CLOCK_MONOTONIC time in us stored by
+ *      the daemon on every sample and at least every heartbeatInterval, is within writerTimeout;
+ *      a restarted daemon unlinks the object and creates a new one, reopen by the name then
+ *   2. the slot of the sample serial is (serial % slotCount) at slotOffset + index * slotStride
+ *   3. read slot.sequence, skip the slot if it is odd (being written), copy it, then read
+ *      slot.sequence again and drop the copy if it has changed (seqlock)
+ *   4. header.calibrateRequest incremented by a reader starts the magnetometer calibration,
+ *      header.compassRequest set to 0 or 1 switches the magnetic field fusion (-1 is none)
+ *
+ * The orientation is the raw unit quaternion of the sensor axes (z up), the readers map and
+ * filter it as they need, with the raw gyro rates, gravity and magnetic field of the sample
+ * if the flags tell so. The readers may take every sample of the last slotCount by serial.
+ */
+
+static constexpr const char *poseRingName = "/panoramaplay-pose";
+static constexpr uint32_t poseRingMagic = 0x52505650; // "PVPR"
+static constexpr uint32_t poseRingVersion = 4;
+static constexpr uint32_t poseCalibrating = 0x1; // PoseSlot::flags
+static constexpr uint32_t poseRates       = 0x2; // rates are reported
+static constexpr uint32_t poseGravity     = 0x4; // gravity is reported
+static constexpr uint32_t poseMag         = 0x8; // mag is reported
+
+struct PoseRingHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slotCount;
+    uint32_t slotOffset; // of the first slot from the header in bytes
+    uint32_t slotStride; // in bytes
+    uint32_t reserved;
+    std::atomic<uint64_t> latest; // serial of the last published sample, 0 if none
+    std::atomic<int64_t> writerTime; // CLOCK_MONOTONIC us of the last sample or heartbeat, by the daemon
+    std::atomic<uint32_t> calibrateRequest; // incremented by the readers
+    std::atomic<int32_t> compassRequest; // 0 or 1 by the readers, -1 once taken by the daemon
+};
+
+struct PoseSlot
+{
+    std::atomic<uint64_t> sequence; // odd while the slot is written
+    uint64_t serial;
+    int64_t timestamp; // CLOCK_MONOTONIC us of the reception
+    float quat[4]; // w, x, y, z
+    float rates[3]; // of the x, y, z gyro axes in degree/s
+    float gravity[3]; // the acceleration with gravity in m/s2
+    float mag[3]; // uT
+    uint32_t flags;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "The ring is shared by processes, the atomics must be lock-free");
+
+class PoseRing
+{
+public:
+    static constexpr int const slotCount = 64;
+    static constexpr int const heartbeatInterval = 100; // ms
+    static constexpr int const writerTimeout = 500; // ms
+
+    struct Pose {
+        uint64_t serial = 0;
+        int64_t timestamp = 0;
+        float quat[4] = { 1.0f, 0.0f, 0.0f, 0.0f };
+        float rates[3] = { 0.0f, 0.0f, 0.0f };
+        float gravity[3] = { 0.0f, 0.0f, 0.0f };
+        float mag[3] = { 0.0f, 0.0f, 0.0f };
+        uint32_t flags = 0;
+    };
+
+    PoseRing();
+    ~PoseRing();
+
+    bool create(); // by the daemon, replaces the object of poseRingName
+    bool attach(); // by a reader, the live object of poseRingName if any
+    void close();
+    bool isOpen() const { return m_header != nullptr; }
+    bool isWriter() const { return m_writer; }
+
+    static int64_t monotonicTime(); // in us as the ring stores
+
+    // The daemon
+    void publish(const Pose &pose); // the serial is assigned
+    void heartbeat();
+    uint32_t calibrateRequest() const;
+    int takeCompassRequest(); // 0 or 1 if requested since, else -1
+
+    // The readers
+    bool isLive() const; // the daemon runs and the object is still the current one
+    uint64_t latest() const;
+    bool read(Pose *pose) const; // the latest sample, false if none or torn
+    bool read(uint64_t serial, Pose *pose) const; // false if overwritten or torn
+    void requestCalibrate();
+    void requestCompass(bool yes);
+
+private:
+    PoseRingHeader *m_header;
+    PoseSlot *m_slots;
+    int m_fd; // of a reader, to see the object unlinked by a restarted daemon
+    bool m_writer;
+    uint64_t m_serial;
+};
+
+#endif // POSERING_H
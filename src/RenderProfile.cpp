@@ -0,0 +1,59 @@
+#include "RenderProfile.h"
+
+#include <QSettings>
+#include <QUrl>
+
+static QString settingsGroup(const QString &glRenderer)
+{
+    // The renderer strings have slashes and spaces, e.g. "Mesa DRI Intel(R) UHD Graphics (CML GT2)"
+    return QStringLiteral("RenderProfiles/") + QString::fromLatin1(QUrl::toPercentEncoding(glRenderer));
+}
+
+QString RenderProfile::toString() const
+{
+    return QStringLiteral("textures %1, frame mipmaps %2, view mipmaps %3")
+            .arg(compactTextures ? "10 bits" : "16 bits")
+            .arg(frameMipmaps ? "on" : "off")
+            .arg(viewMipmaps ? "on" : "off");
+}
+
+QList<RenderProfile> RenderProfile::candidates(bool openGLES)
+{
+    QList<RenderProfile> list;
+    for (int compact = openGLES ? 1 : 0; compact < 2; compact++) {
+        for (int frameMips = 1; frameMips >= 0; frameMips--) {
+            for (int viewMips = 1; viewMips >= 0; viewMips--) {
+                RenderProfile profile;
+                profile.compactTextures = compact;
+                profile.frameMipmaps = frameMips;
+                profile.viewMipmaps = viewMips;
+                list.append(profile);
+            }
+        }
+    }
+    return list;
+}
+
+RenderProfile RenderProfile::load(const QString &glRenderer, bool *found)
+{
+    RenderProfile profile;
+    QSettings settings;
+    settings.beginGroup(settingsGroup(glRenderer));
+    if (found) *found = settings.contains(QStringLiteral("compactTextures"));
+    profile.compactTextures = settings.value(QStringLiteral("compactTextures"), profile.compactTextures).toBool();
+    profile.frameMipmaps = settings.value(QStringLiteral("frameMipmaps"), profile.frameMipmaps).toBool();
+    profile.viewMipmaps = settings.value(QStringLiteral("viewMipmaps"), profile.viewMipmaps).toBool();
+    return profile;
+}
+
+void RenderProfile::save(const QString &glRenderer, qint64 cpuTime, qint64 gpuTime) const
+{
+    QSettings settings;
+    settings.beginGroup(settingsGroup(glRenderer));
+    settings.setValue(QStringLiteral("glRenderer"), glRenderer);
+    settings.setValue(QStringLiteral("compactTextures"), compactTextures);
+    settings.setValue(QStringLiteral("frameMipmaps"), frameMipmaps);
+    settings.setValue(QStringLiteral("viewMipmaps"), viewMipmaps);
+    settings.setValue(QStringLiteral("cpuTime"), cpuTime); // for the reference only
+    settings.setValue(QStringLiteral("gpuTime"), gpuTime);
+}
@@ -0,0 +1,32 @@
+#ifndef RENDERPROFILE_H
+#define RENDERPROFILE_H
+
+#include <QString>
+#include <QList>
+
+/*
+ * The pipeline configuration of VideoRenderer which performs differently by the GPU and
+ * driver, chosen by the --tune run of RenderTuner and saved per GL_RENDERER string into the
+ * settings, then loaded by PanoramaView when its renderer starts on the same GPU.
+ */
+struct RenderProfile
+{
+    bool compactTextures = false; // RGB10_A2 frame and view textures instead of 16 bits, always on OpenGLES
+    bool frameMipmaps = true; // of the converted frame, for the reduced view resolution
+    bool viewMipmaps = true; // of the view texture, trilinear display and capture
+
+    bool operator==(const RenderProfile &other) const {
+        return compactTextures == other.compactTextures && frameMipmaps == other.frameMipmaps &&
+               viewMipmaps == other.viewMipmaps;
+    }
+    bool operator!=(const RenderProfile &other) const { return !(*this == other); }
+
+    QString toString() const;
+    static QList<RenderProfile> candidates(bool openGLES); // all to try by the tuner
+
+    // The settings by the GL renderer, the defaults if none has been saved
+    static RenderProfile load(const QString &glRenderer, bool *found = nullptr);
+    void save(const QString &glRenderer, qint64 cpuTime, qint64 gpuTime) const; // the measured ns per frame
+};
+
+#endif // RENDERPROFILE_H
@@ -0,0 +1,151 @@
+#include "RenderTuner.h"
+#include "PanoramaView.h"
+
+#include <QOpenGLContext>
+#include <QSurfaceFormat>
+#include <QVideoFrameFormat>
+#include <QtDebug>
+
+#include <algorithm>
+
+//#define TRACE_RENDERTUNER
+#ifdef  TRACE_RENDERTUNER
+#include <QTime>
+#include <QThread>
+#define TRACE()      qDebug() << QTime::currentTime().toString("hh:mm:ss.zzz") << QThread::currentThreadId() << Q_FUNC_INFO;
+#define TRACE_ARG(x) qDebug() << QTime::currentTime().toString("hh:mm:ss.zzz") << QThread::currentThreadId() << Q_FUNC_INFO << x;
+#else
+#define TRACE()
+#define TRACE_ARG(x)
+#endif
+
+// The synthetic frames have detail at all scales for the mipmaps, different per frame
+static QVideoFrame tuneFrame(int phase)
+{
+    QVideoFrameFormat format(QSize(RenderTuner::frameWidth, RenderTuner::frameHeight), QVideoFrameFormat::Format_NV12);
+    format.setColorSpace(QVideoFrameFormat::ColorSpace_BT709);
+    format.setColorRange(QVideoFrameFormat::ColorRange_Video);
+    QVideoFrame frame(format);
+    if (!frame.map(QVideoFrame::WriteOnly)) return QVideoFrame();
+    for (int row = 0; row < format.frameHeight(); row++) {
+        uchar *line = frame.bits(0) + row * frame.bytesPerLine(0);
+        for (int x = 0; x < format.frameWidth(); x++)
+            line[x] = uchar(16 + ((x ^ row) + phase * 37) % 220);
+    }
+    for (int row = 0; row < format.frameHeight() / 2; row++) {
+        uchar *line = frame.bits(1) + row * frame.bytesPerLine(1);
+        for (int x = 0; x < format.frameWidth() / 2; x++) {
+            line[2 * x] = uchar(64 + (x * 128 / (format.frameWidth() / 2) + phase * 16) % 128);
+            line[2 * x + 1] = uchar(64 + (row * 128 / (format.frameHeight() / 2)) % 128);
+        }
+    }
+    frame.unmap();
+    return frame;
+}
+
+static qint64 median(QVector<qint64> &values)
+{
+    if (values.isEmpty()) return -1;
+    std::nth_element(values.begin(), values.begin() + values.size() / 2, values.end());
+    return values.at(values.size() / 2);
+}
+
+RenderTuner::RenderTuner(PanoramaView *view, QObject *parent)
+    : QObject(parent)
+    , m_view(view)
+    , m_profile(0)
+    , m_frame(0)
+{
+    Q_ASSERT(m_view);
+    m_stallTimer.setSingleShot(true);
+    m_stallTimer.setInterval(stallTimeout);
+    connect(&m_stallTimer, &QTimer::timeout, this, &RenderTuner::onStalled);
+    connect(m_view, &PanoramaView::frameTimed, this, &RenderTuner::onFrameTimed);
+}
+
+void RenderTuner::start()
+{
+    TRACE();
+    m_frames[0] = tuneFrame(0);
+    m_frames[1] = tuneFrame(1);
+    if (!m_frames[0].isValid() || !m_frames[1].isValid()) {
+        qCritical() << Q_FUNC_INFO << "Can't create the synthetic frames";
+        emit finished(false);
+        return;
+    }
+    const bool openGLES = (QSurfaceFormat::defaultFormat().renderableType() == QSurfaceFormat::OpenGLES ||
+                           QOpenGLContext::openGLModuleType() == QOpenGLContext::LibGLES);
+    m_profiles = RenderProfile::candidates(openGLES);
+    m_profile = m_frame = 0;
+    m_results.clear();
+    m_view->setStereoMode(PanoramaView::StereoMono);
+    m_view->setRenderProfile(m_profiles.first());
+    m_view->setFrameTiming(true);
+    m_stallTimer.start();
+    nextFrame();
+}
+
+void RenderTuner::nextFrame()
+{
+    // Looking around at a steady pace as the head does, a new frame every time
+    const qreal yaw = qreal((m_frame * 3) % 360) - 180.0;
+    m_view->setOrientation(15.0 * ((m_frame / 60) % 2 ? 1 : -1), yaw);
+    m_view->setVideoFrame(m_frames[m_frame % 2]);
+}
+
+void RenderTuner::onFrameTimed(qint64 cpuTime, qint64 gpuTime)
+{
+    if (m_profile >= m_profiles.size()) return;
+    m_stallTimer.start();
+    if (m_frame >= warmupFrames) {
+        m_cpuTimes.append(cpuTime);
+        if (gpuTime >= 0) m_gpuTimes.append(gpuTime);
+    }
+    if (++m_frame >= warmupFrames + measureFrames) {
+        Result result;
+        result.profile = m_profiles.at(m_profile);
+        result.cpuTime = median(m_cpuTimes);
+        result.gpuTime = median(m_gpuTimes);
+        m_results.append(result);
+        qInfo().noquote() << QString("%1: CPU %2 us, GPU %3 us per frame")
+                             .arg(result.profile.toString(), -50)
+                             .arg(result.cpuTime / 1000.0, 0, 'f', 1)
+                             .arg(result.gpuTime >= 0 ? QString::number(result.gpuTime / 1000.0, 'f', 1) : QStringLiteral("n/a"));
+        m_cpuTimes.clear();
+        m_gpuTimes.clear();
+        m_frame = 0;
+        if (++m_profile >= m_profiles.size()) {
+            finish();
+            return;
+        }
+        m_view->setRenderProfile(m_profiles.at(m_profile));
+    }
+    nextFrame();
+}
+
+void RenderTuner::onStalled()
+{
+    qCritical() << Q_FUNC_INFO << "No frames rendered for" << stallTimeout << "ms, the OpenGL renderer is required";
+    m_profile = m_profiles.size();
+    emit finished(false);
+}
+
+void RenderTuner::finish()
+{
+    m_stallTimer.stop();
+    m_view->setFrameTiming(false);
+    const QString glRenderer = m_view->glRenderer();
+    if (m_results.isEmpty() || glRenderer.isEmpty()) {
+        emit finished(false);
+        return;
+    }
+
+    // The CPU and GPU work of a frame overlap, the slower one limits the frame rate,
+    // the other one breaks the ties
+    auto cost = [](const Result &r) { return qMakePair(qMax(r.cpuTime, r.gpuTime), r.cpuTime + qMax(r.gpuTime, qint64(0))); };
+    const auto best = std::min_element(m_results.cbegin(), m_results.cend(),
+                                       [&cost](const Result &a, const Result &b) { return cost(a) < cost(b); });
+    best->profile.save(glRenderer, best->cpuTime, best->gpuTime);
+    qInfo().noquote() << "Render profile of" << glRenderer << "saved -" << best->profile.toString();
+    emit finished(true);
+}
@@ -0,0 +1,58 @@
+#ifndef RENDERTUNER_H
+#define RENDERTUNER_H
+
+#include <QObject>
+#include <QPointer>
+#include <QVideoFrame>
+#include <QVector>
+#include <QList>
+#include <QTimer>
+
+#include "RenderProfile.h"
+
+class PanoramaView;
+
+/*
+ * The --tune run: renders a synthetic 4K NV12 clip looking around by PanoramaView under each
+ * candidate RenderProfile, measures the CPU time of the render thread and the GPU time per
+ * frame, then saves the fastest profile for the GL renderer and finishes.
+ */
+class RenderTuner : public QObject
+{
+    Q_OBJECT
+public:
+    static constexpr int const frameWidth = 3840;
+    static constexpr int const frameHeight = 1920;
+    static constexpr int const warmupFrames = 30; // after a profile change, beyond the GPU timer latency
+    static constexpr int const measureFrames = 120;
+    static constexpr int const stallTimeout = 5000; // ms without a rendered frame to give up
+
+    explicit RenderTuner(PanoramaView *view, QObject *parent = nullptr);
+
+    void start();
+
+signals:
+    void finished(bool ok);
+
+private:
+    struct Result {
+        RenderProfile profile;
+        qint64 cpuTime; // median ns per frame
+        qint64 gpuTime; // or -1 if unknown
+    };
+    void nextFrame();
+    void onFrameTimed(qint64 cpuTime, qint64 gpuTime);
+    void onStalled();
+    void finish();
+
+    QPointer<PanoramaView> m_view;
+    QVideoFrame m_frames[2];
+    QList<RenderProfile> m_profiles;
+    int m_profile; // being measured
+    int m_frame; // of the profile
+    QVector<qint64> m_cpuTimes, m_gpuTimes;
+    QVector<Result> m_results;
+    QTimer m_stallTimer;
+};
+
+#endif // RENDERTUNER_H
@@ -0,0 +1,59 @@
+#include "ResolutionScaler.h"
+
+#include <QtMath>
+
+ResolutionScaler::ResolutionScaler()
+    : m_budget(0)
+    , m_scale(1.0)
+    , m_average(0.0)
+    , m_over(0)
+    , m_under(0)
+{
+}
+
+void ResolutionScaler::setBudget(qint64 nsecs)
+{
+    m_budget = qMax(qint64(0), nsecs);
+    m_over = m_under = 0;
+    m_average = 0.0;
+    if (!m_budget) m_scale = 1.0;
+}
+
+bool ResolutionScaler::update(qint64 nsecs)
+{
+    if (!m_budget || nsecs <= 0) return false;
+    m_average = m_average > 0.0 ? m_average * 0.8 + nsecs * 0.2 : nsecs;
+
+    // The cost is about the pixel count, the square of the scale
+    qreal scale = m_scale;
+    if (m_average > m_budget) {
+        m_under = 0;
+        if (++m_over >= overFrames) {
+            m_over = 0;
+            const qreal target = m_scale * qSqrt(m_budget / m_average);
+            scale = qMin(m_scale - scaleStep, std::floor(target / scaleStep) * scaleStep);
+        }
+    } else if (m_average < m_budget * underRatio && m_scale < 1.0) {
+        m_over = 0;
+        if (++m_under >= underFrames) {
+            m_under = 0;
+            const qreal up = m_scale + scaleStep;
+            if (m_average * (up * up) / (m_scale * m_scale) < m_budget * 0.9)
+                scale = up;
+        }
+    } else {
+        m_over = m_under = 0;
+    }
+    scale = qBound(minScale, scale, 1.0);
+    if (qFuzzyCompare(scale, m_scale)) return false;
+
+    // The time of the previous scale doesn't apply anymore
+    m_average *= (scale * scale) / (m_scale * m_scale);
+    m_scale = scale;
+    return true;
+}
+
+float ResolutionScaler::mipBias() const
+{
+    return m_scale < 1.0 ? float(std::log2(m_scale)) : 0.0f;
+}
@@ -0,0 +1,37 @@
+#ifndef RESOLUTIONSCALER_H
+#define RESOLUTIONSCALER_H
+
+#include <QtGlobal>
+
+/*
+ * The dynamic resolution controller of VideoRenderer: the scale of the view texture by the
+ * GPU time of the view and display passes against the per-frame budget. The scale drops
+ * quickly once the time stays over the budget and rises slowly while it stays well under,
+ * in steps, so the view texture is not reallocated every frame.
+ */
+class ResolutionScaler
+{
+public:
+    static constexpr qreal const minScale = 0.5;
+    static constexpr qreal const scaleStep = 0.05;
+    static constexpr int const overFrames = 3; // over the budget to scale down
+    static constexpr int const underFrames = 60; // well under the budget to scale up
+    static constexpr qreal const underRatio = 0.75; // of the budget
+
+    ResolutionScaler();
+
+    void setBudget(qint64 nsecs); // per frame, 0 is off and the scale is 1
+    qint64 budget() const { return m_budget; }
+
+    bool update(qint64 nsecs); // the GPU time of a frame, true if the scale changed
+    qreal scale() const { return m_scale; }
+    float mipBias() const; // the LOD bias keeping the texture detail of the full resolution
+
+private:
+    qint64 m_budget;
+    qreal m_scale;
+    qreal m_average; // of the GPU time in ns
+    int m_over, m_under;
+};
+
+#endif // RESOLUTIONSCALER_H
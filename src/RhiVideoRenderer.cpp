@@ -0,0 +1,801 @@
+#include "RhiVideoRenderer.h"
+
+#include <QQuickWindow>
+#include <QQuaternion>
+#include <QImage>
+#include <QFile>
+#include <QVarLengthArray>
+#include <QtMath>
+#include <rhi/qrhi.h>
+#include <QtDebug>
+
+#include <cstring>
+
+//#define TRACE_RHIVIDEORENDERER
+#ifdef  TRACE_RHIVIDEORENDERER
+#include <QTime>
+#include <QThread>
+#define TRACE()      qDebug() << QTime::currentTime().toString("hh:mm:ss.zzz") << QThread::currentThreadId() << Q_FUNC_INFO;
+#define TRACE_ARG(x) qDebug() << QTime::currentTime().toString("hh:mm:ss.zzz") << QThread::currentThreadId() << Q_FUNC_INFO << x;
+#else
+#define TRACE()
+#define TRACE_ARG(x)
+#endif
+
+static constexpr int const cpuTimeFrames = 300; // the frames per print of the CPU time
+
+// The uniform blocks of shaders/rhi in the std140 layout
+struct ColorUniforms
+{
+    float clipCorr[16];
+    qint32 planeFormat;
+    qint32 colorSpace;
+    qint32 colorTransfer;
+    qint32 colorRangeSmall;
+    float sampleScale;
+    float masteringWhite;
+    float padding[2];
+};
+
+struct ViewUniforms
+{
+    float clipCorr[16];
+    float projection[16];
+    float orientation[16];
+    float eyeRect[2][4];
+    float viewRange[4];
+    float viewXoffs[2];
+    float cubePad[2];
+    qint32 frameProjection;
+    qint32 padding[3];
+};
+
+struct DisplayUniforms
+{
+    float clipCorr[16];
+    float viewRect[2];
+    qint32 rotateDir;
+    qint32 padding;
+};
+
+static QShader loadShader(const QString &name)
+{
+    QFile file(QStringLiteral(":/shaders/rhi/%1.qsb").arg(name));
+    if (!file.open(QIODevice::ReadOnly)) {
+        qCritical() << Q_FUNC_INFO << "Can't read shader" << file.fileName();
+        return QShader();
+    }
+    return QShader::fromSerialized(file.readAll());
+}
+
+RhiVideoRenderer::RhiVideoRenderer(QQuickWindow *win)
+    : m_window(win)
+    , m_rhi(nullptr)
+    , m_debug(false)
+    , m_coverage(0.0, 0.0, 1.0, 1.0)
+    , m_rotateDisplay(0)
+    , m_stereoShift(0.0)
+    , m_stereoMode(0)
+    , m_frameProjection(0)
+    , m_cubemapPadding(0)
+    , m_frameDirty(false)
+    , m_renderFrame(false)
+    , m_planeTexs{ nullptr, nullptr, nullptr }
+    , m_planeFormats{ 0, 0, 0 }
+    , m_frameTex(nullptr)
+    , m_frameTarget(nullptr)
+    , m_frameTargetDesc(nullptr)
+    , m_colorBuf(nullptr)
+    , m_planeSampler(nullptr)
+    , m_lumaSampler(nullptr)
+    , m_colorSrb(nullptr)
+    , m_colorPipeline(nullptr)
+    , m_viewTex(nullptr)
+    , m_viewTarget(nullptr)
+    , m_viewTargetDesc(nullptr)
+    , m_cubeBuf(nullptr)
+    , m_cubeIndexBuf(nullptr)
+    , m_viewBuf(nullptr)
+    , m_wrapSampler(nullptr)
+    , m_clampSampler(nullptr)
+    , m_viewSrbs{ nullptr, nullptr }
+    , m_viewPipeline(nullptr)
+    , m_viewWrap(false)
+    , m_dispBufs{ nullptr, nullptr }
+    , m_viewSampler(nullptr)
+    , m_dispSrbs{ nullptr, nullptr }
+    , m_dispPipeline(nullptr)
+    , m_cpuTime(0)
+    , m_cpuFrames(0)
+{
+    TRACE_ARG(win);
+    setProjection(95);
+}
+
+RhiVideoRenderer::~RhiVideoRenderer()
+{
+    TRACE();
+    releaseResources();
+}
+
+void RhiVideoRenderer::releaseResources()
+{
+    TRACE();
+    for (int i = 0; i < 3; i++) {
+        delete m_planeTexs[i];
+        m_planeTexs[i] = nullptr;
+        m_planeFormats[i] = 0;
+    }
+    delete m_colorPipeline;     m_colorPipeline = nullptr;
+    delete m_colorSrb;          m_colorSrb = nullptr;
+    delete m_lumaSampler;       m_lumaSampler = nullptr;
+    delete m_planeSampler;      m_planeSampler = nullptr;
+    delete m_colorBuf;          m_colorBuf = nullptr;
+    delete m_frameTarget;       m_frameTarget = nullptr;
+    delete m_frameTargetDesc;   m_frameTargetDesc = nullptr;
+    delete m_frameTex;          m_frameTex = nullptr;
+    m_frameSize = QSize();
+
+    delete m_viewPipeline;      m_viewPipeline = nullptr;
+    for (int i = 0; i < 2; i++) {
+        delete m_viewSrbs[i];   m_viewSrbs[i] = nullptr;
+        delete m_dispSrbs[i];   m_dispSrbs[i] = nullptr;
+        delete m_dispBufs[i];   m_dispBufs[i] = nullptr;
+    }
+    delete m_clampSampler;      m_clampSampler = nullptr;
+    delete m_wrapSampler;       m_wrapSampler = nullptr;
+    delete m_viewBuf;           m_viewBuf = nullptr;
+    delete m_cubeIndexBuf;      m_cubeIndexBuf = nullptr;
+    delete m_cubeBuf;           m_cubeBuf = nullptr;
+    delete m_viewTarget;        m_viewTarget = nullptr;
+    delete m_viewTargetDesc;    m_viewTargetDesc = nullptr;
+    delete m_viewTex;           m_viewTex = nullptr;
+    m_viewSize = QSize();
+
+    delete m_dispPipeline;      m_dispPipeline = nullptr;
+    delete m_viewSampler;       m_viewSampler = nullptr;
+    m_frameExt = VideoFrameExt();
+    m_frameDirty = m_videoFrame.isValid();
+    m_rhi = nullptr;
+}
+
+void RhiVideoRenderer::setDebug(bool yes)
+{
+    TRACE_ARG(yes);
+    m_debug = yes;
+}
+
+void RhiVideoRenderer::setRotateDisplay(int direction)
+{
+    TRACE_ARG(direction);
+    m_rotateDisplay = direction;
+}
+
+void RhiVideoRenderer::setStereoShift(qreal shift)
+{
+    TRACE_ARG(shift);
+    m_stereoShift = shift;
+}
+
+void RhiVideoRenderer::setStereoMode(int mode)
+{
+    TRACE_ARG(mode);
+    m_stereoMode = qBound(0, mode, 2);
+}
+
+void RhiVideoRenderer::setProjection(int angle)
+{
+    TRACE_ARG(angle);
+    float fov = qTan(qDegreesToRadians(0.5 * angle));
+    QMatrix4x4 matrix;
+    matrix.frustum(-fov, fov, -fov, fov, 1.0, 100.0);
+    m_projection = matrix;
+}
+
+void RhiVideoRenderer::setOrientation(const QQuaternion &rotation)
+{
+    TRACE_ARG(rotation);
+    QMatrix4x4 matrix;
+    matrix.rotate(rotation.conjugated()); // the inverse of a unit quaternion
+    m_orientation = matrix;
+}
+
+void RhiVideoRenderer::setCoverage(const QRectF &range)
+{
+    TRACE_ARG(range);
+    if (range.isEmpty()) {
+        m_coverage = QRectF(0.0, 0.0, 1.0, 1.0);
+        return;
+    }
+    m_coverage.setRect((range.left() + 180.0) / 360.0, (90.0 - range.bottom()) / 180.0,
+                       qMin(range.width() / 360.0, 1.0), qMin(range.height() / 180.0, 1.0));
+}
+
+void RhiVideoRenderer::setFrameProjection(int type, int padding)
+{
+    TRACE_ARG(type << padding);
+    m_frameProjection = qBound(0, type, 1);
+    m_cubemapPadding = qMax(0, padding);
+}
+
+void RhiVideoRenderer::setVideoFrame(const QVideoFrame &frame)
+{
+    if (frame == m_videoFrame) return; // synchronized again, the texture is up to date
+    TRACE_ARG(frame);
+    m_videoFrame = frame;
+    m_frameDirty = true;
+}
+
+void RhiVideoRenderer::setRect(const QRectF &rect)
+{
+    m_rect = rect;
+}
+
+QString RhiVideoRenderer::takeErrorText()
+{
+    QString text = m_errorText;
+    m_errorText.clear();
+    return text;
+}
+
+QSGRenderNode::StateFlags RhiVideoRenderer::changedStates() const
+{
+    return ViewportState;
+}
+
+QSGRenderNode::RenderingFlags RhiVideoRenderer::flags() const
+{
+    return BoundedRectRendering | OpaqueRendering;
+}
+
+QRectF RhiVideoRenderer::rect() const
+{
+    return m_rect;
+}
+
+// The offscreen passes keep the OpenGL clip space of shaders/view.vert with the y up at
+// the row 0 of the texture on all backends, the depth range is 0..1 on Vulkan
+QMatrix4x4 RhiVideoRenderer::offscreenCorrMatrix() const
+{
+    QMatrix4x4 matrix;
+    if (m_rhi->isYUpInNDC() == m_rhi->isYUpInFramebuffer())
+        matrix.scale(1.0f, -1.0f);
+    if (m_rhi->isClipDepthZeroToOne()) {
+        QMatrix4x4 depth;
+        depth(2, 2) = 0.5f;
+        depth(2, 3) = 0.5f;
+        matrix = depth * matrix;
+    }
+    return matrix;
+}
+
+bool RhiVideoRenderer::initResources()
+{
+    TRACE();
+    static const float positions[] = {
+        -10.0f, -10.0f, +10.0f,
+        +10.0f, -10.0f, +10.0f,
+        -10.0f, +10.0f, +10.0f,
+        +10.0f, +10.0f, +10.0f,
+        +10.0f, -10.0f, -10.0f,
+        -10.0f, -10.0f, -10.0f,
+        +10.0f, +10.0f, -10.0f,
+        -10.0f, +10.0f, -10.0f,
+        -10.0f, -10.0f, -10.0f,
+        -10.0f, -10.0f, +10.0f,
+        -10.0f, +10.0f, -10.0f,
+        -10.0f, +10.0f, +10.0f,
+        +10.0f, -10.0f, +10.0f,
+        +10.0f, -10.0f, -10.0f,
+        +10.0f, +10.0f, +10.0f,
+        +10.0f, +10.0f, -10.0f,
+        -10.0f, +10.0f, -10.0f,
+        -10.0f, +10.0f, +10.0f,
+        +10.0f, +10.0f, -10.0f,
+        +10.0f, +10.0f, +10.0f,
+        +10.0f, -10.0f, -10.0f,
+        +10.0f, -10.0f, +10.0f,
+        -10.0f, -10.0f, -10.0f,
+        -10.0f, -10.0f, +10.0f
+    };
+    static const quint16 indices[] = {
+        0, 1, 2, 1, 3, 2,
+        4, 5, 6, 5, 7, 6,
+        8, 9, 10, 9, 11, 10,
+        12, 13, 14, 13, 15, 14,
+        16, 17, 18, 17, 19, 18,
+        20, 21, 22, 21, 23, 22
+    };
+    m_rhi = m_window->rhi();
+    if (!m_rhi) return false;
+
+    m_cubeBuf = m_rhi->newBuffer(QRhiBuffer::Immutable, QRhiBuffer::VertexBuffer, sizeof(positions));
+    m_cubeIndexBuf = m_rhi->newBuffer(QRhiBuffer::Immutable, QRhiBuffer::IndexBuffer, sizeof(indices));
+    m_colorBuf = m_rhi->newBuffer(QRhiBuffer::Dynamic, QRhiBuffer::UniformBuffer, sizeof(ColorUniforms));
+    m_viewBuf = m_rhi->newBuffer(QRhiBuffer::Dynamic, QRhiBuffer::UniformBuffer, sizeof(ViewUniforms));
+    m_dispBufs[0] = m_rhi->newBuffer(QRhiBuffer::Dynamic, QRhiBuffer::UniformBuffer, sizeof(DisplayUniforms));
+    m_dispBufs[1] = m_rhi->newBuffer(QRhiBuffer::Dynamic, QRhiBuffer::UniformBuffer, sizeof(DisplayUniforms));
+    for (auto buf : { m_cubeBuf, m_cubeIndexBuf, m_colorBuf, m_viewBuf, m_dispBufs[0], m_dispBufs[1] }) {
+        if (!buf->create()) {
+            qCritical() << Q_FUNC_INFO << "Can't create buffer" << buf->size();
+            return false;
+        }
+    }
+
+    // The samplers of VideoRenderer::initFunctions(), the frame one wraps at the full sphere only
+    m_lumaSampler = m_rhi->newSampler(QRhiSampler::Nearest, QRhiSampler::Nearest, QRhiSampler::None,
+                                      QRhiSampler::ClampToEdge, QRhiSampler::ClampToEdge);
+    m_planeSampler = m_rhi->newSampler(QRhiSampler::Linear, QRhiSampler::Linear, QRhiSampler::None,
+                                       QRhiSampler::ClampToEdge, QRhiSampler::ClampToEdge);
+    m_wrapSampler = m_rhi->newSampler(QRhiSampler::Linear, QRhiSampler::Linear, QRhiSampler::None,
+                                      QRhiSampler::Repeat, QRhiSampler::ClampToEdge);
+    m_clampSampler = m_rhi->newSampler(QRhiSampler::Linear, QRhiSampler::Linear, QRhiSampler::None,
+                                       QRhiSampler::ClampToEdge, QRhiSampler::ClampToEdge);
+    m_viewSampler = m_rhi->newSampler(QRhiSampler::Linear, QRhiSampler::Linear, QRhiSampler::Linear,
+                                      QRhiSampler::ClampToEdge, QRhiSampler::ClampToEdge);
+    for (auto sampler : { m_lumaSampler, m_planeSampler, m_wrapSampler, m_clampSampler, m_viewSampler }) {
+        if (!sampler->create()) {
+            qCritical() << Q_FUNC_INFO << "Can't create sampler";
+            return false;
+        }
+    }
+
+    auto updates = m_rhi->nextResourceUpdateBatch();
+    updates->uploadStaticBuffer(m_cubeBuf, positions);
+    updates->uploadStaticBuffer(m_cubeIndexBuf, indices);
+    commandBuffer()->resourceUpdate(updates);
+    TRACE_ARG(m_rhi->backendName() << m_rhi->driverInfo());
+    return true;
+}
+
+bool RhiVideoRenderer::setPlaneTexture(int plane, int format, const QSize &size)
+{
+    auto &tex = m_planeTexs[plane];
+    if (tex && m_planeFormats[plane] == format && tex->pixelSize() == size)
+        return true;
+    TRACE_ARG(plane << format << size);
+    if (!tex) tex = m_rhi->newTexture(QRhiTexture::Format(format), size);
+    else {
+        tex->setFormat(QRhiTexture::Format(format));
+        tex->setPixelSize(size);
+    }
+    m_planeFormats[plane] = format;
+    if (!tex->create()) {
+        qCritical() << Q_FUNC_INFO << "Can't create plane texture" << plane << format << size;
+        return false;
+    }
+    delete m_colorSrb; // refers to the native texture
+    m_colorSrb = nullptr;
+    return true;
+}
+
+bool RhiVideoRenderer::uploadPlanes(QRhiResourceUpdateBatch *updates, int &planeFormat)
+{
+    auto &frame = m_videoFrame;
+    const bool norm16 = m_rhi->isTextureFormatSupported(QRhiTexture::R16) &&
+                        m_rhi->isTextureFormatSupported(QRhiTexture::RG16);
+
+    // The plane formats of VideoRenderer::uploadPlanes() without the swizzles, see shaders/rhi/color.frag
+    struct Plane { int format, width, height; };
+    QVarLengthArray<Plane, 3> planes;
+    const int w = frame.width(), h = frame.height();
+    planeFormat = 2;
+    switch (frame.pixelFormat()) {
+    case QVideoFrameFormat::Format_YUV420P:
+        planes = { { QRhiTexture::R8, w, h }, { QRhiTexture::R8, w / 2, h / 2 }, { QRhiTexture::R8, w / 2, h / 2 } };
+        break;
+    case QVideoFrameFormat::Format_YUV422P:
+        planes = { { QRhiTexture::R8, w, h }, { QRhiTexture::R8, w / 2, h }, { QRhiTexture::R8, w / 2, h } };
+        break;
+    case QVideoFrameFormat::Format_YV12:
+        planes = { { QRhiTexture::R8, w, h }, { QRhiTexture::R8, w / 2, h / 2 }, { QRhiTexture::R8, w / 2, h / 2 } };
+        planeFormat = 3;
+        break;
+    case QVideoFrameFormat::Format_NV12:
+        planes = { { QRhiTexture::R8, w, h }, { QRhiTexture::RG8, w / 2, h / 2 } };
+        planeFormat = 4;
+        break;
+    case QVideoFrameFormat::Format_YUV420P10:
+        if (norm16)
+            planes = { { QRhiTexture::R16, w, h }, { QRhiTexture::R16, w / 2, h / 2 }, { QRhiTexture::R16, w / 2, h / 2 } };
+        break;
+    case QVideoFrameFormat::Format_P010:
+    case QVideoFrameFormat::Format_P016:
+        if (norm16)
+            planes = { { QRhiTexture::R16, w, h }, { QRhiTexture::RG16, w / 2, h / 2 } };
+        planeFormat = 4;
+        break;
+    case QVideoFrameFormat::Format_Y8:
+        planes = { { QRhiTexture::R8, w, h } };
+        planeFormat = 5;
+        break;
+    case QVideoFrameFormat::Format_Y16:
+        if (norm16)
+            planes = { { QRhiTexture::R16, w, h } };
+        planeFormat = 5;
+        break;
+    default:
+        break;
+    }
+
+    if (planes.isEmpty() || planes.size() != frame.planeCount()) {
+        // The packed RGB and YUV frames by Qt, the 16 bit ones without the normalized textures too
+        const QImage image = frame.toImage().convertToFormat(QImage::Format_RGBA8888);
+        if (image.isNull() || !setPlaneTexture(0, QRhiTexture::RGBA8, image.size()))
+            return false;
+        updates->uploadTexture(m_planeTexs[0], QRhiTextureUploadDescription(
+                                   QRhiTextureUploadEntry(0, 0, QRhiTextureSubresourceUploadDescription(image))));
+        planeFormat = 1;
+        return true;
+    }
+    if (!frame.map(QVideoFrame::ReadOnly)) {
+        qCritical() << Q_FUNC_INFO << "Can't map video frame";
+        return false;
+    }
+    bool ok = true;
+    for (int i = 0; ok && i < planes.size(); i++) {
+        const Plane &plane = planes.at(i);
+        ok = setPlaneTexture(i, plane.format, QSize(plane.width, plane.height));
+        if (!ok) break;
+        // The upload description copies the mapped data
+        QRhiTextureSubresourceUploadDescription desc(frame.bits(i), frame.mappedBytes(i));
+        desc.setDataStride(frame.bytesPerLine(i));
+        desc.setSourceSize(QSize(plane.width, plane.height));
+        updates->uploadTexture(m_planeTexs[i], QRhiTextureUploadDescription(QRhiTextureUploadEntry(0, 0, desc)));
+    }
+    frame.unmap();
+    return ok;
+}
+
+bool RhiVideoRenderer::setFrameTexture(const QSize &size)
+{
+    if (m_frameTex && m_frameTex->pixelSize() == size)
+        return true;
+    TRACE_ARG(size);
+    const int maxSize = m_rhi->resourceLimit(QRhi::TextureSizeMax);
+    if (size.width() > maxSize || size.height() > maxSize) {
+        m_errorText = QStringLiteral("The frame %1x%2 exceeds the max texture size %3")
+                .arg(size.width()).arg(size.height()).arg(maxSize);
+        return false;
+    }
+    // The linear colors need more than 8 bits as the GL_RGB16 of VideoRenderer
+    const auto format = m_rhi->isTextureFormatSupported(QRhiTexture::RGBA16F) ? QRhiTexture::RGBA16F
+                      : m_rhi->isTextureFormatSupported(QRhiTexture::RGB10A2) ? QRhiTexture::RGB10A2
+                      : QRhiTexture::RGBA8;
+    if (!m_frameTex) m_frameTex = m_rhi->newTexture(format, size, 1, QRhiTexture::RenderTarget);
+    else m_frameTex->setPixelSize(size);
+    if (!m_frameTex->create()) {
+        qCritical() << Q_FUNC_INFO << "Can't create frame texture" << size;
+        return false;
+    }
+    if (!m_frameTarget) {
+        m_frameTarget = m_rhi->newTextureRenderTarget({ QRhiColorAttachment(m_frameTex) });
+        m_frameTargetDesc = m_frameTarget->newCompatibleRenderPassDescriptor();
+        m_frameTarget->setRenderPassDescriptor(m_frameTargetDesc);
+    }
+    if (!m_frameTarget->create()) {
+        qCritical() << Q_FUNC_INFO << "Can't create frame render target" << size;
+        return false;
+    }
+    // The view bindings refer to the native texture
+    for (int i = 0; i < 2; i++) {
+        delete m_viewSrbs[i];
+        m_viewSrbs[i] = nullptr;
+    }
+    return true;
+}
+
+bool RhiVideoRenderer::convertFrame(QRhiResourceUpdateBatch *updates)
+{
+    TRACE_ARG(m_videoFrame.pixelFormat() << m_videoFrame.size());
+
+    // Upload the frame planes and convert them to the linear RGB frame texture
+
+    int planeFormat = 0;
+    if (!uploadPlanes(updates, planeFormat) || !setFrameTexture(m_videoFrame.size()))
+        return false;
+    if (!m_colorSrb) {
+        QRhiTexture *planes[3];
+        for (int i = 0; i < 3; i++)
+            planes[i] = m_planeTexs[i] ? m_planeTexs[i] : m_planeTexs[0]; // the unused ones still bound
+        m_colorSrb = m_rhi->newShaderResourceBindings();
+        m_colorSrb->setBindings({
+            QRhiShaderResourceBinding::uniformBuffer(0, QRhiShaderResourceBinding::VertexStage |
+                                                        QRhiShaderResourceBinding::FragmentStage, m_colorBuf),
+            QRhiShaderResourceBinding::sampledTexture(1, QRhiShaderResourceBinding::FragmentStage, planes[0], m_lumaSampler),
+            QRhiShaderResourceBinding::sampledTexture(2, QRhiShaderResourceBinding::FragmentStage, planes[1], m_planeSampler),
+            QRhiShaderResourceBinding::sampledTexture(3, QRhiShaderResourceBinding::FragmentStage, planes[2], m_planeSampler)
+        });
+        if (!m_colorSrb->create()) {
+            qCritical() << Q_FUNC_INFO << "Can't create color bindings";
+            return false;
+        }
+    }
+    if (!m_colorPipeline) {
+        // Layout compatible with the bindings rebuilt on the plane change, so built once
+        m_colorPipeline = m_rhi->newGraphicsPipeline();
+        m_colorPipeline->setShaderStages({
+            { QRhiShaderStage::Vertex, loadShader(QStringLiteral("color.vert")) },
+            { QRhiShaderStage::Fragment, loadShader(QStringLiteral("color.frag")) }
+        });
+        m_colorPipeline->setTopology(QRhiGraphicsPipeline::TriangleStrip);
+        m_colorPipeline->setShaderResourceBindings(m_colorSrb);
+        m_colorPipeline->setRenderPassDescriptor(m_frameTargetDesc);
+        if (!m_colorPipeline->create()) {
+            qCritical() << Q_FUNC_INFO << "Can't create color pipeline";
+            delete m_colorPipeline;
+            m_colorPipeline = nullptr;
+            return false;
+        }
+    }
+
+    const VideoFrameExt frameExt(planeFormat, m_videoFrame.surfaceFormat());
+    if (frameExt != m_frameExt) {
+        TRACE_ARG(frameExt);
+        ColorUniforms uniforms = {};
+        memcpy(uniforms.clipCorr, offscreenCorrMatrix().constData(), sizeof(uniforms.clipCorr));
+        uniforms.planeFormat = planeFormat;
+        uniforms.colorSpace = frameExt.colorSpace();
+        uniforms.colorTransfer = frameExt.colorTransfer();
+        uniforms.colorRangeSmall = frameExt.isColorFull() ? 0 : 1;
+        uniforms.sampleScale = frameExt.sampleScale();
+        uniforms.masteringWhite = frameExt.colorWhite();
+        updates->updateDynamicBuffer(m_colorBuf, 0, sizeof(uniforms), &uniforms);
+        m_frameExt = frameExt;
+    }
+
+    auto cb = commandBuffer();
+    const QSize size = m_frameTex->pixelSize();
+    cb->beginPass(m_frameTarget, Qt::black, { 1.0f, 0 }, updates);
+    cb->setGraphicsPipeline(m_colorPipeline);
+    cb->setViewport(QRhiViewport(0, 0, size.width(), size.height()));
+    cb->setShaderResources(m_colorSrb);
+    cb->draw(4);
+    cb->endPass();
+    m_frameSize = size;
+    return true;
+}
+
+bool RhiVideoRenderer::setViewTexture(const QSize &size)
+{
+    if (m_viewTex && size == m_viewSize)
+        return true;
+    TRACE_ARG(size);
+    const QSize texSize(size.width() * 2, size.height()); // double-wide, both eyes
+    const auto format = m_rhi->isTextureFormatSupported(QRhiTexture::RGBA16F) ? QRhiTexture::RGBA16F
+                      : m_rhi->isTextureFormatSupported(QRhiTexture::RGB10A2) ? QRhiTexture::RGB10A2
+                      : QRhiTexture::RGBA8;
+    if (!m_viewTex) {
+        m_viewTex = m_rhi->newTexture(format, texSize, 1, QRhiTexture::RenderTarget |
+                                      QRhiTexture::MipMapped | QRhiTexture::UsedWithGenerateMips);
+    } else m_viewTex->setPixelSize(texSize);
+    if (!m_viewTex->create()) {
+        qCritical() << Q_FUNC_INFO << "Can't create view texture" << texSize;
+        return false;
+    }
+    if (!m_viewTarget) {
+        m_viewTarget = m_rhi->newTextureRenderTarget({ QRhiColorAttachment(m_viewTex) });
+        m_viewTargetDesc = m_viewTarget->newCompatibleRenderPassDescriptor();
+        m_viewTarget->setRenderPassDescriptor(m_viewTargetDesc);
+    }
+    if (!m_viewTarget->create()) {
+        qCritical() << Q_FUNC_INFO << "Can't create view render target" << texSize;
+        return false;
+    }
+    m_viewSize = size;
+    for (int i = 0; i < 2; i++) {
+        delete m_dispSrbs[i]; // refer to the native texture
+        m_dispSrbs[i] = nullptr;
+    }
+    return true;
+}
+
+bool RhiVideoRenderer::renderView(QRhiResourceUpdateBatch *updates)
+{
+    TRACE_ARG(m_stereoMode);
+
+    // Render both views by one instanced draw into the halves of the double-wide view texture
+
+    QSize viewSize = m_frameSize; // of an eye
+    if (m_stereoMode == 1) viewSize.setHeight(viewSize.height() / 2);
+    else if (m_stereoMode == 2) viewSize.setWidth(viewSize.width() / 2);
+    const int maxSize = m_rhi->resourceLimit(QRhi::TextureSizeMax);
+    if (viewSize.width() * 2 > maxSize || viewSize.height() > maxSize)
+        viewSize.scale(maxSize / 2, maxSize, Qt::KeepAspectRatio);
+    if (!setViewTexture(viewSize))
+        return false;
+    for (int i = 0; i < 2; i++) {
+        if (m_viewSrbs[i]) continue;
+        m_viewSrbs[i] = m_rhi->newShaderResourceBindings();
+        m_viewSrbs[i]->setBindings({
+            QRhiShaderResourceBinding::uniformBuffer(0, QRhiShaderResourceBinding::VertexStage |
+                                                        QRhiShaderResourceBinding::FragmentStage, m_viewBuf),
+            QRhiShaderResourceBinding::sampledTexture(1, QRhiShaderResourceBinding::FragmentStage,
+                                                      m_frameTex, i ? m_wrapSampler : m_clampSampler)
+        });
+        if (!m_viewSrbs[i]->create()) {
+            qCritical() << Q_FUNC_INFO << "Can't create view bindings";
+            return false;
+        }
+    }
+    if (!m_viewPipeline) {
+        m_viewPipeline = m_rhi->newGraphicsPipeline();
+        m_viewPipeline->setShaderStages({
+            { QRhiShaderStage::Vertex, loadShader(QStringLiteral("view.vert")) },
+            { QRhiShaderStage::Fragment, loadShader(QStringLiteral("view.frag")) }
+        });
+        QRhiVertexInputLayout inputLayout;
+        inputLayout.setBindings({ QRhiVertexInputBinding(3 * sizeof(float)) });
+        inputLayout.setAttributes({ { 0, 0, QRhiVertexInputAttribute::Float3, 0 } });
+        m_viewPipeline->setVertexInputLayout(inputLayout);
+        m_viewPipeline->setCullMode(QRhiGraphicsPipeline::None);
+        m_viewPipeline->setShaderResourceBindings(m_viewSrbs[0]);
+        m_viewPipeline->setRenderPassDescriptor(m_viewTargetDesc);
+        if (!m_viewPipeline->create()) {
+            qCritical() << Q_FUNC_INFO << "Can't create view pipeline";
+            delete m_viewPipeline;
+            m_viewPipeline = nullptr;
+            return false;
+        }
+    }
+
+    // The uniforms of VideoRenderer::textureToView()
+    static const float eyeRects[3][2][4] = {
+        { { 0.0f, 0.0f, 1.0f, 1.0f }, { 0.0f, 0.0f, 1.0f, 1.0f } },
+        { { 0.0f, 0.0f, 1.0f, 0.5f }, { 0.0f, 0.5f, 1.0f, 0.5f } }, // top-bottom
+        { { 0.0f, 0.0f, 0.5f, 1.0f }, { 0.5f, 0.0f, 0.5f, 1.0f } }  // side-by-side
+    };
+    ViewUniforms uniforms = {};
+    memcpy(uniforms.clipCorr, offscreenCorrMatrix().constData(), sizeof(uniforms.clipCorr));
+    memcpy(uniforms.projection, m_projection.constData(), sizeof(uniforms.projection));
+    memcpy(uniforms.orientation, m_orientation.constData(), sizeof(uniforms.orientation));
+    memcpy(uniforms.eyeRect, eyeRects[m_stereoMode], sizeof(uniforms.eyeRect));
+    uniforms.viewRange[0] = m_coverage.x();
+    uniforms.viewRange[1] = m_coverage.y();
+    uniforms.viewRange[2] = m_coverage.width();
+    uniforms.viewRange[3] = m_coverage.height();
+    uniforms.viewXoffs[1] = m_stereoMode ? 0.0f : float(-m_stereoShift / 250.0);
+    if (m_frameProjection == 1) {
+        // At least a half texel inside of the face cell for the filtering
+        const float cellWidth = m_frameSize.width() * eyeRects[m_stereoMode][0][2] / 3.0f;
+        const float cellHeight = m_frameSize.height() * eyeRects[m_stereoMode][0][3] / 2.0f;
+        const float pad = qMax(0.5f, float(m_cubemapPadding));
+        uniforms.cubePad[0] = pad / cellWidth;
+        uniforms.cubePad[1] = pad / cellHeight;
+    }
+    uniforms.frameProjection = m_frameProjection;
+    updates->updateDynamicBuffer(m_viewBuf, 0, sizeof(uniforms), &uniforms);
+    m_viewWrap = (m_frameProjection == 0 && m_coverage.width() >= 1.0 && m_stereoMode != 2);
+
+    auto cb = commandBuffer();
+    cb->beginPass(m_viewTarget, Qt::black, { 1.0f, 0 }, updates);
+    cb->setGraphicsPipeline(m_viewPipeline);
+    cb->setViewport(QRhiViewport(0, 0, m_viewSize.width() * 2, m_viewSize.height()));
+    cb->setShaderResources(m_viewSrbs[m_viewWrap ? 1 : 0]);
+    const QRhiCommandBuffer::VertexInput vertexInput(m_cubeBuf, 0);
+    cb->setVertexInput(0, 1, &vertexInput, m_cubeIndexBuf, 0, QRhiCommandBuffer::IndexUInt16);
+    cb->drawIndexed(36, 2);
+    auto mipmaps = m_rhi->nextResourceUpdateBatch();
+    mipmaps->generateMips(m_viewTex);
+    cb->endPass(mipmaps);
+    return true;
+}
+
+bool RhiVideoRenderer::setDisplayPipeline()
+{
+    auto target = renderTarget();
+    if (m_dispPipeline && m_dispPipeline->renderPassDescriptor()->isCompatible(target->renderPassDescriptor()) &&
+            m_dispPipeline->sampleCount() == target->sampleCount())
+        return true;
+    TRACE_ARG(target->sampleCount());
+    delete m_dispPipeline;
+    m_dispPipeline = m_rhi->newGraphicsPipeline();
+    m_dispPipeline->setShaderStages({
+        { QRhiShaderStage::Vertex, loadShader(QStringLiteral("display.vert")) },
+        { QRhiShaderStage::Fragment, loadShader(QStringLiteral("display.frag")) }
+    });
+    m_dispPipeline->setTopology(QRhiGraphicsPipeline::TriangleStrip);
+    m_dispPipeline->setSampleCount(target->sampleCount());
+    m_dispPipeline->setShaderResourceBindings(m_dispSrbs[0]);
+    m_dispPipeline->setRenderPassDescriptor(target->renderPassDescriptor());
+    if (!m_dispPipeline->create()) {
+        qCritical() << Q_FUNC_INFO << "Can't create display pipeline";
+        delete m_dispPipeline;
+        m_dispPipeline = nullptr;
+        return false;
+    }
+    return true;
+}
+
+void RhiVideoRenderer::prepare()
+{
+    if (m_debug) m_cpuTimer.start();
+    if (!m_rhi && !initResources()) {
+        m_renderFrame = false;
+        return;
+    }
+    // A batch only for a pass to take it, the pool of the batches is small
+    if (m_frameDirty && m_videoFrame.isValid()) {
+        m_frameDirty = false;
+        auto updates = m_rhi->nextResourceUpdateBatch();
+        m_renderFrame = (updates && convertFrame(updates)); // the batch goes with the color pass
+        if (!m_renderFrame && updates) updates->release();
+    }
+    if (m_renderFrame) {
+        auto updates = m_rhi->nextResourceUpdateBatch();
+        if (!updates || !renderView(updates)) {
+            if (updates) updates->release();
+            m_renderFrame = false;
+        }
+    }
+    if (!m_renderFrame) return;
+
+    // The display uniforms per eye, the bindings on the view texture change
+
+    for (int i = 0; i < 2; i++) {
+        if (!m_dispSrbs[i]) {
+            m_dispSrbs[i] = m_rhi->newShaderResourceBindings();
+            m_dispSrbs[i]->setBindings({
+                QRhiShaderResourceBinding::uniformBuffer(0, QRhiShaderResourceBinding::VertexStage |
+                                                            QRhiShaderResourceBinding::FragmentStage, m_dispBufs[i]),
+                QRhiShaderResourceBinding::sampledTexture(1, QRhiShaderResourceBinding::FragmentStage,
+                                                          m_viewTex, m_viewSampler)
+            });
+            if (!m_dispSrbs[i]->create()) {
+                qCritical() << Q_FUNC_INFO << "Can't create display bindings";
+                m_renderFrame = false;
+                return;
+            }
+        }
+    }
+    if (!setDisplayPipeline()) {
+        m_renderFrame = false;
+        return;
+    }
+    auto updates = m_rhi->nextResourceUpdateBatch();
+    if (!updates) {
+        m_renderFrame = false;
+        return;
+    }
+    for (int i = 0; i < 2; i++) {
+        DisplayUniforms uniforms = {};
+        memcpy(uniforms.clipCorr, m_rhi->clipSpaceCorrMatrix().constData(), sizeof(uniforms.clipCorr));
+        uniforms.viewRect[0] = i * 0.5f;
+        uniforms.viewRect[1] = 0.5f;
+        uniforms.rotateDir = m_rotateDisplay;
+        updates->updateDynamicBuffer(m_dispBufs[i], 0, sizeof(uniforms), &uniforms);
+    }
+    commandBuffer()->resourceUpdate(updates);
+    if (m_debug) m_cpuTime += m_cpuTimer.nsecsElapsed();
+}
+
+void RhiVideoRenderer::render(const RenderState *state)
+{
+    Q_UNUSED(state);
+    if (!m_renderFrame || !m_dispPipeline) return;
+    if (m_debug) m_cpuTimer.start();
+
+    // The eye halves of the target as VideoRenderer::renderDisplay(), bottom-up if portrait
+
+    const QSize size = renderTarget()->pixelSize();
+    const int halfWidth = size.width() / 2;
+    const int halfHeight = size.height() / 2;
+    auto cb = commandBuffer();
+    cb->setGraphicsPipeline(m_dispPipeline);
+    for (int eye = 0; eye < 2; eye++) {
+        if (halfWidth > halfHeight)
+             cb->setViewport(QRhiViewport(eye * halfWidth, 0, halfWidth, size.height()));
+        else cb->setViewport(QRhiViewport(0, eye * halfHeight, size.width(), halfHeight));
+        cb->setShaderResources(m_dispSrbs[eye]);
+        cb->draw(4);
+    }
+    if (m_debug) {
+        m_cpuTime += m_cpuTimer.nsecsElapsed();
+        if (++m_cpuFrames == cpuTimeFrames) {
+            qInfo().noquote() << m_rhi->backendName() << "CPU time per frame"
+                              << QString::number(m_cpuTime / 1000.0 / m_cpuFrames, 'f', 1) << "us";
+            m_cpuTime = 0;
+            m_cpuFrames = 0;
+        }
+    }
+}
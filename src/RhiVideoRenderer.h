@@ -0,0 +1,124 @@
+#ifndef RHIVIDEORENDERER_H
+#define RHIVIDEORENDERER_H
+
+#include <QSGRenderNode>
+#include <QVideoFrame>
+#include <QMatrix4x4>
+#include <QQuaternion>
+#include <QElapsedTimer>
+#include <QRectF>
+#include <QSize>
+#include <QString>
+
+#include "VideoFrameExt.h"
+
+class QQuickWindow;
+class QRhi;
+class QRhiBuffer;
+class QRhiTexture;
+class QRhiSampler;
+class QRhiTextureRenderTarget;
+class QRhiRenderPassDescriptor;
+class QRhiShaderResourceBindings;
+class QRhiGraphicsPipeline;
+class QRhiResourceUpdateBatch;
+
+/*
+ * The QRhi port of VideoRenderer for Vulkan (and OpenGL or GLES through QRhi) as the
+ * render node of PanoramaView: the same color, view and display passes by the precompiled
+ * shaders/rhi, the pipelines and uniform buffers built once and rebuilt on the texture size
+ * change only. The color and view passes are recorded as the offscreen passes in prepare(),
+ * the display pass is recorded into the scene graph pass in render().
+ *
+ * Unlike VideoRenderer the frames are always mapped to memory, the frames beyond the max
+ * texture size are not split into slabs, and the detail tiles of still images and the
+ * partial sphere mesh are left out.
+ */
+class RhiVideoRenderer : public QSGRenderNode
+{
+public:
+    explicit RhiVideoRenderer(QQuickWindow *win); // the win is not parent!
+    ~RhiVideoRenderer() override;
+
+    void setDebug(bool yes); // print the CPU time per frame
+    void setRotateDisplay(int direction); // -1/0/1
+    void setStereoShift(qreal shift); // 0.0..1.0, of the mono frames
+    void setStereoMode(int mode); // 0 mono, 1 top-bottom, 2 side-by-side
+    void setProjection(int angle); // vertical FOV angle 5..115 in degree
+    void setOrientation(const QQuaternion &rotation); // of the view, a unit quaternion
+    void setCoverage(const QRectF &range); // longitude, latitude range of the frame in degree
+    void setFrameProjection(int type, int padding = 0); // 0 equirectangular, 1 EAC with the face padding
+    void setVideoFrame(const QVideoFrame &frame);
+    void setRect(const QRectF &rect);
+
+    QString takeErrorText(); // the last error if any, then cleared
+
+    void prepare() override;
+    void render(const RenderState *state) override;
+    void releaseResources() override;
+    StateFlags changedStates() const override;
+    RenderingFlags flags() const override;
+    QRectF rect() const override;
+
+private:
+    QMatrix4x4 offscreenCorrMatrix() const;
+    bool initResources();
+    bool uploadPlanes(QRhiResourceUpdateBatch *updates, int &planeFormat);
+    bool setPlaneTexture(int plane, int format, const QSize &size);
+    bool setFrameTexture(const QSize &size);
+    bool setViewTexture(const QSize &size);
+    bool setDisplayPipeline();
+    bool convertFrame(QRhiResourceUpdateBatch *updates); // records the color pass
+    bool renderView(QRhiResourceUpdateBatch *updates); // records the view pass
+
+    QQuickWindow *m_window;
+    QRhi *m_rhi;
+    bool m_debug;
+    QString m_errorText;
+
+    QMatrix4x4 m_projection, m_orientation;
+    QRectF m_coverage; // of the frame in the normalized full sphere, top-left origin
+    QRectF m_rect;
+    int m_rotateDisplay;
+    qreal m_stereoShift;
+    int m_stereoMode;
+    int m_frameProjection;
+    int m_cubemapPadding; // in pixels
+
+    QVideoFrame m_videoFrame;
+    bool m_frameDirty;
+    bool m_renderFrame;
+    VideoFrameExt m_frameExt;
+    QSize m_frameSize;
+
+    QRhiTexture *m_planeTexs[3];
+    int m_planeFormats[3]; // QRhiTexture::Format of the plane textures
+    QRhiTexture *m_frameTex;
+    QRhiTextureRenderTarget *m_frameTarget;
+    QRhiRenderPassDescriptor *m_frameTargetDesc;
+    QRhiBuffer *m_colorBuf;
+    QRhiSampler *m_planeSampler, *m_lumaSampler;
+    QRhiShaderResourceBindings *m_colorSrb;
+    QRhiGraphicsPipeline *m_colorPipeline;
+
+    QSize m_viewSize; // of an eye
+    QRhiTexture *m_viewTex;
+    QRhiTextureRenderTarget *m_viewTarget;
+    QRhiRenderPassDescriptor *m_viewTargetDesc;
+    QRhiBuffer *m_cubeBuf, *m_cubeIndexBuf, *m_viewBuf;
+    QRhiSampler *m_wrapSampler, *m_clampSampler;
+    QRhiShaderResourceBindings *m_viewSrbs[2]; // the frame sampler wraps horizontally or clamps
+    QRhiGraphicsPipeline *m_viewPipeline;
+    bool m_viewWrap;
+
+    QRhiBuffer *m_dispBufs[2]; // per eye
+    QRhiSampler *m_viewSampler;
+    QRhiShaderResourceBindings *m_dispSrbs[2];
+    QRhiGraphicsPipeline *m_dispPipeline;
+
+    QElapsedTimer m_cpuTimer;
+    qint64 m_cpuTime; // of the frames since the last print in ns
+    int m_cpuFrames;
+};
+
+#endif // RHIVIDEORENDERER_H
@@ -0,0 +1,81 @@
+#ifndef SAMPLERING_H
+#define SAMPLERING_H
+
+#include <QtGlobal>
+
+#include <atomic>
+#include <cstring>
+#include <type_traits>
+
+/*
+ * The lock-free ring of the last N samples of one producer thread, read by any consumer
+ * thread without blocking the producer: the newest one, or the older ones by their serial.
+ * The producer never waits for a slow consumer, it overwrites the oldest slot; the consumer
+ * finds out by the slot sequence (seqlock) and skips ahead.
+ */
+template <typename T, int N>
+class SampleRing
+{
+    static_assert(std::is_trivially_copyable<T>::value, "The samples are copied as bytes");
+    static_assert(N > 1 && (N & (N - 1)) == 0, "The slot count is a power of 2");
+
+public:
+    static constexpr int const slotCount = N;
+
+    SampleRing() : m_latest(0)
+    {
+        for (auto &slot : m_slots)
+            slot.sequence.store(0, std::memory_order_relaxed);
+    }
+
+    // The producer thread only
+    void push(const T &value)
+    {
+        const quint64 serial = m_latest.load(std::memory_order_relaxed) + 1;
+        Slot &slot = m_slots[serial & (N - 1)];
+        slot.sequence.store(serial * 2 - 1, std::memory_order_relaxed); // odd while written
+        std::atomic_thread_fence(std::memory_order_release);
+        memcpy(&slot.value, &value, sizeof(T));
+        slot.sequence.store(serial * 2, std::memory_order_release);
+        m_latest.store(serial, std::memory_order_release);
+    }
+
+    // Any thread
+    quint64 latest() const { return m_latest.load(std::memory_order_acquire); } // serial, 0 if none
+    quint64 oldest() const { const quint64 serial = latest(); return serial > quint64(N) ? serial - N + 1 : 1; }
+
+    bool read(quint64 serial, T *value) const // false if not pushed yet, overwritten or being written
+    {
+        if (!serial) return false;
+        const Slot &slot = m_slots[serial & (N - 1)];
+        if (slot.sequence.load(std::memory_order_acquire) != serial * 2) return false;
+        memcpy(value, &slot.value, sizeof(T));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return slot.sequence.load(std::memory_order_relaxed) == serial * 2;
+    }
+
+    bool readLatest(T *value, quint64 *serial = nullptr) const
+    {
+        // Retried while the producer laps the reader, rare unless the reader is preempted
+        for (int i = 0; i < 4; i++) {
+            const quint64 latestSerial = latest();
+            if (!latestSerial) return false;
+            if (read(latestSerial, value)) {
+                if (serial) *serial = latestSerial;
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    struct alignas(64) Slot {
+        std::atomic<quint64> sequence; // serial * 2 once written
+        T value;
+    };
+
+    Slot m_slots[N];
+    alignas(64) std::atomic<quint64> m_latest;
+};
+
+#endif // SAMPLERING_H
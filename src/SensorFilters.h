@@ -0,0 +1,260 @@
+#ifndef SENSORFILTERS_H
+#define SENSORFILTERS_H
+
+#include <QQuaternion>
+#include <QVector3D>
+#include <QtMath>
+
+#include "SensorThread.h"
+
+/*
+ * The orientation filters of the sensor samples, run on every sample at the full sensor
+ * rate. Header-only and of fixed size, nothing is allocated per sample. The rotations are
+ * of the sensor axes (body to world, z up) as SensorSample::rotation(), the gyro rates in
+ * degree/s and the times in us as the samples carry.
+ */
+
+namespace SensorFilters {
+
+static inline float sampleTime(qint64 time, qint64 last) // s since the last sample, bounded
+{
+    return last ? qBound(0.0001f, float(time - last) / 1e6f, 0.1f) : 0.0f;
+}
+
+static inline QQuaternion shorterArc(const QQuaternion &from, const QQuaternion &to)
+{
+    return QQuaternion::dotProduct(from, to) < 0.0f ? -to : to;
+}
+
+// The rotation vector of a unit quaternion in radians, its axis times its angle
+static inline QVector3D rotationVector(const QQuaternion &rotation)
+{
+    const QQuaternion q = rotation.scalar() < 0.0f ? -rotation : rotation;
+    const QVector3D axis = q.vector();
+    const float sinHalf = axis.length();
+    if (sinHalf < 1e-7f) return axis * 2.0f;
+    return axis * (2.0f * std::atan2(sinHalf, q.scalar()) / sinHalf);
+}
+
+static inline QQuaternion fromRotationVector(const QVector3D &vector)
+{
+    const float angle = vector.length();
+    if (angle < 1e-7f) return QQuaternion(1.0f, vector * 0.5f).normalized();
+    return QQuaternion::fromAxisAndAngle(vector / angle, qRadiansToDegrees(angle));
+}
+
+/*
+ * The One-Euro filter (Casiez et al.) of the rotation: a slerp towards each sample by the
+ * smoothing factor of a low-pass cutoff raised with the angular speed, so the jitter at rest
+ * is cut by minCutoff while a fast turn is followed with little lag. The speed is of the gyro
+ * if reported, else of the sample differences, low-passed by speedCutoff.
+ */
+class OneEuroFilter
+{
+public:
+    float minCutoff = 1.0f; // Hz at rest
+    float beta = 0.1f; // Hz more per degree/s
+    float speedCutoff = 1.0f; // Hz of the speed estimate
+
+    void reset() { m_last = 0; }
+
+    QQuaternion update(const SensorSample &sample)
+    {
+        const QQuaternion rotation = sample.rotation();
+        const float dt = sampleTime(sample.timestamp, m_last);
+        m_last = sample.timestamp;
+        if (dt <= 0.0f) {
+            m_raw = m_rotation = rotation;
+            m_speed = 0.0f;
+            return m_rotation;
+        }
+        const float speed = (sample.fields & SensorSample::GyroField)
+                ? QVector3D(sample.gyro[0], sample.gyro[1], sample.gyro[2]).length()
+                : qRadiansToDegrees(rotationVector(m_raw.conjugated() * rotation).length()) / dt;
+        m_raw = rotation;
+        m_speed += alpha(speedCutoff, dt) * (speed - m_speed);
+        m_rotation = QQuaternion::slerp(m_rotation, rotation, alpha(minCutoff + beta * m_speed, dt));
+        return m_rotation;
+    }
+
+private:
+    static float alpha(float cutoff, float dt)
+    {
+        const float tau = 1.0f / (2.0f * float(M_PI) * cutoff);
+        return 1.0f / (1.0f + tau / dt);
+    }
+
+    qint64 m_last = 0;
+    QQuaternion m_raw, m_rotation;
+    float m_speed = 0.0f;
+};
+
+/*
+ * The multiplicative Kalman filter of the rotation: predicted by the gyro rates, corrected by
+ * the sensor rotation as the measurement. The error state is the small rotation vector of
+ * the estimate, isotropic so its covariance is a scalar.
+ */
+class KalmanFilter
+{
+public:
+    float gyroNoise = 1e-4f; // rad2/s, the process noise of the rate integration
+    float rotationNoise = 1e-5f; // rad2, the measurement noise of the sensor rotation
+
+    void reset() { m_last = 0; }
+
+    QQuaternion update(const SensorSample &sample)
+    {
+        const QQuaternion measured = sample.rotation();
+        const float dt = sampleTime(sample.timestamp, m_last);
+        m_last = sample.timestamp;
+        if (dt <= 0.0f) {
+            m_rotation = measured;
+            m_variance = rotationNoise;
+            return m_rotation;
+        }
+
+        // Predict by the body rates, the variance grows by the time
+        if (sample.fields & SensorSample::GyroField) {
+            const QVector3D rate(sample.gyro[0], sample.gyro[1], sample.gyro[2]);
+            m_rotation = m_rotation * fromRotationVector(rate * (float(M_PI) / 180.0f * dt));
+        }
+        m_variance += gyroNoise * dt;
+
+        // Correct by the measured rotation, in the body frame of the estimate
+        const float gain = m_variance / (m_variance + rotationNoise);
+        const QVector3D error = rotationVector(m_rotation.conjugated() * shorterArc(m_rotation, measured));
+        m_rotation = (m_rotation * fromRotationVector(error * gain)).normalized();
+        m_variance *= 1.0f - gain;
+        return m_rotation;
+    }
+
+private:
+    qint64 m_last = 0;
+    QQuaternion m_rotation;
+    float m_variance = 0.0f;
+};
+
+/*
+ * The Madgwick filter of the raw gyro rates, the acceleration with gravity and, if reported,
+ * the magnetic field: the rates integrated and corrected by a gradient descent step of beta
+ * towards the rotation matching the measured gravity and field. Starts from the sensor
+ * rotation so the heading is of the sensor; without the field the heading is of the gyro.
+ */
+class MadgwickFilter
+{
+public:
+    float beta = 0.05f; // rad/s, of the gradient step
+
+    void reset() { m_last = 0; }
+
+    QQuaternion update(const SensorSample &sample)
+    {
+        const float dt = sampleTime(sample.timestamp, m_last);
+        m_last = sample.timestamp;
+        if (dt <= 0.0f || !(sample.fields & SensorSample::GyroField)) {
+            m_q = sample.rotation();
+            return m_q;
+        }
+        const float d2r = float(M_PI) / 180.0f;
+        const QQuaternion rate(0.0f, sample.gyro[0] * d2r, sample.gyro[1] * d2r, sample.gyro[2] * d2r);
+        QQuaternion dq = m_q * rate * 0.5f;
+
+        QVector3D a(sample.gravity[0], sample.gravity[1], sample.gravity[2]);
+        if ((sample.fields & SensorSample::GravityField) && a.lengthSquared() > 0.0f) {
+            a.normalize();
+            const float q0 = m_q.scalar(), q1 = m_q.x(), q2 = m_q.y(), q3 = m_q.z();
+            float grad[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+            // The world up in the body axes less the measured one, by the Jacobian rows
+            const float fg[3] = {
+                2.0f * (q1 * q3 - q0 * q2) - a.x(),
+                2.0f * (q0 * q1 + q2 * q3) - a.y(),
+                1.0f - 2.0f * (q1 * q1 + q2 * q2) - a.z()
+            };
+            const float jg[3][4] = {
+                { -2.0f * q2, 2.0f * q3, -2.0f * q0, 2.0f * q1 },
+                { 2.0f * q1, 2.0f * q0, 2.0f * q3, 2.0f * q2 },
+                { 0.0f, -4.0f * q1, -4.0f * q2, 0.0f }
+            };
+            accumulate(grad, jg, fg);
+
+            // The field of the world (bx, 0, bz) by the estimate, the same way
+            QVector3D m(sample.mag[0], sample.mag[1], sample.mag[2]);
+            if ((sample.fields & SensorSample::MagField) && m.lengthSquared() > 0.0f) {
+                m.normalize();
+                const QVector3D h = m_q.rotatedVector(m);
+                const float bx = std::hypot(h.x(), h.y()), bz = h.z();
+                const float fm[3] = {
+                    bx * (1.0f - 2.0f * (q2 * q2 + q3 * q3)) + 2.0f * bz * (q1 * q3 - q0 * q2) - m.x(),
+                    2.0f * bx * (q1 * q2 - q0 * q3) + 2.0f * bz * (q0 * q1 + q2 * q3) - m.y(),
+                    2.0f * bx * (q0 * q2 + q1 * q3) + bz * (1.0f - 2.0f * (q1 * q1 + q2 * q2)) - m.z()
+                };
+                const float jm[3][4] = {
+                    { -2.0f * bz * q2, 2.0f * bz * q3, -4.0f * bx * q2 - 2.0f * bz * q0, -4.0f * bx * q3 + 2.0f * bz * q1 },
+                    { -2.0f * bx * q3 + 2.0f * bz * q1, 2.0f * bx * q2 + 2.0f * bz * q0, 2.0f * bx * q1 + 2.0f * bz * q3, -2.0f * bx * q0 + 2.0f * bz * q2 },
+                    { 2.0f * bx * q2, 2.0f * bx * q3 - 4.0f * bz * q1, 2.0f * bx * q0 - 4.0f * bz * q2, 2.0f * bx * q1 }
+                };
+                accumulate(grad, jm, fm);
+            }
+            const QQuaternion step(grad[0], grad[1], grad[2], grad[3]);
+            if (step.lengthSquared() > 0.0f) dq -= step.normalized() * beta;
+        }
+        m_q = (m_q + dq * dt).normalized();
+        return m_q;
+    }
+
+private:
+    static void accumulate(float *grad, const float (*jacobian)[4], const float *f)
+    {
+        for (int row = 0; row < 3; row++)
+            for (int i = 0; i < 4; i++)
+                grad[i] += jacobian[row][i] * f[row];
+    }
+
+    qint64 m_last = 0;
+    QQuaternion m_q;
+};
+
+} // namespace SensorFilters
+
+/*
+ * The filter bank of SerialSensor, one of the filters above by its type. All of them are
+ * members, switching resets the chosen one to the next sample.
+ */
+class SensorFilter
+{
+public:
+    enum Type { None, OneEuro, Kalman, Madgwick };
+
+    int type() const { return m_type; }
+    void setType(int type)
+    {
+        m_type = qBound(int(None), type, int(Madgwick));
+        reset();
+    }
+
+    void reset()
+    {
+        m_oneEuro.reset();
+        m_kalman.reset();
+        m_madgwick.reset();
+    }
+
+    QQuaternion update(const SensorSample &sample)
+    {
+        switch (m_type) {
+        case OneEuro:  return m_oneEuro.update(sample);
+        case Kalman:   return m_kalman.update(sample);
+        case Madgwick: return m_madgwick.update(sample);
+        }
+        return sample.rotation();
+    }
+
+private:
+    int m_type = None;
+    SensorFilters::OneEuroFilter m_oneEuro;
+    SensorFilters::KalmanFilter m_kalman;
+    SensorFilters::MadgwickFilter m_madgwick;
+};
+
+#endif // SENSORFILTERS_H
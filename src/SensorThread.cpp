@@ -0,0 +1,455 @@
+#include "SensorThread.h"
+#include "PoseRing.h"
+
+#include <QtDebug>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/file.h>
+#include <sys/ioctl.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#ifdef __linux__
+#include <linux/serial.h>
+#endif
+
+//#define TRACE_SENSORTHREAD
+#ifdef  TRACE_SENSORTHREAD
+#include <QTime>
+#define TRACE()      qDebug() << QTime::currentTime().toString("hh:mm:ss.zzz") << QThread::currentThreadId() << Q_FUNC_INFO;
+#define TRACE_ARG(x) qDebug() << QTime::currentTime().toString("hh:mm:ss.zzz") << QThread::currentThreadId() << Q_FUNC_INFO << x;
+#else
+#define TRACE()
+#define TRACE_ARG(x)
+#endif
+
+static speed_t termiosSpeed(int rate)
+{
+    switch (rate) {
+    case 9600:   return B9600;
+    case 19200:  return B19200;
+    case 38400:  return B38400;
+    case 57600:  return B57600;
+    case 115200: return B115200;
+    case 230400: return B230400;
+    }
+    return B0;
+}
+
+static qint16 int16At(const quint8 *buf, int pos)
+{
+    return qint16((quint16(buf[pos + 1]) << 8) | buf[pos]);
+}
+
+static qint32 int24At(const quint8 *buf, int pos)
+{
+    quint32 value = (quint32(buf[pos + 2]) << 16) | (quint32(buf[pos + 1]) << 8) | quint32(buf[pos]);
+    if (value & 0x800000) value |= 0xff000000; // negative, the sign extended to 32 bits
+    return qint32(value);
+}
+
+SensorThread::SensorThread(QObject *parent)
+    : QThread(parent)
+    , m_baudRate(115200)
+    , m_fd(-1)
+    , m_eventFd(-1)
+    , m_lowLatency(false)
+    , m_clear(false)
+    , m_stopped(false)
+    , m_notified(false)
+    , m_globalCS(0)
+    , m_globalI(0)
+    , m_rxIndex(0)
+    , m_cmdLen(0)
+{
+}
+
+SensorThread::~SensorThread()
+{
+    close();
+}
+
+QString SensorThread::portName() const
+{
+    return m_portName;
+}
+
+void SensorThread::setPortName(const QString &name)
+{
+    m_portName = name;
+}
+
+int SensorThread::baudRate() const
+{
+    return m_baudRate;
+}
+
+bool SensorThread::setBaudRate(int rate)
+{
+    const speed_t speed = termiosSpeed(rate);
+    if (speed == B0) return false;
+    m_baudRate = rate;
+    if (m_fd < 0) return true;
+    termios tio;
+    if (tcgetattr(m_fd, &tio) != 0) return false;
+    cfsetispeed(&tio, speed);
+    cfsetospeed(&tio, speed);
+    return tcsetattr(m_fd, TCSANOW, &tio) == 0;
+}
+
+QString SensorThread::errorText() const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_errorText;
+}
+
+void SensorThread::setError(const QString &text)
+{
+    {
+        QMutexLocker lock(&m_mutex);
+        m_errorText = text;
+    }
+    emit errorOccurred(text);
+}
+
+bool SensorThread::open()
+{
+    TRACE_ARG(m_portName << m_baudRate);
+    close();
+    const QString path = m_portName.contains('/') ? m_portName : QStringLiteral("/dev/") + m_portName;
+    int fd = ::open(path.toLocal8Bit().constData(), O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) {
+        setError(QStringLiteral("Can't open %1: %2").arg(path, QString::fromLocal8Bit(strerror(errno))));
+        return false;
+    }
+
+    // The tracker daemon and the player never share the port
+    if (flock(fd, LOCK_EX | LOCK_NB) != 0) {
+        setError(QStringLiteral("%1 is in use by another process").arg(path));
+        ::close(fd);
+        return false;
+    }
+    ioctl(fd, TIOCEXCL);
+
+    termios tio;
+    if (tcgetattr(fd, &tio) != 0) {
+        setError(QStringLiteral("%1 is not a serial port: %2").arg(path, QString::fromLocal8Bit(strerror(errno))));
+        ::close(fd);
+        return false;
+    }
+    cfmakeraw(&tio);
+    tio.c_cflag |= CLOCAL | CREAD;
+    tio.c_cc[VMIN] = 0; // never blocks, epoll waits
+    tio.c_cc[VTIME] = 0;
+    cfsetispeed(&tio, termiosSpeed(m_baudRate));
+    cfsetospeed(&tio, termiosSpeed(m_baudRate));
+    if (tcsetattr(fd, TCSANOW, &tio) != 0) {
+        setError(QStringLiteral("Can't set up %1: %2").arg(path, QString::fromLocal8Bit(strerror(errno))));
+        ::close(fd);
+        return false;
+    }
+    tcflush(fd, TCIOFLUSH);
+
+    // The bytes are passed on at once instead of by the tty flip buffer work, if the driver can
+    m_lowLatency = false;
+#ifdef __linux__
+    serial_struct serial;
+    if (ioctl(fd, TIOCGSERIAL, &serial) == 0) {
+        serial.flags |= ASYNC_LOW_LATENCY;
+        m_lowLatency = (ioctl(fd, TIOCSSERIAL, &serial) == 0);
+    }
+#endif
+    m_eventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_eventFd < 0) {
+        setError(QStringLiteral("Can't create eventfd: %1").arg(QString::fromLocal8Bit(strerror(errno))));
+        ::close(fd);
+        return false;
+    }
+    m_fd = fd;
+    {
+        QMutexLocker lock(&m_mutex);
+        m_output.clear();
+        m_clear = m_stopped = false;
+        m_errorText.clear();
+    }
+    m_rxIndex = 0;
+    m_notified.store(false, std::memory_order_relaxed);
+    TRACE_ARG(path << "low latency" << m_lowLatency);
+    start(QThread::TimeCriticalPriority);
+    return true;
+}
+
+void SensorThread::close()
+{
+    if (m_fd < 0) return;
+    TRACE();
+    {
+        QMutexLocker lock(&m_mutex);
+        m_stopped = true;
+    }
+    wake();
+    wait();
+    ::close(m_eventFd);
+    ::close(m_fd);
+    m_eventFd = m_fd = -1;
+}
+
+void SensorThread::wake()
+{
+    const quint64 one = 1;
+    if (m_eventFd >= 0 && ::write(m_eventFd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+        qWarning() << Q_FUNC_INFO << "Can't wake the sensor thread" << strerror(errno);
+}
+
+qint64 SensorThread::write(const QByteArray &data)
+{
+    if (m_fd < 0) return -1;
+    {
+        QMutexLocker lock(&m_mutex);
+        m_output += data;
+    }
+    wake();
+    return data.size();
+}
+
+void SensorThread::clear()
+{
+    if (m_fd < 0) return;
+    {
+        QMutexLocker lock(&m_mutex);
+        m_output.clear();
+        m_clear = true;
+    }
+    wake();
+}
+
+void SensorThread::samplesTaken()
+{
+    m_notified.store(false, std::memory_order_release);
+}
+
+void SensorThread::run()
+{
+    TRACE();
+    int epollFd = epoll_create1(EPOLL_CLOEXEC);
+    epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.fd = m_eventFd;
+    bool ok = (epollFd >= 0 && epoll_ctl(epollFd, EPOLL_CTL_ADD, m_eventFd, &event) == 0);
+    event.data.fd = m_fd;
+    ok = (ok && epoll_ctl(epollFd, EPOLL_CTL_ADD, m_fd, &event) == 0);
+    if (!ok) {
+        setError(QStringLiteral("Can't poll %1: %2").arg(m_portName, QString::fromLocal8Bit(strerror(errno))));
+        if (epollFd >= 0) ::close(epollFd);
+        return;
+    }
+
+    quint8 buf[256];
+    epoll_event events[2];
+    for (;;) {
+        const int count = epoll_wait(epollFd, events, 2, -1);
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            setError(QStringLiteral("Polling %1 failed: %2").arg(m_portName, QString::fromLocal8Bit(strerror(errno))));
+            break;
+        }
+        bool failed = false;
+        for (int i = 0; i < count && !failed; i++) {
+            if (events[i].data.fd == m_eventFd) {
+                quint64 value;
+                while (::read(m_eventFd, &value, sizeof(value)) > 0) {}
+                bool clear;
+                {
+                    QMutexLocker lock(&m_mutex);
+                    if (m_stopped) goto stopped;
+                    clear = m_clear;
+                    m_clear = false;
+                }
+                if (clear) {
+                    tcflush(m_fd, TCIFLUSH);
+                    m_rxIndex = 0;
+                }
+                failed = !flushOutput(epollFd);
+                continue;
+            }
+            if (events[i].events & EPOLLOUT)
+                failed = !flushOutput(epollFd);
+            if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                setError(QStringLiteral("%1 is gone, e.g. the device was removed").arg(m_portName));
+                failed = true;
+                break;
+            }
+            if (!(events[i].events & EPOLLIN)) continue;
+            for (;;) {
+                const ssize_t len = ::read(m_fd, buf, sizeof(buf));
+                if (len > 0) {
+                    // Stamped as read, a packet arrives within one read with the low latency
+                    parse(buf, int(len), PoseRing::monotonicTime());
+                    continue;
+                }
+                if (len < 0 && errno == EINTR) continue;
+                if (len < 0 && errno == EAGAIN) break;
+                setError(QStringLiteral("Reading %1 failed: %2").arg(m_portName,
+                         len ? QString::fromLocal8Bit(strerror(errno)) : QStringLiteral("hang up")));
+                failed = true;
+                break;
+            }
+        }
+        if (failed) break;
+    }
+stopped:
+    ::close(epollFd);
+    TRACE_ARG("Finished");
+}
+
+bool SensorThread::flushOutput(int epollFd)
+{
+    QMutexLocker lock(&m_mutex);
+    while (!m_output.isEmpty()) {
+        const ssize_t len = ::write(m_fd, m_output.constData(), m_output.size());
+        if (len > 0) {
+            m_output.remove(0, len);
+            continue;
+        }
+        if (len < 0 && errno == EINTR) continue;
+        if (len < 0 && errno == EAGAIN) break;
+        lock.unlock();
+        setError(QStringLiteral("Writing %1 failed: %2").arg(m_portName, QString::fromLocal8Bit(strerror(errno))));
+        return false;
+    }
+
+    // Waits for the room in the output buffer while there is more to write
+    epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = m_output.isEmpty() ? EPOLLIN : EPOLLIN | EPOLLOUT;
+    event.data.fd = m_fd;
+    epoll_ctl(epollFd, EPOLL_CTL_MOD, m_fd, &event);
+    return true;
+}
+
+void SensorThread::parse(const quint8 *buf, int len, qint64 time)
+{
+    // Calculate the check code while receiving the data. The check code is the sum of the data from
+    // the beginning of the address code (including the address code) to before the check code.
+    for (int i = 0; i < len; i++) {
+        m_globalCS += buf[i];
+        switch (m_rxIndex) {
+        case 0: // Start code
+            if (buf[i] == cmdPacketBegin) {
+                m_globalI = 0;
+                m_buf[m_globalI++] = cmdPacketBegin;
+                m_globalCS = 0; // Calculate the check code starting from the next byte
+                m_rxIndex = 1;
+            }
+            break;
+        case 1: // The address code of the data body
+            m_buf[m_globalI++] = buf[i];
+            if (buf[i] == 255) { // 255 is the broadcast address, module as slave, Its address cannot appear 255
+                m_rxIndex = 0;
+            } else {
+                m_rxIndex++;
+            }
+            break;
+        case 2: // The length of the data body
+            m_buf[m_globalI++] = buf[i];
+            if (buf[i] > cmdPacketMaxDatSizeRx || buf[i] == 0) { // Invalid length
+                m_rxIndex = 0;
+            } else {
+                m_rxIndex++;
+                m_cmdLen = buf[i];
+            }
+            break;
+        case 3: // Get the data of the data body
+            m_buf[m_globalI++] = buf[i];
+            if (m_globalI >= m_cmdLen + 3) { // Data body has been received
+                m_rxIndex++;
+            }
+            break;
+        case 4: // Compare verification code
+            m_globalCS -= buf[i];
+            if ((m_globalCS & 0xff) == buf[i]) { // Verification is correct
+                m_buf[m_globalI++] = buf[i];
+                m_rxIndex++;
+            } else { // Verification failed
+                m_rxIndex = 0;
+            }
+            break;
+        case 5: // End code
+            m_rxIndex = 0;
+            if (buf[i] == cmdPacketEnd) { // Get the complete package
+                m_buf[m_globalI++] = buf[i];
+                unpack(m_buf + 3, m_globalI - 5, time); // Process the data body of the packet
+            }
+            break;
+        default:
+            m_rxIndex = 0;
+            break;
+        }
+    }
+}
+
+void SensorThread::unpack(const quint8 *buf, int size, qint64 time)
+{
+    static const float scaleAccel       = 0.00478515625f;
+    static const float scaleQuat        = 0.000030517578125f;
+    static const float scaleAngle       = 0.0054931640625f;
+    static const float scaleAngleSpeed  = 0.06103515625f;
+    static const float scaleMag         = 0.15106201171875f;
+    static const float scaleTemperature = 0.01f;
+    static const float scaleAirPressure = 0.0002384185791f;
+    static const float scaleHeight      = 0.0010728836f;
+
+    if (size < 7 || buf[0] != 0x11) return; // Data head not defined
+
+    SensorSample sample;
+    memset(&sample, 0, sizeof(sample));
+    sample.timestamp = time;
+    sample.fields = ((buf[2] << 8) | buf[1]) & 0x7f;
+    sample.sensorTime = (quint32(buf[6]) << 24) | (quint32(buf[5]) << 16) | (quint32(buf[4]) << 8) | quint32(buf[3]);
+
+    // From the 7th byte on, the data by the subscription tags in this order
+    static const int fieldBytes[] = { 6, 6, 6, 6, 8, 8, 6 };
+    int needed = 7;
+    for (int i = 0; i < 7; i++)
+        if (sample.fields & (1 << i)) needed += fieldBytes[i];
+    if (size < needed) return; // truncated
+
+    int len = 7;
+    auto vector = [&](float *dst, int count, float scale) {
+        for (int i = 0; i < count; i++, len += 2)
+            dst[i] = int16At(buf, len) * scale;
+    };
+    if (sample.fields & SensorSample::AccelField) vector(sample.accel, 3, scaleAccel);
+    if (sample.fields & SensorSample::GravityField) vector(sample.gravity, 3, scaleAccel);
+    if (sample.fields & SensorSample::GyroField) vector(sample.gyro, 3, scaleAngleSpeed);
+    if (sample.fields & SensorSample::MagField) vector(sample.mag, 3, scaleMag);
+    if (sample.fields & SensorSample::EnvField) {
+        sample.temperature = int16At(buf, len) * scaleTemperature; len += 2;
+        sample.pressure = int24At(buf, len) * scaleAirPressure; len += 3;
+        sample.height = int24At(buf, len) * scaleHeight; len += 3;
+    }
+    if (sample.fields & SensorSample::QuatField) vector(sample.quat, 4, scaleQuat);
+    if (sample.fields & SensorSample::EulerField) vector(sample.euler, 3, scaleAngle);
+
+    m_samples.push(sample);
+    if (!m_notified.exchange(true, std::memory_order_acq_rel))
+        emit samplesReady();
+}
+
+QQuaternion SensorSample::rotation() const
+{
+    if (fields & QuatField)
+        return QQuaternion(quat[0], quat[1], quat[2], quat[3]).normalized();
+    if (!(fields & EulerField))
+        return QQuaternion();
+    // The yaw, pitch, roll about the z, y, x axes of the sensor in this order
+    return QQuaternion::fromAxisAndAngle(0.0f, 0.0f, 1.0f, euler[2]) *
+           QQuaternion::fromAxisAndAngle(0.0f, 1.0f, 0.0f, euler[1]) *
+           QQuaternion::fromAxisAndAngle(1.0f, 0.0f, 0.0f, euler[0]);
+}
+
@@ -0,0 +1,124 @@
+#ifndef SENSORTHREAD_H
+#define SENSORTHREAD_H
+
+#include <QThread>
+#include <QMutex>
+#include <QString>
+#include <QByteArray>
+#include <QQuaternion>
+
+#include <atomic>
+
+#include "SampleRing.h"
+
+// A decoded data packet of the sensor, the fields by its subscription tags
+struct SensorSample
+{
+    enum Field {
+        AccelField   = 0x01, // without gravity
+        GravityField = 0x02, // the acceleration with gravity
+        GyroField    = 0x04,
+        MagField     = 0x08,
+        EnvField     = 0x10, // temperature, air pressure and height
+        QuatField    = 0x20,
+        EulerField   = 0x40
+    };
+
+    qint64 timestamp; // CLOCK_MONOTONIC us of the reception by the host
+    quint32 sensorTime; // ms by the sensor clock
+    quint32 fields; // of Field
+    float accel[3]; // m/s2
+    float gravity[3]; // m/s2
+    float gyro[3]; // degree/s
+    float mag[3]; // uT
+    float temperature, pressure, height; // C, Pa, m
+    float quat[4]; // w, x, y, z
+    float euler[3]; // degree: x roll, y pitch, z yaw
+
+    bool hasRotation() const { return fields & (QuatField | EulerField); }
+    QQuaternion rotation() const; // of the sensor axes, by the quaternion else the Euler angles
+};
+
+/*
+ * The serial port of the sensor on its own thread, by a blocking epoll read of the raw
+ * termios port with the low latency flag of the driver where available, so the packets are
+ * taken as they arrive whatever the GUI thread does. The decoded packets are stamped with
+ * the host time and pushed into the lock-free ring for the consumers of any thread, which
+ * take the samples by their serial since the last ones they read. There is no read
+ * interpolated at a past time: the pose is predicted ahead from the newest sample only
+ * (PosePredictor), the older ones are there for the consumers that fell behind.
+ *
+ * The packet format is of the Waveshare 10_OF_ROS_IMO_(A) sensor, see SerialSensor.
+ */
+class SensorThread : public QThread
+{
+    Q_OBJECT
+public:
+    static constexpr int const sampleCount = 256; // about a second at the top rate of 250Hz
+    typedef SampleRing<SensorSample, sampleCount> Ring;
+
+    static constexpr int const cmdPacketBegin = 0x49; // Start code
+    static constexpr int const cmdPacketEnd   = 0x4D; // End code
+    // The maximum length of the data body of the data packet sent by the module
+    static constexpr int const cmdPacketMaxDatSizeRx = 73;
+
+    explicit SensorThread(QObject *parent = nullptr);
+    ~SensorThread() override;
+
+    QString portName() const;
+    void setPortName(const QString &name); // ttyAMA0 in /dev or a path, taken by open()
+
+    int baudRate() const;
+    bool setBaudRate(int rate); // applied at once if open, false if not supported
+
+    bool open(); // the port and the I/O thread, false with errorText()
+    void close(); // stops the thread, the pending writes are dropped
+    bool isOpen() const { return m_fd >= 0; }
+    bool isLowLatency() const { return m_lowLatency; } // the driver took ASYNC_LOW_LATENCY
+    QString errorText() const;
+
+    qint64 write(const QByteArray &data); // by the I/O thread, the size or -1 if not open
+    void clear(); // the pending writes and the unread input
+
+    // Lock-free, any thread
+    const Ring &samples() const { return m_samples; }
+    void samplesTaken(); // by the consumer of samplesReady, before reading the ring
+
+signals:
+    void samplesReady(); // once until samplesTaken()
+    void errorOccurred(const QString &text);
+
+protected:
+    void run() override;
+
+private:
+    void setError(const QString &text);
+    void wake(); // the I/O thread out of epoll_wait
+    bool flushOutput(int epollFd); // false if failed
+    void parse(const quint8 *data, int size, qint64 time);
+    void unpack(const quint8 *data, int size, qint64 time);
+
+    QString m_portName;
+    int m_baudRate;
+    int m_fd;
+    int m_eventFd; // wakes the I/O thread to write or stop
+    bool m_lowLatency;
+
+    mutable QMutex m_mutex;
+    QByteArray m_output; // to be written by the I/O thread
+    bool m_clear;
+    bool m_stopped;
+    QString m_errorText;
+
+    Ring m_samples;
+    std::atomic<bool> m_notified;
+
+    // The parser state of the I/O thread
+    int m_globalCS; // Checksum
+    int m_globalI;
+    int m_rxIndex;
+    quint8 m_buf[5 + cmdPacketMaxDatSizeRx]; // Receive packet cache
+    int m_cmdLen; // length
+};
+
+#endif // SENSORTHREAD_H
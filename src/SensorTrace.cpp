@@ -0,0 +1,172 @@
+#include "SensorTrace.h"
+#include "SensorFilters.h"
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QTextStream>
+#include <QVector3D>
+#include <QtMath>
+#include <QtDebug>
+
+#include <cstring>
+#include <iterator>
+
+//static
+QByteArray SensorTrace::header()
+{
+    return QByteArrayLiteral("# timestamp_us quat_w quat_x quat_y quat_z gyro_x gyro_y gyro_z "
+                             "grav_x grav_y grav_z mag_x mag_y mag_z (degree/s, m/s2, uT)\n");
+}
+
+//static
+QByteArray SensorTrace::line(const SensorSample &sample)
+{
+    if (!sample.hasRotation() || !(sample.fields & SensorSample::GyroField)) return QByteArray();
+    const QQuaternion rotation = sample.rotation();
+    const bool gravity = (sample.fields & SensorSample::GravityField);
+    const bool mag = (sample.fields & SensorSample::MagField);
+    return QStringLiteral("%1 %2 %3 %4 %5 %6 %7 %8 %9 %10 %11 %12 %13 %14\n").arg(sample.timestamp)
+            .arg(rotation.scalar(), 0, 'f', 6).arg(rotation.x(), 0, 'f', 6)
+            .arg(rotation.y(), 0, 'f', 6).arg(rotation.z(), 0, 'f', 6)
+            .arg(sample.gyro[0], 0, 'f', 3).arg(sample.gyro[1], 0, 'f', 3).arg(sample.gyro[2], 0, 'f', 3)
+            .arg(gravity ? sample.gravity[0] : 0.0f, 0, 'f', 3)
+            .arg(gravity ? sample.gravity[1] : 0.0f, 0, 'f', 3)
+            .arg(gravity ? sample.gravity[2] : 0.0f, 0, 'f', 3)
+            .arg(mag ? sample.mag[0] : 0.0f, 0, 'f', 2)
+            .arg(mag ? sample.mag[1] : 0.0f, 0, 'f', 2)
+            .arg(mag ? sample.mag[2] : 0.0f, 0, 'f', 2).toLatin1();
+}
+
+bool SensorTrace::load(const QString &fileName)
+{
+    m_samples.clear();
+    m_rotations.clear();
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        qCritical().noquote() << "Can't open" << fileName << file.errorString();
+        return false;
+    }
+    QTextStream stream(&file);
+    while (!stream.atEnd()) {
+        const QString text = stream.readLine().trimmed();
+        if (text.isEmpty() || text.startsWith('#')) continue;
+        const auto fields = QStringView(text).split(' ', Qt::SkipEmptyParts);
+        bool ok = (fields.size() == 8 || fields.size() == 14);
+        SensorSample sample;
+        memset(&sample, 0, sizeof(sample));
+        sample.timestamp = ok ? fields.at(0).toLongLong(&ok) : 0;
+        float values[13] = {};
+        for (int i = 1; ok && i < fields.size(); i++) values[i - 1] = fields.at(i).toFloat(&ok);
+        if (!ok) {
+            qCritical().noquote() << "Bad trace line:" << text;
+            return false;
+        }
+        sample.fields = SensorSample::QuatField | SensorSample::GyroField;
+        memcpy(sample.quat, values, sizeof(sample.quat));
+        memcpy(sample.gyro, values + 4, sizeof(sample.gyro));
+        memcpy(sample.gravity, values + 7, sizeof(sample.gravity));
+        memcpy(sample.mag, values + 10, sizeof(sample.mag));
+        if (sample.gravity[0] || sample.gravity[1] || sample.gravity[2]) sample.fields |= SensorSample::GravityField;
+        if (sample.mag[0] || sample.mag[1] || sample.mag[2]) sample.fields |= SensorSample::MagField;
+        if (!m_samples.isEmpty() && sample.timestamp <= m_samples.last().timestamp) continue;
+        m_samples.append(sample);
+        m_rotations.append(sample.rotation());
+    }
+    if (m_samples.size() < 2) {
+        qCritical().noquote() << "The trace is too short:" << fileName;
+        return false;
+    }
+    return true;
+}
+
+qint64 SensorTrace::duration() const
+{
+    return m_samples.size() < 2 ? 0 : m_samples.last().timestamp - m_samples.first().timestamp;
+}
+
+qreal SensorTrace::rate() const
+{
+    const qint64 time = duration();
+    return time > 0 ? (m_samples.size() - 1) * 1e6 / time : 0.0;
+}
+
+QQuaternion SensorTrace::rotationAt(qint64 time, int &index) const
+{
+    while (index + 1 < m_samples.size() && m_samples.at(index + 1).timestamp <= time) index++;
+    if (index + 1 >= m_samples.size() || time <= m_samples.at(index).timestamp) return m_rotations.at(index);
+    const qint64 a = m_samples.at(index).timestamp, b = m_samples.at(index + 1).timestamp;
+    return QQuaternion::slerp(m_rotations.at(index), m_rotations.at(index + 1), float(time - a) / (b - a));
+}
+
+// The angle of the rotation between in degree
+static qreal angleBetween(const QQuaternion &a, const QQuaternion &b)
+{
+    return qRadiansToDegrees(SensorFilters::rotationVector(a.conjugated() * b).length());
+}
+
+//static
+int SensorTrace::benchmarkFilters(const QString &traceFile)
+{
+    static constexpr qreal restSpeed = 3.0; // degree/s of the gyro, below is at rest
+    static constexpr qreal turnSpeed = 30.0; // degree/s, above is turning
+    static constexpr int maxLag = 150; // ms
+
+    SensorTrace trace;
+    if (!trace.load(traceFile)) return 1;
+    QVector<bool> resting(trace.size()), turning(trace.size());
+    int rests = 0, turns = 0;
+    for (int i = 0; i < trace.size(); i++) {
+        const float *gyro = trace.sample(i).gyro;
+        const qreal speed = QVector3D(gyro[0], gyro[1], gyro[2]).length();
+        resting[i] = (speed < restSpeed);
+        turning[i] = (speed > turnSpeed && trace.sample(i).timestamp - maxLag * 1000 >= trace.sample(0).timestamp);
+        rests += resting.at(i);
+        turns += turning.at(i);
+    }
+    qInfo().noquote() << QString("Sensor filters of %1: %2 samples at %3 Hz, %4 at rest, %5 turning")
+                         .arg(traceFile).arg(trace.size()).arg(trace.rate(), 0, 'f', 1).arg(rests).arg(turns);
+    qInfo().noquote() << "filter      lag   error at lag   jitter at rest   time per sample";
+
+    static const char *const names[] = { "none", "one-euro", "kalman", "madgwick" };
+    QVector<QQuaternion> output(trace.size());
+    for (int type = SensorFilter::None; type < int(std::size(names)); type++) {
+        SensorFilter filter;
+        filter.setType(type);
+        QElapsedTimer timer;
+        timer.start();
+        for (int i = 0; i < trace.size(); i++) output[i] = filter.update(trace.sample(i));
+        const qreal sampleTime = timer.nsecsElapsed() / 1e3 / trace.size(); // us
+
+        // The jitter: the RMS turn between the outputs at rest
+        qreal jitter = 0.0;
+        int count = 0;
+        for (int i = 1; i < trace.size(); i++) {
+            if (!resting.at(i) || !resting.at(i - 1)) continue;
+            const qreal angle = angleBetween(output.at(i - 1), output.at(i));
+            jitter += angle * angle;
+            count++;
+        }
+        jitter = count ? qSqrt(jitter / count) : 0.0;
+
+        // The lag: the delay of the raw rotations matching the outputs best while turning
+        int lag = 0;
+        qreal lagError = 0.0;
+        for (int delay = 0; turns && delay <= maxLag; delay++) {
+            qreal error = 0.0;
+            int index = 0;
+            for (int i = 0; i < trace.size(); i++) {
+                if (turning.at(i))
+                    error += angleBetween(output.at(i), trace.rotationAt(trace.sample(i).timestamp - delay * 1000, index));
+            }
+            error /= turns;
+            if (!delay || error < lagError) {
+                lag = delay;
+                lagError = error;
+            }
+        }
+        qInfo().noquote() << QString("%1 %2 ms   %3 deg      %4 deg         %5 us")
+                             .arg(QString::fromLatin1(names[type]), -9).arg(lag, 4)
+                             .arg(lagError, 8, 'f', 3).arg(jitter, 10, 'f', 4).arg(sampleTime, 8, 'f', 2);
+    }
+    return 0;
+}
@@ -0,0 +1,45 @@
+#ifndef SENSORTRACE_H
+#define SENSORTRACE_H
+
+#include <QString>
+#include <QByteArray>
+#include <QVector>
+#include <QQuaternion>
+
+#include "SensorThread.h"
+
+/*
+ * The sample traces of panoramatracker --record, replayed by its --benchmark. A text line per
+ * sample with the rotation and the gyro rates, the gravity and magnetic field if reported:
+ *
+ *   timestamp_us quat_w quat_x quat_y quat_z gyro_x gyro_y gyro_z [grav_x grav_y grav_z mag_x mag_y mag_z]
+ *
+ * The missing vectors are written as zeros, the lines of '#' are comments.
+ */
+class SensorTrace
+{
+public:
+    static QByteArray header();
+    static QByteArray line(const SensorSample &sample); // empty if without the rotation or the rates
+
+    bool load(const QString &fileName); // false if none or bad, logged
+    int size() const { return m_samples.size(); }
+    const SensorSample &sample(int index) const { return m_samples.at(index); }
+    const QQuaternion &rotation(int index) const { return m_rotations.at(index); }
+    qint64 duration() const; // us
+    qreal rate() const; // Hz
+
+    // The recorded rotation at the time, slerped between the samples; index is the search hint
+    // of the ascending times, start from 0
+    QQuaternion rotationAt(qint64 time, int &index) const;
+
+    // Replays the trace through the filters of SensorFilter, their lag behind the turns and
+    // their jitter at rest, 0 if done
+    static int benchmarkFilters(const QString &traceFile);
+
+private:
+    QVector<SensorSample> m_samples;
+    QVector<QQuaternion> m_rotations;
+};
+
+#endif // SENSORTRACE_H
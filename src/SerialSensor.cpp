@@ -1,16 +1,44 @@
 #include "SerialSensor.h"
-#include "Lerp.h"
 
 #include <QSerialPortInfo>
 #include <QByteArray>
 #include <QTimer>
 #include <QMetaMethod>
+#include <QtMath>
 #include <QtDebug>
 
-// round up to 2 digit after point
-static qreal roundTo2(qreal value)
+#include <cmath>
+#include <cstring>
+
+// The rotation of the sensor axes (x ahead, z up) as of the view axes (-z ahead, y up): the
+// cyclic axis swap keeps the handedness, so the sensor pitch, yaw and roll about its y, z and x
+// axes turn the view about its x, y and z axes as QQuaternion::fromEulerAngles() does
+static QQuaternion viewRotation(const QQuaternion &sensor)
+{
+    return QQuaternion(sensor.scalar(), sensor.y(), sensor.z(), sensor.x());
+}
+
+// The sample of the tracker daemon, with the fields its flags tell
+static SensorSample sensorSample(const PoseRing::Pose &pose)
 {
-    return int(value * 100.0 + 0.5) / 100.0;
+    SensorSample sample;
+    memset(&sample, 0, sizeof(sample));
+    sample.timestamp = pose.timestamp;
+    sample.fields = SensorSample::QuatField;
+    memcpy(sample.quat, pose.quat, sizeof(sample.quat));
+    if (pose.flags & poseRates) {
+        sample.fields |= SensorSample::GyroField;
+        memcpy(sample.gyro, pose.rates, sizeof(sample.gyro));
+    }
+    if (pose.flags & poseGravity) {
+        sample.fields |= SensorSample::GravityField;
+        memcpy(sample.gravity, pose.gravity, sizeof(sample.gravity));
+    }
+    if (pose.flags & poseMag) {
+        sample.fields |= SensorSample::MagField;
+        memcpy(sample.mag, pose.mag, sizeof(sample.mag));
+    }
+    return sample;
 }
 
 SerialSensor::SerialSensor(QObject *parent)
@@ -19,25 +47,26 @@ SerialSensor::SerialSensor(QObject *parent)
     , m_calibrate(false)
     , m_enableCompass(false)
     , m_adjustAngle(0)
-    , m_pitchAngle(0.0)
-    , m_yawAngle(0.0)
+    , m_pitchDegree(0)
+    , m_pitchSines{ 1.0f, -1.0f } // none, taken by the first orientation
+    , m_smoothingFactor(1.0)
     , m_threshold(defaultThreshold)
     , m_frequency(defaultFrequency)
     , m_gyroscope(defaultGyroscope)
     , m_accelerometer(defaultAccelerometer)
     , m_magnetometer(defaultMagnetometer)
-    , m_globalCS(0)
-    , m_globalI(0)
-    , m_rxIndex(0)
-    , m_cmdLen(0)
-    // , m_kfYaw(0.1, 0.01, 0.1)
-    // , m_kfPitch(0.1, 0.01, 0.1)
+    , m_sampleSerial(0)
+    , m_useTracker(true)
+    , m_ringSerial(0)
+    , m_ringChecked(0)
+    , m_calibrateRequest(0)
+    , m_displayLatency(0.0)
 {
-    m_serialPort.setReadBufferSize(sizeof(m_buf));
-    m_serialPort.setBaudRate(BaudRate115200);
-    connect(&m_serialPort, &QSerialPort::readyRead, this, &SerialSensor::onReadyRead);
-    connect(&m_serialPort, &QSerialPort::errorOccurred, this, &SerialSensor::setPortError);
-    connect(&m_serialPort, &QSerialPort::baudRateChanged, this, &SerialSensor::baudRateChanged);
+    m_port.setBaudRate(BaudRate115200);
+    connect(&m_port, &SensorThread::samplesReady, this, &SerialSensor::onSamplesReady);
+    connect(&m_port, &SensorThread::errorOccurred, this, &SerialSensor::setErrorText);
+    m_ringTimer.setTimerType(Qt::PreciseTimer);
+    connect(&m_ringTimer, &QTimer::timeout, this, &SerialSensor::onRingTimer);
 }
 
 bool SerialSensor::active() const
@@ -53,32 +82,73 @@ void SerialSensor::setActive(bool yes)
         return;
     }
     if (yes) {
+        m_filter.reset();
+        if (attachTracker()) { // no handshake, the daemon keeps the sensor initialized
+            m_active = true;
+            m_ringTimer.start(trackerPollInterval);
+            emit activeChanged();
+            return;
+        }
+        if (!m_port.isOpen() && !m_port.portName().isEmpty() && !m_port.open()) {
+            qWarning() << Q_FUNC_INFO << "Can't open" << m_port.portName();
+            return;
+        }
         QTimer::singleShot(200, this, &SerialSensor::initSensor);
         return;
     }
-    if (m_serialPort.isOpen()) {
-        m_serialPort.clear();
-        m_serialPort.close();
+    detachTracker();
+    if (m_port.isOpen()) {
+        m_port.clear();
+        m_port.close();
     }
     m_active = false;
     emit activeChanged();
 }
 
+QQuaternion SerialSensor::orientation() const
+{
+    return m_orientation;
+}
+
 qreal SerialSensor::pitchAngle() const
 {
-    // m_pitchAngle = m_kfPitch.updateEstimate(m_pitchAngle);
-    return m_pitchAngle;
+    return m_orientation.toEulerAngles().x();
 }
 
 qreal SerialSensor::yawAngle() const
 {
-    // m_yawAngle = m_kfYaw.updateEstimate(m_pitchAngle);
-    return m_yawAngle;
+    return m_orientation.toEulerAngles().y();
+}
+
+qreal SerialSensor::rollAngle() const
+{
+    return m_orientation.toEulerAngles().z();
+}
+
+int SerialSensor::pitchDegree() const
+{
+    return m_pitchDegree;
+}
+
+void SerialSensor::updatePitchDegree()
+{
+    // The sine of the pitch as QQuaternion::toEulerAngles() of the unit orientation, the arc
+    // sine only once out of the bounds of the last degree
+    const QQuaternion &q = m_orientation;
+    const float sinPitch = qBound(-1.0f, -2.0f * (q.y() * q.z() - q.x() * q.scalar()), 1.0f);
+    if (sinPitch >= m_pitchSines[0] && sinPitch < m_pitchSines[1]) return;
+    const int degree = qRound(qRadiansToDegrees(std::asin(sinPitch)));
+    m_pitchSines[0] = degree <= -90 ? -2.0f : float(std::sin(qDegreesToRadians(degree - 0.5)));
+    m_pitchSines[1] = degree >= 90 ? 2.0f : float(std::sin(qDegreesToRadians(degree + 0.5)));
+    if (degree != m_pitchDegree) {
+        m_pitchDegree = degree;
+        emit pitchDegreeChanged();
+    }
 }
 
 QString SerialSensor::portName() const
 {
-    return m_serialPort.portName();
+    return m_port.portName();
 }
 
 void SerialSensor::setPortName(const QString &name)
@@ -87,8 +157,8 @@ void SerialSensor::setPortName(const QString &name)
     if (was_active) setActive(false);
     if (name.isEmpty()) return;
 
-    m_serialPort.setPortName(name);
-    if (!m_serialPort.open(QSerialPort::ReadWrite)) {
+    m_port.setPortName(name);
+    if (!attachTracker() && !m_port.open()) {
         qWarning() << Q_FUNC_INFO << "Can't open" << name;
         return;
     }
@@ -98,7 +168,7 @@ void SerialSensor::setPortName(const QString &name)
 
 int SerialSensor::baudRate() const
 {
-    return m_serialPort.baudRate();
+    return m_port.baudRate();
 }
 
 void SerialSensor::setBaudRate(int rate) // enum BaudRate
@@ -109,7 +179,10 @@ void SerialSensor::setBaudRate(int rate) // enum BaudRate
     case BaudRate38400:
     case BaudRate57600:
     case BaudRate115200:
-        m_serialPort.setBaudRate(rate);
+        if (rate != m_port.baudRate()) {
+            m_port.setBaudRate(rate);
+            emit baudRateChanged();
+        }
         return;
     }
     qWarning() << Q_FUNC_INFO << "Invalid baudRate" << rate;
@@ -123,7 +196,9 @@ bool SerialSensor::enableCompass() const
 void SerialSensor::setEnableCompass(bool yes)
 {
     if (yes != m_enableCompass) {
-        if (m_active) {
+        if (tracking()) {
+            m_ring.requestCompass(yes);
+        } else if (m_active) {
             setActive(false);
             setActive(true);
         }
@@ -143,9 +218,9 @@ void SerialSensor::setAdjustAngle(int angle)
     if (degree != m_adjustAngle) {
         int diff = m_adjustAngle - degree;
         m_adjustAngle = degree;
-        m_yawAngle -= diff;
+        m_orientation = QQuaternion::fromAxisAndAngle(0.0f, 1.0f, 0.0f, diff) * m_orientation;
         emit adjustAngleChanged();
-        emit yawAngleChanged();
+        emit orientationChanged();
     }
 }
 
@@ -232,6 +307,31 @@ void SerialSensor::setSmoothingFactor(double factor)
     }
 }
 
+int SerialSensor::filter() const
+{
+    return m_filter.type();
+}
+
+void SerialSensor::setFilter(int type) // enum Filter
+{
+    if (type == m_filter.type()) return;
+    m_filter.setType(type);
+    if (m_filter.type() != type)
+        qWarning() << Q_FUNC_INFO << "Unknown filter" << type;
+    emit filterChanged();
+}
+
+//static
+int SerialSensor::parseFilter(const QString &text)
+{
+    const QString name = text.trimmed().toLower();
+    if (name.isEmpty() || name == "none") return FilterNone;
+    if (name == "oneeuro" || name == "one-euro") return FilterOneEuro;
+    if (name == "kalman") return FilterKalman;
+    if (name == "madgwick") return FilterMadgwick;
+    return -1;
+}
+
 QString SerialSensor::errorText() const
 {
     return m_errorText;
@@ -242,34 +342,153 @@ bool SerialSensor::calibrating() const
     return m_calibrate;
 }
 
-void SerialSensor::setPortError(QSerialPort::SerialPortError error)
-{
-    QString text;
-    switch (error) {
-    case QSerialPort::NoError:
-        setErrorText(QString()); return;
-    case QSerialPort::DeviceNotFoundError:
-        text = QStringLiteral("Attempt to open a non-existing device"); break;
-    case QSerialPort::PermissionError:
-        text = QStringLiteral("An attempt to open an already opened device by another process or a user not having enough permission and credentials to open"); break;
-    case QSerialPort::OpenError:
-        text = QStringLiteral("An attempt to open an already opened device in this object"); break;
-    case QSerialPort::NotOpenError:
-        text = QStringLiteral("An attempt to perform an operation that can only be successfully performed if the device is open"); break;
-    case QSerialPort::WriteError:
-        text = QStringLiteral("An I/O error occurred while writing the data"); break;
-    case QSerialPort::ReadError:
-        text = QStringLiteral("An I/O error occurred while reading the data"); break;
-    case QSerialPort::ResourceError:
-        text = QStringLiteral("An I/O error occurred when a resource becomes unavailable, e.g. when the device is unexpectedly removed from the system"); break;
-    case QSerialPort::UnsupportedOperationError:
-        text = QStringLiteral("The requested device operation is not supported or prohibited by the running operating system"); break;
-    case QSerialPort::TimeoutError:
-        text = QStringLiteral("A timeout error occurred"); break;
-    case QSerialPort::UnknownError:
-        text = QStringLiteral("An unidentified error occurred"); break;
-    }
-    setErrorText(portName() + ": " + text);
+void SerialSensor::setCalibrating(bool yes)
+{
+    if (yes != m_calibrate) {
+        m_calibrate = yes;
+        emit calibratingChanged();
+    }
+}
+
+bool SerialSensor::useTracker() const
+{
+    return m_useTracker;
+}
+
+void SerialSensor::setUseTracker(bool yes)
+{
+    if (yes == m_useTracker) return;
+    bool was_active = m_active;
+    if (was_active) setActive(false);
+    m_useTracker = yes;
+    if (was_active) setActive(true);
+    emit useTrackerChanged();
+}
+
+bool SerialSensor::tracking() const
+{
+    return m_ring.isOpen() && !m_ring.isWriter();
+}
+
+int SerialSensor::maxPrediction() const
+{
+    return m_predictor.maxHorizon();
+}
+
+void SerialSensor::setMaxPrediction(int ms)
+{
+    int horizon = m_predictor.maxHorizon();
+    m_predictor.setMaxHorizon(ms);
+    if (m_predictor.maxHorizon() != horizon) emit maxPredictionChanged();
+}
+
+qreal SerialSensor::maxPredictionAngle() const
+{
+    return m_predictor.maxAngle();
+}
+
+void SerialSensor::setMaxPredictionAngle(qreal degree)
+{
+    qreal angle = m_predictor.maxAngle();
+    m_predictor.setMaxAngle(degree);
+    if (m_predictor.maxAngle() != angle) emit maxPredictionAngleChanged();
+}
+
+qreal SerialSensor::displayLatency() const
+{
+    return m_displayLatency;
+}
+
+void SerialSensor::setDisplayLatency(qreal ms)
+{
+    qreal latency = qMax(0.0, ms);
+    if (latency != m_displayLatency) {
+        m_displayLatency = latency;
+        emit displayLatencyChanged();
+    }
+}
+
+bool SerialSensor::setPublishPose(bool yes)
+{
+    if (yes == m_ring.isWriter()) return true;
+    detachTracker();
+    m_ringTimer.stop();
+    m_ring.close();
+    if (!yes) return true;
+    if (!m_ring.create()) return false;
+    m_calibrateRequest = 0;
+    m_ringTimer.start(PoseRing::heartbeatInterval);
+    return true;
+}
+
+bool SerialSensor::attachTracker()
+{
+    if (!m_useTracker || m_ring.isWriter()) return false;
+    if (tracking() && m_ring.isLive()) return true;
+    bool was_tracking = tracking();
+    if (!m_ring.attach()) return false;
+    m_ringSerial = 0; // the filter takes the samples of the ring so far
+    m_ringChecked = PoseRing::monotonicTime();
+    m_filter.reset();
+    m_ring.requestCompass(m_enableCompass);
+    setErrorText(QString());
+    if (!was_tracking) {
+        qInfo().noquote() << "Head tracking by the tracker daemon of" << poseRingName;
+        emit trackingChanged();
+    }
+    return true;
+}
+
+void SerialSensor::detachTracker()
+{
+    if (!tracking()) return;
+    m_ringTimer.stop();
+    m_ring.close();
+    emit trackingChanged();
+}
+
+void SerialSensor::onRingTimer()
+{
+    if (!m_ring.isWriter()) {
+        pollTracker();
+        return;
+    }
+
+    // The daemon: alive even while the sensor is silent, and the requests of the readers
+    m_ring.heartbeat();
+    quint32 request = m_ring.calibrateRequest();
+    if (request != m_calibrateRequest) {
+        m_calibrateRequest = request;
+        if (m_active && !m_calibrate) startCalibrate();
+    }
+    int compass = m_ring.takeCompassRequest();
+    if (compass >= 0 && !m_calibrate) setEnableCompass(compass > 0);
+}
+
+void SerialSensor::pollTracker()
+{
+    const qint64 now = PoseRing::monotonicTime();
+    const quint64 serial = m_ring.latest();
+    if (serial != m_ringSerial) {
+        // All of the samples since the last poll, the filter runs at the sensor rate
+        const quint64 oldest = serial > quint64(PoseRing::slotCount) ? serial - PoseRing::slotCount + 1 : 1;
+        PoseRing::Pose pose;
+        for (quint64 next = qMax(m_ringSerial + 1, oldest); next <= serial; next++) {
+            if (!m_ring.read(next, &pose)) continue; // overwritten meanwhile
+            setCalibrating(pose.flags & poseCalibrating);
+            takeSample(sensorSample(pose));
+        }
+        m_ringSerial = serial;
+        m_ringChecked = now;
+        return;
+    }
+    if (now - m_ringChecked < trackerCheckInterval * 1000) return;
+    m_ringChecked = now;
+    if (m_ring.isLive()) return;
+
+    // The daemon is gone or restarting, its new ring is taken as soon as it is there
+    if (!attachTracker())
+        setErrorText(QStringLiteral("The head tracker daemon is not responding"));
 }
 
 void SerialSensor::setErrorText(const QString &text)
@@ -299,6 +518,10 @@ void SerialSensor::startCalibrate()
         qWarning() << Q_FUNC_INFO << "The calibration already in progress";
         return;
     }
+    if (tracking()) { // the daemon calibrates, its samples tell the progress
+        m_ring.requestCalibrate();
+        return;
+    }
     connect(this, &SerialSensor::initialized, this, &SerialSensor::calibrateSequence);
     m_calibrate = true;
     initSensor();
@@ -311,7 +534,7 @@ void SerialSensor::startCalibrate()
  */
 void SerialSensor::initSensor()
 {
-    if (!m_serialPort.isOpen()) {
+    if (!m_port.isOpen()) {
         qWarning() << Q_FUNC_INFO << "The serial port is not open";
         return;
     }
@@ -370,7 +593,7 @@ void SerialSensor::calibrateSequence()
         // 6. Z axis angle reset to zero
         transmitData(QByteArray(1, 0x05));
 
-        // 7. At least read data once by onReadyRead() signal
+        // 7. At least read data once by onSamplesReady() signal
 
         // Calibration is completed, so disable this sequence for further normal operation.
         disconnect(this, &SerialSensor::initialized, this, &SerialSensor::calibrateSequence);
@@ -381,7 +604,7 @@ void SerialSensor::calibrateSequence()
 
 int SerialSensor::transmitData(const QByteArray &data)
 {
-    if (!m_serialPort.isOpen() || data.isEmpty() || data.size() > 19)
+    if (!m_port.isOpen() || data.isEmpty() || data.size() > 19)
         return 0; // Illegal parameters
 
     // Build a send packet cache, including the 50-byte preamble
@@ -398,180 +621,67 @@ int SerialSensor::transmitData(const QByteArray &data)
     buf.append(cmdPacketEnd); // Add closing code
 
     // Send data
-    return m_serialPort.write(buf);
-}
-
-void SerialSensor::onReadyRead()
-{
-    quint8 buf[sizeof(m_buf)];
-    int len = m_serialPort.read(reinterpret_cast<char*>(buf), sizeof(buf));
-
-    // Calculate the check code while receiving the data. The check code is the sum of the data from
-    // the beginning of the address code (including the address code) to before the check code.
-    for (int i = 0; i < len; i++) {
-        m_globalCS += buf[i];
-        switch (m_rxIndex) {
-        case 0: // Start code
-            if (buf[i] == cmdPacketBegin) {
-                m_globalI = 0;
-                m_buf[m_globalI++] = cmdPacketBegin;
-                m_globalCS = 0; // Calculate the check code starting from the next byte
-                m_rxIndex = 1;
-            }
-            break;
-        case 1: // The address code of the data body
-            m_buf[m_globalI++] = buf[i];
-            if (buf[i] == 255) { // 255 is the broadcast address，module as slave，Its address cannot appear 255
-                m_rxIndex = 0;
-            } else {
-                m_rxIndex++;
-            }
-            break;
-        case 2: // The length of the data body
-            m_buf[m_globalI++] = buf[i];
-            if (buf[i] > cmdPacketMaxDatSizeRx || buf[i] == 0) { // Invalid length
-                m_rxIndex = 0;
-            } else {
-                m_rxIndex++;
-                m_cmdLen = buf[i];
-            }
-            break;
-        case 3: // Get the data of the data body
-            m_buf[m_globalI++] = buf[i];
-            if (m_globalI >= m_cmdLen + 3) { // Data body has been received
-                m_rxIndex++;
+    return m_port.write(buf);
+}
+
+void SerialSensor::onSamplesReady()
+{
+    m_port.samplesTaken(); // first, a sample pushed meanwhile notifies again
+    const auto &ring = m_port.samples();
+    const quint64 latest = ring.latest();
+    SensorSample sample;
+    for (quint64 serial = qMax(m_sampleSerial + 1, ring.oldest()); serial <= latest; serial++) {
+        if (!ring.read(serial, &sample) || !sample.hasRotation())
+            continue; // overwritten meanwhile, or without the orientation
+        if (m_ring.isWriter()) {
+            const QQuaternion rotation = sample.rotation();
+            PoseRing::Pose pose;
+            pose.timestamp = sample.timestamp;
+            pose.quat[0] = rotation.scalar();
+            pose.quat[1] = rotation.x();
+            pose.quat[2] = rotation.y();
+            pose.quat[3] = rotation.z();
+            pose.flags = m_calibrate ? poseCalibrating : 0;
+            if (sample.fields & SensorSample::GyroField) {
+                memcpy(pose.rates, sample.gyro, sizeof(pose.rates));
+                pose.flags |= poseRates;
             }
-            break;
-        case 4: // Compare verification code
-            m_globalCS -= buf[i];
-            if ((m_globalCS & 0xff) == buf[i]) { // Verification is correct
-                m_buf[m_globalI++] = buf[i];
-                m_rxIndex++;
-            } else { // Verification failed
-                m_rxIndex = 0;
+            if (sample.fields & SensorSample::GravityField) {
+                memcpy(pose.gravity, sample.gravity, sizeof(pose.gravity));
+                pose.flags |= poseGravity;
             }
-            break;
-        case 5: // End code
-            m_rxIndex = 0;
-            if (buf[i] == cmdPacketEnd) { // Get the complete package
-                m_buf[m_globalI++] = buf[i];
-                //hex_string = " ".join(f"{b:02X}" for b in buf[0:i])
-                //print(f"U-Rx[Len={i}]:{hex_string}")
-                //Cmd_RxUnpack(buf[3:i-2], i-5); // Process the data body of the packet
-                unpackData(m_buf + 3, m_globalI - 5);
+            if (sample.fields & SensorSample::MagField) {
+                memcpy(pose.mag, sample.mag, sizeof(pose.mag));
+                pose.flags |= poseMag;
             }
-            break;
-        default:
-            m_rxIndex = 0;
-            break;
+            m_ring.publish(pose);
         }
+        takeSample(sample);
     }
+    m_sampleSerial = latest;
 }
 
-void SerialSensor::unpackData(const quint8 *buf, int size)
+void SerialSensor::takeSample(const SensorSample &sample)
 {
-    static const qreal scaleAccel       = 0.00478515625;
-    static const qreal scaleQuat        = 0.000030517578125;
-    static const qreal scaleAngle       = 0.0054931640625;
-    static const qreal scaleAngleSpeed  = 0.06103515625;
-    static const qreal scaleMag         = 0.15106201171875;
-    static const qreal scaleTemperature = 0.01;
-    static const qreal scaleAirPressure = 0.0002384185791;
-    static const qreal scaleHeight      = 0.0010728836;
-
-    if (buf[0] != 0x11) {
-        //qDebug() << Q_FUNC_INFO << "Data head not defined";
+    const QQuaternion rotation = m_filter.update(sample);
+    if (!(sample.fields & SensorSample::GyroField) || !m_predictor.maxHorizon() || m_calibrate) {
+        updateOrientation(rotation);
         return;
     }
-    int ctl = (buf[2] << 8) | buf[1];
-    int ms = (buf[6] << 24) | (buf[5] << 16) | (buf[4] << 8) | (buf[3] << 0);
-    //qDebug() << "\n subscribe tag:" << QString::number(ctl, 16) << "\n ms:" << ms;
-
-    qreal tmpX, tmpY, tmpZ;
-    int len = 7; // Starting from the 7th byte, the remaining data is parsed according to the subscription identification tag.
-    if ((ctl & 0x0001) != 0) { // Acceleration without gravity
-        tmpX = short((short(buf[len + 1]) << 8) | buf[len]) * scaleAccel; len += 2;
-        //qDebug() << "\taX:" << tmpX; // Acceleration ax without gravity
-        tmpY = short((short(buf[len + 1]) << 8) | buf[len]) * scaleAccel; len += 2;
-        //qDebug() << "\taY:" << tmpY; // Acceleration ay without gravity
-        tmpZ = short((short(buf[len + 1]) << 8) | buf[len]) * scaleAccel; len += 2;
-        //qDebug() << "\taZ:" << tmpZ; // Acceleration az without gravity
-    }
-    if ((ctl & 0x0002) != 0) { // Acceleration with gravity
-        tmpX = short((short(buf[len + 1]) << 8) | buf[len]) * scaleAccel; len += 2;
-        //qDebug() << "\tAX:" << tmpX; // Acceleration AX with gravity
-        tmpY = short((short(buf[len + 1]) << 8) | buf[len]) * scaleAccel; len += 2;
-        //qDebug() << "\tAY:" << tmpY; // Acceleration AY gravity
-        tmpZ = short((short(buf[len + 1]) << 8) | buf[len]) * scaleAccel; len += 2;
-        //qDebug() << "\tAZ:" << tmpZ; // Acceleration AZ gravity
-    }
-    if ((ctl & 0x0004) != 0) { // Angular velocity
-        tmpX = short((short(buf[len + 1]) << 8) | buf[len]) * scaleAngleSpeed; len += 2;
-        //qDebug() << "\tGX:" << tmpX; // Angular velocity GX
-        tmpY = short((short(buf[len + 1]) << 8) | buf[len]) * scaleAngleSpeed; len += 2;
-        //qDebug() << "\tGY:" << tmpY; // Angular velocity GY
-        tmpZ = short((short(buf[len + 1]) << 8) | buf[len]) * scaleAngleSpeed; len += 2;
-        //qDebug() << "\tGZ:" << tmpZ; // Angular velocity GZ
-    }
-    if ((ctl & 0x0008) != 0) { // Magnetic field
-        tmpX = short((short(buf[len + 1]) << 8) | buf[len]) * scaleMag; len += 2;
-        //qDebug() << "\tCX:" << tmpX; // Magnetic field data CX
-        tmpY = short((short(buf[len + 1]) << 8) | buf[len]) * scaleMag; len += 2;
-        //qDebug() << "\tCY:" << tmpY; // Magnetic field data CY
-        tmpZ = short((short(buf[len + 1]) << 8) | buf[len]) * scaleMag; len += 2;
-        //qDebug() << "\tCZ:" << tmpZ; // Magnetic field data CZ
-    }
-    if ((ctl & 0x0010) != 0) { // Temperature
-        tmpX = short((short(buf[len + 1]) << 8) | buf[len]) * scaleTemperature; len += 2;
-        //qDebug() << "\ttemperature:" << tmpX; // temperature
-
-        quint32 tmpU32 = quint32((quint32(buf[len + 2]) << 16) | (quint32(buf[len + 1]) << 8) | quint32(buf[len]));
-        if ((tmpU32 & 0x800000) == 0x800000) // If the highest bit of the 24-digit number is 1, the value is a negative number and needs to be converted to a 32-bit negative number, just add ff directly.
-            tmpU32 = (tmpU32 | 0xff000000);
-        tmpY = qint32(tmpU32) * scaleAirPressure; len += 3;
-        //qDebug() << "\tairPressure:" << tmpY; // air pressure
-
-        tmpU32 = quint32((quint32(buf[len + 2]) << 16) | (quint32(buf[len + 1]) << 8) | quint32(buf[len]));
-        if ((tmpU32 & 0x800000) == 0x800000) // If the highest bit of the 24-digit number is 1, the value is a negative number and needs to be converted to a 32-bit negative number, just add ff directly.
-            tmpU32 = (tmpU32 | 0xff000000);
-        tmpZ = qint32(tmpU32) * scaleHeight; len += 3;
-        //qDebug() << "\theight:" << tmpZ; // high
-    }
-    if ((ctl & 0x0020) != 0) { // Quaternions
-        qreal tmpAbs = short((short(buf[len + 1]) << 8) | buf[len]) * scaleQuat; len += 2;
-        //qDebug() << "\tQW:" << tmpAbs; // Quaternions w
-        tmpX = short((short(buf[len + 1]) << 8) | buf[len]) * scaleQuat; len += 2;
-        //qDebug() << "\tQX:" << tmpX; // Quaternions x
-        tmpY =   short((short(buf[len + 1]) << 8) | buf[len]) * scaleQuat; len += 2;
-        //qDebug() << "\tQY:" << tmpY; // Quaternions y
-        tmpZ =   short((short(buf[len + 1]) << 8) | buf[len]) * scaleQuat; len += 2;
-        //qDebug() << "\tQZ:" << tmpZ; // Quaternions z
-    }
-    if ((ctl & 0x0040) != 0) { // Euler angles
-        tmpX = short((short(buf[len + 1]) << 8) | buf[len]) * scaleAngle; len += 2;
-        //qDebug() << "\tangleX:" << tmpX; // Euler angles x
-        tmpY = short((short(buf[len + 1]) << 8) | buf[len]) * scaleAngle; len += 2;
-        //qDebug() << "\tangleY:" << tmpY; // Euler angles y
-        tmpZ = short((short(buf[len + 1]) << 8) | buf[len]) * scaleAngle; len += 2;
-        //qDebug() << "\tangleZ:" << tmpZ; // Euler angles z
-
-        qreal pitch = roundTo2(qBound(-90.0, tmpY, 90.0));
-        qreal yaw = roundTo2(qBound(-180.0, tmpZ, 180.0));
-
-        bool pitch_changed = (pitch != m_pitchAngle);
-        if (pitch_changed)
-        {
-            m_pitchAngle = repeat(lerpAngle(m_pitchAngle+180.0, pitch+180.0, m_smoothingFactor), 360.0) - 180.0;
-        }
-
-        if (m_adjustAngle) tmpZ -= m_adjustAngle;
+    // The pose at the photons of the frame to come: the sample is aged already, then displayed
+    const qint64 horizon = PoseRing::monotonicTime() - sample.timestamp + qint64(m_displayLatency * 1000.0);
+    updateOrientation(m_predictor.predict(rotation, sample.gyro, horizon));
+}
 
-        bool yaw_changed = (yaw != m_yawAngle);
-        if (yaw_changed)
-        {
-            m_yawAngle = repeat(lerpAngle(m_yawAngle+180.0, yaw+180.0, m_smoothingFactor), 360.0) - 180.0;
-        }
-        if (pitch_changed) emit pitchAngleChanged();
-        if (yaw_changed) emit yawAngleChanged();
+void SerialSensor::updateOrientation(const QQuaternion &rotation)
+{
+    QQuaternion view = viewRotation(rotation);
+    if (m_adjustAngle) view = QQuaternion::fromAxisAndAngle(0.0f, 1.0f, 0.0f, -m_adjustAngle) * view;
+    if (m_filter.type() == SensorFilter::None)
+        view = QQuaternion::slerp(m_orientation, view, float(qBound(0.0, m_smoothingFactor, 1.0)));
+    if (view != m_orientation) {
+        m_orientation = view;
+        updatePitchDegree();
+        emit orientationChanged();
     }
 }
@@ -2,9 +2,29 @@
 #define SERIALSENSOR_H
 
 #include <QObject>
-#include <QQmlEngine>
-#include <QSerialPort>
+#include <QtQmlIntegration/qqmlintegration.h> // QML_ELEMENT without linking Qt Qml
 #include <QPointer>
+#include <QTimer>
+#include <QQuaternion>
+
+#include "PosePredictor.h"
+#include "PoseRing.h"
+#include "SensorFilters.h"
+#include "SensorThread.h"
+
+/*
+ * The head orientation of the serial IMU sensor. With useTracker (the default) the samples
+ * of a running tracker daemon are read from its PoseRing instead, without opening the port
+ * and the handshake of initSensor(), and the ring is reattached as soon as a restarted daemon
+ * has created it again. The daemon itself owns the port and publishes by setPublishPose().
+ *
+ * The port is read by SensorThread, the samples are taken from its ring on this thread.
+ * Every sample, of the port or the ring, runs through the sensor filter of SensorFilter at the
+ * full sensor rate; the result is mapped to the view axes and, without a filter, smoothed by
+ * slerp into the orientation. The Euler angles are computed from it only when read.
+ * The orientation is extrapolated by the gyro rates over the age of the sample plus the
+ * displayLatency of the frontend, up to maxPrediction ms and maxPredictionAngle degree.
+ */
 
 class SerialSensor : public QObject
 {
@@ -20,10 +40,19 @@ class SerialSensor : public QObject
     Q_PROPERTY(bool     enableCompass READ enableCompass   WRITE setEnableCompass   NOTIFY enableCompassChanged FINAL)
     Q_PROPERTY(int        adjustAngle READ adjustAngle     WRITE setAdjustAngle     NOTIFY adjustAngleChanged FINAL)
     Q_PROPERTY(double smoothingFactor READ smoothingFactor WRITE setSmoothingFactor NOTIFY smoothingFactorChanged FINAL)
-    Q_PROPERTY(qreal       pitchAngle READ pitchAngle    NOTIFY pitchAngleChanged FINAL)
-    Q_PROPERTY(qreal         yawAngle READ yawAngle      NOTIFY yawAngleChanged FINAL)
+    Q_PROPERTY(int             filter READ filter          WRITE setFilter          NOTIFY filterChanged FINAL)
+    Q_PROPERTY(QQuaternion orientation READ orientation  NOTIFY orientationChanged FINAL)
+    Q_PROPERTY(qreal       pitchAngle READ pitchAngle    NOTIFY orientationChanged FINAL)
+    Q_PROPERTY(qreal         yawAngle READ yawAngle      NOTIFY orientationChanged FINAL)
+    Q_PROPERTY(qreal        rollAngle READ rollAngle     NOTIFY orientationChanged FINAL)
+    Q_PROPERTY(int        pitchDegree READ pitchDegree   NOTIFY pitchDegreeChanged FINAL)
     Q_PROPERTY(QString      errorText READ errorText     NOTIFY errorTextChanged FINAL)
     Q_PROPERTY(bool       calibrating READ calibrating   NOTIFY calibratingChanged FINAL)
+    Q_PROPERTY(bool        useTracker READ useTracker      WRITE setUseTracker      NOTIFY useTrackerChanged FINAL)
+    Q_PROPERTY(bool          tracking READ tracking      NOTIFY trackingChanged FINAL)
+    Q_PROPERTY(int      maxPrediction READ maxPrediction   WRITE setMaxPrediction   NOTIFY maxPredictionChanged FINAL)
+    Q_PROPERTY(qreal maxPredictionAngle READ maxPredictionAngle WRITE setMaxPredictionAngle NOTIFY maxPredictionAngleChanged FINAL)
+    Q_PROPERTY(qreal   displayLatency READ displayLatency  WRITE setDisplayLatency  NOTIFY displayLatencyChanged FINAL)
     QML_ELEMENT
 
 public:
@@ -32,11 +61,11 @@ public:
     static constexpr int const defaultGyroscope     = 1;
     static constexpr int const defaultAccelerometer = 3;
     static constexpr int const defaultMagnetometer  = 5;
+    static constexpr int const trackerPollInterval  = 4; // ms, the sensor reports at 250Hz at most
+    static constexpr int const trackerCheckInterval = 50; // ms without samples to check the daemon
 
-    static constexpr int const cmdPacketBegin = 0x49; // Start code
-    static constexpr int const cmdPacketEnd   = 0x4D; // End code
-    // The maximum length of the data body of the data packet sent by the module
-    static constexpr int const cmdPacketMaxDatSizeRx = 73;
+    static constexpr int const cmdPacketBegin = SensorThread::cmdPacketBegin; // Start code
+    static constexpr int const cmdPacketEnd   = SensorThread::cmdPacketEnd; // End code
 
     explicit SerialSensor(QObject *parent = nullptr);
 
@@ -49,6 +78,14 @@ public:
     };
     Q_ENUM(BaudRate)
 
+    enum Filter {
+        FilterNone     = SensorFilter::None,
+        FilterOneEuro  = SensorFilter::OneEuro,
+        FilterKalman   = SensorFilter::Kalman,
+        FilterMadgwick = SensorFilter::Madgwick
+    };
+    Q_ENUM(Filter)
+
     bool active() const;
     void setActive(bool yes);
 
@@ -80,14 +117,37 @@ public:
     void setAdjustAngle(int angle); // -180..180 in degree
 
     double smoothingFactor() const;
-    void setSmoothingFactor(double factor); // 0..1
+    void setSmoothingFactor(double factor); // 0..1, without a filter
+
+    int filter() const;
+    void setFilter(int type); // enum Filter
+    static int parseFilter(const QString &text); // "none", "oneeuro", "kalman" or "madgwick", -1 if bad
     
-    qreal pitchAngle() const;
+    QQuaternion orientation() const; // of the view axes, as QQuaternion::fromEulerAngles()
+    qreal pitchAngle() const; // of the orientation in degree
     qreal yawAngle() const;
+    qreal rollAngle() const;
+    int pitchDegree() const; // the pitch rounded, notified only on the change of the degree
 
     QString errorText() const;
     bool calibrating() const;
 
+    bool useTracker() const;
+    void setUseTracker(bool yes);
+    bool tracking() const; // the samples are of the tracker daemon
+
+    int maxPrediction() const;
+    void setMaxPrediction(int ms); // 0..500, 0 is off
+
+    qreal maxPredictionAngle() const;
+    void setMaxPredictionAngle(qreal degree); // 0..90
+
+    qreal displayLatency() const;
+    void setDisplayLatency(qreal ms); // from the change of the angles to the photons
+
+    bool setPublishPose(bool yes); // the tracker daemon, false if the ring can't be created
+    const SensorThread *sensorThread() const { return &m_port; } // its samples for any thread
+
     Q_INVOKABLE static QStringList allPortNames();
 
 public slots:
@@ -105,43 +165,61 @@ signals:
     void magnetometerChanged();
     void enableCompassChanged();
     void adjustAngleChanged();
-    void pitchAngleChanged();
-    void yawAngleChanged();
+    void orientationChanged();
+    void pitchDegreeChanged();
     void errorTextChanged();
     void calibratingChanged();
     void smoothingFactorChanged();
+    void filterChanged();
+    void useTrackerChanged();
+    void trackingChanged();
+    void maxPredictionChanged();
+    void maxPredictionAngleChanged();
+    void displayLatencyChanged();
 
 private:
-    void setPortError(QSerialPort::SerialPortError error);
     void setErrorText(const QString &text);
-    void onReadyRead();
+    void onSamplesReady();
     void initSensor();
     int transmitData(const QByteArray &data);
-    void unpackData(const quint8 *data, int size);
     void calibrateSequence();
+    void takeSample(const SensorSample &sample); // filtered and predicted into orientation
+    void updateOrientation(const QQuaternion &rotation); // of the sensor axes, smoothed into orientation
+    void updatePitchDegree();
+    void setCalibrating(bool yes);
+    bool attachTracker();
+    void detachTracker();
+    void onRingTimer();
+    void pollTracker();
 
     bool m_active;
     bool m_calibrate;
     bool m_enableCompass;
     int m_adjustAngle;
-    qreal m_pitchAngle;
-    qreal m_yawAngle;
-    qreal m_rollAngle;
+    QQuaternion m_orientation;
+    int m_pitchDegree;
+    float m_pitchSines[2]; // of the pitch degree bounds, the sine of the pitch within is of the same degree
     QString m_errorText;
     double m_smoothingFactor;
+    SensorFilter m_filter;
 
-    QSerialPort m_serialPort;
+    SensorThread m_port;
     int m_threshold;
     int m_frequency;
     int m_gyroscope;
     int m_accelerometer;
     int m_magnetometer;
+    quint64 m_sampleSerial; // of the last sample taken
+
+    bool m_useTracker;
+    PoseRing m_ring; // of the daemon to read, or to publish
+    QTimer m_ringTimer; // polls the samples, or the heartbeat and the requests of the readers
+    quint64 m_ringSerial; // of the last sample read
+    qint64 m_ringChecked; // us
+    quint32 m_calibrateRequest; // the last one taken
 
-    int m_globalCS; // Checksum
-    int m_globalI;
-    int m_rxIndex;
-    quint8 m_buf[5 + cmdPacketMaxDatSizeRx]; // Receive packet cache
-    int m_cmdLen; // length
+    PosePredictor m_predictor;
+    qreal m_displayLatency; // ms
 };
 
 #endif // SERIALSENSOR_H
@@ -0,0 +1,110 @@
+#include "SharedFrame.h"
+
+#include <QWindow>
+#include <QMutexLocker>
+#include <QtDebug>
+
+//#define TRACE_SHAREDFRAME
+#ifdef  TRACE_SHAREDFRAME
+#include <QTime>
+#include <QThread>
+#define TRACE()      qDebug() << QTime::currentTime().toString("hh:mm:ss.zzz") << QThread::currentThreadId() << Q_FUNC_INFO;
+#define TRACE_ARG(x) qDebug() << QTime::currentTime().toString("hh:mm:ss.zzz") << QThread::currentThreadId() << Q_FUNC_INFO << x;
+#else
+#define TRACE()
+#define TRACE_ARG(x)
+#endif
+
+SharedFrame::SharedFrame()
+    : m_latest(-1)
+    , m_serial(0)
+{
+}
+
+void SharedFrame::addConsumer(QWindow *win)
+{
+    TRACE_ARG(win);
+    QMutexLocker locker(&m_mutex);
+    if (!m_consumers.contains(win))
+        m_consumers.append(win);
+}
+
+void SharedFrame::removeConsumer(QWindow *win)
+{
+    TRACE_ARG(win);
+    QMutexLocker locker(&m_mutex);
+    m_consumers.removeAll(win);
+}
+
+bool SharedFrame::hasConsumers() const
+{
+    QMutexLocker locker(&m_mutex);
+    return !m_consumers.isEmpty();
+}
+
+int SharedFrame::writeSlot()
+{
+    QMutexLocker locker(&m_mutex);
+    for (int i = 0; i < slotCount; i++) {
+        if (i != m_latest && !m_slots[i].readers)
+            return i;
+    }
+    TRACE_ARG("All slots busy, frame skipped");
+    return -1;
+}
+
+SharedFrame::Slot SharedFrame::slot(int index) const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_slots[index];
+}
+
+void SharedFrame::setSlotTexture(int index, GLuint texture, const QSize &size)
+{
+    QMutexLocker locker(&m_mutex);
+    m_slots[index].texture = texture;
+    m_slots[index].size = size;
+}
+
+GLsync SharedFrame::publish(int index, GLsync fence)
+{
+    QMutexLocker locker(&m_mutex);
+    Slot &slot = m_slots[index];
+    GLsync replaced = slot.fence;
+    slot.fence = fence;
+    slot.serial = ++m_serial;
+    m_latest = index;
+    TRACE_ARG(index << slot.serial);
+
+    // The consumers render on their own threads, request their next frame
+    for (const auto &win : std::as_const(m_consumers)) {
+        if (win) QMetaObject::invokeMethod(win, "update", Qt::QueuedConnection);
+    }
+    return replaced;
+}
+
+void SharedFrame::reset()
+{
+    TRACE();
+    QMutexLocker locker(&m_mutex);
+    for (auto &slot : m_slots)
+        slot = Slot();
+    m_latest = -1;
+}
+
+int SharedFrame::acquire(int held, Slot *info)
+{
+    QMutexLocker locker(&m_mutex);
+    if (held != m_latest) {
+        if (held >= 0 && m_slots[held].readers > 0) m_slots[held].readers--;
+        if (m_latest >= 0) m_slots[m_latest].readers++;
+    }
+    if (m_latest >= 0) *info = m_slots[m_latest];
+    return m_latest;
+}
+
+void SharedFrame::release(int held)
+{
+    QMutexLocker locker(&m_mutex);
+    if (held >= 0 && m_slots[held].readers > 0) m_slots[held].readers--;
+}
@@ -0,0 +1,58 @@
+#ifndef SHAREDFRAME_H
+#define SHAREDFRAME_H
+
+#include <QMutex>
+#include <QPointer>
+#include <QSize>
+#include <QVector>
+#include <qopengl.h>
+
+class QWindow;
+
+/*
+ * The converted frame of one VideoRenderer (the producer) shared with the renderers of
+ * the other windows (spectator screens, extra headsets) through the shared OpenGL contexts,
+ * so a frame is decoded, uploaded and converted once for all outputs. The producer copies
+ * its frame texture into a slot neither published nor read and publishes it with a fence,
+ * each consumer samples the latest published slot, which is not rewritten while held.
+ */
+class SharedFrame
+{
+public:
+    static constexpr int const slotCount = 4; // enough for two consumers, then frames are skipped
+
+    struct Slot {
+        GLuint texture = 0; // of the producer context, shared
+        QSize size;
+        GLsync fence = nullptr; // of the copy into the texture
+        qint64 serial = 0;
+        int readers = 0;
+    };
+
+    SharedFrame();
+
+    void addConsumer(QWindow *win); // updated on the new frames
+    void removeConsumer(QWindow *win);
+    bool hasConsumers() const;
+
+    // Producer: the slot to copy the next frame into, -1 if all are busy,
+    // then publish it and update the consumer windows
+    int writeSlot();
+    Slot slot(int index) const;
+    void setSlotTexture(int index, GLuint texture, const QSize &size);
+    GLsync publish(int index, GLsync fence); // returns the fence replaced to delete
+    void reset(); // the producer context is gone
+
+    // Consumer: the latest published slot instead of the held one, -1 if none
+    int acquire(int held, Slot *info);
+    void release(int held);
+
+private:
+    mutable QMutex m_mutex;
+    Slot m_slots[slotCount];
+    int m_latest;
+    qint64 m_serial;
+    QVector<QPointer<QWindow>> m_consumers;
+};
+
+#endif // SHAREDFRAME_H
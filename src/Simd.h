@@ -0,0 +1,192 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+/*
+ * Thin wrappers of the float vectors for the CPU kernels written once as templates:
+ * SimdScalar always, SimdSse2 on x86, SimdAvx2 in the translation units compiled with
+ * -mavx2 -mfma, SimdNeon on AArch64. The kernels are instantiated per ISA in separate
+ * translation units, so everything here has internal linkage to keep the instances
+ * compiled with the different target flags apart.
+ */
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SIMD_HAVE_SSE2
+#endif
+#if defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#define SIMD_HAVE_AVX2
+#endif
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define SIMD_HAVE_NEON
+#endif
+
+#if defined(__GNUC__)
+#define SIMD_INLINE inline __attribute__((always_inline))
+#else
+#define SIMD_INLINE inline
+#endif
+
+namespace {
+
+struct SimdScalar
+{
+    typedef float F;
+    typedef bool M;
+    static constexpr int const N = 1;
+    static constexpr const char *name() { return "scalar"; }
+
+    static SIMD_INLINE F set1(float a) { return a; }
+    static SIMD_INLINE F load(const float *p) { return *p; }
+    static SIMD_INLINE void store(float *p, F a) { *p = a; }
+    static SIMD_INLINE F add(F a, F b) { return a + b; }
+    static SIMD_INLINE F sub(F a, F b) { return a - b; }
+    static SIMD_INLINE F mul(F a, F b) { return a * b; }
+    static SIMD_INLINE F div(F a, F b) { return a / b; }
+    static SIMD_INLINE F fmadd(F a, F b, F c) { return a * b + c; }
+    static SIMD_INLINE F min(F a, F b) { return a < b ? a : b; }
+    static SIMD_INLINE F max(F a, F b) { return a > b ? a : b; }
+    static SIMD_INLINE F abs(F a) { return std::fabs(a); }
+    static SIMD_INLINE F neg(F a) { return -a; }
+    static SIMD_INLINE F sqrt(F a) { return std::sqrt(a); }
+    static SIMD_INLINE F floor(F a) { return std::floor(a); }
+    static SIMD_INLINE M cmplt(F a, F b) { return a < b; }
+    static SIMD_INLINE M cmpgt(F a, F b) { return a > b; }
+    static SIMD_INLINE M or_(M a, M b) { return a || b; }
+    static SIMD_INLINE F select(M m, F a, F b) { return m ? a : b; }
+    static SIMD_INLINE void storeRgb32(uint32_t *p, F r, F g, F b) { // 0..255, rounded
+        *p = 0xff000000 | uint32_t(r + 0.5f) << 16 | uint32_t(g + 0.5f) << 8 | uint32_t(b + 0.5f);
+    }
+};
+
+#ifdef SIMD_HAVE_SSE2
+struct SimdSse2
+{
+    typedef __m128 F;
+    typedef __m128 M;
+    static constexpr int const N = 4;
+    static constexpr const char *name() { return "SSE2"; }
+
+    static SIMD_INLINE F set1(float a) { return _mm_set1_ps(a); }
+    static SIMD_INLINE F load(const float *p) { return _mm_loadu_ps(p); }
+    static SIMD_INLINE void store(float *p, F a) { _mm_storeu_ps(p, a); }
+    static SIMD_INLINE F add(F a, F b) { return _mm_add_ps(a, b); }
+    static SIMD_INLINE F sub(F a, F b) { return _mm_sub_ps(a, b); }
+    static SIMD_INLINE F mul(F a, F b) { return _mm_mul_ps(a, b); }
+    static SIMD_INLINE F div(F a, F b) { return _mm_div_ps(a, b); }
+    static SIMD_INLINE F fmadd(F a, F b, F c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+    static SIMD_INLINE F min(F a, F b) { return _mm_min_ps(a, b); }
+    static SIMD_INLINE F max(F a, F b) { return _mm_max_ps(a, b); }
+    static SIMD_INLINE F abs(F a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+    static SIMD_INLINE F neg(F a) { return _mm_xor_ps(_mm_set1_ps(-0.0f), a); }
+    static SIMD_INLINE F sqrt(F a) { return _mm_sqrt_ps(a); }
+    static SIMD_INLINE F floor(F a) { // valid within the int range
+        F t = _mm_cvtepi32_ps(_mm_cvttps_epi32(a));
+        return _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, a), _mm_set1_ps(1.0f)));
+    }
+    static SIMD_INLINE M cmplt(F a, F b) { return _mm_cmplt_ps(a, b); }
+    static SIMD_INLINE M cmpgt(F a, F b) { return _mm_cmpgt_ps(a, b); }
+    static SIMD_INLINE M or_(M a, M b) { return _mm_or_ps(a, b); }
+    static SIMD_INLINE F select(M m, F a, F b) { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+    static SIMD_INLINE void storeRgb32(uint32_t *p, F r, F g, F b) {
+        __m128i c = _mm_or_si128(_mm_slli_epi32(_mm_cvtps_epi32(r), 16), _mm_slli_epi32(_mm_cvtps_epi32(g), 8));
+        c = _mm_or_si128(_mm_or_si128(c, _mm_cvtps_epi32(b)), _mm_set1_epi32(int(0xff000000)));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(p), c);
+    }
+};
+#endif
+
+#ifdef SIMD_HAVE_AVX2
+struct SimdAvx2
+{
+    typedef __m256 F;
+    typedef __m256 M;
+    static constexpr int const N = 8;
+    static constexpr const char *name() { return "AVX2"; }
+
+    static SIMD_INLINE F set1(float a) { return _mm256_set1_ps(a); }
+    static SIMD_INLINE F load(const float *p) { return _mm256_loadu_ps(p); }
+    static SIMD_INLINE void store(float *p, F a) { _mm256_storeu_ps(p, a); }
+    static SIMD_INLINE F add(F a, F b) { return _mm256_add_ps(a, b); }
+    static SIMD_INLINE F sub(F a, F b) { return _mm256_sub_ps(a, b); }
+    static SIMD_INLINE F mul(F a, F b) { return _mm256_mul_ps(a, b); }
+    static SIMD_INLINE F div(F a, F b) { return _mm256_div_ps(a, b); }
+    static SIMD_INLINE F fmadd(F a, F b, F c) { return _mm256_fmadd_ps(a, b, c); }
+    static SIMD_INLINE F min(F a, F b) { return _mm256_min_ps(a, b); }
+    static SIMD_INLINE F max(F a, F b) { return _mm256_max_ps(a, b); }
+    static SIMD_INLINE F abs(F a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+    static SIMD_INLINE F neg(F a) { return _mm256_xor_ps(_mm256_set1_ps(-0.0f), a); }
+    static SIMD_INLINE F sqrt(F a) { return _mm256_sqrt_ps(a); }
+    static SIMD_INLINE F floor(F a) { return _mm256_floor_ps(a); }
+    static SIMD_INLINE M cmplt(F a, F b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+    static SIMD_INLINE M cmpgt(F a, F b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+    static SIMD_INLINE M or_(M a, M b) { return _mm256_or_ps(a, b); }
+    static SIMD_INLINE F select(M m, F a, F b) { return _mm256_blendv_ps(b, a, m); }
+    static SIMD_INLINE void storeRgb32(uint32_t *p, F r, F g, F b) {
+        __m256i c = _mm256_or_si256(_mm256_slli_epi32(_mm256_cvtps_epi32(r), 16), _mm256_slli_epi32(_mm256_cvtps_epi32(g), 8));
+        c = _mm256_or_si256(_mm256_or_si256(c, _mm256_cvtps_epi32(b)), _mm256_set1_epi32(int(0xff000000)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(p), c);
+    }
+};
+#endif
+
+#ifdef SIMD_HAVE_NEON
+struct SimdNeon
+{
+    typedef float32x4_t F;
+    typedef uint32x4_t M;
+    static constexpr int const N = 4;
+    static constexpr const char *name() { return "NEON"; }
+
+    static SIMD_INLINE F set1(float a) { return vdupq_n_f32(a); }
+    static SIMD_INLINE F load(const float *p) { return vld1q_f32(p); }
+    static SIMD_INLINE void store(float *p, F a) { vst1q_f32(p, a); }
+    static SIMD_INLINE F add(F a, F b) { return vaddq_f32(a, b); }
+    static SIMD_INLINE F sub(F a, F b) { return vsubq_f32(a, b); }
+    static SIMD_INLINE F mul(F a, F b) { return vmulq_f32(a, b); }
+    static SIMD_INLINE F div(F a, F b) { return vdivq_f32(a, b); }
+    static SIMD_INLINE F fmadd(F a, F b, F c) { return vfmaq_f32(c, a, b); }
+    static SIMD_INLINE F min(F a, F b) { return vminq_f32(a, b); }
+    static SIMD_INLINE F max(F a, F b) { return vmaxq_f32(a, b); }
+    static SIMD_INLINE F abs(F a) { return vabsq_f32(a); }
+    static SIMD_INLINE F neg(F a) { return vnegq_f32(a); }
+    static SIMD_INLINE F sqrt(F a) { return vsqrtq_f32(a); }
+    static SIMD_INLINE F floor(F a) { return vrndmq_f32(a); }
+    static SIMD_INLINE M cmplt(F a, F b) { return vcltq_f32(a, b); }
+    static SIMD_INLINE M cmpgt(F a, F b) { return vcgtq_f32(a, b); }
+    static SIMD_INLINE M or_(M a, M b) { return vorrq_u32(a, b); }
+    static SIMD_INLINE F select(M m, F a, F b) { return vbslq_f32(m, a, b); }
+    static SIMD_INLINE void storeRgb32(uint32_t *p, F r, F g, F b) {
+        uint32x4_t c = vorrq_u32(vshlq_n_u32(vcvtnq_u32_f32(r), 16), vshlq_n_u32(vcvtnq_u32_f32(g), 8));
+        vst1q_u32(p, vorrq_u32(vorrq_u32(c, vcvtnq_u32_f32(b)), vdupq_n_u32(0xff000000)));
+    }
+};
+#endif
+
+// atan2(y, x) by the minimax polynomial, the max error is about 1e-5 radian
+template <class V>
+SIMD_INLINE typename V::F simdAtan2(typename V::F y, typename V::F x)
+{
+    typedef typename V::F F;
+    const F ax = V::abs(x), ay = V::abs(y);
+    const F a = V::div(V::min(ax, ay), V::max(V::max(ax, ay), V::set1(1e-30f)));
+    const F s = V::mul(a, a);
+    F r = V::fmadd(V::set1(-0.0117212f), s, V::set1(0.05265332f));
+    r = V::fmadd(r, s, V::set1(-0.11643287f));
+    r = V::fmadd(r, s, V::set1(0.19354346f));
+    r = V::fmadd(r, s, V::set1(-0.33262347f));
+    r = V::fmadd(r, s, V::set1(0.99997726f));
+    r = V::mul(r, a);
+    r = V::select(V::cmpgt(ay, ax), V::sub(V::set1(1.57079637f), r), r);
+    r = V::select(V::cmplt(x, V::set1(0.0f)), V::sub(V::set1(3.14159274f), r), r);
+    return V::select(V::cmplt(y, V::set1(0.0f)), V::neg(r), r);
+}
+
+} // namespace
+
+#endif // SIMD_H
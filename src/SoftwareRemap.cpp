@@ -0,0 +1,86 @@
+#include "SoftwareRemapKernel.h"
+
+typedef void (*RemapDirectionsFunc)(const RemapParams &, const float *, const float *, const float *,
+                                    int, float *, float *);
+
+template <class V>
+static void remapDirectionsWith(const RemapParams &params, const float *x, const float *y, const float *z,
+                                int count, float *u, float *v)
+{
+    remapKernel<V>(params, x, y, z, count, u, v);
+}
+
+#if defined(SIMD_HAVE_NEON)
+typedef SimdNeon SimdBase;
+#elif defined(SIMD_HAVE_SSE2)
+typedef SimdSse2 SimdBase;
+#else
+typedef SimdScalar SimdBase;
+#endif
+
+// The widest kernel the CPU runs, the AVX2 one is built for x86-64 if the compiler can
+static RemapDirectionsFunc selectRemapDirections(const char **name)
+{
+#if defined(PANORAMA_SIMD_AVX2)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        *name = "AVX2";
+        return &remapDirectionsAvx2;
+    }
+#endif
+    *name = SimdBase::name();
+    return &remapDirectionsWith<SimdBase>;
+}
+
+static const char *remapName = nullptr;
+static const RemapDirectionsFunc remapDirectionsFunc = selectRemapDirections(&remapName);
+
+void remapDirections(const RemapParams &params, const float *x, const float *y, const float *z,
+                     int count, float *u, float *v)
+{
+    remapDirectionsFunc(params, x, y, z, count, u, v);
+}
+
+const char *remapInstructionSet()
+{
+    return remapName;
+}
+
+// Blend the RGB32 pixels by the weight 0..256 of b, two channels per multiply
+static inline uint32_t blend(uint32_t a, uint32_t b, uint32_t w)
+{
+    const uint32_t rb = (((a & 0xff00ff) * (256 - w) + (b & 0xff00ff) * w) >> 8) & 0xff00ff;
+    const uint32_t ag = (((a >> 8) & 0xff00ff) * (256 - w) + ((b >> 8) & 0xff00ff) * w) & 0xff00ff00;
+    return rb | ag;
+}
+
+void remapSample(const uint32_t *frame, int stride, const int part[4], bool wrap,
+                 const float *u, const float *v, int count, uint32_t *dst)
+{
+    const int width = part[2], height = part[3];
+    const uint32_t *base = frame + part[1] * stride + part[0];
+    for (int i = 0; i < count; i++) {
+        const float fu = u[i];
+        if (fu <= remapOutside) {
+            dst[i] = 0xff000000;
+            continue;
+        }
+        const float fx = std::floor(fu), fy = std::floor(v[i]);
+        const uint32_t wx = uint32_t((fu - fx) * 256.0f + 0.5f);
+        const uint32_t wy = uint32_t((v[i] - fy) * 256.0f + 0.5f);
+        int x0 = int(fx) - part[0], y0 = int(fy) - part[1];
+        int x1 = x0 + 1, y1 = y0 + 1;
+        if (wrap) {
+            if (x0 < 0) x0 += width;
+            if (x1 >= width) x1 -= width;
+        } else {
+            x0 = x0 < 0 ? 0 : x0 >= width ? width - 1 : x0;
+            x1 = x1 < 0 ? 0 : x1 >= width ? width - 1 : x1;
+        }
+        y0 = y0 < 0 ? 0 : y0 >= height ? height - 1 : y0;
+        y1 = y1 < 0 ? 0 : y1 >= height ? height - 1 : y1;
+        const uint32_t *row0 = base + y0 * stride;
+        const uint32_t *row1 = base + y1 * stride;
+        dst[i] = blend(blend(row0[x0], row0[x1], wx), blend(row1[x0], row1[x1], wx), wy) | 0xff000000;
+    }
+}
@@ -0,0 +1,37 @@
+#ifndef SOFTWAREREMAP_H
+#define SOFTWAREREMAP_H
+
+#include <cstdint>
+
+/*
+ * The CPU kernels of SoftwareRenderer, kept free of Qt since the AVX2 variant is compiled
+ * with its own target flags in SoftwareRemapAvx2.cpp and selected at runtime.
+ */
+
+struct RemapParams
+{
+    float rotation[9]; // the view to world directions, row-major
+    float xoffs;       // the longitude shift in turns
+    float range[4];    // the frame coverage of the full sphere: left, top, width, height
+    float eye[4];      // the frame part of the eye in pixels: left, top, width, height
+};
+
+// The marker of the pixels outside of the frame coverage in the u coordinate
+static constexpr float const remapOutside = -1e30f;
+
+// The frame pixel coordinates (u, v) of the view directions (x, y, z) as shaders/view.frag
+void remapDirections(const RemapParams &params, const float *x, const float *y, const float *z,
+                     int count, float *u, float *v);
+
+// Bilinear sampling of the RGB32 frame part (left, top, width, height), wrapped horizontally or clamped
+void remapSample(const uint32_t *frame, int stride, const int part[4], bool wrap,
+                 const float *u, const float *v, int count, uint32_t *dst);
+
+const char *remapInstructionSet();
+
+#if defined(PANORAMA_SIMD_AVX2)
+void remapDirectionsAvx2(const RemapParams &params, const float *x, const float *y, const float *z,
+                         int count, float *u, float *v);
+#endif
+
+#endif // SOFTWAREREMAP_H
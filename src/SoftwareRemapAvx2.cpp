@@ -0,0 +1,8 @@
+// Compiled with -mavx2 -mfma, called only if the CPU supports them, see SoftwareRemap.cpp
+#include "SoftwareRemapKernel.h"
+
+void remapDirectionsAvx2(const RemapParams &params, const float *x, const float *y, const float *z,
+                         int count, float *u, float *v)
+{
+    remapKernel<SimdAvx2>(params, x, y, z, count, u, v);
+}
@@ -0,0 +1,52 @@
+#ifndef SOFTWAREREMAPKERNEL_H
+#define SOFTWAREREMAPKERNEL_H
+
+#include "SoftwareRemap.h"
+#include "Simd.h"
+
+namespace {
+
+// The direction to the equirectangular frame pixel of shaders/view.frag, V::N pixels at once
+template <class V>
+void remapKernel(const RemapParams &p, const float *lx, const float *ly, const float *lz,
+                 int count, float *u, float *v)
+{
+    typedef typename V::F F;
+    const F r0 = V::set1(p.rotation[0]), r1 = V::set1(p.rotation[1]), r2 = V::set1(p.rotation[2]);
+    const F r3 = V::set1(p.rotation[3]), r4 = V::set1(p.rotation[4]), r5 = V::set1(p.rotation[5]);
+    const F r6 = V::set1(p.rotation[6]), r7 = V::set1(p.rotation[7]), r8 = V::set1(p.rotation[8]);
+    const F zero = V::set1(0.0f), one = V::set1(1.0f);
+    const F lonScale = V::set1(float(0.5 / M_PI)), latScale = V::set1(float(1.0 / M_PI));
+    const F lonBias = V::set1(p.xoffs + 0.5f - p.range[0]), latBias = V::set1(0.5f - p.range[1]);
+    const F rangeW = V::set1(1.0f / p.range[2]), rangeH = V::set1(1.0f / p.range[3]);
+    const F eyeX = V::set1(p.eye[0] - 0.5f), eyeY = V::set1(p.eye[1] - 0.5f); // to texel centers
+    const F eyeW = V::set1(p.eye[2]), eyeH = V::set1(p.eye[3]);
+    const F outside = V::set1(remapOutside);
+
+    int i = 0;
+    for (; i + V::N <= count; i += V::N) {
+        const F vx = V::load(lx + i), vy = V::load(ly + i), vz = V::load(lz + i);
+        const F x = V::fmadd(r0, vx, V::fmadd(r1, vy, V::mul(r2, vz)));
+        const F y = V::fmadd(r3, vx, V::fmadd(r4, vy, V::mul(r5, vz)));
+        const F z = V::fmadd(r6, vx, V::fmadd(r7, vy, V::mul(r8, vz)));
+
+        // asin(-y) of the normalized direction is atan2(-y, |xz|) of any length
+        const F lon = simdAtan2<V>(x, V::neg(z));
+        const F lat = simdAtan2<V>(V::neg(y), V::sqrt(V::fmadd(x, x, V::mul(z, z))));
+        F tx = V::fmadd(lon, lonScale, lonBias);
+        tx = V::mul(V::sub(tx, V::floor(tx)), rangeW);
+        const F ty = V::mul(V::fmadd(lat, latScale, latBias), rangeH);
+
+        const auto out = V::or_(V::cmpgt(tx, one), V::or_(V::cmplt(ty, zero), V::cmpgt(ty, one)));
+        V::store(u + i, V::select(out, outside, V::fmadd(tx, eyeW, eyeX)));
+        V::store(v + i, V::fmadd(ty, eyeH, eyeY));
+    }
+    if constexpr (V::N > 1) {
+        if (i < count)
+            remapKernel<SimdScalar>(p, lx + i, ly + i, lz + i, count - i, u + i, v + i);
+    }
+}
+
+} // namespace
+
+#endif // SOFTWAREREMAPKERNEL_H
@@ -0,0 +1,229 @@
+#include "SoftwareRenderer.h"
+#include "ParallelStrips.h"
+#include "ColorConverter.h"
+
+#include <QQuaternion>
+#include <QVarLengthArray>
+#include <QtMath>
+#include <QtDebug>
+
+//#define TRACE_SOFTWARERENDERER
+#ifdef  TRACE_SOFTWARERENDERER
+#include <QTime>
+#include <QThread>
+#define TRACE()      qDebug() << QTime::currentTime().toString("hh:mm:ss.zzz") << QThread::currentThreadId() << Q_FUNC_INFO;
+#define TRACE_ARG(x) qDebug() << QTime::currentTime().toString("hh:mm:ss.zzz") << QThread::currentThreadId() << Q_FUNC_INFO << x;
+#else
+#define TRACE()
+#define TRACE_ARG(x)
+#endif
+
+static constexpr int const stripRows = 16; // small enough to balance the cores
+
+SoftwareRenderer::SoftwareRenderer()
+    : m_rotateDisplay(0)
+    , m_stereoShift(0.0)
+    , m_stereoMode(0)
+    , m_fovTan(1.0f)
+    , m_coverage(0.0, 0.0, 1.0, 1.0)
+    , m_frameDirty(false)
+    , m_lookupDirty(true)
+    , m_wrap(true)
+{
+    TRACE();
+    qInfo().nospace() << "Software renderer: " << instructionSet() << ", " << m_pool.maxThreadCount() << " threads";
+}
+
+SoftwareRenderer::~SoftwareRenderer()
+{
+    TRACE();
+    m_pool.waitForDone();
+}
+
+//static
+QString SoftwareRenderer::instructionSet()
+{
+    return QString::fromLatin1(remapInstructionSet());
+}
+
+void SoftwareRenderer::setRotateDisplay(int direction)
+{
+    TRACE_ARG(direction);
+    if (direction != m_rotateDisplay) {
+        m_rotateDisplay = direction;
+        m_lookupDirty = true;
+    }
+}
+
+void SoftwareRenderer::setStereoShift(qreal shift)
+{
+    TRACE_ARG(shift);
+    m_stereoShift = shift;
+}
+
+void SoftwareRenderer::setStereoMode(int mode)
+{
+    TRACE_ARG(mode);
+    m_stereoMode = qBound(0, mode, 2);
+}
+
+void SoftwareRenderer::setProjection(int angle)
+{
+    TRACE_ARG(angle);
+    float fov = qTan(qDegreesToRadians(0.5 * angle));
+    if (fov != m_fovTan) {
+        m_fovTan = fov;
+        m_lookupDirty = true;
+    }
+}
+
+void SoftwareRenderer::setOrientation(const QQuaternion &rotation)
+{
+    TRACE_ARG(rotation);
+    QMatrix4x4 matrix;
+    matrix.rotate(rotation.conjugated()); // the inverse of a unit quaternion
+    m_orientation = matrix;
+}
+
+void SoftwareRenderer::setCoverage(const QRectF &range)
+{
+    TRACE_ARG(range);
+    if (range.isEmpty()) {
+        m_coverage = QRectF(0.0, 0.0, 1.0, 1.0);
+        return;
+    }
+    m_coverage.setRect((range.left() + 180.0) / 360.0, (90.0 - range.bottom()) / 180.0,
+                       qMin(range.width() / 360.0, 1.0), qMin(range.height() / 180.0, 1.0));
+}
+
+void SoftwareRenderer::setVideoFrame(const QVideoFrame &frame)
+{
+    if (frame == m_videoFrame) return; // synchronized again, the image is up to date
+    TRACE_ARG(frame);
+    m_videoFrame = frame;
+    m_frameDirty = true;
+}
+
+void SoftwareRenderer::updateLookup(const QSize &eye)
+{
+    TRACE_ARG(eye << m_fovTan << m_rotateDisplay);
+    const int count = eye.width() * eye.height();
+    m_lookupX.resize(count);
+    m_lookupY.resize(count);
+    m_lookupZ.resize(count);
+    float *lx = m_lookupX.data(), *ly = m_lookupY.data(), *lz = m_lookupZ.data();
+
+    // The eye viewport to the view texture coordinates as shaders/display.frag, then to
+    // the view space directions of the frustum as shaders/view.vert
+    const float dir = m_rotateDisplay > 0 ? 1.0f : -1.0f;
+    for (int row = 0, i = 0; row < eye.height(); row++) {
+        const float y = 1.0f - (row + 0.5f) / eye.height(); // bottom-up
+        for (int col = 0; col < eye.width(); col++, i++) {
+            float tx = (col + 0.5f) / eye.width(), ty = y;
+            if (m_rotateDisplay) {
+                const float cx = tx - 0.5f, cy = ty - 0.5f;
+                tx = 0.5f - dir * cy;
+                ty = 0.5f + dir * cx;
+            }
+            lx[i] = (2.0f * tx - 1.0f) * m_fovTan;
+            ly[i] = (2.0f * ty - 1.0f) * m_fovTan;
+            lz[i] = -1.0f;
+        }
+    }
+    m_lookupSize = eye;
+    m_lookupDirty = false;
+}
+
+QImage SoftwareRenderer::render(const QSize &viewport)
+{
+    TRACE_ARG(viewport);
+    if (viewport.isEmpty() || !m_videoFrame.isValid())
+        return QImage();
+
+    if (m_frameDirty) {
+        // The planar YUV frames by the SIMD converter, the rest by Qt
+        bool converted = false;
+        if (ColorConverter::isSupported(m_videoFrame.pixelFormat()) && m_videoFrame.map(QVideoFrame::ReadOnly)) {
+            converted = ColorConverter::convert(m_videoFrame, m_frame, &m_pool);
+            m_videoFrame.unmap();
+        }
+        if (!converted) m_frame = m_videoFrame.toImage().convertToFormat(QImage::Format_RGB32);
+        m_frameDirty = false;
+        if (m_frame.isNull()) qCritical() << Q_FUNC_INFO << "Can't convert video frame" << m_videoFrame.pixelFormat();
+    }
+    if (m_frame.isNull())
+        return QImage();
+
+    // The eye halves of the viewport as VideoRenderer::renderDisplay(), bottom-up if portrait
+    const int halfWidth = viewport.width() / 2;
+    const int halfHeight = viewport.height() / 2;
+    if (halfWidth > halfHeight) {
+        m_eyeRects[0] = QRect(0, 0, halfWidth, viewport.height());
+        m_eyeRects[1] = QRect(halfWidth, 0, halfWidth, viewport.height());
+    } else {
+        m_eyeRects[0] = QRect(0, viewport.height() - halfHeight, viewport.width(), halfHeight);
+        m_eyeRects[1] = QRect(0, viewport.height() - 2 * halfHeight, viewport.width(), halfHeight);
+    }
+    if (m_eyeRects[0].isEmpty())
+        return QImage();
+    if (m_lookupDirty || m_eyeRects[0].size() != m_lookupSize)
+        updateLookup(m_eyeRects[0].size());
+
+    // Reuse the image unless the scene graph still holds the previous one
+    if (m_image.size() != viewport || !m_image.isDetached()) {
+        m_image = QImage(viewport, QImage::Format_RGB32);
+        m_image.fill(Qt::black);
+    }
+
+    // The packed stereo frame has a half per eye, the mono one is shifted for the right eye
+    static const float eyeRects[3][2][4] = {
+        { { 0.0f, 0.0f, 1.0f, 1.0f }, { 0.0f, 0.0f, 1.0f, 1.0f } },
+        { { 0.0f, 0.0f, 1.0f, 0.5f }, { 0.0f, 0.5f, 1.0f, 0.5f } }, // top-bottom
+        { { 0.0f, 0.0f, 0.5f, 1.0f }, { 0.5f, 0.0f, 0.5f, 1.0f } }  // side-by-side
+    };
+    const QMatrix4x4 toWorld = m_orientation.transposed(); // as the vdirection of shaders/view.vert
+    for (int eye = 0; eye < 2; eye++) {
+        RemapParams &params = m_params[eye];
+        for (int i = 0; i < 9; i++)
+            params.rotation[i] = toWorld(i / 3, i % 3);
+        params.xoffs = (eye && !m_stereoMode) ? float(-m_stereoShift / 250.0) : 0.0f;
+        params.range[0] = m_coverage.x();
+        params.range[1] = m_coverage.y();
+        params.range[2] = m_coverage.width();
+        params.range[3] = m_coverage.height();
+        const float *rect = eyeRects[m_stereoMode][eye];
+        int *part = m_frameParts[eye];
+        part[0] = qRound(rect[0] * m_frame.width());
+        part[1] = qRound(rect[1] * m_frame.height());
+        part[2] = qMax(1, qRound(rect[2] * m_frame.width()));
+        part[3] = qMax(1, qRound(rect[3] * m_frame.height()));
+        for (int i = 0; i < 4; i++)
+            params.eye[i] = part[i];
+    }
+    m_wrap = (m_coverage.width() >= 1.0 && m_stereoMode != 2);
+
+    // Both eyes in strips of rows on all cores
+    uchar *bits = m_image.bits();
+    const int stripsPerEye = (m_lookupSize.height() + stripRows - 1) / stripRows;
+    parallelStrips(&m_pool, 2 * stripsPerEye, [this, bits, stripsPerEye](int strip) {
+        renderStrip(strip / stripsPerEye, (strip % stripsPerEye) * stripRows, bits);
+    });
+    return m_image;
+}
+
+void SoftwareRenderer::renderStrip(int eye, int top, uchar *bits)
+{
+    const int width = m_lookupSize.width();
+    const int bottom = qMin(top + stripRows, m_lookupSize.height());
+    QVarLengthArray<float, 2048> u(width), v(width);
+    const auto frame = reinterpret_cast<const uint32_t *>(m_frame.constBits());
+    const int frameStride = m_frame.bytesPerLine() / 4;
+    const QRect &rect = m_eyeRects[eye];
+    for (int row = top; row < bottom; row++) {
+        const int offset = row * width;
+        remapDirections(m_params[eye], m_lookupX.constData() + offset, m_lookupY.constData() + offset,
+                        m_lookupZ.constData() + offset, width, u.data(), v.data());
+        auto dst = reinterpret_cast<uint32_t *>(bits + (rect.top() + row) * m_image.bytesPerLine()) + rect.left();
+        remapSample(frame, frameStride, m_frameParts[eye], m_wrap, u.constData(), v.constData(), width, dst);
+    }
+}
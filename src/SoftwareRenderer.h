@@ -0,0 +1,67 @@
+#ifndef SOFTWARERENDERER_H
+#define SOFTWARERENDERER_H
+
+#include <QVideoFrame>
+#include <QImage>
+#include <QMatrix4x4>
+#include <QQuaternion>
+#include <QRectF>
+#include <QSize>
+#include <QThreadPool>
+#include <QVector>
+
+#include "SoftwareRemap.h"
+
+/*
+ * The CPU fallback of VideoRenderer without a usable OpenGL: remaps the equirectangular
+ * frame into the perspective views of both eyes by the SIMD kernels of SoftwareRemap.h,
+ * in horizontal strips on all cores. The view directions per eye pixel are a lookup table
+ * rebuilt on the FOV, viewport or display rotation change only, the orientation is then
+ * a 3x3 rotation of the table per frame.
+ */
+class SoftwareRenderer
+{
+public:
+    SoftwareRenderer();
+    ~SoftwareRenderer();
+
+    static QString instructionSet(); // of the remap kernel running on this CPU
+
+    void setRotateDisplay(int direction); // -1/0/1
+    void setStereoShift(qreal shift); // 0.0..1.0, of the mono frames
+    void setStereoMode(int mode); // 0 mono, 1 top-bottom, 2 side-by-side
+    void setProjection(int angle); // vertical FOV angle 5..115 in degree
+    void setOrientation(const QQuaternion &rotation); // of the view, a unit quaternion
+    void setCoverage(const QRectF &range); // longitude, latitude range of the frame in degree
+    void setVideoFrame(const QVideoFrame &frame);
+
+    QImage render(const QSize &viewport); // both eyes as the display pass of VideoRenderer
+
+private:
+    void updateLookup(const QSize &eye);
+    void renderStrip(int eye, int top, uchar *bits);
+
+    int m_rotateDisplay;
+    qreal m_stereoShift;
+    int m_stereoMode;
+    float m_fovTan;
+    QMatrix4x4 m_orientation;
+    QRectF m_coverage; // of the frame in the normalized full sphere, top-left origin
+
+    QVideoFrame m_videoFrame;
+    bool m_frameDirty;
+    QImage m_frame; // RGB32
+
+    QSize m_lookupSize; // per eye
+    bool m_lookupDirty;
+    QVector<float> m_lookupX, m_lookupY, m_lookupZ; // the view directions per eye pixel
+
+    QImage m_image;
+    QRect m_eyeRects[2]; // within m_image
+    RemapParams m_params[2];
+    int m_frameParts[2][4]; // per eye in pixels: left, top, width, height
+    bool m_wrap;
+    QThreadPool m_pool;
+};
+
+#endif // SOFTWARERENDERER_H
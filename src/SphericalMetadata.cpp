@@ -0,0 +1,206 @@
+#include "SphericalMetadata.h"
+
+#include <QFile>
+#include <QtEndian>
+#include <QtDebug>
+
+//#define TRACE_SPHERICALMETADATA
+#ifdef  TRACE_SPHERICALMETADATA
+#include <QTime>
+#include <QThread>
+#define TRACE()      qDebug() << QTime::currentTime().toString("hh:mm:ss.zzz") << QThread::currentThreadId() << Q_FUNC_INFO;
+#define TRACE_ARG(x) qDebug() << QTime::currentTime().toString("hh:mm:ss.zzz") << QThread::currentThreadId() << Q_FUNC_INFO << x;
+#else
+#define TRACE()
+#define TRACE_ARG(x)
+#endif
+
+static constexpr int const maxBoxDepth = 8;
+static constexpr int const visualSampleEntrySize = 78; // after the box header
+static const QByteArray sphericalV1Uuid = QByteArray::fromHex("ffcc8263f8554a938814587a02521fdd");
+
+// Read the box header at pos, returns false at the end or on the bogus box
+static bool readBox(QIODevice *file, qint64 pos, qint64 end, QByteArray &type, qint64 &payload, qint64 &next)
+{
+    if (end - pos < 8 || !file->seek(pos)) return false;
+    QByteArray header = file->read(8);
+    if (header.size() != 8) return false;
+    qint64 size = qFromBigEndian<quint32>(header.constData());
+    type = header.mid(4, 4);
+    payload = pos + 8;
+    if (size == 1) { // largesize
+        QByteArray large = file->read(8);
+        if (large.size() != 8) return false;
+        size = qFromBigEndian<quint64>(large.constData());
+        payload += 8;
+    } else if (size == 0) { // up to the end
+        size = end - pos;
+    }
+    next = pos + size;
+    return size >= payload - pos && next <= end;
+}
+
+static QByteArray readPayload(QIODevice *file, qint64 payload, qint64 next, qint64 maxSize)
+{
+    if (!file->seek(payload)) return QByteArray();
+    return file->read(qMin(next - payload, maxSize));
+}
+
+SphericalMetadata::SphericalMetadata()
+    : m_spherical(false)
+    , m_videoTrack(false)
+    , m_stereoMode(StereoMono)
+    , m_projection(ProjectionUnknown)
+    , m_cubemapLayout(0)
+    , m_cubemapPadding(0)
+{
+}
+
+//static
+SphericalMetadata SphericalMetadata::read(const QString &fileName)
+{
+    TRACE_ARG(fileName);
+    SphericalMetadata meta;
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << Q_FUNC_INFO << fileName << file.errorString();
+        return meta;
+    }
+    meta.parseBoxes(&file, 0, file.size(), 0);
+    TRACE_ARG(meta.m_spherical << meta.m_stereoMode << meta.m_projection << meta.m_coverage);
+    return meta;
+}
+
+bool SphericalMetadata::isSpherical() const
+{
+    return m_spherical;
+}
+
+int SphericalMetadata::stereoMode() const
+{
+    return m_stereoMode;
+}
+
+SphericalMetadata::Projection SphericalMetadata::projection() const
+{
+    return m_projection;
+}
+
+QRectF SphericalMetadata::coverage() const
+{
+    return m_coverage;
+}
+
+quint32 SphericalMetadata::cubemapLayout() const
+{
+    return m_cubemapLayout;
+}
+
+quint32 SphericalMetadata::cubemapPadding() const
+{
+    return m_cubemapPadding;
+}
+
+bool SphericalMetadata::parseBoxes(QIODevice *file, qint64 begin, qint64 end, int depth)
+{
+    if (depth > maxBoxDepth) return false;
+    QByteArray type;
+    qint64 payload, next;
+    for (qint64 pos = begin; readBox(file, pos, end, type, payload, next); pos = next) {
+        if (type == "moov" || type == "mdia" || type == "minf" || type == "stbl") {
+            parseBoxes(file, payload, next, depth + 1);
+        } else if (type == "trak") {
+            m_videoTrack = false;
+            parseBoxes(file, payload, next, depth + 1);
+            if (m_spherical) return true; // the first spherical video track only
+        } else if (type == "hdlr") {
+            QByteArray data = readPayload(file, payload, next, 12);
+            m_videoTrack = (data.size() == 12 && data.mid(8, 4) == "vide");
+        } else if (type == "stsd" && m_videoTrack) {
+            parseSampleEntries(file, payload + 8, next); // skip version, flags and entry_count
+        } else if (type == "uuid" && !m_spherical) {
+            QByteArray data = readPayload(file, payload, next, 65536);
+            if (data.startsWith(sphericalV1Uuid))
+                parseSphericalV1(data.mid(sphericalV1Uuid.size()));
+        }
+    }
+    return m_spherical;
+}
+
+void SphericalMetadata::parseSampleEntries(QIODevice *file, qint64 begin, qint64 end)
+{
+    QByteArray type, box;
+    qint64 payload, next, childPayload, childNext;
+    for (qint64 pos = begin; readBox(file, pos, end, type, payload, next); pos = next) {
+        // The spherical boxes follow the visual sample entry fields
+        QList<qint64> containers = { payload + visualSampleEntrySize, next };
+        while (!containers.isEmpty()) {
+            qint64 cend = containers.takeLast(), cbegin = containers.takeLast();
+            for (qint64 cpos = cbegin; readBox(file, cpos, cend, box, childPayload, childNext); cpos = childNext) {
+                QByteArray data;
+                if (box == "sv3d" || box == "proj") {
+                    containers << childPayload << childNext;
+                    m_spherical = true;
+                } else if (box == "st3d") {
+                    data = readPayload(file, childPayload, childNext, 5);
+                    if (data.size() == 5 && uchar(data.at(4)) <= StereoSideBySide)
+                        m_stereoMode = uchar(data.at(4));
+                } else if (box == "equi") {
+                    data = readPayload(file, childPayload, childNext, 20);
+                    if (data.size() != 20) continue;
+                    m_projection = ProjectionEquirect;
+                    const qreal top    = qFromBigEndian<quint32>(data.constData() + 4)  / 4294967296.0;
+                    const qreal bottom = qFromBigEndian<quint32>(data.constData() + 8)  / 4294967296.0;
+                    const qreal left   = qFromBigEndian<quint32>(data.constData() + 12) / 4294967296.0;
+                    const qreal right  = qFromBigEndian<quint32>(data.constData() + 16) / 4294967296.0;
+                    if (top + bottom < 1.0 && left + right < 1.0 && (top > 0.0 || bottom > 0.0 || left > 0.0 || right > 0.0)) {
+                        m_coverage = QRectF(QPointF(-180.0 + left * 360.0, -90.0 + bottom * 180.0),
+                                            QPointF(180.0 - right * 360.0, 90.0 - top * 180.0));
+                    }
+                } else if (box == "cbmp") {
+                    data = readPayload(file, childPayload, childNext, 12);
+                    if (data.size() != 12) continue;
+                    m_projection = ProjectionCubemap;
+                    m_cubemapLayout = qFromBigEndian<quint32>(data.constData() + 4);
+                    m_cubemapPadding = qFromBigEndian<quint32>(data.constData() + 8);
+                } else if (box == "mshp") {
+                    m_projection = ProjectionMesh;
+                }
+            }
+        }
+        if (m_spherical) return;
+    }
+}
+
+void SphericalMetadata::parseSphericalV1(const QByteArray &xml)
+{
+    // Not a real XML parser, the few tags are enough to guess the layout
+    auto tagValue = [&xml](const char *tag) -> QByteArray {
+        const QByteArray open = QByteArray("<GSpherical:") + tag + '>';
+        int from = xml.indexOf(open);
+        if (from < 0) return QByteArray();
+        from += open.size();
+        int to = xml.indexOf('<', from);
+        return to < 0 ? QByteArray() : xml.mid(from, to - from).trimmed();
+    };
+    if (tagValue("Spherical").toLower() != "true") return;
+    m_spherical = true;
+    const QByteArray projection = tagValue("ProjectionType").toLower();
+    if (projection == "equirectangular") m_projection = ProjectionEquirect;
+    const QByteArray stereo = tagValue("StereoMode").toLower();
+    if (stereo == "top-bottom") m_stereoMode = StereoTopBottom;
+    else if (stereo == "left-right") m_stereoMode = StereoSideBySide;
+
+    bool ok[4];
+    const qreal fullWidth  = tagValue("FullPanoWidthPixels").toDouble(&ok[0]);
+    const qreal fullHeight = tagValue("FullPanoHeightPixels").toDouble(&ok[1]);
+    const qreal cropWidth  = tagValue("CroppedAreaImageWidthPixels").toDouble(&ok[2]);
+    const qreal cropHeight = tagValue("CroppedAreaImageHeightPixels").toDouble(&ok[3]);
+    if (!ok[0] || !ok[1] || !ok[2] || !ok[3] || fullWidth <= 0.0 || fullHeight <= 0.0) return;
+    const qreal left = tagValue("CroppedAreaLeftPixels").toDouble();
+    const qreal top  = tagValue("CroppedAreaTopPixels").toDouble();
+    if (cropWidth < fullWidth || cropHeight < fullHeight) {
+        m_coverage = QRectF(QPointF(-180.0 + left / fullWidth * 360.0, 90.0 - (top + cropHeight) / fullHeight * 180.0),
+                            QPointF(-180.0 + (left + cropWidth) / fullWidth * 360.0, 90.0 - top / fullHeight * 180.0));
+    }
+}
@@ -0,0 +1,54 @@
+#ifndef SPHERICALMETADATA_H
+#define SPHERICALMETADATA_H
+
+#include <QString>
+#include <QRectF>
+
+class QIODevice;
+
+/*
+ * The spherical video metadata of MP4/MOV containers: the st3d (stereo mode) and
+ * sv3d/proj (projection) boxes of Spherical Video V2 in the video sample entry,
+ * or the GSpherical XML of the Spherical Video V1 uuid box in the video track.
+ */
+class SphericalMetadata
+{
+public:
+    enum StereoMode { // as st3d stereo_mode
+        StereoMono,
+        StereoTopBottom,
+        StereoSideBySide
+    };
+    enum Projection {
+        ProjectionUnknown,
+        ProjectionEquirect,
+        ProjectionCubemap,
+        ProjectionMesh
+    };
+
+    SphericalMetadata();
+
+    static SphericalMetadata read(const QString &fileName);
+
+    bool isSpherical() const;
+    int stereoMode() const;
+    Projection projection() const;
+    QRectF coverage() const; // longitude, latitude range in degree, null if not cropped
+    quint32 cubemapLayout() const; // cbmp layout, 0 is the 3x2 equi-angular cubemap
+    quint32 cubemapPadding() const; // cbmp padding in pixels
+
+private:
+    bool parseBoxes(QIODevice *file, qint64 begin, qint64 end, int depth);
+    void parseSampleEntries(QIODevice *file, qint64 begin, qint64 end);
+    void parseSphericalV1(const QByteArray &xml);
+
+    bool m_spherical;
+    bool m_videoTrack;
+    int m_stereoMode;
+    Projection m_projection;
+    QRectF m_coverage;
+    quint32 m_cubemapLayout;
+    quint32 m_cubemapPadding;
+};
+
+#endif // SPHERICALMETADATA_H
@@ -3,7 +3,7 @@
 
 #include <QProcess>
 #include <QProcessEnvironment>
-#include <QQmlEngine>
+#include <QtQmlIntegration/qqmlintegration.h> // QML_ELEMENT without linking Qt Qml
 
 class SystemProcess : public QObject
 {
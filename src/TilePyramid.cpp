@@ -0,0 +1,399 @@
+#include "TilePyramid.h"
+
+#include <QObject>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QImageReader>
+#include <QSettings>
+#include <QDateTime>
+#include <QThreadPool>
+#include <QMutexLocker>
+#include <QPointer>
+#include <QScopeGuard>
+#include <QtDebug>
+
+#include <cstring>
+
+//#define TRACE_TILEPYRAMID
+#ifdef  TRACE_TILEPYRAMID
+#include <QTime>
+#include <QThread>
+#define TRACE()      qDebug() << QTime::currentTime().toString("hh:mm:ss.zzz") << QThread::currentThreadId() << Q_FUNC_INFO;
+#define TRACE_ARG(x) qDebug() << QTime::currentTime().toString("hh:mm:ss.zzz") << QThread::currentThreadId() << Q_FUNC_INFO << x;
+#else
+#define TRACE()
+#define TRACE_ARG(x)
+#endif
+
+static constexpr int const pyramidVersion = 1; // increment on any change of the cache layout
+static constexpr int const pageSize = 4096; // the smallest one, to touch each page of a tile
+
+static quint64 tileKey(int level, int x, int y)
+{
+    return (quint64(level) << 48) | (quint64(y) << 24) | quint64(x);
+}
+
+TilePyramid::TilePyramid(const QString &imageFile)
+    : m_imageFile(imageFile)
+    , m_cachePath(imageFile + QStringLiteral(".pyramid"))
+    , m_ready(false)
+{
+    TRACE_ARG(imageFile);
+    m_loader.setMaxThreadCount(1);
+}
+
+TilePyramid::~TilePyramid()
+{
+    TRACE();
+    m_loader.clear();
+    m_loader.waitForDone();
+    for (const auto &tile : m_loaded) unmapTile(tile.level, tile.data);
+}
+
+//static
+bool TilePyramid::isImageFile(const QString &fileName)
+{
+    static const QStringList suffixes = { "jpg", "jpeg", "png", "tif", "tiff", "webp", "bmp" };
+    const QString suffix = QFileInfo(fileName).suffix().toLower();
+    return suffixes.contains(suffix) && QImageReader::supportedImageFormats().contains(suffix.toLatin1());
+}
+
+QString TilePyramid::imageFile() const
+{
+    return m_imageFile;
+}
+
+QString TilePyramid::cachePath() const
+{
+    return m_cachePath;
+}
+
+bool TilePyramid::isReady() const
+{
+    return m_ready;
+}
+
+QSize TilePyramid::imageSize() const
+{
+    return m_imageSize;
+}
+
+int TilePyramid::levelCount() const
+{
+    return int(m_levels.size());
+}
+
+QSize TilePyramid::levelSize(int level) const
+{
+    return (level >= 0 && level < levelCount()) ? m_levels.at(level) : QSize();
+}
+
+QSize TilePyramid::levelTiles(int level) const
+{
+    QSize size = levelSize(level);
+    return QSize((size.width() + tileStep - 1) / tileStep, (size.height() + tileStep - 1) / tileStep);
+}
+
+QString TilePyramid::levelFileName(int level) const
+{
+    return QDir(m_cachePath).filePath(QStringLiteral("level%1.raw").arg(level));
+}
+
+void TilePyramid::build(QObject *context, const std::function<void(const QString &error)> &done)
+{
+    TRACE();
+    if (m_ready || loadIndex()) {
+        m_ready = true;
+        QMetaObject::invokeMethod(context, [done]() { done(QString()); }, Qt::QueuedConnection);
+        return;
+    }
+    QPointer<QObject> guard(context);
+    QThreadPool::globalInstance()->start([this, guard, done]() {
+        QString error = buildCache();
+        if (error.isEmpty()) m_ready = true;
+        if (!guard.isNull())
+            QMetaObject::invokeMethod(guard.data(), [done, error]() { done(error); }, Qt::QueuedConnection);
+    });
+}
+
+bool TilePyramid::loadIndex()
+{
+    QFileInfo info(m_imageFile);
+    QSettings index(QDir(m_cachePath).filePath(QStringLiteral("index.ini")), QSettings::IniFormat);
+    if (index.value("version").toInt() != pyramidVersion ||
+            index.value("tileSize").toInt() != tileSize ||
+            index.value("imageBytes").toLongLong() != info.size() ||
+            index.value("imageModified").toLongLong() != info.lastModified().toMSecsSinceEpoch()) return false;
+
+    QSize size = index.value("imageSize").toSize();
+    int levels = index.value("levels").toInt();
+    if (size.isEmpty() || levels < 1) return false;
+
+    std::vector<QSize> sizes;
+    for (int i = 0; i < levels; i++) {
+        QSize ls((size.width() + (1 << i) - 1) >> i, (size.height() + (1 << i) - 1) >> i);
+        QSize tiles((ls.width() + tileStep - 1) / tileStep, (ls.height() + tileStep - 1) / tileStep);
+        if (QFileInfo(levelFileName(i)).size() != qint64(tiles.width()) * tiles.height() * tileBytes)
+            return false;
+        sizes.push_back(ls);
+    }
+    m_imageSize = size;
+    m_levels = sizes;
+    m_files.clear();
+    m_files.resize(m_levels.size());
+    return true;
+}
+
+QString TilePyramid::buildCache()
+{
+    TRACE();
+    QFileInfo info(m_imageFile);
+    QDir dir(m_cachePath);
+    if (!dir.exists() && !dir.mkpath(QStringLiteral(".")))
+        return m_cachePath + QStringLiteral(": Can't create the tile cache directory");
+
+    QString error = buildLevel0(m_imageFile);
+    if (!error.isEmpty()) return error;
+
+    m_levels.clear();
+    m_levels.push_back(m_imageSize);
+    for (int i = 1; m_levels.back().width() > tileStep || m_levels.back().height() > tileStep; i++) {
+        m_levels.push_back(QSize((m_imageSize.width() + (1 << i) - 1) >> i, (m_imageSize.height() + (1 << i) - 1) >> i));
+        error = buildLevel(i);
+        if (!error.isEmpty()) return error;
+    }
+
+    QSettings index(dir.filePath(QStringLiteral("index.ini")), QSettings::IniFormat);
+    index.setValue("version", pyramidVersion);
+    index.setValue("tileSize", tileSize);
+    index.setValue("imageBytes", info.size());
+    index.setValue("imageModified", info.lastModified().toMSecsSinceEpoch());
+    index.setValue("imageSize", m_imageSize);
+    index.setValue("levels", levelCount());
+    index.sync();
+    if (index.status() != QSettings::NoError)
+        return m_cachePath + QStringLiteral(": Can't write the tile cache index");
+
+    m_files.clear();
+    m_files.resize(m_levels.size());
+    return QString();
+}
+
+QString TilePyramid::buildLevel0(const QString &fileName)
+{
+    QImageReader probe(fileName);
+    m_imageSize = probe.size();
+    if (m_imageSize.isEmpty())
+        return fileName + QStringLiteral(": ") + probe.errorString();
+    const int width = m_imageSize.width(), height = m_imageSize.height();
+
+    // The panorama is read by the bands of tile rows to limit the memory use where the reader
+    // clips while decoding (JPEG), else decoded once as a whole (PNG, most TIFF) as reading by
+    // the bands would decode it all again for each band
+    const bool banded = probe.supportsOption(QImageIOHandler::ClipRect);
+    TRACE_ARG(m_imageSize << "banded" << banded);
+
+    // The allocation limit of the readers is process-wide, raised for the build only as much
+    // as the decoded band or image needs and restored then
+    const int allocationLimit = QImageReader::allocationLimit(); // MB, 0 is none
+    const int neededLimit = int((qint64(width) * (banded ? tileSize : height) * 4) >> 20) + 1;
+    if (allocationLimit > 0 && allocationLimit < neededLimit)
+        QImageReader::setAllocationLimit(neededLimit);
+    const auto restoreLimit = qScopeGuard([allocationLimit]() {
+        if (QImageReader::allocationLimit() != allocationLimit)
+            QImageReader::setAllocationLimit(allocationLimit);
+    });
+
+    QFile out(levelFileName(0));
+    if (!out.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return out.fileName() + QStringLiteral(": ") + out.errorString();
+
+    const int tilesX = (width + tileStep - 1) / tileStep;
+    const int tilesY = (height + tileStep - 1) / tileStep;
+    QByteArray tile(tileBytes, Qt::Uninitialized);
+    QImage band; // of the rows from y0, or the whole image
+    int y0 = 0;
+    for (int ty = 0; ty < tilesY; ty++) {
+        if (banded || band.isNull()) {
+            y0 = banded ? qMax(ty * tileStep - 1, 0) : 0;
+            const int y1 = banded ? qMin(ty * tileStep - 1 + tileSize, height) : height;
+            QImageReader reader(fileName);
+            if (banded) reader.setClipRect(QRect(0, y0, width, y1 - y0));
+            band = reader.read();
+            if (band.isNull())
+                return fileName + QStringLiteral(": ") + reader.errorString();
+            band.convertTo(QImage::Format_RGBA8888);
+            if (band.size() != QSize(width, y1 - y0))
+                return fileName + QStringLiteral(": Unexpected image band size");
+        }
+
+        for (int tx = 0; tx < tilesX; tx++) {
+            uchar *dst = reinterpret_cast<uchar *>(tile.data());
+            for (int j = 0; j < tileSize; j++, dst += tileSize * 4) {
+                int y = qBound(0, ty * tileStep - 1 + j, height - 1) - y0;
+                const uchar *src = band.constScanLine(qBound(0, y, band.height() - 1));
+                for (int i = 0; i < tileSize; ) { // wrap around the panorama horizontally
+                    int x = (tx * tileStep - 1 + i + width) % width;
+                    int n = qMin(tileSize - i, width - x);
+                    std::memcpy(dst + i * 4, src + x * 4, n * 4);
+                    i += n;
+                }
+            }
+            if (out.write(tile) != tileBytes)
+                return out.fileName() + QStringLiteral(": ") + out.errorString();
+        }
+    }
+    return QString();
+}
+
+QString TilePyramid::buildLevel(int level)
+{
+    TRACE_ARG(level << m_levels.at(level));
+    const QSize srcSize = m_levels.at(level - 1), dstSize = m_levels.at(level);
+    const int srcTilesX = (srcSize.width() + tileStep - 1) / tileStep;
+    const int srcTilesY = (srcSize.height() + tileStep - 1) / tileStep;
+    const int dstTilesX = (dstSize.width() + tileStep - 1) / tileStep;
+    const int dstTilesY = (dstSize.height() + tileStep - 1) / tileStep;
+    const qint64 srcRowBytes = qint64(srcTilesX) * tileBytes;
+
+    QFile in(levelFileName(level - 1)), out(levelFileName(level));
+    if (!in.open(QIODevice::ReadOnly))
+        return in.fileName() + QStringLiteral(": ") + in.errorString();
+    if (!out.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return out.fileName() + QStringLiteral(": ") + out.errorString();
+
+    QByteArray tile(tileBytes, Qt::Uninitialized);
+    for (int ty = 0; ty < dstTilesY; ty++) {
+        // Only the band of the source tile rows under this row of tiles is mapped
+        const int sy0 = qMax(((ty * tileStep - 1) * 2) / tileStep, 0);
+        const int sy1 = qMin(((ty * tileStep - 1 + tileSize) * 2) / tileStep + 1, srcTilesY);
+        const uchar *band = in.map(sy0 * srcRowBytes, (sy1 - sy0) * srcRowBytes);
+        if (!band)
+            return in.fileName() + QStringLiteral(": ") + in.errorString();
+
+        auto pixel = [&](int x, int y) -> const uchar * { // of the source level interior
+            x = (x + srcSize.width()) % srcSize.width();
+            y = qBound(0, y, srcSize.height() - 1);
+            int tx = x / tileStep, ty = y / tileStep;
+            return band + (qint64(ty - sy0) * srcTilesX + tx) * tileBytes
+                    + ((y - ty * tileStep + 1) * tileSize + (x - tx * tileStep + 1)) * 4;
+        };
+        for (int tx = 0; tx < dstTilesX; tx++) {
+            uchar *dst = reinterpret_cast<uchar *>(tile.data());
+            for (int j = 0; j < tileSize; j++) {
+                int y = qBound(0, ty * tileStep - 1 + j, dstSize.height() - 1) * 2;
+                for (int i = 0; i < tileSize; i++, dst += 4) {
+                    int x = ((tx * tileStep - 1 + i + dstSize.width()) % dstSize.width()) * 2;
+                    const uchar *p0 = pixel(x, y), *p1 = pixel(x + 1, y);
+                    const uchar *p2 = pixel(x, y + 1), *p3 = pixel(x + 1, y + 1);
+                    for (int c = 0; c < 4; c++)
+                        dst[c] = uchar((p0[c] + p1[c] + p2[c] + p3[c] + 2) >> 2);
+                }
+            }
+            if (out.write(tile) != tileBytes) {
+                in.unmap(const_cast<uchar *>(band));
+                return out.fileName() + QStringLiteral(": ") + out.errorString();
+            }
+        }
+        in.unmap(const_cast<uchar *>(band));
+    }
+    return QString();
+}
+
+QImage TilePyramid::baseImage() const
+{
+    if (!m_ready) return QImage();
+    int level = 0;
+    while (level < levelCount() - 1 && m_levels.at(level).width() > baseWidth) level++;
+    TRACE_ARG(level << m_levels.at(level));
+
+    QFile in(levelFileName(level));
+    if (!in.open(QIODevice::ReadOnly)) {
+        qWarning() << Q_FUNC_INFO << in.fileName() << in.errorString();
+        return QImage();
+    }
+    const QSize size = m_levels.at(level), tiles = levelTiles(level);
+    const uchar *data = in.map(0, in.size());
+    if (!data) {
+        qWarning() << Q_FUNC_INFO << in.fileName() << in.errorString();
+        return QImage();
+    }
+    QImage image(size, QImage::Format_RGBA8888);
+    for (int y = 0; y < size.height(); y++) {
+        uchar *dst = image.scanLine(y);
+        int ty = y / tileStep;
+        for (int tx = 0; tx < tiles.width(); tx++) {
+            const uchar *src = data + (qint64(ty) * tiles.width() + tx) * tileBytes
+                    + ((y - ty * tileStep + 1) * tileSize + 1) * 4;
+            int n = qMin(tileStep, size.width() - tx * tileStep);
+            std::memcpy(dst + tx * tileStep * 4, src, n * 4);
+        }
+    }
+    in.unmap(const_cast<uchar *>(data));
+    return image;
+}
+
+uchar *TilePyramid::mapTile(int level, int x, int y)
+{
+    if (!m_ready || level < 0 || level >= levelCount()) return nullptr;
+    const QSize tiles = levelTiles(level);
+    if (x < 0 || x >= tiles.width() || y < 0 || y >= tiles.height()) return nullptr;
+
+    QMutexLocker lock(&m_fileMutex);
+    auto &file = m_files[level];
+    if (!file) {
+        file.reset(new QFile(levelFileName(level)));
+        if (!file->open(QIODevice::ReadOnly)) {
+            qWarning() << Q_FUNC_INFO << file->fileName() << file->errorString();
+            return nullptr;
+        }
+    }
+    return file->map((qint64(y) * tiles.width() + x) * tileBytes, tileBytes);
+}
+
+void TilePyramid::unmapTile(int level, uchar *data)
+{
+    if (!data || level < 0 || level >= levelCount()) return;
+    QMutexLocker lock(&m_fileMutex);
+    if (m_files[level]) m_files[level]->unmap(data);
+}
+
+uchar *TilePyramid::takeTile(int level, int x, int y)
+{
+    if (!m_ready) return nullptr;
+    const quint64 key = tileKey(level, x, y);
+    QMutexLocker lock(&m_loadMutex);
+    for (auto it = m_loaded.begin(); it != m_loaded.end(); ++it) {
+        if (it->key != key) continue;
+        uchar *data = it->data;
+        m_loaded.erase(it);
+        return data;
+    }
+    if (m_loading.contains(key) || m_loading.size() >= maxLoadingTiles) return nullptr;
+    m_loading.insert(key);
+    lock.unlock();
+    m_loader.start([this, level, x, y]() { loadTile(level, x, y); });
+    return nullptr;
+}
+
+void TilePyramid::loadTile(int level, int x, int y)
+{
+    // Touch every page so the upload by the render thread doesn't fault on the disk
+    uchar *data = mapTile(level, x, y);
+    if (data) {
+        uchar sum = 0;
+        for (int i = 0; i < tileBytes; i += pageSize) sum += static_cast<volatile uchar *>(data)[i];
+        Q_UNUSED(sum);
+    }
+    TRACE_ARG(level << x << y << (data != nullptr));
+
+    QMutexLocker lock(&m_loadMutex);
+    m_loading.remove(tileKey(level, x, y));
+    if (!data) return;
+    m_loaded.push_back({ tileKey(level, x, y), level, data });
+    while (m_loaded.size() > size_t(maxLoadedTiles)) { // not taken, out of the view meanwhile
+        unmapTile(m_loaded.front().level, m_loaded.front().data);
+        m_loaded.pop_front();
+    }
+}
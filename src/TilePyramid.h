@@ -0,0 +1,96 @@
+#ifndef TILEPYRAMID_H
+#define TILEPYRAMID_H
+
+#include <QString>
+#include <QSize>
+#include <QImage>
+#include <QMutex>
+#include <QSet>
+#include <QThreadPool>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+
+class QObject;
+class QFile;
+
+/*
+ * The multi-resolution pyramid of a still panorama image, cached on disk next to the image
+ * (<image>.pyramid directory) as one raw file of RGBA8888 tiles per level. The level 0 is
+ * the full resolution, each next level is half the size down to a single tile. Each tile
+ * has a one pixel border taken from its neighbors (wrapped around horizontally) for the
+ * seamless linear filtering in the GPU tile cache.
+ *
+ * The tiles are memory-mapped one by one and paged in by a loader thread as the render thread
+ * asks for them, which uploads only the resident ones, so the memory use doesn't depend on
+ * the image size and the render thread never waits for the disk.
+ */
+class TilePyramid
+{
+public:
+    static constexpr int const tileSize  = 512; // in pixels including the border
+    static constexpr int const tileStep  = tileSize - 2; // the tile interior
+    static constexpr int const tileBytes = tileSize * tileSize * 4;
+    static constexpr int const baseWidth = 4096; // the max width of the base video frame
+    static constexpr int const maxLoadingTiles = 8; // queued to the loader thread
+    static constexpr int const maxLoadedTiles = 16; // paged in and not taken yet, the oldest are dropped
+
+    explicit TilePyramid(const QString &imageFile);
+    ~TilePyramid();
+
+    static bool isImageFile(const QString &fileName);
+
+    QString imageFile() const;
+    QString cachePath() const;
+    bool isReady() const;
+
+    QSize imageSize() const;
+    int levelCount() const;
+    QSize levelSize(int level) const;
+    QSize levelTiles(int level) const;
+
+    // Build the cache if missing or outdated; the done() is called in the context thread
+    void build(QObject *context, const std::function<void(const QString &error)> &done);
+
+    // The whole image downscaled to the coarsest level within baseWidth
+    QImage baseImage() const;
+
+    // Thread-safe once isReady(), the tile data is valid until unmapTile()
+    uchar *mapTile(int level, int x, int y);
+    void unmapTile(int level, uchar *data);
+
+    // The tile paged in by the loader thread, else null and queued to it; the data is handed
+    // back by unmapTile() after the upload
+    uchar *takeTile(int level, int x, int y);
+
+private:
+    bool loadIndex();
+    QString buildCache();
+    QString buildLevel0(const QString &fileName);
+    QString buildLevel(int level);
+    QString levelFileName(int level) const;
+    void loadTile(int level, int x, int y); // by the loader thread
+
+    struct LoadedTile {
+        quint64 key;
+        int level;
+        uchar *data;
+    };
+
+    QString m_imageFile;
+    QString m_cachePath;
+    QSize m_imageSize;
+    std::vector<QSize> m_levels;
+    std::atomic<bool> m_ready;
+    QMutex m_fileMutex;
+    std::vector<std::unique_ptr<QFile>> m_files;
+
+    QMutex m_loadMutex;
+    QSet<quint64> m_loading; // the keys queued to the loader
+    std::deque<LoadedTile> m_loaded;
+    QThreadPool m_loader; // a single thread, the tiles are read one after another
+};
+
+#endif // TILEPYRAMID_H
@@ -9,6 +9,9 @@ class VideoFrameExtData : public QSharedData
 public:
     VideoFrameExtData()
         : m_planeFormat(0)
+        , m_planeExternal(false)
+        , m_planeSplit(false)
+        , m_sampleScale(1.0f)
         , m_colorFull(false)
         , m_colorSpace(VideoFrameExt::ColorSpaceBT709)
         , m_colorTransfer(VideoFrameExt::ColorTransferNOOP)
@@ -17,6 +20,9 @@ public:
     VideoFrameExtData(const VideoFrameExtData &other)
         : QSharedData(other)
         , m_planeFormat(other.m_planeFormat)
+        , m_planeExternal(other.m_planeExternal)
+        , m_planeSplit(other.m_planeSplit)
+        , m_sampleScale(other.m_sampleScale)
         , m_colorFull(other.m_colorFull)
         , m_colorSpace(other.m_colorSpace)
         , m_colorTransfer(other.m_colorTransfer)
@@ -25,6 +31,9 @@ public:
     ~VideoFrameExtData() {}
 
     int m_planeFormat;
+    bool m_planeExternal;
+    bool m_planeSplit;
+    float m_sampleScale;
     bool m_colorFull;
     int m_colorSpace;
     int m_colorTransfer;
@@ -47,6 +56,9 @@ VideoFrameExt::~VideoFrameExt() {}
 bool VideoFrameExt::operator==(const VideoFrameExt &other) const
 {
     return (data->m_planeFormat   == other.data->m_planeFormat &&
+            data->m_planeExternal == other.data->m_planeExternal &&
+            data->m_planeSplit    == other.data->m_planeSplit &&
+            data->m_sampleScale   == other.data->m_sampleScale &&
             data->m_colorFull     == other.data->m_colorFull &&
             data->m_colorSpace    == other.data->m_colorSpace &&
             data->m_colorTransfer == other.data->m_colorTransfer &&
@@ -56,6 +68,9 @@ bool VideoFrameExt::operator==(const VideoFrameExt &other) const
 bool VideoFrameExt::operator!=(const VideoFrameExt &other) const
 {
     return (data->m_planeFormat   != other.data->m_planeFormat ||
+            data->m_planeExternal != other.data->m_planeExternal ||
+            data->m_planeSplit    != other.data->m_planeSplit ||
+            data->m_sampleScale   != other.data->m_sampleScale ||
             data->m_colorFull     != other.data->m_colorFull ||
             data->m_colorSpace    != other.data->m_colorSpace ||
             data->m_colorTransfer != other.data->m_colorTransfer ||
@@ -66,6 +81,17 @@ VideoFrameExt::VideoFrameExt(int planeFmt, const QVideoFrameFormat &surfaceForma
     : data(new VideoFrameExtData)
 {
     setPlaneFormat(planeFmt);
+    switch (surfaceFormat.pixelFormat()) {
+    case QVideoFrameFormat::Format_P010: // 10 bit in the MSBs of 16 bit
+        setSampleScale(65535.0f / (64.0f * 1023.0f));
+        break;
+    case QVideoFrameFormat::Format_YUV420P10: // 10 bit in the LSBs of 16 bit
+        setSampleScale(65535.0f / 1023.0f);
+        break;
+    default:
+        break;
+    }
+
     switch (surfaceFormat.colorSpace()) {
     case QVideoFrameFormat::ColorSpace_BT601:
         setColorSpace(ColorSpaceBT601);
@@ -112,6 +138,36 @@ int VideoFrameExt::planeFormat() const
     return data->m_planeFormat;
 }
 
+void VideoFrameExt::setPlaneExternal(bool yes)
+{
+    data->m_planeExternal = yes;
+}
+
+bool VideoFrameExt::isPlaneExternal() const
+{
+    return data->m_planeExternal;
+}
+
+void VideoFrameExt::setPlaneSplit(bool yes)
+{
+    data->m_planeSplit = yes;
+}
+
+bool VideoFrameExt::isPlaneSplit() const
+{
+    return data->m_planeSplit;
+}
+
+void VideoFrameExt::setSampleScale(float scale)
+{
+    data->m_sampleScale = scale;
+}
+
+float VideoFrameExt::sampleScale() const
+{
+    return data->m_sampleScale;
+}
+
 void VideoFrameExt::setColorFull(bool yes)
 {
     data->m_colorFull = yes;
@@ -157,6 +213,9 @@ void VideoFrameExt::dump(QDebug &dbg) const
     QDebugStateSaver saver(dbg);
     dbg.noquote();
     dbg << "VideoFrameExt(planeFormat" << data->m_planeFormat
+        << ", isPlaneExternal" << data->m_planeExternal
+        << ", isPlaneSplit"  << data->m_planeSplit
+        << ", sampleScale"   << data->m_sampleScale
         << ", isColorFull"   << data->m_colorFull
         << ", colorSpace"    << data->m_colorSpace
         << ", colorTransfer" << data->m_colorTransfer
@@ -37,6 +37,15 @@ public:
     void setPlaneFormat(int plane);
     int planeFormat() const;
 
+    void setPlaneExternal(bool yes); // the plane0 is samplerExternalOES
+    bool isPlaneExternal() const;
+
+    void setPlaneSplit(bool yes); // 16 bit samples uploaded as byte pairs
+    bool isPlaneSplit() const;
+
+    void setSampleScale(float scale); // normalizes 10 bit samples stored in 16 bit
+    float sampleScale() const;
+
     void setColorFull(bool yes);
     bool isColorFull() const;
 
@@ -1,16 +1,36 @@
 #include "VideoRenderer.h"
+#include "TilePyramid.h"
+#include "SharedFrame.h"
+#include "CaptureRing.h"
+#include "LoopCache.h"
 
-#include <QSGRendererInterface>
+#ifndef PANORAMA_NO_QUICK // the kiosk frontend is built without Qt Quick
 #include <QQuickWindow>
+#endif
 #include <QSurfaceFormat>
 #include <QOpenGLContext>
 #include <QOpenGLDebugLogger>
 #include <QQuaternion>
 #include <QTimer>
+#include <QScreen>
 #include <QFile>
+#include <rhi/qrhi.h>
+#include <private/qvideoframe_p.h>
+#include <private/qhwvideobuffer_p.h>
 
 #include <GL/glcorearb.h>
 
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+
+#ifndef GL_TEXTURE_EXTERNAL_OES
+#define GL_TEXTURE_EXTERNAL_OES 0x8D65
+#endif
+#ifndef GL_COMPRESSED_SRGB8_ETC2
+#define GL_COMPRESSED_SRGB8_ETC2 0x9275
+#endif
+
 //#define TRACE_VIDEORENDERER
 #ifdef  TRACE_VIDEORENDERER
 #include <QTime>
@@ -22,19 +42,74 @@
 #define TRACE_ARG(x)
 #endif
 
-VideoRenderer::VideoRenderer(QQuickWindow *win, bool debugOpenGL)
+// Whether the external OES frames are imported, by the renderer initialized on its render
+// thread and read by isFrameSuppored() on the thread of the frames: -1 is not known yet, the
+// frames are passed then so that the renderer initializes by them
+static std::atomic<int> s_importExternalOES(-1);
+
+VideoRenderer::VideoRenderer(QWindow *win, bool debugOpenGL)
     : m_window(win)
+#ifndef PANORAMA_NO_QUICK
+    , m_quickWindow(qobject_cast<QQuickWindow *>(win))
+#endif
+    , m_offscreen(!win)
+    , m_targetFbo(0)
     , m_openGLES(false)
     , m_anisotropic(false)
     , m_initialized(false)
+    , m_zeroCopy(false)
+    , m_externalOES(false)
+    , m_importFrames(true)
+    , m_norm16(false)
+    , m_etc2(false)
+    , m_maxTextureSize(4096)
+    , m_maxTextureLayers(256)
+    , m_fovTan(1.0f)
+    , m_coverage(0.0, 0.0, 1.0, 1.0)
     , m_rotateDisplay(0)
     , m_stereoShift(0.0)
+    , m_stereoMode(0)
+    , m_frameProjection(0)
+    , m_cubemapPadding(0)
     , m_frameCount(0)
+    , m_frameConverted(0)
     , m_renderFrame(false)
-    , m_viewSize(3840, 2160) // UHD 4k by default
+    , m_frameGrid(1, 1)
+    , m_frameSplit16(false)
+    , m_viewSize(1920, 1080) // per eye, HD by default
+    , m_viewSlabs(false)
+    , m_viewMesh(false)
+    , m_viewProjection(0)
+    , m_meshVao(0)
+    , m_meshIndices(0)
+    , m_viewTiles(false)
+    , m_viewProgTiles(false)
+    , m_tileAtlasTex(0)
+    , m_tileTableTex(0)
+    , m_tileLevel(-1)
+    , m_tileTableDirty(false)
+    , m_tileFrame(0)
+    , m_frameTiming(false)
+    , m_cpuTime(0)
+    , m_gpuBudget(0)
+    , m_gpuStats(false)
+    , m_gpuStatsFrames(0)
+    , m_cacheIndex(-1)
+    , m_cacheTex(0)
+    , m_overlaysDirty(false)
+    , m_overlayAtlasSerial(0)
+    , m_overlayTex(0)
+    , m_overlayVao(0)
+    , m_overlayBuf(0)
+    , m_monoDisplay(false)
+    , m_shareFbo(0)
+    , m_sourceSlot(-1)
+    , m_sourceTex(0)
+    , m_sourceSampler(0)
+    , m_captureRate(0)
+    , m_captureWidth(0)
+    , m_captureTex(0)
 {
-    Q_ASSERT(m_window);
-
     const auto ctx = QOpenGLContext::currentContext();
     if (!ctx || !ctx->isValid()) {
         emitErrorOccured(QStringLiteral("Invalid OpenGL context"));
@@ -48,26 +123,66 @@ VideoRenderer::VideoRenderer(QQuickWindow *win, bool debugOpenGL)
     }
     initializeOpenGLFunctions();
 
-    m_viewportSize = m_window->size() * m_window->devicePixelRatio();
+    if (m_window) m_viewportSize = m_window->size() * m_window->devicePixelRatio();
     m_openGLES = (fmt.renderableType() == QSurfaceFormat::OpenGLES ||
                   QOpenGLContext::openGLModuleType() == QOpenGLContext::LibGLES);
     m_anisotropic = (ctx->hasExtension("GL_ARB_texture_filter_anisotropic") ||
                      ctx->hasExtension("GL_EXT_texture_filter_anisotropic"));
+    m_norm16 = (!m_openGLES || ctx->hasExtension("GL_EXT_texture_norm16"));
+    m_etc2 = (m_openGLES || fmt.version() >= qMakePair(4, 3) || ctx->hasExtension("GL_ARB_ES3_compatibility"));
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &m_maxTextureSize);
+    glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &m_maxTextureLayers);
+    m_glRenderer = QString::fromLatin1(reinterpret_cast<const char *>(glGetString(GL_RENDERER)));
+    TRACE_ARG("Renderer" << m_glRenderer);
     TRACE_ARG("Viewport" << m_viewportSize << "OpenGLES" << m_openGLES << "Anisotropic" << m_anisotropic);
 
-    connect(m_window, &QQuickWindow::widthChanged, this, &VideoRenderer::onWidthChanged);
-    connect(m_window, &QQuickWindow::heightChanged, this, &VideoRenderer::onHeightChanged);
-    connect(m_window, &QQuickWindow::beforeRendering, this, &VideoRenderer::onBeforeRendering, Qt::DirectConnection);
-    connect(m_window, &QQuickWindow::beforeRenderPassRecording, this, &VideoRenderer::onBeforeRenderPassRecording, Qt::DirectConnection);
+    // The zero-copy import requires the decoder textures to live in the scene graph's QRhi,
+    // probe it here and then again per frame by the frame handle type
+    const auto rhi = sceneRhi();
+    m_zeroCopy = (rhi && rhi->backend() == QRhi::OpenGLES2);
+    m_externalOES = (m_openGLES && ctx->hasExtension("GL_OES_EGL_image_external_essl3"));
+    TRACE_ARG("ZeroCopy" << m_zeroCopy << "ExternalOES" << m_externalOES);
+    s_importExternalOES = (m_zeroCopy && m_importFrames && m_externalOES) ? 1 : 0;
+
+    if (m_window) {
+        connect(m_window, &QWindow::widthChanged, this, &VideoRenderer::onWidthChanged);
+        connect(m_window, &QWindow::heightChanged, this, &VideoRenderer::onHeightChanged);
+    }
+#ifndef PANORAMA_NO_QUICK
+    if (m_quickWindow) {
+        connect(m_quickWindow, &QQuickWindow::beforeRendering, this, &VideoRenderer::onBeforeRendering, Qt::DirectConnection);
+        connect(m_quickWindow, &QQuickWindow::beforeRenderPassRecording, this, &VideoRenderer::onBeforeRenderPassRecording, Qt::DirectConnection);
+    }
+#endif
 
     if (debugOpenGL) setDebugOpenGL(true);
 }
 
+VideoRenderer::~VideoRenderer()
+{
+    TRACE();
+    // The GL objects go with the scene graph context, just leave the shared frames
+    if (m_frameShare) m_frameShare->reset();
+    if (m_frameSource) {
+        m_frameSource->release(m_sourceSlot);
+        m_frameSource->removeConsumer(m_window);
+    }
+}
+
 void VideoRenderer::emitErrorOccured(const QString &text)
 {
     QTimer::singleShot(0, this, [this, text]() { emit errorOccurred(text); });
 }
 
+QRhi *VideoRenderer::sceneRhi() const
+{
+#ifndef PANORAMA_NO_QUICK
+    return m_quickWindow ? m_quickWindow->rhi() : nullptr;
+#else
+    return nullptr;
+#endif
+}
+
 void VideoRenderer::onWidthChanged(int width)
 {
     TRACE_ARG(width);
@@ -95,6 +210,30 @@ bool VideoRenderer::isFrameSuppored(const QVideoFrame &frame)
     case QVideoFrameFormat::Format_YUV422P:
     case QVideoFrameFormat::Format_NV12:
     case QVideoFrameFormat::Format_YV12:
+    case QVideoFrameFormat::Format_YUV420P10:
+    case QVideoFrameFormat::Format_P010:
+    case QVideoFrameFormat::Format_P016:
+    case QVideoFrameFormat::Format_Y8:
+    case QVideoFrameFormat::Format_Y16:
+    case QVideoFrameFormat::Format_ARGB8888:
+    case QVideoFrameFormat::Format_ARGB8888_Premultiplied:
+    case QVideoFrameFormat::Format_XRGB8888:
+    case QVideoFrameFormat::Format_BGRA8888:
+    case QVideoFrameFormat::Format_BGRA8888_Premultiplied:
+    case QVideoFrameFormat::Format_BGRX8888:
+    case QVideoFrameFormat::Format_ABGR8888:
+    case QVideoFrameFormat::Format_XBGR8888:
+    case QVideoFrameFormat::Format_RGBA8888:
+    case QVideoFrameFormat::Format_RGBX8888:
+    case QVideoFrameFormat::Format_AYUV:
+    case QVideoFrameFormat::Format_AYUV_Premultiplied:
+    case QVideoFrameFormat::Format_UYVY:
+    case QVideoFrameFormat::Format_YUYV:
+        break;
+    case QVideoFrameFormat::Format_SamplerExternalOES:
+        // Never mappable, only the decoder texture in the scene graph's context is imported
+        if (frame.handleType() != QVideoFrame::RhiTextureHandle || s_importExternalOES == 0)
+            return false;
         break;
     default:
         return false;
@@ -128,10 +267,19 @@ void VideoRenderer::setDebugOpenGL(bool yes)
              << "\n\tVendor\t\t" << reinterpret_cast<const char*>(glGetString(GL_VENDOR))
              << "\n\tRenderer\t" << reinterpret_cast<const char*>(glGetString(GL_RENDERER))
              << "\n\tAnisotropic\t" << m_anisotropic
-             << "\n\tTextureSize\t" << maxTexSize
+             << "\n\tNorm16\t\t" << m_norm16
+             << "\n\tZeroCopy\t" << (m_zeroCopy && m_importFrames) << (m_externalOES ? "(OES)" : "")
+             << "\n\tTextureSize\t" << maxTexSize << "(frame grid" << m_frameGrid << ")"
              << "\n\tFrameBuffer\t" << maxFBWidth << 'x' << maxFBHeight;
 }
 
+void VideoRenderer::setZeroCopy(bool yes)
+{
+    TRACE_ARG(yes);
+    m_importFrames = yes;
+    if (m_initialized) s_importExternalOES = (m_zeroCopy && m_importFrames && m_externalOES) ? 1 : 0;
+}
+
 void VideoRenderer::setRotateDisplay(int direction)
 {
     TRACE_ARG(direction);
@@ -144,27 +292,53 @@ void VideoRenderer::setStereoShift(qreal shift)
     m_stereoShift = shift;
 }
 
-void VideoRenderer::setProjection(int angle)
+void VideoRenderer::setProjection(qreal angle)
 {
     TRACE_ARG(angle);
     float fov = qTan(qDegreesToRadians(0.5 * angle));
+    m_fovTan = fov;
     QMatrix4x4 matrix;
     matrix.frustum(-fov, fov, -fov, fov, 1.0, 100.0);
     m_projection = matrix;
     m_projection.optimize();
 }
 
-void VideoRenderer::setOrientation(qreal pitch, qreal yaw)
+void VideoRenderer::setOrientation(const QQuaternion &rotation)
 {
-    TRACE_ARG(pitch);
+    TRACE_ARG(rotation);
     QMatrix4x4 matrix;
-    matrix.rotate(QQuaternion::fromEulerAngles(pitch, yaw, 0.0).inverted());
+    matrix.rotate(rotation.conjugated()); // the inverse of a unit quaternion
     m_orientation = matrix;
     m_orientation.optimize();
 }
 
+void VideoRenderer::setCoverage(const QRectF &range)
+{
+    TRACE_ARG(range);
+    if (range.isEmpty()) {
+        m_coverage = QRectF(0.0, 0.0, 1.0, 1.0);
+        return;
+    }
+    m_coverage.setRect((range.left() + 180.0) / 360.0, (90.0 - range.bottom()) / 180.0,
+                       qMin(range.width() / 360.0, 1.0), qMin(range.height() / 180.0, 1.0));
+}
+
+void VideoRenderer::setFrameProjection(int type, int padding)
+{
+    TRACE_ARG(type << padding);
+    m_frameProjection = qBound(0, type, 1);
+    m_cubemapPadding = qMax(0, padding);
+}
+
+void VideoRenderer::setStereoMode(int mode)
+{
+    TRACE_ARG(mode);
+    m_stereoMode = qBound(0, mode, 2);
+}
+
 void VideoRenderer::setVideoFrame(const QVideoFrame &frame)
 {
+    if (frame == m_videoFrame) return; // synchronized again, the texture is up to date
     bool isMapped = m_videoFrame.isMapped() || frame.isMapped();
     TRACE_ARG("isMapped" << isMapped << frame);
     if (!isMapped) {
@@ -173,36 +347,267 @@ void VideoRenderer::setVideoFrame(const QVideoFrame &frame)
     } else qWarning() << Q_FUNC_INFO << "Rendering busy - frame lost!";
 }
 
+void VideoRenderer::setTilePyramid(const QSharedPointer<TilePyramid> &tiles)
+{
+    if (tiles == m_tilePyramid) return;
+    TRACE_ARG((tiles ? tiles->imageFile() : QString()));
+    m_tilePyramid = tiles;
+    m_tileLevel = -1;
+    m_tileSlotOf.clear();
+    m_slotTile.fill(~quint64(0));
+    m_slotUsed.fill(-1);
+}
+
+void VideoRenderer::setGpuBudget(int percent)
+{
+    if (percent == m_gpuBudget) return;
+    TRACE_ARG(percent);
+    m_gpuBudget = percent;
+    if (percent <= 0) {
+        m_scaler.setBudget(0);
+        emit renderScaleChanged(m_scaler.scale());
+    }
+}
+
+void VideoRenderer::setRenderProfile(const RenderProfile &profile)
+{
+    if (profile == m_profile) return;
+    TRACE_ARG(profile.toString());
+    if (profile.compactTextures != m_profile.compactTextures)
+        m_viewSize = QSize(); // reallocate the view texture, the frame one is per frame
+    m_profile = profile;
+}
+
+void VideoRenderer::setFrameTiming(bool yes)
+{
+    TRACE_ARG(yes);
+    m_frameTiming = yes;
+}
+
+void VideoRenderer::setGpuStats(bool yes)
+{
+    if (yes == m_gpuStats) return;
+    TRACE_ARG(yes);
+    m_gpuStats = yes;
+    m_gpuStatsFrames = 0;
+    if (m_gpuTimer) m_gpuTimer->setStatistics(yes);
+}
+
+const char *VideoRenderer::gpuStageName(int stage)
+{
+    switch (stage) {
+    case StageUpload:    return "upload";
+    case StageColor:     return "color";
+    case StageFrameMips: return "frame mips";
+    case StageView:      return "view";
+    case StageViewMips:  return "view mips";
+    case StageDisplay:   return "display";
+    default: break;
+    }
+    return "frame";
+}
+
+void VideoRenderer::setCachedFrame(const QSharedPointer<LoopCache> &cache, int index)
+{
+    const auto playable = (cache && !cache->isUnplayable()) ? cache : QSharedPointer<LoopCache>();
+    if (playable == m_loopCache && index == m_cacheIndex) return;
+    TRACE_ARG(index);
+    m_loopCache = playable;
+    m_cacheIndex = index;
+    ++m_frameCount;
+}
+
+void VideoRenderer::setOverlays(const OverlayAtlas::Batch &overlays)
+{
+    TRACE_ARG(overlays.instances.size() << overlays.atlasSerial);
+    m_overlays = overlays;
+    m_overlaysDirty = true;
+}
+
+void VideoRenderer::setMonoDisplay(bool yes)
+{
+    TRACE_ARG(yes);
+    m_monoDisplay = yes;
+}
+
+void VideoRenderer::setFrameShare(const QSharedPointer<SharedFrame> &share)
+{
+    if (share == m_frameShare) return;
+    TRACE_ARG(share.data());
+    if (m_frameShare) m_frameShare->reset();
+    m_frameShare = share;
+    m_frameConverted = 0; // convert the current frame again to publish it
+}
+
+void VideoRenderer::setFrameSource(const QSharedPointer<SharedFrame> &source)
+{
+    if (source == m_frameSource) return;
+    TRACE_ARG(source.data());
+    if (m_frameSource) {
+        m_frameSource->release(m_sourceSlot);
+        m_frameSource->removeConsumer(m_window);
+    }
+    m_frameSource = source;
+    m_sourceSlot = -1;
+    if (m_frameSource && m_window) m_frameSource->addConsumer(m_window);
+}
+
+void VideoRenderer::setCapture(int rate, int width)
+{
+    if (rate == m_captureRate && width == m_captureWidth) return;
+    TRACE_ARG(rate << width);
+    m_captureRate = rate;
+    m_captureWidth = width;
+    if (rate <= 0 || width <= 0) {
+        m_captureRing.reset();
+        return;
+    }
+    // Room for the mono and portrait views too, the double-wide stereo one takes a half
+    if (!m_captureRing) m_captureRing.reset(new CaptureRing);
+    if (m_captureRing->maxWidth() != width && !m_captureRing->open(width, width)) {
+        emitErrorOccured(QStringLiteral("Can't create the view capture ring %1").arg(captureRingName));
+        m_captureRing.reset();
+    }
+}
+
+void VideoRenderer::setViewportSize(const QSize &size)
+{
+    TRACE_ARG(size);
+    if (m_offscreen) m_viewportSize = size;
+}
+
+void VideoRenderer::setTargetFramebuffer(GLuint fbo)
+{
+    TRACE_ARG(fbo);
+    m_targetFbo = fbo;
+}
+
+void VideoRenderer::render()
+{
+    onBeforeRendering();
+    onBeforeRenderPassRecording();
+}
+
+QImage VideoRenderer::readFrame()
+{
+    TRACE_ARG(m_frameSize);
+    if (!m_initialized || m_frameSize.isEmpty() || m_frameGrid != QSize(1, 1) || m_frameSource)
+        return QImage(); // the frame slabs are not read back
+
+    // The color pass puts the row 0 of the frame at the bottom, the first row read back
+    const bool compact = compactTextures();
+    QImage image(m_frameSize, compact ? QImage::Format_A2BGR30_Premultiplied : QImage::Format_RGBA64);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, m_frameFbo);
+    glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_frameTex, 0);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, m_frameSize.width(), m_frameSize.height(), GL_RGBA,
+                 compact ? GL_UNSIGNED_INT_2_10_10_10_REV : GL_UNSIGNED_SHORT, image.bits());
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    GLenum glErr = glGetError();
+    if (glErr != GL_NO_ERROR) {
+        qCritical() << Q_FUNC_INFO << "OpenGL Error" << glErr << "Line" << __LINE__;
+        return QImage();
+    }
+    return compact ? image.convertToFormat(QImage::Format_RGBA64) : image;
+}
+
 void VideoRenderer::onBeforeRendering()
 {
     TRACE();
     m_renderFrame = false;
-    if (!m_frameCount || (!m_initialized && !initFunctions()))
+    if ((!m_frameCount && !m_frameSource) || (!m_initialized && !initFunctions()))
         return; // just for sanity
 
-    // Convert the QVideoFrame to a regular RGB texture
-
     m_initialized = true;
-    if (m_videoFrame.map(QVideoFrame::ReadOnly)) {
-        m_renderFrame = frameToTexture();
-        m_videoFrame.unmap();
-    } else qCritical() << Q_FUNC_INFO << "Can't map video frame";
+    QElapsedTimer cpuTimer;
+    if (m_frameTiming) cpuTimer.start();
+    m_cpuTime = 0;
+    if (m_gpuBudget > 0 || m_frameTiming || m_gpuStats) {
+        updateGpuTimer();
+    } else if (m_gpuTimer) { // no queries at all while nothing is timed
+        m_gpuTimer->release();
+        m_gpuTimer.reset();
+        m_gpuStatsFrames = 0;
+    }
+    if (m_gpuTimer) m_gpuTimer->begin(StageUpload);
+    if (m_frameSource) {
+        // The frame converted by the renderer of another window
+        m_renderFrame = acquireSourceFrame();
+    } else if (m_frameConverted == m_frameCount) {
+        m_renderFrame = true; // the view changed only, e.g. while looking around a still image
+    } else {
+        if (m_loopCache) {
+            // The compressed frame of a looping clip, no conversion
+            m_renderFrame = uploadCachedFrame();
+            if (!m_renderFrame) {
+                // Back to the decoded frames, the last one until the player restarts the decoder
+                qWarning() << Q_FUNC_INFO << "Can't show the loop cache frame" << m_cacheIndex << ", back to the decoded frames";
+                m_loopCache->setUnplayable();
+                m_loopCache.reset();
+            }
+        }
+        if (!m_loopCache) {
+
+            // Convert the QVideoFrame to a regular RGB texture
+
+            if (m_zeroCopy && m_importFrames && m_videoFrame.handleType() == QVideoFrame::RhiTextureHandle) {
+                m_renderFrame = importFrameTextures();
+                if (!m_renderFrame) TRACE_ARG("Fallback to the mapped frame" << m_videoFrame.pixelFormat());
+            }
+            if (!m_renderFrame) {
+                if (m_videoFrame.map(QVideoFrame::ReadOnly)) {
+                    m_renderFrame = frameToTexture();
+                    m_videoFrame.unmap();
+                } else qCritical() << Q_FUNC_INFO << "Can't map video frame";
+            }
+            if (m_renderFrame && m_frameShare && m_frameShare->hasConsumers()) {
+                if (m_gpuTimer) m_gpuTimer->begin(StageUpload); // the copy for the spectators, not of the color pass
+                publishFrame();
+            }
+        }
+        if (m_renderFrame) m_frameConverted = m_frameCount;
+    }
+
+    // Stream in the detail tiles of a still image for the coming view
+
+    if (m_gpuTimer && m_tilePyramid) m_gpuTimer->begin(StageUpload);
+    m_viewTiles = (m_renderFrame && !m_frameSource && m_tilePyramid && updateTiles());
+    if (m_gpuTimer) m_gpuTimer->end();
+    if (m_frameTiming) m_cpuTime = cpuTimer.nsecsElapsed();
 }
 
 void VideoRenderer::onBeforeRenderPassRecording()
 {
     TRACE_ARG(m_frameSize << m_viewportSize);
-    if (!m_window || !m_renderFrame || m_viewportSize.isEmpty() || m_frameSize.isEmpty())
+    if ((!m_window && !m_offscreen) || !m_renderFrame || m_viewportSize.isEmpty() || m_frameSize.isEmpty())
         return; // just for sanity
 
     // Visualize the texture as a stereo image
 
-    m_window->beginExternalCommands();
-    for (int i = 0; i < 2; i++) {
-        if (textureToView(i ? -(m_stereoShift / 250.0) : 0.0))
-            renderDisplay(!i);
+    QElapsedTimer cpuTimer;
+    if (m_frameTiming) cpuTimer.start();
+#ifndef PANORAMA_NO_QUICK
+    if (m_quickWindow) m_quickWindow->beginExternalCommands();
+#endif
+    if (m_gpuTimer) m_gpuTimer->begin(StageView);
+    bool ok = textureToView();
+    if (ok && m_captureRing) {
+        if (m_gpuTimer) m_gpuTimer->begin(StageView);
+        captureView();
+    }
+    if (m_gpuTimer) m_gpuTimer->begin(StageDisplay);
+    if (ok) {
+        renderDisplay(0);
+        if (!m_monoDisplay) renderDisplay(1);
+    }
+    if (m_gpuTimer) m_gpuTimer->end();
+#ifndef PANORAMA_NO_QUICK
+    if (m_quickWindow) m_quickWindow->endExternalCommands();
+#endif
+    if (m_frameTiming) {
+        const qint64 gpuTime = (m_gpuTimer && m_gpuTimer->hasResults()) ? m_gpuTimer->frameTime() : -1;
+        emit frameTimed(m_cpuTime + cpuTimer.nsecsElapsed(), gpuTime);
     }
-    m_window->endExternalCommands();
 }
 
 GLuint VideoRenderer::setQuadVaoBuffer()
@@ -350,7 +755,65 @@ GLuint VideoRenderer::setCubeVaoBuffer()
     return cubeVao;
 }
 
-QString VideoRenderer::getShaderSource(const QString &name) const
+bool VideoRenderer::setMeshVaoBuffer()
+{
+    TRACE_ARG(m_coverage);
+
+    // The world space lat/long patch of the sphere covered by the frame, so the view
+    // pass doesn't even rasterize the frustum areas outside of it; 5 degree steps at most
+    const int cols = qMax(4, qCeil(m_coverage.width() * 72.0));
+    const int rows = qMax(2, qCeil(m_coverage.height() * 36.0));
+    QVector<GLfloat> positions, texCoords;
+    QVector<GLushort> indices;
+    positions.reserve((cols + 1) * (rows + 1) * 3);
+    texCoords.reserve((cols + 1) * (rows + 1) * 2);
+    indices.reserve(cols * rows * 6);
+    for (int j = 0; j <= rows; j++) {
+        float v = float(j) / rows;
+        float down = (qBound(0.0, m_coverage.y() + v * m_coverage.height(), 1.0) - 0.5) * float(M_PI);
+        for (int i = 0; i <= cols; i++) {
+            float u = float(i) / cols;
+            float lon = (m_coverage.x() + u * m_coverage.width() - 0.5) * 2.0f * float(M_PI);
+            positions << 10.0f * qCos(down) * qSin(lon) << -10.0f * qSin(down) << -10.0f * qCos(down) * qCos(lon);
+            texCoords << u << v;
+            if (i < cols && j < rows) {
+                GLushort k = j * (cols + 1) + i;
+                indices << k << GLushort(k + cols + 1) << GLushort(k + 1)
+                        << GLushort(k + 1) << GLushort(k + cols + 1) << GLushort(k + cols + 2);
+            }
+        }
+    }
+    if (!m_meshVao) {
+        glGenVertexArrays(1, &m_meshVao);
+        glGenBuffers(3, m_meshBufs);
+    }
+    glBindVertexArray(m_meshVao);
+
+    glBindBuffer(GL_ARRAY_BUFFER, m_meshBufs[0]);
+    glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(GLfloat), positions.constData(), GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
+    glEnableVertexAttribArray(0);
+
+    glBindBuffer(GL_ARRAY_BUFFER, m_meshBufs[1]);
+    glBufferData(GL_ARRAY_BUFFER, texCoords.size() * sizeof(GLfloat), texCoords.constData(), GL_STATIC_DRAW);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, 0);
+    glEnableVertexAttribArray(1);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_meshBufs[2]);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLushort), indices.constData(), GL_STATIC_DRAW);
+
+    glBindVertexArray(0);
+    GLenum glErr = glGetError();
+    if (glErr != GL_NO_ERROR) {
+        qCritical() << Q_FUNC_INFO << "OpenGL Error" << glErr << "Line" << __LINE__;
+        return false;
+    }
+    m_meshIndices = indices.size();
+    m_meshCoverage = m_coverage;
+    return true;
+}
+
+QString VideoRenderer::getShaderSource(const QString &name, const QString &extensions) const
 {
     QFile file(QStringLiteral(":/shaders/") + name);
     if (!file.open(QIODevice::ReadOnly)) {
@@ -358,10 +821,12 @@ QString VideoRenderer::getShaderSource(const QString &name) const
         return QString();
     }
     QString text = QString::fromLatin1(file.readAll());
+    // The #extension directives must precede any non-preprocessor tokens
     if (name.contains("vert")) {
-        text.prepend(m_openGLES ? "#version 300 es\n" : "#version 330\n");
+        text.prepend((m_openGLES ? "#version 300 es\n" : "#version 330\n") + extensions);
     } else if (name.contains("frag")) {
-        text.prepend(m_openGLES ? "#version 300 es\nprecision mediump float;\n" : "#version 330\n");
+        text.prepend(m_openGLES ? "#version 300 es\n" + extensions + "precision mediump float;\n"
+                                : "#version 330\n" + extensions);
     }
     return text;
 }
@@ -376,9 +841,9 @@ bool VideoRenderer::initFunctions()
     glGenTextures(1, &m_viewTex);
     TRACE_ARG("Setup view texture" << m_viewTex);
     glBindTexture(GL_TEXTURE_2D, m_viewTex);
-    if (m_openGLES)
-         glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB10_A2, m_viewSize.width(), m_viewSize.height(), 0, GL_RGBA, GL_UNSIGNED_INT_2_10_10_10_REV, nullptr);
-    else glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16,    m_viewSize.width(), m_viewSize.height(), 0, GL_RGBA, GL_UNSIGNED_SHORT, nullptr);
+    if (compactTextures())
+         glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB10_A2, m_viewSize.width() * 2, m_viewSize.height(), 0, GL_RGBA, GL_UNSIGNED_INT_2_10_10_10_REV, nullptr);
+    else glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16,    m_viewSize.width() * 2, m_viewSize.height(), 0, GL_RGBA, GL_UNSIGNED_SHORT, nullptr);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
@@ -440,6 +905,42 @@ bool VideoRenderer::initFunctions()
         return false;
     }
 
+    // Frame array texture for the slabs beyond GL_MAX_TEXTURE_SIZE, the view pass samples it without mipmaps
+
+    glGenTextures(1, &m_frameArrayTex);
+    TRACE_ARG("Setup frame array texture" << m_frameArrayTex);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, m_frameArrayTex);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glErr = glGetError();
+    if (glErr != GL_NO_ERROR) {
+        qCritical() << Q_FUNC_INFO << "OpenGL Error" << glErr << "Line" << __LINE__;
+        return false;
+    }
+
+    // Tile atlas and its page table for the still image detail, see updateTiles()
+
+    glGenTextures(1, &m_tileAtlasTex);
+    glGenTextures(1, &m_tileTableTex);
+    TRACE_ARG("Setup tile atlas" << m_tileAtlasTex << "and tile table" << m_tileTableTex);
+    glBindTexture(GL_TEXTURE_2D, m_tileAtlasTex);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D, m_tileTableTex);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glErr = glGetError();
+    if (glErr != GL_NO_ERROR) {
+        qCritical() << Q_FUNC_INFO << "OpenGL Error" << glErr << "Line" << __LINE__;
+        return false;
+    }
+
     // FBO and PBO
 
     glGenFramebuffers(1, &m_frameFbo);
@@ -471,69 +972,185 @@ static int alignBytesPerLine(const void *ptr, int bpl)
     return align;
 }
 
+void VideoRenderer::setPlaneSwizzle(GLint r, GLint g, GLint b, GLint a)
+{
+    glBindTexture(GL_TEXTURE_2D, m_planeTexs[0]);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_R, r);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_G, g);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_B, b);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_A, a);
+}
+
+void VideoRenderer::uploadPlane(int plane, GLint internalFormat, GLenum format, GLenum type,
+                                int pixelSize, int width, int height)
+{
+    const auto &frame = m_videoFrame;
+    glBindTexture(GL_TEXTURE_2D, m_planeTexs[plane]);
+    if (plane) { // the byte-split samples can't be interpolated
+        GLint filter = (type == GL_UNSIGNED_BYTE && m_frameSplit16) ? GL_NEAREST : GL_LINEAR;
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, alignBytesPerLine(frame.bits(plane), frame.bytesPerLine(plane)));
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, frame.bytesPerLine(plane) / pixelSize);
+    if (m_uploadRect.isNull()) {
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, frame.bits(plane));
+        return;
+    }
+
+    // Upload just the slab region, the columns are wrapped around and the rows are clamped:
+    // the border rows out of the frame (at the poles) repeat its first or last row, so the
+    // linear filtering at the slab edges never samples undefined texels
+    int x = m_uploadRect.x() * width / frame.width();
+    int y = m_uploadRect.y() * height / frame.height();
+    int w = m_uploadRect.width() * width / frame.width();
+    int h = m_uploadRect.height() * height / frame.height();
+    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, w, h, 0, format, type, nullptr);
+    auto uploadRows = [&](int srcRow, int dstRow, int rows) {
+        glPixelStorei(GL_UNPACK_SKIP_ROWS, srcRow);
+        for (int col = x; col < x + w; ) {
+            int src = (col % width + width) % width;
+            int cols = qMin(x + w - col, width - src);
+            glPixelStorei(GL_UNPACK_SKIP_PIXELS, src);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, col - x, dstRow, cols, rows, format, type, frame.bits(plane));
+            col += cols;
+        }
+    };
+    int row = qMax(0, y), rows = qMin(height, y + h) - row;
+    if (rows > 0) {
+        uploadRows(row, row - y, rows);
+        for (int dst = 0; dst < row - y; dst++) uploadRows(0, dst, 1);
+        for (int dst = row + rows - y; dst < h; dst++) uploadRows(height - 1, dst, 1);
+    }
+    glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+    glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+}
+
+void VideoRenderer::uploadPlane16(int plane, int channels, int width, int height)
+{
+    // Without the normalized 16 bit textures (OpenGLES w/o GL_EXT_texture_norm16) each sample
+    // is uploaded as two bytes and reassembled by shaders/color.frag
+    if (!m_frameSplit16) {
+        if (channels == 1)
+             uploadPlane(plane, GL_R16,   GL_RED,  GL_UNSIGNED_SHORT, 2, width, height);
+        else uploadPlane(plane, GL_RG16,  GL_RG,   GL_UNSIGNED_SHORT, 4, width, height);
+    } else {
+        if (channels == 1)
+             uploadPlane(plane, GL_RG8,   GL_RG,   GL_UNSIGNED_BYTE,  2, width, height);
+        else uploadPlane(plane, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE,  4, width, height);
+    }
+}
+
+bool VideoRenderer::setFrameGrid(const QSize &size)
+{
+    // The frame is split into a grid of slabs when it exceeds GL_MAX_TEXTURE_SIZE,
+    // each slab has an overlapping border for the seamless filtering and mipmaps
+    QSize grid(1, 1);
+    if (size.width() > m_maxTextureSize || size.height() > m_maxTextureSize) {
+        int maxSlab = m_maxTextureSize - 2 * slabBorder;
+        grid.setWidth((size.width() + maxSlab - 1) / maxSlab);
+        grid.setHeight((size.height() + maxSlab - 1) / maxSlab);
+    }
+    if (grid.width() * grid.height() > m_maxTextureLayers) {
+        emitErrorOccured(QStringLiteral("The frame size %1x%2 exceeds the OpenGL limits")
+                         .arg(size.width()).arg(size.height()));
+        return false;
+    }
+    if (grid != m_frameGrid) {
+        m_frameGrid = grid;
+        TRACE_ARG("Frame grid" << m_frameGrid);
+    }
+    // Keep the slabs even for the chroma subsampled planes
+    m_slabSize.setWidth(((size.width() + grid.width() - 1) / grid.width() + 1) & ~1);
+    m_slabSize.setHeight(((size.height() + grid.height() - 1) / grid.height() + 1) & ~1);
+    return true;
+}
+
 bool VideoRenderer::frameToTexture()
 {
     TRACE_ARG(m_videoFrame.pixelFormat() << m_videoFrame.planeCount());
     const auto &frame = m_videoFrame;
+    if (!setFrameGrid(frame.size())) return false;
+
+    int planeFormat = 0;
+    if (m_frameGrid == QSize(1, 1)) {
+        if (!uploadPlanes(planeFormat)) return false;
+        return planesToFrame(planeFormat, false, m_planeTexs, frame.planeCount());
+    }
+
+    // Convert the frame slab by slab into the layers of the frame array texture
+
+    int layerWidth = m_slabSize.width() + 2 * slabBorder;
+    int layerHeight = m_slabSize.height() + 2 * slabBorder;
+    int layers = m_frameGrid.width() * m_frameGrid.height();
+    glBindTexture(GL_TEXTURE_2D_ARRAY, m_frameArrayTex);
+    if (compactTextures())
+         glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGB10_A2, layerWidth, layerHeight, layers, 0, GL_RGBA, GL_UNSIGNED_INT_2_10_10_10_REV, nullptr);
+    else glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA16,   layerWidth, layerHeight, layers, 0, GL_BGRA, GL_UNSIGNED_SHORT, nullptr);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_frameFbo);
+    glViewport(0, 0, layerWidth, layerHeight);
+    glDisable(GL_DEPTH_TEST);
+    for (int i = 0; i < layers; i++) {
+        int col = i % m_frameGrid.width(), row = i / m_frameGrid.width();
+        m_uploadRect.setRect(col * m_slabSize.width() - slabBorder, row * m_slabSize.height() - slabBorder,
+                             layerWidth, layerHeight);
+        if (m_gpuTimer) m_gpuTimer->begin(StageUpload);
+        bool ok = uploadPlanes(planeFormat);
+        m_uploadRect = QRect();
+        if (!ok) return false;
+        if (m_gpuTimer) m_gpuTimer->begin(StageColor);
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, m_frameArrayTex, 0, i);
+        glClear(GL_COLOR_BUFFER_BIT);
+        if (!drawPlanes(planeFormat, false, m_planeTexs, frame.planeCount()))
+            return false;
+    }
+    GLenum glErr = glGetError();
+    if (glErr != GL_NO_ERROR) {
+        qCritical() << Q_FUNC_INFO << "OpenGL Error" << glErr << "Line" << __LINE__;
+        return false;
+    }
+    m_frameSize = frame.size();
+    return true;
+}
+
+bool VideoRenderer::uploadPlanes(int &planeFormat)
+{
+    const auto &frame = m_videoFrame;
 
     // Get the frame data into plane textures
 
     // Reset swizzling for plane0; might be changed below depending in the format
-    glBindTexture(GL_TEXTURE_2D, m_planeTexs[0]);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_R, GL_RED);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_G, GL_GREEN);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_B, GL_BLUE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_A, GL_ALPHA);
+    setPlaneSwizzle(GL_RED, GL_GREEN, GL_BLUE, GL_ALPHA);
 
     // See shaders/color.frag
-    int planeFormat = 2;
+    planeFormat = 2;
+    m_frameSplit16 = false;
     switch (frame.pixelFormat()) {
     case QVideoFrameFormat::Format_YUV420P:
         if (frame.planeCount() != 3) {
             emitErrorOccured(QStringLiteral("Format_YUV420P must contain 3 plains!"));
             return false;
         }
-        glPixelStorei(GL_UNPACK_ALIGNMENT, alignBytesPerLine(frame.bits(0), frame.bytesPerLine(0)));
-        glPixelStorei(GL_UNPACK_ROW_LENGTH, frame.bytesPerLine(0));
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, frame.width(), frame.height(), 0, GL_RED, GL_UNSIGNED_BYTE, frame.bits(0));
-        glBindTexture(GL_TEXTURE_2D, m_planeTexs[1]);
-        glPixelStorei(GL_UNPACK_ALIGNMENT, alignBytesPerLine(frame.bits(1), frame.bytesPerLine(1)));
-        glPixelStorei(GL_UNPACK_ROW_LENGTH, frame.bytesPerLine(1));
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, frame.width() / 2, frame.height() / 2, 0, GL_RED, GL_UNSIGNED_BYTE, frame.bits(1));
-        glBindTexture(GL_TEXTURE_2D, m_planeTexs[2]);
-        glPixelStorei(GL_UNPACK_ALIGNMENT, alignBytesPerLine(frame.bits(2), frame.bytesPerLine(2)));
-        glPixelStorei(GL_UNPACK_ROW_LENGTH, frame.bytesPerLine(2));
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, frame.width() / 2, frame.height() / 2, 0, GL_RED, GL_UNSIGNED_BYTE, frame.bits(2));
+        uploadPlane(0, GL_R8, GL_RED, GL_UNSIGNED_BYTE, 1, frame.width(), frame.height());
+        uploadPlane(1, GL_R8, GL_RED, GL_UNSIGNED_BYTE, 1, frame.width() / 2, frame.height() / 2);
+        uploadPlane(2, GL_R8, GL_RED, GL_UNSIGNED_BYTE, 1, frame.width() / 2, frame.height() / 2);
         break;
     case QVideoFrameFormat::Format_YUV422P:
         if (frame.planeCount() != 3) {
             emitErrorOccured(QStringLiteral("Format_YUV422P must contain 3 plains!"));
             return false;
         }
-        glPixelStorei(GL_UNPACK_ALIGNMENT, alignBytesPerLine(frame.bits(0), frame.bytesPerLine(0)));
-        glPixelStorei(GL_UNPACK_ROW_LENGTH, frame.bytesPerLine(0));
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, frame.width(), frame.height(), 0, GL_RED, GL_UNSIGNED_BYTE, frame.bits(0));
-        glBindTexture(GL_TEXTURE_2D, m_planeTexs[1]);
-        glPixelStorei(GL_UNPACK_ALIGNMENT, alignBytesPerLine(frame.bits(1), frame.bytesPerLine(1)));
-        glPixelStorei(GL_UNPACK_ROW_LENGTH, frame.bytesPerLine(1));
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, frame.width() / 2, frame.height(), 0, GL_RED, GL_UNSIGNED_BYTE, frame.bits(1));
-        glBindTexture(GL_TEXTURE_2D, m_planeTexs[2]);
-        glPixelStorei(GL_UNPACK_ALIGNMENT, alignBytesPerLine(frame.bits(2), frame.bytesPerLine(2)));
-        glPixelStorei(GL_UNPACK_ROW_LENGTH, frame.bytesPerLine(2));
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, frame.width() / 2, frame.height(), 0, GL_RED, GL_UNSIGNED_BYTE, frame.bits(2));
+        uploadPlane(0, GL_R8, GL_RED, GL_UNSIGNED_BYTE, 1, frame.width(), frame.height());
+        uploadPlane(1, GL_R8, GL_RED, GL_UNSIGNED_BYTE, 1, frame.width() / 2, frame.height());
+        uploadPlane(2, GL_R8, GL_RED, GL_UNSIGNED_BYTE, 1, frame.width() / 2, frame.height());
         break;
     case QVideoFrameFormat::Format_NV12:
         if (frame.planeCount() != 2) {
             emitErrorOccured(QStringLiteral("Format_NV12 must contain 2 plains!"));
             return false;
         }
-        glPixelStorei(GL_UNPACK_ALIGNMENT, alignBytesPerLine(frame.bits(0), frame.bytesPerLine(0)));
-        glPixelStorei(GL_UNPACK_ROW_LENGTH, frame.bytesPerLine(0));
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, frame.width(), frame.height(), 0, GL_RED, GL_UNSIGNED_BYTE, frame.bits(0));
-        glBindTexture(GL_TEXTURE_2D, m_planeTexs[1]);
-        glPixelStorei(GL_UNPACK_ALIGNMENT, alignBytesPerLine(frame.bits(1), frame.bytesPerLine(1)));
-        glPixelStorei(GL_UNPACK_ROW_LENGTH, frame.bytesPerLine(1) / 2);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RG8, frame.width() / 2, frame.height() / 2, 0, GL_RG, GL_UNSIGNED_BYTE, frame.bits(1));
+        uploadPlane(0, GL_R8,  GL_RED, GL_UNSIGNED_BYTE, 1, frame.width(), frame.height());
+        uploadPlane(1, GL_RG8, GL_RG,  GL_UNSIGNED_BYTE, 2, frame.width() / 2, frame.height() / 2);
         planeFormat = 4;
         break;
     case QVideoFrameFormat::Format_YV12:
@@ -541,19 +1158,81 @@ bool VideoRenderer::frameToTexture()
             emitErrorOccured(QStringLiteral("Format_YV12 must contain 3 plains!"));
             return false;
         }
-        glPixelStorei(GL_UNPACK_ALIGNMENT, alignBytesPerLine(frame.bits(0), frame.bytesPerLine(0)));
-        glPixelStorei(GL_UNPACK_ROW_LENGTH, frame.bytesPerLine(0));
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, frame.width(), frame.height(), 0, GL_RED, GL_UNSIGNED_BYTE, frame.bits(0));
-        glBindTexture(GL_TEXTURE_2D, m_planeTexs[1]);
-        glPixelStorei(GL_UNPACK_ALIGNMENT, alignBytesPerLine(frame.bits(1), frame.bytesPerLine(1)));
-        glPixelStorei(GL_UNPACK_ROW_LENGTH, frame.bytesPerLine(1));
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, frame.width() / 2, frame.height() / 2, 0, GL_RED, GL_UNSIGNED_BYTE, frame.bits(1));
-        glBindTexture(GL_TEXTURE_2D, m_planeTexs[2]);
-        glPixelStorei(GL_UNPACK_ALIGNMENT, alignBytesPerLine(frame.bits(2), frame.bytesPerLine(2)));
-        glPixelStorei(GL_UNPACK_ROW_LENGTH, frame.bytesPerLine(2));
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, frame.width() / 2, frame.height() / 2, 0, GL_RED, GL_UNSIGNED_BYTE, frame.bits(2));
+        uploadPlane(0, GL_R8, GL_RED, GL_UNSIGNED_BYTE, 1, frame.width(), frame.height());
+        uploadPlane(1, GL_R8, GL_RED, GL_UNSIGNED_BYTE, 1, frame.width() / 2, frame.height() / 2);
+        uploadPlane(2, GL_R8, GL_RED, GL_UNSIGNED_BYTE, 1, frame.width() / 2, frame.height() / 2);
         planeFormat = 3;
         break;
+    case QVideoFrameFormat::Format_YUV420P10:
+        if (frame.planeCount() != 3) {
+            emitErrorOccured(QStringLiteral("Format_YUV420P10 must contain 3 plains!"));
+            return false;
+        }
+        m_frameSplit16 = !m_norm16;
+        uploadPlane16(0, 1, frame.width(), frame.height());
+        uploadPlane16(1, 1, frame.width() / 2, frame.height() / 2);
+        uploadPlane16(2, 1, frame.width() / 2, frame.height() / 2);
+        break;
+    case QVideoFrameFormat::Format_P010:
+    case QVideoFrameFormat::Format_P016:
+        if (frame.planeCount() != 2) {
+            emitErrorOccured(QStringLiteral("Format_P010/P016 must contain 2 plains!"));
+            return false;
+        }
+        m_frameSplit16 = !m_norm16;
+        uploadPlane16(0, 1, frame.width(), frame.height());
+        uploadPlane16(1, 2, frame.width() / 2, frame.height() / 2);
+        planeFormat = 4;
+        break;
+    case QVideoFrameFormat::Format_Y8:
+        uploadPlane(0, GL_R8, GL_RED, GL_UNSIGNED_BYTE, 1, frame.width(), frame.height());
+        planeFormat = 5;
+        break;
+    case QVideoFrameFormat::Format_Y16:
+        m_frameSplit16 = !m_norm16;
+        uploadPlane16(0, 1, frame.width(), frame.height());
+        planeFormat = 5;
+        break;
+    case QVideoFrameFormat::Format_ARGB8888: // bytes A R G B
+    case QVideoFrameFormat::Format_ARGB8888_Premultiplied:
+    case QVideoFrameFormat::Format_XRGB8888:
+        setPlaneSwizzle(GL_GREEN, GL_BLUE, GL_ALPHA, GL_RED);
+        uploadPlane(0, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, 4, frame.width(), frame.height());
+        planeFormat = 1;
+        break;
+    case QVideoFrameFormat::Format_BGRA8888: // bytes B G R A
+    case QVideoFrameFormat::Format_BGRA8888_Premultiplied:
+    case QVideoFrameFormat::Format_BGRX8888:
+        setPlaneSwizzle(GL_BLUE, GL_GREEN, GL_RED, GL_ALPHA);
+        uploadPlane(0, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, 4, frame.width(), frame.height());
+        planeFormat = 1;
+        break;
+    case QVideoFrameFormat::Format_ABGR8888: // bytes A B G R
+    case QVideoFrameFormat::Format_XBGR8888:
+        setPlaneSwizzle(GL_ALPHA, GL_BLUE, GL_GREEN, GL_RED);
+        uploadPlane(0, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, 4, frame.width(), frame.height());
+        planeFormat = 1;
+        break;
+    case QVideoFrameFormat::Format_RGBA8888: // bytes R G B A
+    case QVideoFrameFormat::Format_RGBX8888:
+        uploadPlane(0, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, 4, frame.width(), frame.height());
+        planeFormat = 1;
+        break;
+    case QVideoFrameFormat::Format_AYUV: // bytes A Y U V
+    case QVideoFrameFormat::Format_AYUV_Premultiplied:
+        setPlaneSwizzle(GL_GREEN, GL_BLUE, GL_ALPHA, GL_RED);
+        uploadPlane(0, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, 4, frame.width(), frame.height());
+        planeFormat = 6;
+        break;
+    case QVideoFrameFormat::Format_UYVY: // bytes U Y0 V Y1, swizzled to Y0 U Y1 V
+        setPlaneSwizzle(GL_GREEN, GL_RED, GL_ALPHA, GL_BLUE);
+        uploadPlane(0, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, 4, frame.width() / 2, frame.height());
+        planeFormat = 7;
+        break;
+    case QVideoFrameFormat::Format_YUYV: // bytes Y0 U Y1 V
+        uploadPlane(0, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, 4, frame.width() / 2, frame.height());
+        planeFormat = 7;
+        break;
     default:
         emitErrorOccured(QStringLiteral("Unsupported frame pixel format"));
         return false;
@@ -565,29 +1244,111 @@ bool VideoRenderer::frameToTexture()
         qCritical() << Q_FUNC_INFO << "OpenGL Error" << glErr << "Line" << __LINE__;
         return false;
     }
+    return true;
+}
+
+bool VideoRenderer::importFrameTextures()
+{
+    TRACE_ARG(m_videoFrame.pixelFormat() << m_videoFrame.planeCount());
+    const auto &frame = m_videoFrame;
+    auto hwBuffer = QVideoFramePrivate::hwBuffer(frame);
+    if (!hwBuffer || !setFrameGrid(frame.size()) || m_frameGrid != QSize(1, 1))
+        return false; // the slabs are converted from the mapped frame only
+
+    // See shaders/color.frag
+    int planeFormat = 0;
+    bool external = false;
+    switch (frame.pixelFormat()) {
+    case QVideoFrameFormat::Format_YUV420P:
+    case QVideoFrameFormat::Format_YUV422P:
+    case QVideoFrameFormat::Format_YUV420P10:
+        planeFormat = 2;
+        break;
+    case QVideoFrameFormat::Format_YV12:
+        planeFormat = 3;
+        break;
+    case QVideoFrameFormat::Format_NV12:
+    case QVideoFrameFormat::Format_P010:
+    case QVideoFrameFormat::Format_P016:
+        planeFormat = 4;
+        break;
+    case QVideoFrameFormat::Format_SamplerExternalOES:
+        if (!m_externalOES) return false;
+        planeFormat = 1;
+        external = true;
+        break;
+    default:
+        return false;
+    }
+
+    // The imported 16 bit planes are always normalized textures
+    m_frameSplit16 = false;
+
+    // The textures are owned by the frame and stay valid while m_videoFrame holds it
+    GLuint planeTexs[3] = { 0, 0, 0 };
+    int planeCount = qMin(frame.planeCount(), 3);
+    for (int i = 0; i < planeCount; i++) {
+        planeTexs[i] = GLuint(hwBuffer->textureHandle(sceneRhi(), i));
+        if (!planeTexs[i]) return false;
+    }
+    return planesToFrame(planeFormat, external, planeTexs, planeCount);
+}
+
+bool VideoRenderer::planesToFrame(int planeFormat, bool external, const GLuint *planeTexs, int planeCount)
+{
+    TRACE_ARG(planeFormat << external << planeCount);
+    const auto &frame = m_videoFrame;
 
     // Convert plane textures into linear RGB in the frame texture
 
     glBindTexture(GL_TEXTURE_2D, m_frameTex);
-    if (m_openGLES)
+    if (compactTextures())
          glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB10_A2, frame.width(), frame.height(), 0, GL_RGBA, GL_UNSIGNED_INT_2_10_10_10_REV, nullptr);
     else glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16,   frame.width(), frame.height(), 0, GL_BGRA, GL_UNSIGNED_SHORT, nullptr);
     glBindFramebuffer(GL_FRAMEBUFFER, m_frameFbo);
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_frameTex, 0);
     glViewport(0, 0, frame.width(), frame.height());
     glDisable(GL_DEPTH_TEST);
+    GLenum glErr = glGetError();
+    if (glErr != GL_NO_ERROR) {
+        qCritical() << Q_FUNC_INFO << "OpenGL Error" << glErr << "Line" << __LINE__;
+        return false;
+    }
+    if (m_gpuTimer) m_gpuTimer->begin(StageColor);
+    if (!drawPlanes(planeFormat, external, planeTexs, planeCount))
+        return false;
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, m_frameTex);
+    if (m_profile.frameMipmaps) {
+        if (m_gpuTimer) m_gpuTimer->begin(StageFrameMips);
+        glGenerateMipmap(GL_TEXTURE_2D);
+    }
     glErr = glGetError();
     if (glErr != GL_NO_ERROR) {
         qCritical() << Q_FUNC_INFO << "OpenGL Error" << glErr << "Line" << __LINE__;
         return false;
     }
 
-    VideoFrameExt frameExt(planeFormat, frame.surfaceFormat());
+    m_frameSize.setWidth(frame.width());
+    m_frameSize.setHeight(frame.height());
+    return true;
+}
+
+bool VideoRenderer::drawPlanes(int planeFormat, bool external, const GLuint *planeTexs, int planeCount)
+{
+    VideoFrameExt frameExt(planeFormat, m_videoFrame.surfaceFormat());
+    frameExt.setPlaneExternal(external);
+    frameExt.setPlaneSplit(m_frameSplit16);
     if (!m_colorProg.isLinked() || frameExt != m_frameExt) {
         QString colorVert = getShaderSource("color.vert");
-        QString colorFrag = getShaderSource("color.frag");
+        QString colorFrag = getShaderSource("color.frag", external ?
+                    QStringLiteral("#extension GL_OES_EGL_image_external_essl3 : require\n") : QString());
         if (colorVert.isEmpty() || colorFrag.isEmpty()) return false; // should bot happend
+        colorFrag.replace("$PLANE0_SAMPLER", external ? "samplerExternalOES" : "sampler2D");
         colorFrag.replace("$PLANE_FORMAT", QString::number(planeFormat));
+        colorFrag.replace("$PLANE_SPLIT16", frameExt.isPlaneSplit() ? "true" : "false");
+        colorFrag.replace("$SAMPLE_SCALE", QString::number(frameExt.sampleScale(), 'f', 6));
         colorFrag.replace("$COLOR_RANGE_SMALL", frameExt.isColorFull() ? "false" : "true");
         colorFrag.replace("$COLOR_SPACE", QString::number(frameExt.colorSpace()));
         colorFrag.replace("$COLOR_TRANSFER", QString::number(frameExt.colorTransfer()));
@@ -600,94 +1361,524 @@ bool VideoRenderer::frameToTexture()
     }
     glUseProgram(m_colorProg.programId());
     m_colorProg.setUniformValue("masteringWhite", frameExt.colorWhite());
-    for (int i = 0; i < frame.planeCount(); i++) {
+    for (int i = 0; i < planeCount; i++) {
         m_colorProg.setUniformValue(qPrintable(QString("plane%1").arg(i)), i);
         glActiveTexture(GL_TEXTURE0 + i);
-        glBindTexture(GL_TEXTURE_2D, m_planeTexs[i]);
+        glBindTexture(external && !i ? GL_TEXTURE_EXTERNAL_OES : GL_TEXTURE_2D, planeTexs[i]);
     }
     glBindVertexArray(m_quadVao);
     glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, 0);
-    glBindTexture(GL_TEXTURE_2D, m_frameTex);
-    glGenerateMipmap(GL_TEXTURE_2D);
-
+    if (external) {
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_EXTERNAL_OES, 0);
+    }
     glBindVertexArray(0);
-    glErr = glGetError();
+    GLenum glErr = glGetError();
     if (glErr != GL_NO_ERROR) {
         qCritical() << Q_FUNC_INFO << "OpenGL Error" << glErr << "Line" << __LINE__;
         return false;
     }
+    return true;
+}
 
-    m_frameSize.setWidth(frame.width());
-    m_frameSize.setHeight(frame.height());
+bool VideoRenderer::updateTiles()
+{
+    const auto tiles = m_tilePyramid.data();
+    if (!tiles->isReady() || m_viewportSize.isEmpty() || m_frameProjection != 0) return false;
+    TRACE_ARG(tiles->imageFile());
+
+    if (m_tileSlots.isEmpty()) {
+        int slots = qBound(1, int(m_maxTextureSize) / TilePyramid::tileSize, int(tileSlots));
+        m_tileSlots = QSize(slots, slots);
+        m_slotTile.fill(~quint64(0), slots * slots);
+        m_slotUsed.fill(-1, slots * slots);
+        glBindTexture(GL_TEXTURE_2D, m_tileAtlasTex);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_SRGB8_ALPHA8, slots * TilePyramid::tileSize, slots * TilePyramid::tileSize,
+                     0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    }
+
+    // The level to match the pixel density of an eye viewport (or the view texture if less) at its
+    // center, but coarser when the visible tiles don't fit the atlas
+
+    QSize eye = m_viewportSize.width() > m_viewportSize.height() ?
+                QSize(m_viewportSize.width() / 2, m_viewportSize.height()) :
+                QSize(m_viewportSize.width(), m_viewportSize.height() / 2);
+    int pixels = qMin(qMax(eye.width(), eye.height()), qMax(m_viewSize.width(), m_viewSize.height()));
+    float density = pixels * 0.5f / m_fovTan; // per radian
+    float scale = tiles->imageSize().width() / (2.0f * float(M_PI) * m_coverage.width() * density);
+    int level = qBound(0, int(std::floor(std::log2(qMax(scale, 1.0f)))), tiles->levelCount() - 1);
+    if (tiles->levelSize(level).width() <= m_frameSize.width())
+        return false; // the base frame is good enough
+
+    const int capacity = m_tileSlots.width() * m_tileSlots.height();
+    const QMatrix4x4 toWorld = m_orientation.transposed(); // as the vdirection of shaders/view.vert
+    constexpr int const samples = 32;
+    QVarLengthArray<int, 64> visible;
+    QSize grid;
+    for (; level < tiles->levelCount(); level++) {
+        const QSize size = tiles->levelSize(level);
+        if (size.width() <= m_frameSize.width()) return false;
+        grid = tiles->levelTiles(level);
+        visible.clear();
+        for (int j = 0; j <= samples && visible.size() <= capacity; j++) {
+            for (int i = 0; i <= samples && visible.size() <= capacity; i++) {
+                QVector3D dir = toWorld.map(QVector3D((2.0f * i / samples - 1.0f) * m_fovTan,
+                                                      (2.0f * j / samples - 1.0f) * m_fovTan, -1.0f)).normalized();
+                float tx = std::atan2(dir.x(), -dir.z()) / (2.0f * float(M_PI)) + 0.5f;
+                float ty = std::asin(qBound(-1.0f, -dir.y(), 1.0f)) / float(M_PI) + 0.5f;
+                tx = (tx - m_coverage.x() - std::floor(tx - m_coverage.x())) / m_coverage.width();
+                ty = (ty - m_coverage.y()) / m_coverage.height();
+                if (tx > 1.0f || ty < 0.0f || ty > 1.0f) continue; // out of the frame
+                int x = qBound(0, int(tx * size.width()) / TilePyramid::tileStep, grid.width() - 1);
+                int y = qBound(0, int(ty * size.height()) / TilePyramid::tileStep, grid.height() - 1);
+                int index = y * grid.width() + x;
+                if (!visible.contains(index)) visible.append(index);
+            }
+        }
+        if (visible.size() <= capacity) break;
+    }
+    if (level >= tiles->levelCount()) return false;
+
+    auto setTableEntry = [this](int index, int slot) {
+        uchar *texel = reinterpret_cast<uchar *>(m_tileTable.data()) + index * 4;
+        texel[0] = slot < 0 ? 0 : uchar(slot % m_tileSlots.width());
+        texel[1] = slot < 0 ? 0 : uchar(slot / m_tileSlots.width());
+        texel[2] = 0;
+        texel[3] = slot < 0 ? 0 : 255;
+        m_tileTableDirty = true;
+    };
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    if (level != m_tileLevel) {
+        TRACE_ARG("Tile level" << level << tiles->levelSize(level) << "grid" << grid);
+        m_tileLevel = level;
+        m_tileGrid = grid;
+        m_tileTable.fill(0, grid.width() * grid.height() * 4);
+        for (auto it = m_tileSlotOf.cbegin(); it != m_tileSlotOf.cend(); ++it) {
+            if (int(it.key() >> 32) == level) setTableEntry(int(it.key() & 0xffffffff), it.value());
+        }
+        glBindTexture(GL_TEXTURE_2D, m_tileTableTex);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, grid.width(), grid.height(), 0,
+                     GL_RGBA, GL_UNSIGNED_BYTE, m_tileTable.constData());
+        m_tileTableDirty = false;
+    }
+
+    // Upload a few missing tiles per frame into the least recently used slots, of those paged
+    // in by the loader thread of the pyramid; the others are queued to it meanwhile
+
+    ++m_tileFrame;
+    int uploads = 0;
+    bool pending = false;
+    for (int index : std::as_const(visible)) {
+        const quint64 key = (quint64(level) << 32) | quint32(index);
+        int slot = m_tileSlotOf.value(key, -1);
+        if (slot >= 0) {
+            m_slotUsed[slot] = m_tileFrame;
+            continue;
+        }
+        if (uploads >= tileUploads) {
+            pending = true;
+            continue;
+        }
+        uchar *data = tiles->takeTile(level, index % grid.width(), index / grid.width());
+        if (!data) {
+            pending = true;
+            continue;
+        }
+        for (int i = 0; i < capacity; i++) {
+            if (m_slotUsed.at(i) < m_tileFrame && (slot < 0 || m_slotUsed.at(i) < m_slotUsed.at(slot)))
+                slot = i;
+        }
+        if (slot < 0) { // just for sanity, the visible tiles fit the atlas
+            tiles->unmapTile(level, data);
+            break;
+        }
+
+        const quint64 evicted = m_slotTile.at(slot);
+        if (evicted != ~quint64(0)) {
+            m_tileSlotOf.remove(evicted);
+            if (int(evicted >> 32) == level) setTableEntry(int(evicted & 0xffffffff), -1);
+            m_slotTile[slot] = ~quint64(0);
+        }
+        glBindTexture(GL_TEXTURE_2D, m_tileAtlasTex);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, (slot % m_tileSlots.width()) * TilePyramid::tileSize,
+                        (slot / m_tileSlots.width()) * TilePyramid::tileSize,
+                        TilePyramid::tileSize, TilePyramid::tileSize, GL_RGBA, GL_UNSIGNED_BYTE, data);
+        tiles->unmapTile(level, data);
+        m_slotTile[slot] = key;
+        m_slotUsed[slot] = m_tileFrame;
+        m_tileSlotOf.insert(key, slot);
+        setTableEntry(index, slot);
+        uploads++;
+    }
+    if (m_tileTableDirty) {
+        glBindTexture(GL_TEXTURE_2D, m_tileTableTex);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, grid.width(), grid.height(),
+                        GL_RGBA, GL_UNSIGNED_BYTE, m_tileTable.constData());
+        m_tileTableDirty = false;
+    }
+    GLenum glErr = glGetError();
+    if (glErr != GL_NO_ERROR) {
+        qCritical() << Q_FUNC_INFO << "OpenGL Error" << glErr << "Line" << __LINE__;
+        return false;
+    }
+    if (pending && m_window) // keep streaming while the view stays still
+        QMetaObject::invokeMethod(m_window, "update", Qt::QueuedConnection);
     return true;
 }
 
-bool VideoRenderer::textureToView(float xOffs)
+bool VideoRenderer::uploadCachedFrame()
 {
-    TRACE_ARG(xOffs);
+    const uchar *data = m_loopCache->frameData(m_cacheIndex);
+    if (!data || !m_etc2) return false;
+    const QSize size = m_loopCache->frameSize();
+    TRACE_ARG(m_cacheIndex << size);
+
+    // The sRGB blocks are decoded to the linear light as the converted frames hold
+    if (!m_cacheTex) {
+        glGenTextures(1, &m_cacheTex);
+        TRACE_ARG("Setup cache texture" << m_cacheTex);
+        glBindTexture(GL_TEXTURE_2D, m_cacheTex);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    } else glBindTexture(GL_TEXTURE_2D, m_cacheTex);
+    if (size != m_cacheSize) {
+        glCompressedTexImage2D(GL_TEXTURE_2D, 0, GL_COMPRESSED_SRGB8_ETC2, size.width(), size.height(), 0,
+                               m_loopCache->frameBytes(), data);
+        m_cacheSize = size;
+    } else {
+        glCompressedTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, size.width(), size.height(), GL_COMPRESSED_SRGB8_ETC2,
+                                  m_loopCache->frameBytes(), data);
+    }
+    m_frameSize = size;
+    m_frameGrid = QSize(1, 1);
+    GLenum glErr = glGetError();
+    if (glErr != GL_NO_ERROR) {
+        qCritical() << Q_FUNC_INFO << "OpenGL Error" << glErr << "Line" << __LINE__;
+        return false;
+    }
+    return true;
+}
 
-    // Prepare view texture and render view into it
+void VideoRenderer::publishFrame()
+{
+    if (m_frameGrid != QSize(1, 1)) return; // the slabs are not shared
+    const int index = m_frameShare->writeSlot();
+    if (index < 0) return;
+    TRACE_ARG(index << m_frameSize);
+
+    // Copy the frame into the slot texture, the frame texture is rewritten by the next frame
+    // while the consumers may still sample the slot
+
+    SharedFrame::Slot slot = m_frameShare->slot(index);
+    if (!slot.texture || slot.size != m_frameSize) {
+        if (!slot.texture) {
+            glGenTextures(1, &slot.texture);
+            glBindTexture(GL_TEXTURE_2D, slot.texture);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        } else glBindTexture(GL_TEXTURE_2D, slot.texture);
+        if (compactTextures())
+             glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB10_A2, m_frameSize.width(), m_frameSize.height(), 0, GL_RGBA, GL_UNSIGNED_INT_2_10_10_10_REV, nullptr);
+        else glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16,   m_frameSize.width(), m_frameSize.height(), 0, GL_BGRA, GL_UNSIGNED_SHORT, nullptr);
+        m_frameShare->setSlotTexture(index, slot.texture, m_frameSize);
+    }
+    if (!m_shareFbo) glGenFramebuffers(1, &m_shareFbo);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, m_frameFbo);
+    glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_frameTex, 0);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_shareFbo);
+    glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, slot.texture, 0);
+    glBlitFramebuffer(0, 0, m_frameSize.width(), m_frameSize.height(),
+                      0, 0, m_frameSize.width(), m_frameSize.height(), GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_frameFbo);
+    GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glFlush(); // the fence must reach the server before the consumer contexts wait for it
+    GLsync replaced = m_frameShare->publish(index, fence);
+    if (replaced) glDeleteSync(replaced);
+    GLenum glErr = glGetError();
+    if (glErr != GL_NO_ERROR) {
+        qCritical() << Q_FUNC_INFO << "OpenGL Error" << glErr << "Line" << __LINE__;
+    }
+}
 
-    glBindTexture(GL_TEXTURE_2D, m_viewTex);
-    if (m_frameSize != m_viewSize) {
-        m_viewSize = m_frameSize;
-        if (m_openGLES)
-             glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB10_A2, m_viewSize.width(), m_viewSize.height(), 0, GL_RGBA, GL_UNSIGNED_INT_2_10_10_10_REV, nullptr);
-        else glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16,    m_viewSize.width(), m_viewSize.height(), 0, GL_RGBA, GL_UNSIGNED_SHORT, nullptr);
+bool VideoRenderer::renderOverlays(const QMatrix4x4 &projection, int eyes)
+{
+    TRACE_ARG(m_overlays.instances.size() << eyes);
+    if (!m_overlayVao) {
+        glGenTextures(1, &m_overlayTex);
+        glBindTexture(GL_TEXTURE_2D, m_overlayTex);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+
+        // The instance attributes only, the quad corners are by gl_VertexID
+        glGenVertexArrays(1, &m_overlayVao);
+        glBindVertexArray(m_overlayVao);
+        glGenBuffers(1, &m_overlayBuf);
+        glBindBuffer(GL_ARRAY_BUFFER, m_overlayBuf);
+        const GLsizei stride = sizeof(OverlayAtlas::Instance);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<void *>(offsetof(OverlayAtlas::Instance, center)));
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<void *>(offsetof(OverlayAtlas::Instance, right)));
+        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<void *>(offsetof(OverlayAtlas::Instance, up)));
+        glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<void *>(offsetof(OverlayAtlas::Instance, rect)));
+        for (GLuint i = 0; i < 4; i++)
+            glEnableVertexAttribArray(i);
+        glBindVertexArray(0);
+        TRACE_ARG("Setup overlay atlas" << m_overlayTex << "and VAO" << m_overlayVao);
     }
-    glBindTexture(GL_TEXTURE_2D, m_depthTex);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, m_frameSize.width(), m_frameSize.height(), 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, nullptr);
-    glEnable(GL_DEPTH_TEST);
+    if (m_overlaysDirty) {
+        m_overlaysDirty = false;
+        glBindBuffer(GL_ARRAY_BUFFER, m_overlayBuf);
+        glBufferData(GL_ARRAY_BUFFER, m_overlays.instances.size() * sizeof(OverlayAtlas::Instance),
+                     m_overlays.instances.constData(), GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        if (m_overlays.atlasSerial != m_overlayAtlasSerial && !m_overlays.atlas.isNull()) {
+            const QImage &atlas = m_overlays.atlas;
+            glBindTexture(GL_TEXTURE_2D, m_overlayTex);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+            glPixelStorei(GL_UNPACK_ROW_LENGTH, atlas.bytesPerLine() / 4);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, atlas.width(), atlas.height(), 0, GL_RGBA, GL_UNSIGNED_BYTE, atlas.constBits());
+            glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        }
+        m_overlayAtlasSerial = m_overlays.atlasSerial;
+    }
+    if (m_overlays.instances.isEmpty())
+        return true;
+
+    if (!m_overlayProg.isLinked()) {
+        if (!m_overlayProg.addCacheableShaderFromSourceCode(QOpenGLShader::Vertex, getShaderSource("overlay.vert")) ||
+            !m_overlayProg.addCacheableShaderFromSourceCode(QOpenGLShader::Fragment, getShaderSource("overlay.frag")))
+            return false;
+        m_overlayProg.link();
+        TRACE_ARG("Setup overlay shader program" << m_overlayProg.programId());
+    }
+    glUseProgram(m_overlayProg.programId());
+    m_overlayProg.setUniformValue("projection", projection);
+    m_overlayProg.setUniformValue("orientation", m_orientation);
+    m_overlayProg.setUniformValue("eye_xoffs", QVector2D(-eyeDistance / 2.0f, eyeDistance / 2.0f));
+    m_overlayProg.setUniformValue("eye_count", eyes);
+    m_overlayProg.setUniformValue("atlas_tex", 0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, m_overlayTex);
+
+    // All overlays in both eyes by one draw, the attributes advance per eye pair
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    glBindVertexArray(m_overlayVao);
+    for (GLuint i = 0; i < 4; i++)
+        glVertexAttribDivisor(i, eyes);
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, m_overlays.instances.size() * eyes);
+    glBindVertexArray(0);
+    glDisable(GL_BLEND);
+    GLenum glErr = glGetError();
+    if (glErr != GL_NO_ERROR) {
+        qCritical() << Q_FUNC_INFO << "OpenGL Error" << glErr << "Line" << __LINE__;
+        return false;
+    }
+    return true;
+}
+
+bool VideoRenderer::acquireSourceFrame()
+{
+    SharedFrame::Slot slot;
+    m_sourceSlot = m_frameSource->acquire(m_sourceSlot, &slot);
+    if (m_sourceSlot < 0 || !slot.texture || slot.size.isEmpty())
+        return false;
+    TRACE_ARG(m_sourceSlot << slot.serial << slot.size);
+
+    // The held slot is not rewritten, wait on the GPU for its copy only
+    if (slot.fence) glWaitSync(slot.fence, 0, GL_TIMEOUT_IGNORED);
+    if (!m_sourceSampler) {
+        glGenSamplers(1, &m_sourceSampler);
+        glSamplerParameteri(m_sourceSampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glSamplerParameteri(m_sourceSampler, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glSamplerParameteri(m_sourceSampler, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+    m_sourceTex = slot.texture;
+    m_frameSize = slot.size;
+    m_frameGrid = QSize(1, 1);
+    GLenum glErr = glGetError();
+    if (glErr != GL_NO_ERROR) {
+        qCritical() << Q_FUNC_INFO << "OpenGL Error" << glErr << "Line" << __LINE__;
+        return false;
+    }
+    return true;
+}
+
+bool VideoRenderer::textureToView()
+{
+    TRACE_ARG(m_stereoMode);
+
+    // Prepare the double-wide view texture, the left half for the left eye, and render
+    // both views into it by one draw
+
+    QSize viewSize = m_frameSize; // of an eye
+    if (m_stereoMode == 1) viewSize.setHeight(viewSize.height() / 2);
+    else if (m_stereoMode == 2) viewSize.setWidth(viewSize.width() / 2);
+    if (viewSize.width() * 2 > m_maxTextureSize || viewSize.height() > m_maxTextureSize)
+        viewSize.scale(m_maxTextureSize / 2, m_maxTextureSize, Qt::KeepAspectRatio);
+    if (m_scaler.scale() < 1.0) { // by the GPU time, see updateRenderScale()
+        viewSize = QSize(qRound(viewSize.width() * m_scaler.scale()) & ~1,
+                         qRound(viewSize.height() * m_scaler.scale()) & ~1);
+    }
+    if (viewSize != m_viewSize) {
+        m_viewSize = viewSize;
+        glBindTexture(GL_TEXTURE_2D, m_viewTex);
+        if (compactTextures())
+             glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB10_A2, m_viewSize.width() * 2, m_viewSize.height(), 0, GL_RGBA, GL_UNSIGNED_INT_2_10_10_10_REV, nullptr);
+        else glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16,    m_viewSize.width() * 2, m_viewSize.height(), 0, GL_RGBA, GL_UNSIGNED_SHORT, nullptr);
+        glBindTexture(GL_TEXTURE_2D, m_depthTex);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, m_viewSize.width() * 2, m_viewSize.height(), 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, nullptr);
+    }
+    glDisable(GL_DEPTH_TEST); // the depth clips the eyes, see shaders/view.vert
     glBindFramebuffer(GL_FRAMEBUFFER, m_viewFbo);
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_viewTex, 0);
-    glViewport(0, 0, m_frameSize.width(), m_frameSize.height());
+    glViewport(0, 0, m_viewSize.width() * 2, m_viewSize.height());
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     GLenum glErr = glGetError();
     if (glErr != GL_NO_ERROR) {
         qCritical() << Q_FUNC_INFO << "OpenGL Error" << glErr << "Line" << __LINE__;
         return false;
     }
-    if (!m_viewProg.isLinked()) {
-        if (!m_viewProg.addCacheableShaderFromSourceCode(QOpenGLShader::Vertex, getShaderSource("view.vert")) ||
-            !m_viewProg.addCacheableShaderFromSourceCode(QOpenGLShader::Fragment, getShaderSource("view.frag")))
+    bool slabs = (m_frameGrid != QSize(1, 1));
+    bool mesh = (m_frameProjection == 0 && m_coverage != QRectF(0.0, 0.0, 1.0, 1.0));
+    if (mesh && m_coverage != m_meshCoverage && !setMeshVaoBuffer())
+        return false;
+    if (!m_viewProg.isLinked() || slabs != m_viewSlabs || m_viewTiles != m_viewProgTiles ||
+            mesh != m_viewMesh || m_frameProjection != m_viewProjection) {
+        QString viewVert = getShaderSource("view.vert");
+        viewVert.replace("$VIEW_MESH", mesh ? "true" : "false");
+        QString viewFrag = getShaderSource("view.frag");
+        viewFrag.replace("$FRAME_SLABS", slabs ? "true" : "false");
+        viewFrag.replace("$TILE_DETAIL", m_viewTiles ? "true" : "false");
+        viewFrag.replace("$FRAME_PROJECTION", QString::number(m_frameProjection));
+        m_viewProg.removeAllShaders();
+        if (!m_viewProg.addCacheableShaderFromSourceCode(QOpenGLShader::Vertex, viewVert) ||
+            !m_viewProg.addCacheableShaderFromSourceCode(QOpenGLShader::Fragment, viewFrag))
             return false;
         m_viewProg.link();
-        TRACE_ARG("Setup view shader program" << m_viewProg.programId());
+        m_viewSlabs = slabs;
+        m_viewProgTiles = m_viewTiles;
+        m_viewMesh = mesh;
+        m_viewProjection = m_frameProjection;
+        TRACE_ARG("Setup view shader program" << m_viewProg.programId() << "slabs" << slabs << "tiles" << m_viewTiles << "mesh" << mesh);
     }
     glUseProgram(m_viewProg.programId());
-    m_viewProg.setUniformValue("projection", m_projection);
+    QMatrix4x4 projection = m_projection;
+    if (m_monoDisplay && !m_viewportSize.isEmpty()) {
+        // The left eye on the whole viewport, widen the horizontal FOV by its aspect
+        QMatrix4x4 aspect;
+        aspect.scale(float(m_viewportSize.height()) / m_viewportSize.width(), 1.0f, 1.0f);
+        projection = aspect * m_projection;
+    }
+    m_viewProg.setUniformValue("projection", projection);
     m_viewProg.setUniformValue("orientation", m_orientation);
     m_viewProg.setUniformValue("frame_tex", 0);
-    m_viewProg.setUniformValue("view_xoffs", xOffs);
+    m_viewProg.setUniformValue("frame_slabs", 1); // never share the unit with frame_tex
+    // The packed stereo frame has a half per eye, the mono one is shifted for the right eye
+    static const QVector4D eyeRects[3][2] = {
+        { QVector4D(0.0f, 0.0f, 1.0f, 1.0f), QVector4D(0.0f, 0.0f, 1.0f, 1.0f) },
+        { QVector4D(0.0f, 0.0f, 1.0f, 0.5f), QVector4D(0.0f, 0.5f, 1.0f, 0.5f) }, // top-bottom
+        { QVector4D(0.0f, 0.0f, 0.5f, 1.0f), QVector4D(0.5f, 0.0f, 0.5f, 1.0f) }  // side-by-side
+    };
+    m_viewProg.setUniformValueArray("eye_rect", eyeRects[m_stereoMode], 2);
+    if (m_frameProjection == 1) {
+        // At least a half texel inside of the face cell for the filtering
+        QSizeF cell(m_frameSize.width() * eyeRects[m_stereoMode][0].z() / 3.0,
+                    m_frameSize.height() * eyeRects[m_stereoMode][0].w() / 2.0);
+        qreal pad = qMax(0.5, qreal(m_cubemapPadding));
+        m_viewProg.setUniformValue("cube_pad", QVector2D(pad / cell.width(), pad / cell.height()));
+    }
+    m_viewProg.setUniformValue("view_xoffs", QVector2D(0.0f, m_stereoMode ? 0.0f : -(m_stereoShift / 250.0)));
+    m_viewProg.setUniformValue("lod_bias", (m_frameSource || m_loopCache || !m_profile.frameMipmaps) ? 0.0f : m_scaler.mipBias());
+    m_viewProg.setUniformValue("view_range", QVector4D(m_coverage.x(), m_coverage.y(),
+                                                       m_coverage.width(), m_coverage.height()));
+    if (slabs) {
+        // The slab interior within the layer, see shaders/view.frag
+        float layerWidth = m_slabSize.width() + 2 * slabBorder;
+        float layerHeight = m_slabSize.height() + 2 * slabBorder;
+        m_viewProg.setUniformValue("slab_grid", QVector2D(m_frameGrid.width(), m_frameGrid.height()));
+        m_viewProg.setUniformValue("slab_map", QVector4D(slabBorder / layerWidth, slabBorder / layerHeight,
+                                                         m_slabSize.width() / layerWidth,
+                                                         m_slabSize.height() / layerHeight));
+        // The slab columns may be partially filled at the right edge
+        m_viewProg.setUniformValue("slab_extent", QVector2D(
+                float(m_frameSize.width()) / (m_slabSize.width() * m_frameGrid.width()),
+                float(m_frameSize.height()) / (m_slabSize.height() * m_frameGrid.height())));
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, m_frameArrayTex);
+    }
+    m_viewProg.setUniformValue("tile_table", 2);
+    m_viewProg.setUniformValue("tile_atlas", 3);
+    if (m_viewTiles) {
+        const QSize size = m_tilePyramid->levelSize(m_tileLevel);
+        m_viewProg.setUniformValue("tile_level", QVector4D(size.width(), size.height(),
+                                                           TilePyramid::tileStep, TilePyramid::tileSize));
+        m_viewProg.setUniformValue("tile_slots", QVector2D(m_tileSlots.width(), m_tileSlots.height()));
+        glActiveTexture(GL_TEXTURE2);
+        glBindTexture(GL_TEXTURE_2D, m_tileTableTex);
+        glActiveTexture(GL_TEXTURE3);
+        glBindTexture(GL_TEXTURE_2D, m_tileAtlasTex);
+    }
 
     // Render scene
     glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, m_frameTex);
+    glBindTexture(GL_TEXTURE_2D, m_frameSource ? m_sourceTex : m_loopCache ? m_cacheTex : m_frameTex);
     glErr = glGetError();
     if (glErr != GL_NO_ERROR) {
         qCritical() << Q_FUNC_INFO << "OpenGL Error" << glErr << "Line" << __LINE__;
         return false;
     }
 
-    // Setup filtering to work correctly at the horizontal wraparound
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    // Setup filtering to work correctly at the horizontal wraparound, by the sampler object
+    // for the shared frame since the other contexts sample its texture too
+    bool wrap = (m_frameProjection == 0 && m_coverage.width() >= 1.0 && m_stereoMode != 2);
+    if (m_frameSource) {
+        glSamplerParameteri(m_sourceSampler, GL_TEXTURE_WRAP_S, wrap ? GL_REPEAT : GL_CLAMP_TO_EDGE);
+        glBindSampler(0, m_sourceSampler);
+    } else {
+        // The own frame has mipmaps, sampled with the bias at the reduced view resolution
+        bool mipmaps = (m_profile.frameMipmaps && !m_loopCache && !slabs && m_scaler.scale() < 1.0);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, mipmaps ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap ? GL_REPEAT : GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
 
-    // Render vertexes
-    glBindVertexArray(m_cubeVao);
-    glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_SHORT, 0);
+    // Render vertexes, the partial sphere leaves the uncovered areas cleared
+    const GLsizei eyes = m_monoDisplay ? 1 : 2;
+    glDisable(GL_CULL_FACE);
+    if (mesh) {
+        glBindVertexArray(m_meshVao);
+        glDrawElementsInstanced(GL_TRIANGLES, m_meshIndices, GL_UNSIGNED_SHORT, 0, eyes);
+    } else {
+        glBindVertexArray(m_cubeVao);
+        glDrawElementsInstanced(GL_TRIANGLES, 36, GL_UNSIGNED_SHORT, 0, eyes);
+    }
 
     // Reset filtering parameters to their defaults
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    if (m_frameSource) {
+        glBindSampler(0, 0);
+    } else {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    }
+    glBindVertexArray(0);
 
-    // Generate mipmaps for the view texture
-    glBindTexture(GL_TEXTURE_2D, m_viewTex);
-    glGenerateMipmap(GL_TEXTURE_2D);
+    // The world-anchored overlays on top of the sphere, in the view texture for both eyes
+    if (!m_overlays.instances.isEmpty() || m_overlaysDirty)
+        renderOverlays(projection, eyes);
 
-    glBindVertexArray(0);
+    // Generate mipmaps for the view texture, else the display samples it bilinear
+    glBindTexture(GL_TEXTURE_2D, m_viewTex);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, m_profile.viewMipmaps ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    if (m_profile.viewMipmaps) {
+        if (m_gpuTimer) m_gpuTimer->begin(StageViewMips);
+        glGenerateMipmap(GL_TEXTURE_2D);
+    }
     glErr = glGetError();
     if (glErr != GL_NO_ERROR) {
         qCritical() << Q_FUNC_INFO << "OpenGL Error" << glErr << "Line" << __LINE__;
@@ -696,16 +1887,168 @@ bool VideoRenderer::textureToView(float xOffs)
     return true;
 }
 
-void VideoRenderer::renderDisplay(bool first)
+void VideoRenderer::updateGpuTimer()
+{
+    if (!m_gpuTimer) {
+        m_gpuTimer.reset(new GpuTimer(StageCount));
+        if (!m_gpuTimer->init())
+            qWarning() << Q_FUNC_INFO << "No GPU timer queries, the dynamic resolution and GPU timing are off";
+        m_gpuTimer->setStatistics(m_gpuStats);
+    }
+    if (m_gpuTimer->nextFrame()) {
+        if (m_gpuBudget > 0) updateRenderScale();
+        if (m_gpuStats && ++m_gpuStatsFrames >= GpuTimer::statsFrames) reportGpuStats();
+    }
+}
+
+void VideoRenderer::updateRenderScale()
+{
+    // The budget of the view and display passes per refresh interval
+    const qreal refreshRate = (m_window && m_window->screen()) ? m_window->screen()->refreshRate() : 60.0;
+    const qint64 budget = qint64(1e9 / qMax(refreshRate, 1.0) * m_gpuBudget / 100.0);
+    if (budget != m_scaler.budget()) m_scaler.setBudget(budget);
+    const qint64 time = m_gpuTimer->stageTime(StageView) + m_gpuTimer->stageTime(StageViewMips) +
+            m_gpuTimer->stageTime(StageDisplay);
+    if (m_scaler.update(time)) {
+        TRACE_ARG("Render scale" << m_scaler.scale() << "GPU time" << time << "budget" << budget);
+        emit renderScaleChanged(m_scaler.scale());
+    }
+}
+
+void VideoRenderer::reportGpuStats()
+{
+    // Once per window of the statistics, the log is the same as the signal
+    m_gpuStatsFrames = 0;
+    QList<GpuTimer::Stats> stats;
+    for (int i = 0; i < StageCount; i++)
+        stats.append(m_gpuTimer->stageStats(i));
+    stats.append(m_gpuTimer->frameStats());
+    QDebug log = qDebug();
+    log.nospace().noquote();
+    log << "GPU time in us (min/avg/p99) of " << stats.last().frames << " frames:";
+    for (int i = 0; i < stats.size(); i++) {
+        log << " " << gpuStageName(i) << " " << stats.at(i).min / 1000 << "/" << stats.at(i).avg / 1000
+            << "/" << stats.at(i).p99 / 1000;
+    }
+    emit gpuStatsUpdated(stats);
+}
+
+void VideoRenderer::captureView()
+{
+    // Nothing is read back until a reader polls the ring, then at the capture rate
+
+    bool pending = readCaptures();
+    if (!m_captureRing->hasReaders() ||
+            (m_captureTimer.isValid() && m_captureTimer.elapsed() < 1000 / m_captureRate)) {
+        if (pending && m_window) QMetaObject::invokeMethod(m_window, "update", Qt::QueuedConnection);
+        return;
+    }
+    CaptureBuffer *buf = nullptr;
+    for (auto &capture : m_captureBufs) {
+        if (!capture.fence) {
+            buf = &capture;
+            break;
+        }
+    }
+    if (!buf) {
+        TRACE_ARG("All readbacks in flight, view skipped");
+        return;
+    }
+
+    // Downscale the composed view from its nearest mipmap level, the view pass generated them.
+    // The view is of linear light, encoded to sRGB by the blit into the sRGB capture texture
+    // the same way as display.frag encodes for the screen
+
+    QSize viewSize(m_viewSize.width() * (m_monoDisplay ? 1 : 2), m_viewSize.height());
+    QSize size = viewSize.scaled(qMin(m_captureWidth, viewSize.width()), m_captureRing->maxHeight(), Qt::KeepAspectRatio);
+    if (size.isEmpty()) return;
+    int level = 0; // of the mipmaps if any
+    while (m_profile.viewMipmaps && (viewSize.width() >> (level + 1)) >= size.width() && (viewSize.height() >> (level + 1)) >= size.height())
+        level++;
+    TRACE_ARG(viewSize << "level" << level << "to" << size);
+
+    if (!m_captureTex) {
+        glGenTextures(1, &m_captureTex);
+        glGenFramebuffers(2, m_captureFbos);
+        TRACE_ARG("Setup capture texture" << m_captureTex << "and FBOs" << m_captureFbos[0] << m_captureFbos[1]);
+    }
+    if (size != m_captureSize) {
+        m_captureSize = size;
+        glBindTexture(GL_TEXTURE_2D, m_captureTex);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_SRGB8_ALPHA8, size.width(), size.height(), 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_captureFbos[1]);
+        glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_captureTex, 0);
+    }
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, m_captureFbos[0]);
+    glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_viewTex, level);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_captureFbos[1]);
+    if (!m_openGLES) glEnable(GL_FRAMEBUFFER_SRGB); // always on for the sRGB targets of OpenGL ES
+    glBlitFramebuffer(0, 0, viewSize.width() >> level, viewSize.height() >> level,
+                      0, 0, size.width(), size.height(), GL_COLOR_BUFFER_BIT, GL_LINEAR);
+    if (!m_openGLES) glDisable(GL_FRAMEBUFFER_SRGB);
+
+    // Read back into the pixel buffer asynchronously, mapped by readCaptures() once fenced
+
+    if (!buf->pbo) glGenBuffers(1, &buf->pbo);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, m_captureFbos[1]);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, buf->pbo);
+    if (buf->size != size) {
+        buf->size = size;
+        glBufferData(GL_PIXEL_PACK_BUFFER, size.width() * size.height() * 4, nullptr, GL_STREAM_READ);
+    }
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, size.width(), size.height(), GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    buf->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    buf->timestamp = CaptureRing::monotonicTime();
+    m_captureTimer.start();
+    glBindFramebuffer(GL_FRAMEBUFFER, m_viewFbo);
+    GLenum glErr = glGetError();
+    if (glErr != GL_NO_ERROR) {
+        qCritical() << Q_FUNC_INFO << "OpenGL Error" << glErr << "Line" << __LINE__;
+    }
+}
+
+bool VideoRenderer::readCaptures()
+{
+    // Oldest first, the later fences can't be signaled before it
+    for (;;) {
+        CaptureBuffer *buf = nullptr;
+        for (auto &capture : m_captureBufs) {
+            if (capture.fence && (!buf || capture.timestamp < buf->timestamp))
+                buf = &capture;
+        }
+        if (!buf) return false;
+        GLenum status = glClientWaitSync(buf->fence, 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+            return true;
+        glDeleteSync(buf->fence);
+        buf->fence = nullptr;
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, buf->pbo);
+        const int bytes = buf->size.width() * buf->size.height() * 4;
+        auto pixels = static_cast<const uint8_t *>(glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, bytes, GL_MAP_READ_BIT));
+        if (pixels) {
+            m_captureRing->publish(pixels, buf->size.width(), buf->size.height(), buf->timestamp);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        } else qCritical() << Q_FUNC_INFO << "Can't map pixel buffer" << buf->pbo;
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+}
+
+void VideoRenderer::renderDisplay(int eye)
 {
-    TRACE_ARG(first);
+    TRACE_ARG(eye);
+    bool first = !eye;
 
     // Put the views on screen using framebuffer
 
-    glBindFramebuffer(GL_FRAMEBUFFER, QOpenGLContext::currentContext()->defaultFramebufferObject());
+    glBindFramebuffer(GL_FRAMEBUFFER, m_targetFbo ? m_targetFbo : QOpenGLContext::currentContext()->defaultFramebufferObject());
     int halfWidth = m_viewportSize.width() / 2;
     int halfHeight = m_viewportSize.height() / 2;
-    if (first) {
+    if (m_monoDisplay) {
+        glViewport(0, 0, m_viewportSize.width(), m_viewportSize.height());
+    } else if (first) {
         if (halfWidth > halfHeight)
              glViewport(0, 0, halfWidth, m_viewportSize.height());
         else glViewport(0, 0, m_viewportSize.width(), halfHeight);
@@ -731,6 +2074,7 @@ void VideoRenderer::renderDisplay(bool first)
     glUseProgram(m_dispProg.programId());
     m_dispProg.setUniformValue("view_tex", 0);
     m_dispProg.setUniformValue("rotate_dir", m_rotateDisplay);
+    m_dispProg.setUniformValue("view_rect", QVector2D(eye * 0.5f, 0.5f));
 
     // Bind textures for vertexes and draw its
 
@@ -6,63 +6,171 @@
 #include <QOpenGLExtraFunctions>
 #include <QOpenGLShaderProgram>
 #include <QVideoFrame>
+#include <QImage>
 #include <QMatrix4x4>
+#include <QQuaternion>
 #include <QSize>
+#include <QRect>
+#include <QRectF>
+#include <QSharedPointer>
+#include <QScopedPointer>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QVector>
+#include <QVarLengthArray>
 
 #include "VideoFrameExt.h"
+#include "OverlayAtlas.h"
+#include "GpuTimer.h"
+#include "ResolutionScaler.h"
+#include "RenderProfile.h"
 
+class QWindow;
 class QQuickWindow;
+class QRhi;
 class QOpenGLDebugLogger;
+class TilePyramid;
+class SharedFrame;
+class CaptureRing;
+class LoopCache;
 
 class VideoRenderer : public QObject, protected QOpenGLExtraFunctions
 {
     Q_OBJECT
 public:
-    VideoRenderer(QQuickWindow *win, bool debugOpenGL = false); // the win is not parent!
+    static constexpr int const slabBorder = 2; // overlap of the frame slabs in pixels
+    static constexpr int const tileSlots = 8; // the tile atlas is a grid of slots up to 8x8
+    static constexpr int const tileUploads = 4; // the max tiles to upload per frame
+    static constexpr int const captureBuffers = 3; // the readbacks in flight
+    static constexpr float const eyeDistance = 0.064f; // interpupillary in meters, for the overlays
+
+    enum GpuStage { // of m_gpuTimer
+        StageUpload, // the frame planes, the cached frames and the still image tiles
+        StageColor, // the color conversion into the frame texture
+        StageFrameMips,
+        StageView, // the projection into the view texture, the overlays and the capture
+        StageViewMips,
+        StageDisplay,
+        StageCount
+    };
+    static const char *gpuStageName(int stage);
+
+    // Renders within the scene graph of a QQuickWindow, else by render() of the host window,
+    // or offscreen by render() into the target framebuffer if no window
+    VideoRenderer(QWindow *win, bool debugOpenGL = false); // the win is not parent!
+    ~VideoRenderer() override;
 
     static bool isFrameSuppored(const QVideoFrame &frame);
 
+    void setZeroCopy(bool yes); // import the decoder textures instead of mapping the frame
     void setRotateDisplay(int direction); // -1/0/1
-    void setStereoShift(qreal shift); // 0.0..1.0
-    void setProjection(int angle); // vertical FOV angle 5..115 in degree
-    void setOrientation(qreal pitch, qreal yaw); // circular orientation using Euler angles
+    void setStereoShift(qreal shift); // 0.0..1.0, of the mono frames
+    void setStereoMode(int mode); // 0 mono, 1 top-bottom, 2 side-by-side
+    void setProjection(qreal angle); // vertical FOV angle 5..115 in degree
+    void setOrientation(const QQuaternion &rotation); // of the view, a unit quaternion
+    void setCoverage(const QRectF &range); // longitude, latitude range of the frame in degree
+    void setFrameProjection(int type, int padding = 0); // 0 equirectangular, 1 EAC with the face padding
     void setVideoFrame(const QVideoFrame &frame);
+    void setTilePyramid(const QSharedPointer<TilePyramid> &tiles); // the detail of a still image
+    void setMonoDisplay(bool yes); // the left eye on the whole viewport, for a flat screen
+    void setFrameShare(const QSharedPointer<SharedFrame> &share); // publish the converted frames
+    void setFrameSource(const QSharedPointer<SharedFrame> &source); // render the frames of another renderer
+    void setCapture(int rate, int width); // the views per second into CaptureRing, 0 is off
+    void setOverlays(const OverlayAtlas::Batch &overlays);
+    void setCachedFrame(const QSharedPointer<LoopCache> &cache, int index); // instead of the video frames if set
+    bool hasEtc2() const { return m_etc2; } // the cached frames can be sampled
+    void setGpuBudget(int percent); // of the refresh interval for the view and display passes, 0 is off
+    void setRenderProfile(const RenderProfile &profile);
+    void setFrameTiming(bool yes); // emit frameTimed() per rendered frame
+    void setGpuStats(bool yes); // log and emit gpuStatsUpdated() of the rolling GPU time per stage
+    QString glRenderer() const { return m_glRenderer; } // the GL_RENDERER string, the key of the profiles
+    void render(); // both passes into the default framebuffer, for the hosts without Qt Quick
+    QImage readFrame(); // the linear RGB of the last color pass as RGBA64, for the checks of ColorConverter
+    void setViewportSize(const QSize &size); // in pixels, of the offscreen rendering only
+    void setTargetFramebuffer(GLuint fbo); // of the display pass, 0 is the default one of the context
 
 public slots:
     void setDebugOpenGL(bool yes);
 
 signals:
     void errorOccurred(const QString &text);
+    void renderScaleChanged(qreal scale); // emitted from the render thread
+    void frameTimed(qint64 cpuTime, qint64 gpuTime); // ns of the render thread and of the GPU if known else -1
+    void gpuStatsUpdated(const QList<GpuTimer::Stats> &stats); // per GpuStage then the frame, every GpuTimer::statsFrames
 
 private:
     void emitErrorOccured(const QString &text);
+    QRhi *sceneRhi() const; // of the decoder textures to import, null without the scene graph
     void onWidthChanged(int width);
     void onHeightChanged(int height);
     void onBeforeRendering();
     void onBeforeRenderPassRecording();
     GLuint setQuadVaoBuffer();
     GLuint setCubeVaoBuffer();
-    QString getShaderSource(const QString &name) const;
+    bool setMeshVaoBuffer();
+    QString getShaderSource(const QString &name, const QString &extensions = QString()) const;
     bool initFunctions();
+    void setPlaneSwizzle(GLint r, GLint g, GLint b, GLint a);
+    void uploadPlane(int plane, GLint internalFormat, GLenum format, GLenum type, int pixelSize, int width, int height);
+    void uploadPlane16(int plane, int channels, int width, int height);
+    bool setFrameGrid(const QSize &size);
     bool frameToTexture();
-    bool textureToView(float xOffs);
-    void renderDisplay(bool first);
-
-    QPointer<QQuickWindow> m_window;
+    bool uploadPlanes(int &planeFormat);
+    bool importFrameTextures();
+    bool planesToFrame(int planeFormat, bool external, const GLuint *planeTexs, int planeCount);
+    bool drawPlanes(int planeFormat, bool external, const GLuint *planeTexs, int planeCount);
+    bool updateTiles();
+    bool uploadCachedFrame();
+    void publishFrame();
+    bool acquireSourceFrame();
+    bool textureToView();
+    bool renderOverlays(const QMatrix4x4 &projection, int eyes);
+    void updateGpuTimer(); // collects the results of a past frame
+    void updateRenderScale();
+    void reportGpuStats();
+    void captureView();
+    bool readCaptures(); // the finished readbacks only, true if any pending
+    void renderDisplay(int eye);
+    bool compactTextures() const { return m_openGLES || m_profile.compactTextures; }
+
+    QPointer<QWindow> m_window;
+#ifndef PANORAMA_NO_QUICK
+    QPointer<QQuickWindow> m_quickWindow; // if in its scene graph
+#endif
+    bool m_offscreen; // no window at all
+    GLuint m_targetFbo;
     bool m_openGLES;
     bool m_anisotropic;
     bool m_initialized;
+    bool m_zeroCopy; // capability of the context
+    bool m_externalOES;
+    bool m_importFrames; // requested by user
+    bool m_norm16; // GL_R16 and GL_RG16 textures are renderable
+    bool m_etc2; // GL_COMPRESSED_SRGB8_ETC2 textures
+    GLint m_maxTextureSize;
+    GLint m_maxTextureLayers;
 
     QPointer<QOpenGLDebugLogger> m_debugLog;
     QMatrix4x4 m_projection, m_orientation;
+    float m_fovTan;
+    QRectF m_coverage; // of the frame in the normalized full sphere, top-left origin
+
     int m_rotateDisplay;
     qreal m_stereoShift;
+    int m_stereoMode;
+    int m_frameProjection;
+    int m_cubemapPadding; // in pixels
 
     qint64 m_frameCount;
+    qint64 m_frameConverted; // the m_frameCount of the last converted frame
     bool m_renderFrame;
     QVideoFrame m_videoFrame;
 
     GLuint m_planeTexs[3], m_frameTex, m_frameFbo;
+    GLuint m_frameArrayTex; // the frame slabs as layers
+    QSize m_frameGrid, m_slabSize;
+    QRect m_uploadRect; // the slab region of the frame to upload
+    bool m_frameSplit16;
     VideoFrameExt m_frameExt;
     QSize m_frameSize;
     QOpenGLShaderProgram m_colorProg;
@@ -70,10 +178,71 @@ private:
     GLuint m_viewTex, m_quadVao, m_cubeVao;
     QSize m_viewSize;
     QOpenGLShaderProgram m_viewProg;
+    bool m_viewSlabs;
+    bool m_viewMesh; // the partial sphere mesh instead of the cube
+    int m_viewProjection;
+    GLuint m_meshVao, m_meshBufs[3];
+    GLsizei m_meshIndices;
+    QRectF m_meshCoverage;
+    bool m_viewTiles; // the detail tiles are ready for this frame
+    bool m_viewProgTiles;
+
+    QSharedPointer<TilePyramid> m_tilePyramid;
+    GLuint m_tileAtlasTex, m_tileTableTex;
+    QSize m_tileSlots; // the atlas grid
+    int m_tileLevel;
+    QSize m_tileGrid; // the tiles of the level
+    QByteArray m_tileTable; // per tile RGBA8 texel: atlas slot column, row, 0, resident
+    bool m_tileTableDirty;
+    QHash<quint64, int> m_tileSlotOf; // level:index to the atlas slot
+    QVector<quint64> m_slotTile;
+    QVector<qint64> m_slotUsed; // the m_tileFrame of the last use for LRU
+    qint64 m_tileFrame;
+
+    QString m_glRenderer;
+    RenderProfile m_profile;
+    bool m_frameTiming;
+    qint64 m_cpuTime; // of the frame so far in ns
+    int m_gpuBudget;
+    bool m_gpuStats;
+    int m_gpuStatsFrames; // of the results since the last report
+    QScopedPointer<GpuTimer> m_gpuTimer;
+    ResolutionScaler m_scaler;
+
+    QSharedPointer<LoopCache> m_loopCache;
+    int m_cacheIndex; // of the frame to show
+    GLuint m_cacheTex;
+    QSize m_cacheSize; // of the texture
+
+    OverlayAtlas::Batch m_overlays;
+    bool m_overlaysDirty; // the instances to upload
+    qint64 m_overlayAtlasSerial; // of the uploaded atlas
+    GLuint m_overlayTex, m_overlayVao, m_overlayBuf;
+    QOpenGLShaderProgram m_overlayProg;
 
     GLuint m_depthTex, m_viewFbo;
     QSize m_viewportSize;
     QOpenGLShaderProgram m_dispProg;
+    bool m_monoDisplay;
+
+    QSharedPointer<SharedFrame> m_frameShare; // of this producer if any consumers
+    GLuint m_shareFbo;
+    QSharedPointer<SharedFrame> m_frameSource; // instead of the own frames
+    int m_sourceSlot; // held
+    GLuint m_sourceTex, m_sourceSampler;
+
+    struct CaptureBuffer {
+        GLuint pbo = 0;
+        GLsync fence = nullptr; // of the readback into the pbo
+        QSize size;
+        qint64 timestamp = 0;
+    };
+    int m_captureRate, m_captureWidth;
+    QScopedPointer<CaptureRing> m_captureRing;
+    QElapsedTimer m_captureTimer;
+    GLuint m_captureTex, m_captureFbos[2]; // read, draw
+    QSize m_captureSize;
+    CaptureBuffer m_captureBufs[captureBuffers];
 };
 
 #endif // VIDEORENDERER_H
@@ -0,0 +1,177 @@
+#include <QGuiApplication>
+#include <QCommandLineParser>
+#include <QOpenGLContext>
+#include <QSurfaceFormat>
+#include <QFileInfo>
+#include <QtDebug>
+
+#include "BatchJob.h"
+#include "CameraPath.h"
+#include "SphericalMetadata.h"
+
+// The flat "director's cut" of a 360 clip by the player's renderer, without a window:
+//
+//     panoramabatch -p path.txt -s 1920x1080 clip360.mp4 preview.mp4
+//     panoramabatch -p path.txt clip360.mp4 - | ffmpeg -f rawvideo -pix_fmt rgb0 -s 1920x1080 -r 30 -i - ...
+
+static QRectF parseCoverage(const QString &text) // as PanoramaOutput::parseCoverage()
+{
+    const QString mode = text.trimmed().toLower();
+    if (mode == "360") return QRectF(-180.0, -90.0, 360.0, 180.0);
+    if (mode == "180") return QRectF(-90.0, -90.0, 180.0, 180.0);
+    const auto list = mode.split(',');
+    if (list.size() != 4) return QRectF();
+    qreal val[4];
+    for (int i = 0; i < 4; i++) {
+        bool ok = false;
+        val[i] = list.at(i).toDouble(&ok);
+        if (!ok) return QRectF();
+    }
+    return QRectF(QPointF(qBound(-180.0, val[0], 180.0), qBound(-90.0, val[2], 90.0)),
+                  QPointF(qBound(-180.0, val[1], 180.0), qBound(-90.0, val[3], 90.0))).normalized();
+}
+
+int main(int argc, char *argv[])
+{
+    // Never a window. Unless another platform is asked for, the offscreen one on an X display
+    // (it takes GLX), else EGL without any surface as on a headless runner with llvmpipe
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        if (qEnvironmentVariableIsEmpty("DISPLAY")) {
+            qputenv("QT_QPA_PLATFORM", "eglfs");
+            if (qEnvironmentVariableIsEmpty("QT_QPA_EGLFS_INTEGRATION"))
+                qputenv("QT_QPA_EGLFS_INTEGRATION", "none"); // no KMS, no screen taken
+            if (qEnvironmentVariableIsEmpty("EGL_PLATFORM"))
+                qputenv("EGL_PLATFORM", "surfaceless"); // of Mesa
+        } else {
+            qputenv("QT_QPA_PLATFORM", "offscreen");
+        }
+    }
+    QGuiApplication app(argc, argv);
+    app.setApplicationDisplayName(QStringLiteral("Flat view batch renderer of the 360 video clips"));
+    app.setApplicationName(QStringLiteral("PanoramaPlayer")); // the same render profiles
+    app.setOrganizationName(QStringLiteral("Rpi5VRproject"));
+    app.setApplicationVersion(QStringLiteral("1.0"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(app.applicationDisplayName());
+    parser.addHelpOption();
+    parser.addVersionOption();
+    QCommandLineOption debugOption({ "d", "debug" }, QStringLiteral("Enable OpenGL debugging output"));
+    parser.addOption(debugOption);
+#if !defined(Q_OS_MACOS) && !defined(Q_PROCESSOR_ARM)
+    QCommandLineOption glesOption({ "e", "gles" }, QStringLiteral("Use OpenGLES instead of OpenGL"));
+    parser.addOption(glesOption);
+#endif
+    QCommandLineOption pathOption({ "p", "path" }, QStringLiteral("The camera path <file> of the lines: seconds yaw pitch [fov], in degree, a still camera ahead if omitted"), QStringLiteral("file"));
+    parser.addOption(pathOption);
+    QCommandLineOption sizeOption({ "s", "size" }, QStringLiteral("The output <size> in pixels"), QStringLiteral("size"), QStringLiteral("1920x1080"));
+    parser.addOption(sizeOption);
+    QCommandLineOption durationOption({ "t", "duration" }, QStringLiteral("Render the first <seconds> of the source only"), QStringLiteral("seconds"));
+    parser.addOption(durationOption);
+    QCommandLineOption projOption({ "projection" }, QStringLiteral("The source <projection>: 360, 180 for VR180, lonMin,lonMax,latMin,latMax in degree or eac (equi-angular cubemap), by the video metadata if omitted"), QStringLiteral("projection"));
+    parser.addOption(projOption);
+    QCommandLineOption stereoOption({ "stereo" }, QStringLiteral("The source stereo <mode>: mono, tb (top-bottom) or sbs (side-by-side), by the video metadata if omitted, the left eye is rendered"), QStringLiteral("mode"));
+    parser.addOption(stereoOption);
+    parser.addPositionalArgument(QStringLiteral("source"), QStringLiteral("The 360 video file"));
+    parser.addPositionalArgument(QStringLiteral("output"), QStringLiteral("The .mp4, .mkv, .mov or .webm file to encode, or the raw RGBX frames into a .rgba file or - for stdout"));
+    parser.process(app);
+    const auto args = parser.positionalArguments();
+    if (args.size() != 2) parser.showHelp(1);
+
+    const auto sizeParts = parser.value(sizeOption).trimmed().toLower().split('x');
+    QSize size(sizeParts.value(0).toInt(), sizeParts.value(1).toInt());
+    if (sizeParts.size() != 2 || size.width() < 64 || size.height() < 64 || size.width() > 8192 ||
+            size.height() > 8192 || (size.width() & 1) || (size.height() & 1)) {
+        qCritical().noquote() << "Bad output size:" << parser.value(sizeOption);
+        return 1;
+    }
+    qint64 duration = 0;
+    if (parser.isSet(durationOption)) {
+        bool ok = false;
+        duration = qRound64(parser.value(durationOption).toDouble(&ok) * 1000.0);
+        if (!ok || duration <= 0) {
+            qCritical().noquote() << "Bad duration:" << parser.value(durationOption);
+            return 1;
+        }
+    }
+    CameraPath path;
+    if (parser.isSet(pathOption)) {
+        QString errorText;
+        path = CameraPath::load(parser.value(pathOption), &errorText);
+        if (path.isEmpty()) {
+            qCritical().noquote() << errorText;
+            return 1;
+        }
+    }
+
+    // The source layout by its metadata as the player does, then by the options
+
+    int stereoMode = SphericalMetadata::StereoMono;
+    QRectF coverage;
+    int projection = 0, padding = 0; // VideoRenderer::setFrameProjection()
+    const auto meta = SphericalMetadata::read(args.at(0));
+    if (meta.isSpherical()) {
+        stereoMode = meta.stereoMode();
+        coverage = meta.coverage();
+        if (meta.projection() == SphericalMetadata::ProjectionCubemap && meta.cubemapLayout() == 0) {
+            projection = 1;
+            padding = meta.cubemapPadding();
+        }
+    }
+    if (parser.isSet(stereoOption)) {
+        const QString mode = parser.value(stereoOption).trimmed().toLower();
+        if (mode == "mono") stereoMode = SphericalMetadata::StereoMono;
+        else if (mode == "tb") stereoMode = SphericalMetadata::StereoTopBottom;
+        else if (mode == "sbs") stereoMode = SphericalMetadata::StereoSideBySide;
+        else {
+            qCritical().noquote() << "Bad stereo mode:" << parser.value(stereoOption);
+            return 1;
+        }
+    }
+    if (parser.value(projOption).trimmed().toLower() == "eac") {
+        projection = 1;
+        coverage = QRectF();
+    } else if (parser.isSet(projOption)) {
+        projection = padding = 0;
+        coverage = parseCoverage(parser.value(projOption));
+        if (coverage.isEmpty()) {
+            qCritical().noquote() << "Bad projection coverage:" << parser.value(projOption);
+            return 1;
+        }
+    }
+
+    QSurfaceFormat format = QSurfaceFormat::defaultFormat();
+#if defined(Q_OS_MACOS)
+    format.setVersion(4, 1);
+    format.setProfile(QSurfaceFormat::CoreProfile);
+#elif defined(Q_PROCESSOR_ARM)
+    format.setRenderableType(QSurfaceFormat::OpenGLES);
+    format.setVersion(3, 1);
+#else
+    if (parser.isSet(glesOption))
+        format.setRenderableType(QSurfaceFormat::OpenGLES);
+    if (format.renderableType() == QSurfaceFormat::OpenGLES ||
+            QOpenGLContext::openGLModuleType() == QOpenGLContext::LibGLES) {
+        format.setVersion(3, 1);
+    } else {
+        format.setVersion(3, 3);
+        format.setProfile(QSurfaceFormat::CoreProfile);
+    }
+#endif
+    QSurfaceFormat::setDefaultFormat(format);
+
+    BatchJob job;
+    if (!job.open(args.at(0), args.at(1), size, parser.isSet(debugOption))) {
+        qCritical().noquote() << job.errorText();
+        return 1;
+    }
+    job.setSourceLayout(stereoMode, coverage, projection, padding);
+    job.setCameraPath(path);
+    job.setDuration(duration);
+    QObject::connect(&job, &BatchJob::finished, &app, [&job](bool ok) {
+        if (!ok) qCritical().noquote() << job.errorText();
+        QCoreApplication::exit(ok ? 0 : 1);
+    }, Qt::QueuedConnection);
+    job.start();
+    return app.exec();
+}
@@ -0,0 +1,207 @@
+#include <QGuiApplication>
+#include <QScreen>
+#include <QCommandLineParser>
+#include <QOpenGLContext>
+#include <QSurfaceFormat>
+#include <QFile>
+#include <QElapsedTimer>
+#include <QtDebug>
+
+#include "PanoramaOutput.h"
+#include "Kiosk.h"
+#include "KioskWindow.h"
+#include "PosePredictor.h"
+#include "SerialSensor.h"
+
+#include <unistd.h>
+
+// The lightweight frontend of the player on the small boards: a plain OpenGL window and
+// the objects of Main.qml wired in C++, not linked to Qt Qml, Qt Quick and its controls,
+// so none of them is loaded. The video source and the settings come by ConfigReceiver:
+//
+//     panoramakiosk --fullscreen --prediction 50
+
+// The time from the process start to the first frame on screen and the resident memory then
+static void reportStartup(const QElapsedTimer &timer)
+{
+    qint64 rss = 0;
+    QFile statm(QStringLiteral("/proc/self/statm"));
+    if (statm.open(QIODevice::ReadOnly)) {
+        const auto fields = statm.readAll().split(' ');
+        rss = fields.value(1).toLongLong() * sysconf(_SC_PAGESIZE);
+    }
+    qInfo().noquote() << "Kiosk frontend: first frame in" << timer.elapsed() << "ms, RSS"
+                      << (rss ? QString::number(rss / (1024 * 1024)) + " MB" : QStringLiteral("unknown"));
+}
+
+int main(int argc, char *argv[])
+{
+    QElapsedTimer startTimer;
+    startTimer.start();
+
+    QGuiApplication app(argc, argv);
+    app.setApplicationDisplayName(QStringLiteral("Stereo video Panorama Player kiosk for virtual reality glasses"));
+    app.setApplicationName(QStringLiteral("PanoramaPlayer"));
+    app.setOrganizationName(QStringLiteral("Rpi5VRproject"));
+    app.setApplicationVersion(QStringLiteral("1.0"));
+
+    QString descrText = app.applicationDisplayName();
+    const auto screenList = app.screens();
+    if (!screenList.isEmpty()) {
+        descrText += QStringLiteral("\n    Available output screens (see --output option):");
+        for (int i = 0; i < screenList.size(); i++) {
+            const auto scr = screenList.at(i);
+            descrText += QString("\n\t%1%2: %3 (%4 %5x%6/%7)")
+                    .arg(scr == app.primaryScreen() ? '*' : ' ').arg(i).arg(scr->name()).arg(scr->model())
+                    .arg(scr->size().width()).arg(scr->size().height()).arg(scr->refreshRate());
+        }
+    }
+    QCommandLineParser parser;
+    parser.setApplicationDescription(descrText);
+    parser.addHelpOption();
+    parser.addVersionOption();
+    QCommandLineOption debugOption({ "d", "debug" }, QStringLiteral("Enable OpenGL debugging output"));
+    parser.addOption(debugOption);
+#if !defined(Q_OS_MACOS) && !defined(Q_PROCESSOR_ARM)
+    QCommandLineOption glesOption({ "e", "gles" }, QStringLiteral("Use OpenGLES instead of OpenGL"));
+    parser.addOption(glesOption);
+#endif
+    QCommandLineOption fullOption({{ "f", "fullscreen" }, QStringLiteral("Full-screen mode, on an ARM processor by default") });
+    parser.addOption(fullOption);
+    QCommandLineOption projOption({ "p", "projection" }, QStringLiteral("The video <projection>: 360, 180 for VR180, lonMin,lonMax,latMin,latMax in degree or eac (equi-angular cubemap), by the video metadata if omitted"), QStringLiteral("projection"));
+    parser.addOption(projOption);
+    QCommandLineOption stereoOption({ "s", "stereo" }, QStringLiteral("The video stereo <mode>: auto (by the video metadata), mono, tb (top-bottom) or sbs (side-by-side)"), QStringLiteral("mode"), QStringLiteral("auto"));
+    parser.addOption(stereoOption);
+    QCommandLineOption outputOption({ "o", "output" }, QStringLiteral("The screen <index> to play video"), QStringLiteral("index"));
+    parser.addOption(outputOption);
+    QCommandLineOption captureOption({ "c", "capture" }, QStringLiteral("Capture the headset view <rate>[:width] times per second into the shared memory /panoramaplay-view for the local readers, 960 pixels wide by default"), QStringLiteral("rate"));
+    parser.addOption(captureOption);
+    QCommandLineOption loopCacheOption({ "l", "loop-cache" }, QStringLiteral("Play the later loops of a clip from its ETC2 compressed frames within the <budget> in MB, kept in RAM or in the files of the optional :directory"), QStringLiteral("budget"));
+    parser.addOption(loopCacheOption);
+    QCommandLineOption gpuBudgetOption({ "gpu-budget" }, QStringLiteral("Scale the view resolution down to keep the GPU time of the view and display passes within the <percent> of the refresh interval"), QStringLiteral("percent"));
+    parser.addOption(gpuBudgetOption);
+    QCommandLineOption gpuStatsOption({ "gpu-stats" }, QStringLiteral("Log the GPU time of the render stages (min/avg/p99 in microseconds) every few seconds"));
+    parser.addOption(gpuStatsOption);
+    QCommandLineOption predictionOption({ "prediction" }, QStringLiteral("Extrapolate the head pose by the gyro rates up to <ms>[:degree] ahead to the measured display time, 50:10 by default, 0 is off"), QStringLiteral("ms"));
+    parser.addOption(predictionOption);
+    QCommandLineOption sensorFilterOption({ "sensor-filter" }, QStringLiteral("Filter the head orientation on every sensor sample by <type>: none, oneeuro, kalman or madgwick (of the gyro, gravity and magnetic field), none by default"), QStringLiteral("type"), QStringLiteral("none"));
+    parser.addOption(sensorFilterOption);
+    parser.process(app);
+
+    QRectF coverage; // by the video metadata if null
+    int projection = PanoramaOutput::ProjectionAuto;
+    if (parser.value(projOption).trimmed().toLower() == "eac") {
+        projection = PanoramaOutput::ProjectionCubemap;
+    } else if (parser.isSet(projOption)) {
+        projection = PanoramaOutput::ProjectionEquirect;
+        coverage = PanoramaOutput::parseCoverage(parser.value(projOption));
+        if (coverage.isEmpty()) {
+            qCritical().noquote() << "Bad projection coverage:" << parser.value(projOption);
+            return 1;
+        }
+    }
+    int stereoMode = PanoramaOutput::parseStereoMode(parser.value(stereoOption));
+    if (stereoMode < PanoramaOutput::StereoAuto) {
+        qCritical().noquote() << "Bad stereo mode:" << parser.value(stereoOption);
+        return 1;
+    }
+
+    int scrIdx = -1; // the primary screen
+    if (parser.isSet(outputOption)) {
+        bool ok = false;
+        scrIdx = parser.value(outputOption).trimmed().toInt(&ok);
+        if (!ok || scrIdx < 0 || scrIdx >= screenList.size()) {
+            qCritical().noquote() << "Bad output screen:" << parser.value(outputOption);
+            return 1;
+        }
+    }
+
+    int captureRate = 0, captureWidth = PanoramaOutput::defaultCaptureWidth;
+    if (parser.isSet(captureOption)) {
+        if (!PanoramaOutput::parseCapture(parser.value(captureOption), &captureRate, &captureWidth)) {
+            qCritical().noquote() << "Bad view capture:" << parser.value(captureOption);
+            return 1;
+        }
+    }
+
+    int gpuBudget = 0;
+    if (parser.isSet(gpuBudgetOption)) {
+        if (!PanoramaOutput::parseGpuBudget(parser.value(gpuBudgetOption), &gpuBudget)) {
+            qCritical().noquote() << "Bad GPU budget:" << parser.value(gpuBudgetOption);
+            return 1;
+        }
+    }
+
+    const bool gpuStats = parser.isSet(gpuStatsOption);
+
+    int prediction = PosePredictor::defaultMaxHorizon;
+    qreal predictionAngle = PosePredictor::defaultMaxAngle;
+    if (parser.isSet(predictionOption)) {
+        if (!PanoramaOutput::parsePrediction(parser.value(predictionOption), &prediction, &predictionAngle)) {
+            qCritical().noquote() << "Bad pose prediction:" << parser.value(predictionOption);
+            return 1;
+        }
+    }
+
+    const int sensorFilter = SerialSensor::parseFilter(parser.value(sensorFilterOption));
+    if (sensorFilter < SerialSensor::FilterNone) {
+        qCritical().noquote() << "Bad sensor filter:" << parser.value(sensorFilterOption);
+        return 1;
+    }
+
+    int loopCacheBudget = 0;
+    QString loopCacheDir;
+    if (parser.isSet(loopCacheOption)) {
+        if (!PanoramaOutput::parseLoopCache(parser.value(loopCacheOption), &loopCacheBudget, &loopCacheDir)) {
+            qCritical().noquote() << "Bad loop cache:" << parser.value(loopCacheOption);
+            return 1;
+        }
+    }
+
+    bool fullScreen = parser.isSet(fullOption);
+    QSurfaceFormat format = QSurfaceFormat::defaultFormat();
+    format.setDepthBufferSize(24);
+    format.setStencilBufferSize(8);
+#if defined(Q_OS_MACOS)
+    format.setVersion(4, 1);
+    format.setProfile(QSurfaceFormat::CoreProfile);
+#elif defined(Q_PROCESSOR_ARM)
+    fullScreen = true;
+    format.setRenderableType(QSurfaceFormat::OpenGLES);
+    format.setVersion(3, 1);
+#else
+    if (parser.isSet(glesOption))
+        format.setRenderableType(QSurfaceFormat::OpenGLES);
+    if (format.renderableType() == QSurfaceFormat::OpenGLES ||
+            QOpenGLContext::openGLModuleType() == QOpenGLContext::LibGLES) {
+        format.setVersion(3, 1);
+    } else {
+        format.setVersion(3, 3);
+        format.setProfile(QSurfaceFormat::CoreProfile);
+    }
+#endif
+    QSurfaceFormat::setDefaultFormat(format);
+
+    // No software fallback without Qt Quick, the kiosk renders by OpenGL only
+    QOpenGLContext probe;
+    if (!probe.create()) {
+        qCritical() << "Can't create OpenGL context" << format;
+        return 1;
+    }
+
+    Kiosk kiosk(parser.isSet(debugOption));
+    kiosk.setStereoMode(stereoMode);
+    kiosk.setCoverage(coverage);
+    kiosk.setProjection(projection);
+    kiosk.setLoopCache(loopCacheBudget, loopCacheDir);
+    kiosk.setCapture(captureRate, captureWidth);
+    kiosk.setGpuBudget(gpuBudget);
+    kiosk.setGpuStats(gpuStats);
+    kiosk.setPrediction(prediction, predictionAngle);
+    kiosk.setSensorFilter(sensorFilter);
+    QObject::connect(kiosk.window(), &KioskWindow::frameSwapped, &app, [&startTimer]() {
+        reportStartup(startTimer);
+    }, Qt::SingleShotConnection);
+    kiosk.show(scrIdx >= 0 ? screenList.at(scrIdx) : nullptr, fullScreen);
+    return app.exec();
+}
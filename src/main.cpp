@@ -9,9 +9,38 @@
 #include <QQmlEngine>
 #include <QQmlContext>
 #include <QDir>
+#include <QFile>
+#include <QElapsedTimer>
+#include <QtDebug>
+
+#include "PanoramaView.h"
+#include "ColorConverter.h"
+#include "RenderTuner.h"
+#include "PosePredictor.h"
+#include "SerialSensor.h"
+
+#include <unistd.h>
+
+// The time from the process start to the first frame on screen and the resident memory then
+static void reportStartup(const QElapsedTimer &timer)
+{
+    qint64 rss = 0;
+    QFile statm(QStringLiteral("/proc/self/statm"));
+    if (statm.open(QIODevice::ReadOnly)) {
+        const auto fields = statm.readAll().split(' ');
+        rss = fields.value(1).toLongLong() * sysconf(_SC_PAGESIZE);
+    }
+    qInfo().noquote() << "Quick frontend: first frame in" << timer.elapsed() << "ms, RSS"
+                      << (rss ? QString::number(rss / (1024 * 1024)) + " MB" : QStringLiteral("unknown"));
+}
 
 int main(int argc, char *argv[])
 {
+    QElapsedTimer startTimer;
+    startTimer.start();
+
+    // The spectator windows render the frame texture converted in the main window's context
+    QCoreApplication::setAttribute(Qt::AA_ShareOpenGLContexts);
     QGuiApplication app(argc, argv);
     app.setApplicationDisplayName(QStringLiteral("Stereo video Panorama Player for virtual reality glasses"));
     app.setApplicationName(QStringLiteral("PanoramaPlayer"));
@@ -39,10 +68,38 @@ int main(int argc, char *argv[])
     QCommandLineOption glesOption({ "e", "gles" }, QStringLiteral("Use OpenGLES instead of OpenGL"));
     parser.addOption(glesOption);
 #endif
+    QCommandLineOption softOption({ "software" }, QStringLiteral("Render on CPU without OpenGL, the fallback if no OpenGL context can be created"));
+    parser.addOption(softOption);
+    QCommandLineOption apiOption({ "g", "graphics-api" }, QStringLiteral("The renderer <api>: opengl (direct OpenGL), vulkan or rhi-opengl (by QRhi) or software"), QStringLiteral("api"), QStringLiteral("opengl"));
+    parser.addOption(apiOption);
+    QCommandLineOption benchOption({ "benchmark" }, QStringLiteral("Measure the CPU color conversion of the software renderer against the OpenGL color pass and exit"));
+    parser.addOption(benchOption);
+    QCommandLineOption tuneOption({ "tune" }, QStringLiteral("Measure the render pipeline configurations on a synthetic clip, save the fastest one for this GPU and exit"));
+    parser.addOption(tuneOption);
+    QCommandLineOption mapOption({ "m", "map-frames" }, QStringLiteral("Always map the video frames to memory, do not import the decoder textures"));
+    parser.addOption(mapOption);
     QCommandLineOption fullOption({{ "f", "fullscreen" }, QStringLiteral("Full-screen mode, on an ARM processor by default") });
     parser.addOption(fullOption);
+    QCommandLineOption projOption({ "p", "projection" }, QStringLiteral("The video <projection>: 360, 180 for VR180, lonMin,lonMax,latMin,latMax in degree or eac (equi-angular cubemap), by the video metadata if omitted"), QStringLiteral("projection"));
+    parser.addOption(projOption);
+    QCommandLineOption stereoOption({ "s", "stereo" }, QStringLiteral("The video stereo <mode>: auto (by the video metadata), mono, tb (top-bottom) or sbs (side-by-side)"), QStringLiteral("mode"), QStringLiteral("auto"));
+    parser.addOption(stereoOption);
     QCommandLineOption outputOption({ "o", "output" }, QStringLiteral("The screen <index> to play video"), QStringLiteral("index"));
     parser.addOption(outputOption);
+    QCommandLineOption spectatorOption({ "x", "spectator" }, QStringLiteral("An extra output of the same decoded video on the screen <index>[:mono|:stereo[:port]], mono for a flat screen by default, a stereo headset follows the sensor on the serial port if given else the main one, repeatable"), QStringLiteral("index"));
+    parser.addOption(spectatorOption);
+    QCommandLineOption captureOption({ "c", "capture" }, QStringLiteral("Capture the headset view <rate>[:width] times per second into the shared memory /panoramaplay-view for the local readers, 960 pixels wide by default"), QStringLiteral("rate"));
+    parser.addOption(captureOption);
+    QCommandLineOption loopCacheOption({ "l", "loop-cache" }, QStringLiteral("Play the later loops of a clip from its ETC2 compressed frames within the <budget> in MB, kept in RAM or in the files of the optional :directory"), QStringLiteral("budget"));
+    parser.addOption(loopCacheOption);
+    QCommandLineOption gpuBudgetOption({ "gpu-budget" }, QStringLiteral("Scale the view resolution down to keep the GPU time of the view and display passes within the <percent> of the refresh interval"), QStringLiteral("percent"));
+    parser.addOption(gpuBudgetOption);
+    QCommandLineOption gpuStatsOption({ "gpu-stats" }, QStringLiteral("Log the GPU time of the render stages (min/avg/p99 in microseconds) every few seconds"));
+    parser.addOption(gpuStatsOption);
+    QCommandLineOption predictionOption({ "prediction" }, QStringLiteral("Extrapolate the head pose by the gyro rates up to <ms>[:degree] ahead to the measured display time, 50:10 by default, 0 is off"), QStringLiteral("ms"));
+    parser.addOption(predictionOption);
+    QCommandLineOption sensorFilterOption({ "sensor-filter" }, QStringLiteral("Filter the head orientation on every sensor sample by <type>: none, oneeuro, kalman or madgwick (of the gyro, gravity and magnetic field), none by default"), QStringLiteral("type"), QStringLiteral("none"));
+    parser.addOption(sensorFilterOption);
     parser.addPositionalArgument(QStringLiteral("source"), QStringLiteral("The URL of the video source to open (video360 format)"));
     parser.process(app);
 
@@ -50,6 +107,120 @@ int main(int argc, char *argv[])
     if (!parser.positionalArguments().isEmpty())
         sourceUrl = QUrl::fromUserInput(parser.positionalArguments().at(0), QDir::currentPath());
 
+    QRectF coverage; // by the video metadata if null
+    int projection = PanoramaView::ProjectionAuto;
+    if (parser.value(projOption).trimmed().toLower() == "eac") {
+        projection = PanoramaView::ProjectionCubemap;
+    } else if (parser.isSet(projOption)) {
+        projection = PanoramaView::ProjectionEquirect;
+        coverage = PanoramaView::parseCoverage(parser.value(projOption));
+        if (coverage.isEmpty()) {
+            qCritical().noquote() << "Bad projection coverage:" << parser.value(projOption);
+            return 1;
+        }
+    }
+    int stereoMode = PanoramaView::parseStereoMode(parser.value(stereoOption));
+    if (stereoMode < PanoramaView::StereoAuto) {
+        qCritical().noquote() << "Bad stereo mode:" << parser.value(stereoOption);
+        return 1;
+    }
+
+    const QString graphicsApi = parser.value(apiOption).trimmed().toLower();
+    if (graphicsApi != "opengl" && graphicsApi != "vulkan" && graphicsApi != "rhi-opengl" && graphicsApi != "software") {
+        qCritical().noquote() << "Bad graphics API:" << parser.value(apiOption);
+        return 1;
+    }
+    const bool vulkan = (graphicsApi == "vulkan");
+
+    int scrIdx = -1; // the primary screen
+    if (parser.isSet(outputOption)) {
+        bool ok = false;
+        scrIdx = parser.value(outputOption).trimmed().toInt(&ok);
+        if (!ok || scrIdx < 0 || scrIdx >= screenList.size()) {
+            qCritical().noquote() << "Bad output screen:" << parser.value(outputOption);
+            return 1;
+        }
+    }
+
+    struct Spectator {
+        int screen;
+        bool monoDisplay;
+        QString sensorPort; // of its own headset, else the orientation of the main output
+    };
+    QList<Spectator> spectators;
+    const auto spectatorList = parser.values(spectatorOption);
+    for (const auto &value : spectatorList) {
+        const auto parts = value.trimmed().split(':');
+        bool ok = false;
+        int index = parts.at(0).toInt(&ok);
+        const QString mode = parts.value(1, QStringLiteral("mono")).toLower();
+        const QString port = parts.value(2);
+        if (!ok || index < 0 || index >= screenList.size() || parts.size() > 3 || (mode != "mono" && mode != "stereo") ||
+                (parts.size() > 2 && (mode != "stereo" || port.isEmpty()))) {
+            qCritical().noquote() << "Bad spectator output:" << value;
+            return 1;
+        }
+        spectators.append({ index, mode == "mono", port });
+    }
+    if (!spectators.isEmpty() && graphicsApi != "opengl") {
+        qCritical().noquote() << "The spectator outputs require the opengl graphics API";
+        return 1;
+    }
+
+    int captureRate = 0, captureWidth = PanoramaView::defaultCaptureWidth;
+    if (parser.isSet(captureOption)) {
+        if (!PanoramaOutput::parseCapture(parser.value(captureOption), &captureRate, &captureWidth)) {
+            qCritical().noquote() << "Bad view capture:" << parser.value(captureOption);
+            return 1;
+        }
+        if (graphicsApi != "opengl") {
+            qCritical().noquote() << "The view capture requires the opengl graphics API";
+            return 1;
+        }
+    }
+
+    int gpuBudget = 0;
+    if (parser.isSet(gpuBudgetOption)) {
+        if (!PanoramaOutput::parseGpuBudget(parser.value(gpuBudgetOption), &gpuBudget)) {
+            qCritical().noquote() << "Bad GPU budget:" << parser.value(gpuBudgetOption);
+            return 1;
+        }
+        if (graphicsApi != "opengl") {
+            qCritical().noquote() << "The GPU budget requires the opengl graphics API";
+            return 1;
+        }
+    }
+
+    const bool gpuStats = parser.isSet(gpuStatsOption);
+    if (gpuStats && graphicsApi != "opengl") {
+        qCritical().noquote() << "The GPU stats require the opengl graphics API";
+        return 1;
+    }
+
+    int prediction = PosePredictor::defaultMaxHorizon;
+    qreal predictionAngle = PosePredictor::defaultMaxAngle;
+    if (parser.isSet(predictionOption)) {
+        if (!PanoramaOutput::parsePrediction(parser.value(predictionOption), &prediction, &predictionAngle)) {
+            qCritical().noquote() << "Bad pose prediction:" << parser.value(predictionOption);
+            return 1;
+        }
+    }
+
+    const int sensorFilter = SerialSensor::parseFilter(parser.value(sensorFilterOption));
+    if (sensorFilter < SerialSensor::FilterNone) {
+        qCritical().noquote() << "Bad sensor filter:" << parser.value(sensorFilterOption);
+        return 1;
+    }
+
+    int loopCacheBudget = 0;
+    QString loopCacheDir;
+    if (parser.isSet(loopCacheOption)) {
+        if (!PanoramaOutput::parseLoopCache(parser.value(loopCacheOption), &loopCacheBudget, &loopCacheDir)) {
+            qCritical().noquote() << "Bad loop cache:" << parser.value(loopCacheOption);
+            return 1;
+        }
+    }
+
     bool fullScreen = parser.isSet(fullOption);
     QSurfaceFormat format = QSurfaceFormat::defaultFormat();
     // Qt Quick may need a depth and stencil buffer. Always make sure these are available.
@@ -74,22 +245,51 @@ int main(int argc, char *argv[])
     }
 #endif
     QSurfaceFormat::setDefaultFormat(format);
-    QQuickWindow::setGraphicsApi(QSGRendererInterface::OpenGL);
+    if (parser.isSet(benchOption))
+        return ColorConverter::benchmark() ? 1 : 0; // the GPU color pass in the default format
+
+    bool software = parser.isSet(softOption) || graphicsApi == "software";
+    if (!software && !vulkan) {
+        QOpenGLContext probe;
+        if (!probe.create()) {
+            qWarning() << "Can't create OpenGL context" << format << "- fallback to the software renderer";
+            software = true;
+        }
+    }
+    if (parser.isSet(tuneOption) && (software || graphicsApi != "opengl")) {
+        qCritical().noquote() << "The tuning requires the opengl graphics API";
+        return 1;
+    }
+    QQuickWindow::setGraphicsApi(software ? QSGRendererInterface::Software :
+                                 vulkan ? QSGRendererInterface::Vulkan : QSGRendererInterface::OpenGL);
 
     QQuickView view;
     auto engine = view.engine();
     auto context = engine->rootContext();
     context->setContextProperty(QStringLiteral("appDebugOpenGL"), parser.isSet(debugOption));
     context->setContextProperty(QStringLiteral("appSourceUrl"), sourceUrl);
+    context->setContextProperty(QStringLiteral("appZeroCopy"), !parser.isSet(mapOption));
+    context->setContextProperty(QStringLiteral("appRhiRenderer"), graphicsApi == "rhi-opengl");
+    context->setContextProperty(QStringLiteral("appCaptureRate"), captureRate);
+    context->setContextProperty(QStringLiteral("appCaptureWidth"), captureWidth);
+    context->setContextProperty(QStringLiteral("appGpuBudget"), gpuBudget);
+    context->setContextProperty(QStringLiteral("appGpuStats"), gpuStats);
+    context->setContextProperty(QStringLiteral("appPrediction"), prediction);
+    context->setContextProperty(QStringLiteral("appPredictionAngle"), predictionAngle);
+    context->setContextProperty(QStringLiteral("appSensorFilter"), sensorFilter);
+    context->setContextProperty(QStringLiteral("appLoopCache"), loopCacheBudget);
+    context->setContextProperty(QStringLiteral("appLoopCacheDir"), loopCacheDir);
+    context->setContextProperty(QStringLiteral("appCoverage"), coverage);
+    context->setContextProperty(QStringLiteral("appStereoMode"), stereoMode);
+    context->setContextProperty(QStringLiteral("appProjection"), projection);
     QObject::connect(engine, &QQmlEngine::quit, &view, &QQuickView::close);
 
-    view.setSurfaceType(QSurface::OpenGLSurface);
+    view.setSurfaceType(software ? QSurface::RasterSurface :
+                        vulkan ? QSurface::VulkanSurface : QSurface::OpenGLSurface);
     view.setResizeMode(QQuickView::SizeRootObjectToView);
     view.setMinimumSize(QSize(640, 360));
     view.setVisibility(QWindow::AutomaticVisibility);
-    int scrIdx = parser.value(outputOption).toUInt();
-    if (scrIdx >= 0 && scrIdx < screenList.size())
-        view.setScreen(screenList.at(scrIdx));
+    if (scrIdx >= 0) view.setScreen(screenList.at(scrIdx));
     if (fullScreen) {
         auto geometry = view.screen()->geometry();
         view.setX(geometry.x());
@@ -101,14 +301,49 @@ int main(int argc, char *argv[])
         view.resize(QSize(1280, 720)); // HD-ready resolution by default
     }
 
-    QObject::connect(&view, &QQuickView::statusChanged, &app, [&view,fullScreen](QQuickView::Status st) {
+    if (parser.isSet(tuneOption)) {
+        // Just the panorama item, the profile is loaded by the GPU from now on
+        auto panoramaView = new PanoramaView(view.contentItem());
+        panoramaView->setSize(view.size());
+        RenderTuner tuner(panoramaView);
+        QObject::connect(&tuner, &RenderTuner::finished, &app, [](bool ok) { QCoreApplication::exit(ok ? 0 : 1); }, Qt::QueuedConnection);
+        view.show();
+        tuner.start();
+        return app.exec();
+    }
+
+    QList<QQuickView *> spectatorViews;
+    QObject::connect(&view, &QQuickView::statusChanged, &app, [&view,&spectatorViews,spectators,fullScreen](QQuickView::Status st) {
         if (st == QQuickView::Error) QCoreApplication::exit(-1);
         else if (st == QQuickView::Ready) {
             if (!fullScreen) view.show();
             else view.showFullScreen();
+
+            // The extra outputs in the same engine render the frames of the main view,
+            // the video is decoded and converted once for all
+            for (const auto &spectator : spectators) {
+                auto spectatorView = new QQuickView(view.engine(), nullptr);
+                spectatorView->setSurfaceType(QSurface::OpenGLSurface);
+                spectatorView->setResizeMode(QQuickView::SizeRootObjectToView);
+                spectatorView->setScreen(QGuiApplication::screens().at(spectator.screen));
+                spectatorView->setInitialProperties({
+                    { QStringLiteral("frameSource"), QVariant::fromValue(view.rootObject()) },
+                    { QStringLiteral("monoDisplay"), spectator.monoDisplay },
+                    { QStringLiteral("sensorPort"), spectator.sensorPort }
+                });
+                spectatorView->setSource(QUrl("qrc:///PanoramaPlayer/Spectator.qml"));
+                spectatorView->setGeometry(spectatorView->screen()->geometry());
+                spectatorView->showFullScreen();
+                spectatorViews.append(spectatorView);
+            }
         }
     }, Qt::QueuedConnection);
 
+    QObject::connect(&view, &QQuickView::frameSwapped, &app, [&startTimer]() {
+        reportStartup(startTimer);
+    }, Qt::SingleShotConnection);
     view.setSource(QUrl("qrc:///PanoramaPlayer/Main.qml"));
-    return app.exec();
+    int result = app.exec();
+    qDeleteAll(spectatorViews); // before the main view, the frame source
+    return result;
 }
@@ -0,0 +1,144 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QFile>
+#include <QtDebug>
+
+#include "SerialSensor.h"
+#include "PoseRing.h"
+#include "PosePredictor.h"
+#include "SensorTrace.h"
+
+#include <csignal>
+#include <unistd.h>
+#include <sys/mman.h>
+
+// The head tracker daemon: keeps the sensor port open and initialized across the player
+// restarts and publishes the orientation into the shared memory ring for the local readers:
+//
+//     panoramatracker -p ttyAMA0 &
+//     panoramaplay clip360.mp4
+//
+// The traces of --record are replayed by --benchmark to tune the pose prediction and to
+// compare the sensor filters:
+//
+//     panoramatracker -p ttyAMA0 -f 100 --record head.trace
+//     panoramatracker --benchmark head.trace --prediction 50:10
+
+static void onSignal(int)
+{
+    // The readers see the object gone at once, the port is released by the kernel
+    shm_unlink(poseRingName);
+    _exit(0);
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    app.setApplicationName(QStringLiteral("PanoramaTracker"));
+    app.setOrganizationName(QStringLiteral("Rpi5VRproject"));
+    app.setApplicationVersion(QStringLiteral("1.0"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Head tracker daemon publishing the sensor orientation into the shared memory %1").arg(poseRingName));
+    parser.addHelpOption();
+    parser.addVersionOption();
+    QCommandLineOption portOption({ "p", "port" }, QStringLiteral("The serial <port> of the sensor"), QStringLiteral("port"), QStringLiteral("ttyAMA0"));
+    parser.addOption(portOption);
+    QCommandLineOption baudOption({ "b", "baud-rate" }, QStringLiteral("The serial port <rate>: 9600, 19200, 38400, 57600 or 115200"), QStringLiteral("rate"), QString::number(SerialSensor::BaudRate115200));
+    parser.addOption(baudOption);
+    QCommandLineOption freqOption({ "f", "frequency" }, QStringLiteral("The report rate of the sensor in <hz>, 1..250"), QStringLiteral("hz"), QString::number(SerialSensor::defaultFrequency));
+    parser.addOption(freqOption);
+    QCommandLineOption compassOption({ "c", "compass" }, QStringLiteral("Fuse the magnetic field until a reader asks otherwise"));
+    parser.addOption(compassOption);
+    QCommandLineOption recordOption({ "r", "record" }, QStringLiteral("Also write the samples with the gyro rates into the trace <file>"), QStringLiteral("file"));
+    parser.addOption(recordOption);
+    QCommandLineOption benchOption({ "benchmark" }, QStringLiteral("Replay the trace <file> of --record, print the pose prediction error and the latency it saves, the lag and jitter of the sensor filters, then exit"), QStringLiteral("file"));
+    parser.addOption(benchOption);
+    QCommandLineOption predictionOption({ "prediction" }, QStringLiteral("The pose prediction clamping of --benchmark: <ms>[:degree], 50:10 by default"), QStringLiteral("ms"));
+    parser.addOption(predictionOption);
+    parser.process(app);
+
+    if (parser.isSet(benchOption)) {
+        int horizon = PosePredictor::defaultMaxHorizon;
+        qreal angle = PosePredictor::defaultMaxAngle;
+        if (parser.isSet(predictionOption)) {
+            const auto parts = parser.value(predictionOption).trimmed().split(':');
+            bool msOk = false, angleOk = true;
+            horizon = parts.at(0).toInt(&msOk);
+            if (parts.size() > 1) angle = parts.at(1).toDouble(&angleOk);
+            if (!msOk || !angleOk || parts.size() > 2 || horizon < 1 || horizon > 500 || angle <= 0.0 || angle > 90.0) {
+                qCritical().noquote() << "Bad pose prediction:" << parser.value(predictionOption);
+                return 1;
+            }
+        }
+        const int result = PosePredictor::benchmark(parser.value(benchOption), horizon, angle);
+        return result ? result : SensorTrace::benchmarkFilters(parser.value(benchOption));
+    }
+
+    bool baudOk = false, freqOk = false;
+    const int baudRate = parser.value(baudOption).toInt(&baudOk);
+    const int frequency = parser.value(freqOption).toInt(&freqOk);
+    if (!baudOk || !freqOk || frequency < 1 || frequency > 250) {
+        qCritical().noquote() << "Bad baud rate or frequency:" << parser.value(baudOption) << parser.value(freqOption);
+        return 1;
+    }
+
+    // One daemon only, a second one would replace the ring of the first
+    PoseRing probe;
+    if (probe.attach()) {
+        qCritical().noquote() << "The tracker daemon is already running";
+        return 1;
+    }
+
+    SerialSensor sensor;
+    QObject::connect(&sensor, &SerialSensor::errorTextChanged, &app, [&sensor]() {
+        if (!sensor.errorText().isEmpty()) qCritical().noquote() << sensor.errorText();
+    });
+    QObject::connect(&sensor, &SerialSensor::calibratingChanged, &app, [&sensor]() {
+        qInfo().noquote() << (sensor.calibrating() ? "Calibration started" : "Calibration finished");
+    });
+    sensor.setUseTracker(false);
+    sensor.setMaxPrediction(0); // the readers predict to their own display time
+    if (!sensor.setPublishPose(true))
+        return 1;
+    std::signal(SIGINT, onSignal);
+    std::signal(SIGTERM, onSignal);
+
+    sensor.setBaudRate(baudRate);
+    sensor.setFrequency(frequency);
+    sensor.setEnableCompass(parser.isSet(compassOption));
+    sensor.setSmoothingFactor(1.0); // the readers smooth
+
+    QFile trace;
+    quint64 traceSerial = 0;
+    if (parser.isSet(recordOption)) {
+        trace.setFileName(parser.value(recordOption));
+        if (!trace.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+            qCritical().noquote() << "Can't create" << trace.fileName() << trace.errorString();
+            return 1;
+        }
+        trace.write(SensorTrace::header());
+        trace.flush();
+        // By its own cursor, the sensor drains the same ring
+        QObject::connect(sensor.sensorThread(), &SensorThread::samplesReady, &app, [&sensor, &trace, &traceSerial]() {
+            const auto &ring = sensor.sensorThread()->samples();
+            const quint64 latest = ring.latest();
+            SensorSample sample;
+            QByteArray lines;
+            for (quint64 serial = qMax(traceSerial + 1, ring.oldest()); serial <= latest; serial++) {
+                if (ring.read(serial, &sample)) lines += SensorTrace::line(sample);
+            }
+            traceSerial = latest;
+            if (!lines.isEmpty()) {
+                trace.write(lines);
+                trace.flush(); // the daemon exits by a signal
+            }
+        });
+    }
+    sensor.setPortName(parser.value(portOption));
+    QObject::connect(&sensor, &SerialSensor::activeChanged, &app, [&sensor]() {
+        if (sensor.active()) qInfo().noquote() << "Publishing" << sensor.portName() << "into" << poseRingName;
+    });
+    sensor.setActive(true);
+    return app.exec();
+}